@@ -40,28 +40,41 @@ CarrierFile::CarrierFile(File file,
     virtual_storage_offset_(0),
     file_loaded_(false),
     file_(file),
+    sort_key_(file.GetRelativePath()),
     encoder_(encoder),
     permutation_(permutation),
     fitness_(std::move(fitness)),
-    virtual_storage_(std::shared_ptr<VirtualStorage>(nullptr)) {
+    virtual_storage_(std::shared_ptr<VirtualStorage>(nullptr)),
+    kernel_(nullptr),
+    counters_(nullptr),
+    stats_format_(StegoStats::GetFormat(file.GetExtension())) {
 
   if (encoder)  {
     data_block_size_ = encoder->GetDataBlockSize();
     codeword_block_size_ = encoder->GetCodewordBlockSize();
   }
+
+  std::transform(sort_key_.begin(), sort_key_.end(), sort_key_.begin(),
+                 ::tolower);
 }
 
 CarrierFile::~CarrierFile() {}
 
-File CarrierFile::GetFile() {
+const File& CarrierFile::GetFile() const {
   return file_;
 }
 
+const std::string& CarrierFile::GetSortKey() const {
+  return sort_key_;
+}
+
 void CarrierFile::UnSetEncoder() {
   SetEncoder(std::shared_ptr<Encoder>(nullptr));
 }
 
 void CarrierFile::SetEncoder(std::shared_ptr<Encoder> encoder) {
+  kernel_.reset();
+
   if (!encoder) {
     data_block_size_ = 1;
     codeword_block_size_ = 1;
@@ -72,15 +85,15 @@ void CarrierFile::SetEncoder(std::shared_ptr<Encoder> encoder) {
     encoder_ = encoder;
     data_block_size_ = encoder->GetDataBlockSize();
     codeword_block_size_ = encoder->GetCodewordBlockSize();
-    block_count_ = static_cast<uint32>((permutation_->GetSizeUsingParams(
-                                          raw_capacity_ * 8, subkey_) / 8)
-                                       / encoder->GetCodewordBlockSize());
+    block_count_ = (permutation_->GetSizeUsingParams(raw_capacity_ * 8,
+                                                     subkey_) / 8)
+                   / encoder->GetCodewordBlockSize();
     capacity_ = block_count_ * encoder->GetDataBlockSize();
   }
 }
 
 uint64 CarrierFile::GetCapacityUsingEncoder(std::shared_ptr<Encoder> encoder) {
-  if (encoder && permutation_) return 0;
+  if (!encoder || !permutation_) return 0;
   uint64 block_count = ((permutation_->GetSizeUsingParams(
                            raw_capacity_ * 8, subkey_) / 8)
                         / encoder->GetCodewordBlockSize());
@@ -91,7 +104,7 @@ uint64 CarrierFile::GetCapacity() {
   return capacity_;
 }
 
-uint32 CarrierFile::GetBlockCount() {
+uint64 CarrierFile::GetBlockCount() {
   return block_count_;
 }
 
@@ -112,8 +125,11 @@ int CarrierFile::AddToVirtualStorage(std::shared_ptr<VirtualStorage> storage,
   virtual_storage_ = storage;
   virtual_storage_offset_ = offset;
 
+  // kernel specialized for the encoder and both permutations
+  if (encoder_) kernel_.reset(new CarrierKernel(encoder_, permutation_, storage));
+
   if (bytes_used) {
-    blocks_used_ = static_cast<uint32>(((bytes_used - 1) / data_block_size_) + 1);
+    blocks_used_ = ((bytes_used - 1) / data_block_size_) + 1;
   } else {
     blocks_used_ = 0;
   }
@@ -122,16 +138,7 @@ int CarrierFile::AddToVirtualStorage(std::shared_ptr<VirtualStorage> storage,
 }
 
 bool CarrierFile::operator< (const CarrierFile& val) const {
-
-  string str_a = file_.GetRelativePath();
-  string str_b = val.file_.GetRelativePath();
-
-  std::transform(str_a.begin(), str_a.end(), str_a.begin(), ::tolower);
-  std::transform(str_b.begin(), str_b.end(), str_b.begin(), ::tolower);
-
-  //LOG_DEBUG("operator< was called for string: " << _relativePath << " vs " << val._relativePath << ", transformed: " << str_a << " vs " << str_b);
-
-  return (str_a.compare(str_b) < 0);
+  return (sort_key_.compare(val.sort_key_) < 0);
 }
 
 bool CarrierFile::CompareByPointers(CarrierFile* a, CarrierFile* b) {
@@ -145,8 +152,8 @@ bool CarrierFile::CompareByPointers(CarrierFile* a, CarrierFile* b) {
   return (*a < *b);
 }
 
-bool CarrierFile::CompareBySharedPointers(std::shared_ptr<CarrierFile> a,
-                                          std::shared_ptr<CarrierFile> b) {
+bool CarrierFile::CompareBySharedPointers(const std::shared_ptr<CarrierFile> &a,
+                                          const std::shared_ptr<CarrierFile> &b) {
   if (a == nullptr)
     return 0;
 
@@ -162,38 +169,51 @@ uint64 CarrierFile::GetRawCapacity() {
   return raw_capacity_;
 }
 
+/**
+ * @brief Sets counters for timing of phases of this carrier (nullptr disables it)
+ */
+void CarrierFile::SetPerfCounters(PerfCounters *counters) {
+  counters_ = counters;
+}
+
+StegoStats::Format CarrierFile::GetStatsFormat() {
+  return stats_format_;
+}
+
 void CarrierFile::SetSubkey(const Key& subkey) {
   this->subkey_ = subkey;
 }
 
-void CarrierFile::SetBitInBufferPermuted(uint64 index) {
-  if (index >= permutation_->GetSize()) {
-    LOG_INFO("CarrierFile::SetBitInBufferPermuted: index " << index <<
-             " is too big!");
+/**
+ * @brief Copies LSBs of samples into the buffer in "locally" permuted order
+ *
+ * @param[in] samples Carrier samples, at least 'count' bytes
+ * @param[in] count Number of samples, at most size of the local permutation
+ */
+void CarrierFile::UnpackBuffer(const uint8* samples, uint64 count) {
+  if (!kernel_) throw std::runtime_error("Carrier is not added to storage!");
+  if (count > permutation_->GetSize() || count > buffer_.GetSize() * 8) {
+    LOG_INFO("CarrierFile::UnpackBuffer: count " << count << " is too big!");
     throw std::out_of_range("Index is out of range!");
   }
 
-  uint64 permuted_index = permutation_->Permute(index);
-
-  if (permuted_index >= permutation_->GetSize()) {
-    LOG_INFO("CarrierFile::SetBitInBufferPermuted: permuted index " << permuted_index << " is too big!");
-    throw std::out_of_range("Permuted index is out of range!");
-  }
-
-  buffer_[permuted_index / 8] |= ( 1 << (permuted_index % 8));
+  kernel_->UnpackBits(samples, count, buffer_.GetRawPointer());
 }
 
-uint8 CarrierFile::GetBitInBufferPermuted(uint64 index) {
-
-  if (index >= permutation_->GetSize()) {
-    LOG_INFO("CarrierFile::GetBitInBufferPermuted: index " << index <<
-             " is too big!");
+/**
+ * @brief Writes "locally" permuted bits of the buffer into LSBs of samples
+ *
+ * @param[in,out] samples Carrier samples, at least 'count' bytes
+ * @param[in] count Number of samples, at most size of the local permutation
+ */
+void CarrierFile::PackBuffer(uint8* samples, uint64 count) {
+  if (!kernel_) throw std::runtime_error("Carrier is not added to storage!");
+  if (count > permutation_->GetSize() || count > buffer_.GetSize() * 8) {
+    LOG_INFO("CarrierFile::PackBuffer: count " << count << " is too big!");
     throw std::out_of_range("Index is out of range!");
   }
 
-  uint64 permuted_index = permutation_->Permute(index);
-
-  return ((buffer_[permuted_index / 8] & (1 << (permuted_index % 8))) != 0);
+  kernel_->PackBits(buffer_.GetConstRawPointer(), count, samples);
 }
 
 int CarrierFile::ExtractBufferUsingEncoder() {
@@ -201,31 +221,14 @@ int CarrierFile::ExtractBufferUsingEncoder() {
   if (!encoder_) return -2;
   if (!codeword_block_size_) return -3;
   if (!blocks_used_) return -4;
+  if (!kernel_) return -5;
 
-  MemoryBuffer data_buffer(data_block_size_);
-
-  for (uint64 b = 0; b < blocks_used_; ++b) {
-    encoder_->Extract(&buffer_[b * codeword_block_size_],
-        data_buffer.GetRawPointer());
-
-    for (uint64 i = 0; i < data_block_size_; ++i) {
-      //TODO:            #warning doriesit try catch!
-      try {
-        virtual_storage_->WriteByte(virtual_storage_offset_ +
-                                    (b * data_block_size_) + i, data_buffer[i]);
-      } catch (std::out_of_range& ex) {
-        LOG_DEBUG("CarrierFile::extractBufferUsingEncoder: "
-                  "virtualStorage->writeByte failed: block: " << (b + 1) << "/"
-                  << blocks_used_ << ", byte: " << (i + 1) << "/" <<
-                  data_block_size_);
-        //TODO: poriesit
-        //LOG_TRACE("CarrierFile::extractBufferUsingEncoder: virtualStorage->writeByte failed: error code: " << errc << ", block: " << (b+1) << "/" << blocks_used_ << ", byte: " << (i+1) << "/" << data_block_size_);
-        // TODO: poriesit ako zistit kedy je to error a kedy koniec uloziska -> to je ok
-        // TODO: virtual_storage_->raw_capacity_ testovat
-        //LOG_ERROR("ERROR WRITING BYTE! error code: " << errc << ", block: " << (b+1) << "/" << blocks_used_ << ", byte: " << (i+1) << "/" << data_block_size_);
-      }
-    }
-  }
+  uint64 data_size = blocks_used_ * data_block_size_;
+
+  PhaseTimer timer(counters_, stats_format_, StegoStats::EXTRACT, data_size);
+  // last block of the last carrier can reach beyond the end of the storage
+  kernel_->ExtractBlocks(buffer_.GetConstRawPointer(), blocks_used_,
+                         virtual_storage_offset_, StorageBytesUsed(data_size));
 
   return 0;
 }
@@ -236,31 +239,37 @@ int CarrierFile::EmbedBufferUsingEncoder() {
   if (!encoder_)  throw std::runtime_error("Encoder is not set!");
   if (!codeword_block_size_)  throw std::runtime_error("Codeword block size si not set!");
   if (!blocks_used_)  throw std::runtime_error("Number of used block is not set!");
+  if (!kernel_)  throw std::runtime_error("Carrier is not added to storage!");
 
-  MemoryBuffer data_buffer(data_block_size_);
-
-  for (uint64 b = 0; b < blocks_used_; ++b) {
-    for (uint64 i = 0; i < data_block_size_; ++i) {
-      //TODO:            #warning doriesit try catch!
-      try {
-        data_buffer[i] = virtual_storage_->ReadByte(virtual_storage_offset_ +
-                                                    (b * data_block_size_) + i);
-      } catch (std::out_of_range& ex) {
-        LOG_DEBUG("CarrierFile::embedBufferUsingEncoder: virtualStorage->"
-                  "readByte failed: block: " << (b + 1) << "/" << blocks_used_
-                  << ", byte: " << (i + 1) << "/" << data_block_size_);
-        //TODO: poriesit ako zistit kedy je to error a kedy koniec uloziska -> to je ok
-        //LOG_ERROR("ERROR READING BYTE! error code: " << errc << ", block: " << (b+1) << "/" << blocks_used_ << ", byte: " << (i+1) << "/" << data_block_size_);
-        data_buffer[i] = 0; // TODO: not sure if random data would be better here
-      }
-    }
-    encoder_->Embed(&buffer_[b * codeword_block_size_],
-        data_buffer.GetConstRawPointer());
-  }
+  uint64 data_size = blocks_used_ * data_block_size_;
+
+  PhaseTimer timer(counters_, stats_format_, StegoStats::EMBED, data_size);
+  // bytes beyond the end of the storage are embedded as zeros
+  uint64 bits_modified = kernel_->EmbedBlocks(buffer_.GetRawPointer(),
+                                              blocks_used_,
+                                              virtual_storage_offset_,
+                                              StorageBytesUsed(data_size));
+  timer.Stop();
+
+  if (counters_) counters_->AddSave(stats_format_, bits_modified, 0);
 
   return 0;
 }
 
+/**
+ * @brief Number of bytes of this carrier's part that really lie in the storage
+ *
+ * @param[in] data_size Size of the carrier's part in bytes (all used blocks)
+ * @return data_size trimmed to the raw capacity of the virtual storage
+ */
+uint64 CarrierFile::StorageBytesUsed(uint64 data_size) {
+  uint64 storage_capacity = virtual_storage_->GetRawCapacity();
+
+  if (virtual_storage_offset_ >= storage_capacity) return 0;
+
+  return std::min(data_size, storage_capacity - virtual_storage_offset_);
+}
+
 
 uint32 CarrierFile::GetWidth() {
   return width_;
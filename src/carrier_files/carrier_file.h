@@ -21,6 +21,7 @@
 #include "utils/stego_types.h"
 #include "utils/file.h"
 #include "utils/memory_buffer.h"
+#include "utils/perf_counters.h"
 #include "logging/logger.h"
 #include "encoders/encoder_factory.h"
 #include "permutations/permutation_factory.h"
@@ -28,6 +29,7 @@
 #include "virtual_storage/virtual_storage.h"
 #include "keys/key.h"
 #include "fitness/fitness.h"
+#include "carrier_kernel.h"
 
 
 namespace stego_disk {
@@ -52,9 +54,11 @@ public:
 
   uint64 GetCapacity();
   uint64 GetRawCapacity();
-  uint32 GetBlockCount();
+  uint64 GetBlockCount();
 
-  File GetFile();
+  const File& GetFile() const;
+  // lowercase relative path, carriers are ordered by it
+  const std::string& GetSortKey() const;
 
   void SetPermutation(std::shared_ptr<Permutation> permutation);
   void UnSetPermutation();
@@ -66,6 +70,9 @@ public:
   virtual void LoadFile() = 0;
   virtual void SaveFile() = 0;
 
+  void SetPerfCounters(PerfCounters *counters);
+  StegoStats::Format GetStatsFormat();
+
   void SetSubkey(const Key& subkey_);
   int AddToVirtualStorage(std::shared_ptr<VirtualStorage> storage, uint64 offSet,
                           uint64 bytes_used);
@@ -78,17 +85,18 @@ public:
   bool operator< (const CarrierFile& val) const;
 
   static bool CompareByPointers(CarrierFile* a, CarrierFile* b);
-  static bool CompareBySharedPointers(std::shared_ptr<CarrierFile> a,
-                                      std::shared_ptr<CarrierFile> b);
+  static bool CompareBySharedPointers(const std::shared_ptr<CarrierFile> &a,
+                                      const std::shared_ptr<CarrierFile> &b);
 
 protected:
   int SetDatesBack();
 
-  void SetBitInBufferPermuted(uint64 index);
-  uint8 GetBitInBufferPermuted(uint64 index);
+  void UnpackBuffer(const uint8* samples, uint64 count);
+  void PackBuffer(uint8* samples, uint64 count);
 
   int ExtractBufferUsingEncoder();
   int EmbedBufferUsingEncoder();
+  uint64 StorageBytesUsed(uint64 data_size);
 
   MemoryBuffer buffer_;
   uint32 width_;
@@ -96,18 +104,22 @@ protected:
   bool is_grayscale_;
   uint32 codeword_block_size_;
   uint32 data_block_size_;
-  uint32 block_count_;
+  uint64 block_count_;
   uint64 capacity_;
   uint64 raw_capacity_;
-  uint32 blocks_used_;
+  uint64 blocks_used_;
   uint64 virtual_storage_offset_;
   bool file_loaded_;
   Key subkey_;
   File file_;
+  std::string sort_key_;
   std::shared_ptr<Encoder> encoder_;
   std::shared_ptr<Permutation> permutation_;
   std::unique_ptr<Fitness> fitness_;
   std::shared_ptr<VirtualStorage> virtual_storage_;
+  std::unique_ptr<CarrierKernel> kernel_;
+  PerfCounters *counters_;
+  StegoStats::Format stats_format_;
 };
 
 } // stego_disk
@@ -71,10 +71,15 @@ void CarrierFileBMP::LoadFile() {
 
   if (file_loaded_) return;
 
+  TraceScope trace("carrier", "LoadFile");
+  if (trace.IsActive()) trace.SetDetail(file_.GetRelativePath());
+
   auto file_ptr = file_.Open();
 
   LOG_INFO("Loading file " << file_.GetRelativePath());
 
+  PhaseTimer decode_timer(counters_, stats_format_, StegoStats::DECODE,
+                          raw_capacity_ * 8);
   MemoryBuffer bitmap_buffer(raw_capacity_ * 8);
 
   fseek(file_ptr.Get(), bmp_offset_, SEEK_SET);
@@ -88,40 +93,40 @@ void CarrierFileBMP::LoadFile() {
   }
 
   uint64 usable_capacity = raw_capacity_;
-  MemoryBuffer* usable_buffer = new MemoryBuffer();
+  MemoryBuffer selected_buffer;
+  MemoryBuffer* usable_buffer = &bitmap_buffer;
 
   if(fitness_ != nullptr) {
-    usable_capacity = fitness_->SelectBytes(bitmap_buffer, usable_buffer);
-  } else {
-    delete(usable_buffer);
-    usable_buffer = &bitmap_buffer;
+    usable_capacity = fitness_->SelectBytes(bitmap_buffer, &selected_buffer);
+    usable_buffer = &selected_buffer;
   }
 
   buffer_.Resize(usable_capacity);
   buffer_.Clear();
 
   if (permutation_->GetSize() == 0) {
+    PhaseTimer timer(counters_, stats_format_, StegoStats::PERMUTATION_INIT,
+                     usable_capacity);
     permutation_->Init(usable_capacity * 8, subkey_);
   }
 
   uint64 bits_to_modify = permutation_->GetSize();
 
-  for (uint64 i = 0; i < bits_to_modify; ++i) {
-    if ((*usable_buffer)[i] & 0x01) SetBitInBufferPermuted(i);
-  }
+  UnpackBuffer(usable_buffer->GetConstRawPointer(), bits_to_modify);
+  decode_timer.Stop();
 
   ExtractBufferUsingEncoder();
 
   file_loaded_ = true;
 
   LOG_INFO("File " << file_.GetRelativePath() << " loaded");
-
-  if(fitness_ != nullptr)
-    delete(usable_buffer);
 }
 
 
 void CarrierFileBMP::SaveFile() {
+  TraceScope trace("carrier", "SaveFile");
+  if (trace.IsActive()) trace.SetDetail(file_.GetRelativePath());
+
   auto file_ptr = file_.Open();
 
   if(!file_loaded_) throw std::runtime_error("File " + file_.GetFileName() +
@@ -130,6 +135,8 @@ void CarrierFileBMP::SaveFile() {
 
   LOG_INFO("Saving file " << file_.GetRelativePath());
 
+  PhaseTimer decode_timer(counters_, stats_format_, StegoStats::DECODE,
+                          raw_capacity_ * 8);
   MemoryBuffer bitmap_buffer(raw_capacity_ * 8);
 
   fseek(file_ptr.Get(), bmp_offset_, SEEK_SET);
@@ -143,44 +150,44 @@ void CarrierFileBMP::SaveFile() {
   }
 
   uint64 usable_capacity = raw_capacity_;
-  MemoryBuffer* usable_buffer = new MemoryBuffer();
+  MemoryBuffer selected_buffer;
+  MemoryBuffer* usable_buffer = &bitmap_buffer;
 
   if(fitness_ != nullptr) {
-    usable_capacity = fitness_->SelectBytes(bitmap_buffer, usable_buffer);
-  } else {
-    delete(usable_buffer);
-    usable_buffer = &bitmap_buffer;
+    usable_capacity = fitness_->SelectBytes(bitmap_buffer, &selected_buffer);
+    usable_buffer = &selected_buffer;
   }
 
   buffer_.Resize(usable_capacity);
   buffer_.Clear();
 
   if (permutation_->GetSize() == 0) {
+    PhaseTimer timer(counters_, stats_format_, StegoStats::PERMUTATION_INIT,
+                     usable_capacity);
     permutation_->Init(usable_capacity * 8, subkey_);
   }
 
   uint64 bits_to_modify = permutation_->GetSize();
 
-  for (uint64 i = 0; i < bits_to_modify; ++i) {
-    if ((*usable_buffer)[i] & 0x01) SetBitInBufferPermuted(i);
-  }
+  UnpackBuffer(usable_buffer->GetConstRawPointer(), bits_to_modify);
+  decode_timer.Stop();
 
   EmbedBufferUsingEncoder();
 
-  for (uint64 i = 0; i < bits_to_modify ; ++i) {
-    (*usable_buffer)[i] = ((*usable_buffer)[i] & 0xFE) | GetBitInBufferPermuted(i);
-  }
+  PhaseTimer encode_timer(counters_, stats_format_, StegoStats::ENCODE,
+                          raw_capacity_ * 8);
+  PackBuffer(usable_buffer->GetRawPointer(), bits_to_modify);
 
-  MemoryBuffer *output_buffer = new MemoryBuffer();
-  if(fitness_ != nullptr) {
-    fitness_->InsertBytes((*usable_buffer), output_buffer);
-  } else {
-    delete(output_buffer);
-    output_buffer = usable_buffer;
-  }
+  // selected bytes are written back into the image
+  if(fitness_ != nullptr)
+    fitness_->InsertBytes(selected_buffer, &bitmap_buffer);
+
+  encode_timer.Stop();
 
+  PhaseTimer write_timer(counters_, stats_format_, StegoStats::WRITE,
+                         raw_capacity_ * 8);
   fseek(file_ptr.Get(), bmp_offset_, SEEK_SET);
-  uint32 write_cnt = static_cast<uint32>(fwrite(output_buffer->GetRawPointer(),
+  uint32 write_cnt = static_cast<uint32>(fwrite(bitmap_buffer.GetRawPointer(),
                                                 1, raw_capacity_ * 8,
                                                 file_ptr.Get()));
 
@@ -189,13 +196,10 @@ void CarrierFileBMP::SaveFile() {
     throw std::runtime_error("Writing content to file " + file_.GetFileName() +
                              " failed");
   }
+  write_timer.Stop();
+  if (counters_) counters_->AddSave(stats_format_, 0, raw_capacity_ * 8);
 
   LOG_INFO("File " << file_.GetRelativePath() << " saved");
-
-  if(fitness_ != nullptr) {
-    delete(output_buffer);
-    delete(usable_buffer);
-  }
 }
 
 } // stego_disk
@@ -33,6 +33,9 @@ CarrierFileJPEG::CarrierFileJPEG(File file,
 }
 
 void CarrierFileJPEG::ComputeCapacity() {
+  TraceScope trace("carrier", "ComputeCapacity");
+  if (trace.IsActive()) trace.SetDetail(file_.GetRelativePath());
+
   // TODO: test if file is Opened OK
   auto file_ptr = file_.Open();
 
@@ -62,7 +65,7 @@ void CarrierFileJPEG::ComputeCapacity() {
 
   JDIMENSION ci, by, bx, bi;
 
-  uint32 capacity_in_bits = 0;
+  uint64 capacity_in_bits = 0;
 
   for (ci = 0; ci < COLOR_SPACE; ++ci) {
     compptr = cinfo_decompress.comp_info + ci;
@@ -88,9 +91,14 @@ void CarrierFileJPEG::ComputeCapacity() {
 void CarrierFileJPEG::LoadFile() {
   if (file_loaded_) return;
 
+  TraceScope trace("carrier", "LoadFile");
+  if (trace.IsActive()) trace.SetDetail(file_.GetRelativePath());
+
   auto file_ptr = file_.Open();
 
   if (permutation_->GetSize() == 0) {
+    PhaseTimer timer(counters_, stats_format_, StegoStats::PERMUTATION_INIT,
+                     raw_capacity_);
     permutation_->Init(raw_capacity_ * 8, subkey_);
   }
 
@@ -101,6 +109,8 @@ void CarrierFileJPEG::LoadFile() {
   struct jpeg_error_mgr jerr_decompress;
   jvirt_barray_ptr* coeff_arrays;
 
+  PhaseTimer decode_timer(counters_, stats_format_, StegoStats::DECODE,
+                          file_.GetSize());
   // Create decompression object.
   cinfo_decompress.err = jpeg_std_error(&jerr_decompress);
   jpeg_create_decompress(&cinfo_decompress);
@@ -123,7 +133,7 @@ void CarrierFileJPEG::LoadFile() {
 
   // read data
 
-  uint32 coeff_counter = 0;
+  uint64 coeff_counter = 0;
 
   bool should_read = true;
 
@@ -132,6 +142,10 @@ void CarrierFileJPEG::LoadFile() {
   LOG_TRACE("CarrierFileJPEG::loadFile: file " << file_.GetRelativePath() <<
             ", bits to modify: " << bits_to_modify);
 
+  // LSBs of usable coefficients, in order of reading
+  MemoryBuffer lsbs(bits_to_modify);
+  uint8* lsb = lsbs.GetRawPointer();
+
   for (ci = 0; ci < COLOR_SPACE; ++ci) {
     compptr = cinfo_decompress.comp_info + ci;
     for (by = 0; (by < compptr->height_in_blocks) && should_read; ++by) {
@@ -143,7 +157,7 @@ void CarrierFileJPEG::LoadFile() {
         for (bi = 1; (bi < 64) && should_read; ++bi) { // skip the first coeff (DC) - first index is 1 (first AC coeff)
           if (blockptr[bi] & 0xFFFE) { // ignore 0, 1 coeffs
 
-            if ((blockptr[bi] & 0x1)) SetBitInBufferPermuted(coeff_counter);
+            lsb[coeff_counter] = blockptr[bi] & 0x1;
 
             ++coeff_counter;
             if (coeff_counter >= bits_to_modify) should_read = false;
@@ -156,6 +170,9 @@ void CarrierFileJPEG::LoadFile() {
 
   LOG_TRACE(file_.GetRelativePath() << ", coeff_counter:" << coeff_counter);
 
+  UnpackBuffer(lsbs.GetConstRawPointer(), coeff_counter);
+  decode_timer.Stop();
+
   LOG_TRACE(file_.GetRelativePath() << ", unpacked buffer: " <<
             StegoMath::HexBufferToStr(buffer_.GetRawPointer(), 10));
 
@@ -177,6 +194,8 @@ void CarrierFileJPEG::LoadFile() {
 }
 
 void CarrierFileJPEG::SaveFile() {
+  TraceScope trace("carrier", "SaveFile");
+  if (trace.IsActive()) trace.SetDetail(file_.GetRelativePath());
 
   auto file_ptr = file_.Open();
 
@@ -186,6 +205,8 @@ void CarrierFileJPEG::SaveFile() {
   LOG_TRACE("Saving file " << file_.GetRelativePath());
 
   if (permutation_->GetSize() == 0) {
+    PhaseTimer timer(counters_, stats_format_, StegoStats::PERMUTATION_INIT,
+                     raw_capacity_);
     permutation_->Init(raw_capacity_ * 8, subkey_);
   }
 
@@ -198,6 +219,8 @@ void CarrierFileJPEG::SaveFile() {
   struct jpeg_error_mgr jerr_decompress;
   jvirt_barray_ptr* coeff_arrays;
 
+  PhaseTimer decode_timer(counters_, stats_format_, StegoStats::DECODE,
+                          file_.GetSize());
   // Create decompression object.
   cinfo_decompress.err = jpeg_std_error(&jerr_decompress);
   jpeg_create_decompress(&cinfo_decompress);
@@ -226,18 +249,21 @@ void CarrierFileJPEG::SaveFile() {
   JDIMENSION ci, by, bx, bi;
 
 
-  uint32 coeff_counter = 0;
+  uint64 coeff_counter = 0;
 
   bool should_write = true;
   bool should_read = true;
 
 
-  uint32 bits_to_modify = static_cast<uint32>(permutation_->GetSize());
+  uint64 bits_to_modify = permutation_->GetSize();
 
   // LOG_INFO(_relativePath << ", bits to modify: " << bits_to_modify);
 
   // read LSBs from DCT coefficient and store them in temporary buffer in "locally" permuted order
 
+  MemoryBuffer lsbs(bits_to_modify);
+  uint8* lsb = lsbs.GetRawPointer();
+
   for (ci = 0; ci < COLOR_SPACE; ++ci) {
     compptr = cinfo_decompress.comp_info + ci;
     for (by = 0; (by < compptr->height_in_blocks) && should_read; ++by) {
@@ -249,7 +275,7 @@ void CarrierFileJPEG::SaveFile() {
         for (bi = 1; (bi < 64) && should_read; ++bi) {// skip the first coeff (DC) - first index is 1 (first AC coeff)
           if (blockptr[bi] & 0xFFFE) { // ignore 0, 1 coeffs
 
-            if ((blockptr[bi] & 0x1)) SetBitInBufferPermuted(coeff_counter);
+            lsb[coeff_counter] = blockptr[bi] & 0x1;
 
             ++coeff_counter;
             if (coeff_counter >= bits_to_modify) should_read = false;
@@ -262,6 +288,9 @@ void CarrierFileJPEG::SaveFile() {
 
   //LOG_INFO(_relativePath << ", reading finished coeff_counter:" << coeff_counter);
 
+  UnpackBuffer(lsbs.GetConstRawPointer(), coeff_counter);
+  decode_timer.Stop();
+
   // use encoder to embed "globally" permuted bytes of hidden storage to "locally" permuted LSBbits stored in temporary buffer
 
   //LOG_INFO(_relativePath << ", unpacked buffer: " << StegoMath::hexBufferToStr(buffer_, 10));
@@ -279,6 +308,10 @@ void CarrierFileJPEG::SaveFile() {
 
   // write down permuted and encoded LSBs into DCT coefficients
 
+  PhaseTimer encode_timer(counters_, stats_format_, StegoStats::ENCODE,
+                          raw_capacity_ * 8);
+  PackBuffer(lsbs.GetRawPointer(), coeff_counter);
+
   coeff_counter = 0;
 //  uint8 tmp_lsb = 0;
 
@@ -297,7 +330,7 @@ void CarrierFileJPEG::SaveFile() {
 //            tmp_lsb = GetBitInBufferPermuted(coeff_counter);
 
             blockptr[bi] = (blockptr[bi] & 0xFFFE) |
-                           GetBitInBufferPermuted(coeff_counter);
+                           (lsb[coeff_counter] & 0x1);
 //            blockptr[bi] |= (tmp_lsb & 0x01);
 
             coeff_counter++;
@@ -310,8 +343,13 @@ void CarrierFileJPEG::SaveFile() {
 
   // LOG_INFO(_relativePath << ", writing finished coeff_counter:" << coeff_counter);
 
+  encode_timer.Stop();
+
   // JPEG SAVING PHASE -------------------------------------------
 
+  // entropy coding writes directly to the file, both are timed as WRITE
+  PhaseTimer write_timer(counters_, stats_format_, StegoStats::WRITE);
+
   struct jpeg_compress_struct cinfo_compress;
   struct jpeg_error_mgr jerr_compress;
   jpeg_create_compress(&cinfo_compress);
@@ -340,6 +378,13 @@ void CarrierFileJPEG::SaveFile() {
   jpeg_finish_compress(&cinfo_compress);
   jpeg_destroy_compress(&cinfo_compress);
 
+  if (counters_) {
+    uint64 bytes_written = static_cast<uint64>(ftell(file_ptr.Get()));
+    write_timer.SetBytes(bytes_written);
+    counters_->AddSave(stats_format_, 0, bytes_written);
+  }
+  write_timer.Stop();
+
   jpeg_finish_decompress(&cinfo_decompress);
   jpeg_destroy_decompress(&cinfo_decompress);
 
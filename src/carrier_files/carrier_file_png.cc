@@ -49,11 +49,16 @@ void CarrierFilePNG::LoadFile() {
 
   if (file_loaded_) return;
 
+    TraceScope trace("carrier", "LoadFile");
+    if (trace.IsActive()) trace.SetDetail(file_.GetRelativePath());
+
     auto file_ptr = file_.Open();
 
     LOG_INFO("Loading file " << file_.GetRelativePath());
 
     if (permutation_->GetSize() == 0) {
+      PhaseTimer timer(counters_, stats_format_, StegoStats::PERMUTATION_INIT,
+                       raw_capacity_);
       permutation_->Init(raw_capacity_ * 8, subkey_);
     }
 
@@ -64,7 +69,8 @@ void CarrierFilePNG::LoadFile() {
 
     uint64 bits_to_modify = permutation_->GetSize();
 
-
+    PhaseTimer decode_timer(counters_, stats_format_, StegoStats::DECODE,
+                            file_.GetSize());
     fseek(file_ptr.Get(), 0, SEEK_SET);
     uint32 read_cnt = static_cast<uint32>(fread(png_buffer.GetRawPointer(), 1,
                                                 file_.GetSize(),
@@ -85,11 +91,10 @@ void CarrierFilePNG::LoadFile() {
 
     // copy LSB data to content buffer
 
-    for (uint64 i = 0; i < bits_to_modify; ++i) {
-      if (image[i] & 0x01) SetBitInBufferPermuted(i);
-    }
+    UnpackBuffer(image, bits_to_modify);
 
     free(image);
+    decode_timer.Stop();
 
     ExtractBufferUsingEncoder();
 
@@ -100,6 +105,9 @@ void CarrierFilePNG::LoadFile() {
 
 
 void CarrierFilePNG::SaveFile() {
+  TraceScope trace("carrier", "SaveFile");
+  if (trace.IsActive()) trace.SetDetail(file_.GetRelativePath());
+
   auto file_ptr = file_.Open();
 
   if(!file_loaded_) throw std::runtime_error("File " + file_.GetFileName() +
@@ -109,6 +117,8 @@ void CarrierFilePNG::SaveFile() {
   LOG_INFO("Saving file " << file_.GetRelativePath());
 
   if (permutation_->GetSize() == 0) {
+    PhaseTimer timer(counters_, stats_format_, StegoStats::PERMUTATION_INIT,
+                     raw_capacity_);
     permutation_->Init(raw_capacity_ * 8, subkey_);
   }
 
@@ -119,6 +129,8 @@ void CarrierFilePNG::SaveFile() {
 
   uint64 bits_to_modify = permutation_->GetSize();
 
+  PhaseTimer decode_timer(counters_, stats_format_, StegoStats::DECODE,
+                          file_.GetSize());
   fseek(file_ptr.Get(), 0, SEEK_SET);
   uint32 read_cnt = static_cast<uint32>(fread(png_buffer.GetRawPointer(), 1,
                                               file_.GetSize(),
@@ -140,15 +152,14 @@ void CarrierFilePNG::SaveFile() {
 
   // copy LSB data to content buffer
 
-  for (uint64 i = 0; i < bits_to_modify; ++i) {
-    if (image[i] & 0x01) SetBitInBufferPermuted(i);
-  }
+  UnpackBuffer(image, bits_to_modify);
+  decode_timer.Stop();
 
   EmbedBufferUsingEncoder();
 
-  for (uint64 i = 0; i < bits_to_modify ; ++i) {
-    image[i] = (image[i] & 0xFE) | GetBitInBufferPermuted(i);
-  }
+  PhaseTimer encode_timer(counters_, stats_format_, StegoStats::ENCODE,
+                          raw_capacity_ * 8);
+  PackBuffer(image, bits_to_modify);
 
   unsigned char* image_out;
   size_t size_out;
@@ -158,8 +169,11 @@ void CarrierFilePNG::SaveFile() {
   if(error)
     throw std::runtime_error("Unable to encode file " + file_.GetFileName());
 
+  encode_timer.Stop();
+
   // write data
 
+  PhaseTimer write_timer(counters_, stats_format_, StegoStats::WRITE, size_out);
   fseek(file_ptr.Get(), 0, SEEK_SET);
   uint32 write_cnt = static_cast<uint32>(fwrite(image_out,
                                                 1, size_out,
@@ -171,6 +185,9 @@ void CarrierFilePNG::SaveFile() {
                              " failed");
   }
 
+  write_timer.Stop();
+  if (counters_) counters_->AddSave(stats_format_, 0, size_out);
+
   free(image);
   free(image_out);
 
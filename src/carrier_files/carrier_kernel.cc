@@ -0,0 +1,546 @@
+/**
+* @file carrier_kernel.cc
+* @author Martin Kosdy
+* @author Matus Kysel
+* @date 2016
+* @brief Specialized load/save kernels of carrier files - implementation
+*
+*/
+
+#include "carrier_kernel.h"
+
+#include <string.h>
+#include <algorithm>
+#include <vector>
+#include <stdexcept>
+
+#if defined(_MSC_VER)
+#include <xmmintrin.h>
+#define STEGO_PREFETCH(address) _mm_prefetch((const char*)(address), _MM_HINT_T0)
+#else
+#define STEGO_PREFETCH(address) __builtin_prefetch(address)
+#endif
+
+#include "encoders/hamming_encoder.h"
+#include "encoders/hamming_codec.h"
+#include "encoders/lsb_encoder.h"
+#include "permutations/identity_permutation.h"
+#include "permutations/affine_permutation.h"
+#include "permutations/affine64_permutation.h"
+#include "permutations/feistel_num_permutation.h"
+#include "permutations/feistel_mix_permutation.h"
+#include "permutations/cycle_walking_permutation.h"
+#include "permutations/arx_feistel_permutation.h"
+#include "permutations/blocked_permutation.h"
+#include "utils/stego_math.h"
+
+namespace stego_disk {
+
+class CarrierKernel::BitLayer {
+public:
+  virtual ~BitLayer() {}
+  virtual void UnpackBits(const uint8* samples, uint64 count,
+                          uint8* buffer) const = 0;
+  virtual void PackBits(const uint8* buffer, uint64 count,
+                        uint8* samples) const = 0;
+};
+
+class CarrierKernel::BlockLayer {
+public:
+  virtual ~BlockLayer() {}
+  virtual void ExtractBlocks(const uint8* codewords, uint64 block_count,
+                             uint64 offset, uint64 bytes) const = 0;
+  virtual uint64 EmbedBlocks(uint8* codewords, uint64 block_count,
+                             uint64 offset, uint64 bytes) const = 0;
+};
+
+// Iterator over Permute(index), Permute(index + 1), ...;
+// calls non-virtual PermuteUnchecked of the concrete permutation
+template <class PermutationType>
+class PermuteIterator {
+public:
+  PermuteIterator(const PermutationType* permutation, PermElem index)
+    : permutation_(permutation), index_(index) {}
+  PermElem operator*() const { return permutation_->PermuteUnchecked(index_); }
+  PermuteIterator& operator++() { ++index_; return *this; }
+private:
+  const PermutationType* permutation_;
+  PermElem index_;
+};
+
+// Fallback for permutations without specialized kernel
+template <>
+class PermuteIterator<Permutation> {
+public:
+  PermuteIterator(const Permutation* permutation, PermElem index)
+    : permutation_(permutation), index_(index) {}
+  PermElem operator*() const { return permutation_->Permute(index_); }
+  PermuteIterator& operator++() { ++index_; return *this; }
+private:
+  const Permutation* permutation_;
+  PermElem index_;
+};
+
+// ARX permutation computes a batch of consecutive elements at once
+template <>
+class PermuteIterator<ArxFeistelPermutation> {
+public:
+  PermuteIterator(const ArxFeistelPermutation* permutation, PermElem index)
+    : permutation_(permutation), index_(index), position_(kBatchSize) {}
+  PermElem operator*() {
+    if (position_ == kBatchSize) {
+      permutation_->PermuteRange(index_, kBatchSize, batch_);
+      position_ = 0;
+    }
+    return batch_[position_];
+  }
+  PermuteIterator& operator++() {
+    ++index_;
+    if (position_ < kBatchSize) ++position_;
+    return *this;
+  }
+private:
+  // the last batch may reach beyond the end of the permutation,
+  // such elements are computed (without any table lookup) but not read
+  static const int kBatchSize = 64;
+  const ArxFeistelPermutation* permutation_;
+  PermElem index_;
+  int position_;
+  PermElem batch_[kBatchSize];
+};
+
+// Blocked permutation permutes each line once and steps inside it;
+// base of the next line is known in advance, so it can be prefetched
+template <class LinePermutation>
+class PermuteIterator<BlockedPermutation<LinePermutation> > {
+public:
+  typedef BlockedPermutation<LinePermutation> PermutationType;
+  static const PermElem kLineSize = PermutationType::kLineSize;
+
+  PermuteIterator(const PermutationType* permutation, PermElem index)
+    : permutation_(permutation),
+      line_(index / kLineSize),
+      offset_(index % kLineSize),
+      line_base_(0),
+      next_line_base_(0),
+      line_key_(0) {
+    if (line_ < permutation_->GetLineCount()) {
+      line_base_ = permutation_->LineBase(line_);
+      line_key_ = permutation_->LineKey(line_);
+    }
+    SetNextLine();
+  }
+
+  PermElem operator*() const {
+    return line_base_ + PermutationType::PermuteInLine(line_key_, offset_);
+  }
+
+  PermuteIterator& operator++() {
+    if (++offset_ == kLineSize) {
+      offset_ = 0;
+      ++line_;
+      line_base_ = next_line_base_;
+      line_key_ = permutation_->LineKey(line_);
+      SetNextLine();
+    }
+    return *this;
+  }
+
+  // called once per element, prefetches the next line when entering a line
+  void Prefetch(const uint8* data) const {
+    if (offset_ == 0) STEGO_PREFETCH(data + next_line_base_);
+  }
+
+private:
+  // lines beyond the end are not permuted, underlying permutation
+  // may not handle them
+  void SetNextLine() {
+    if (line_ + 1 < permutation_->GetLineCount())
+      next_line_base_ = permutation_->LineBase(line_ + 1);
+  }
+
+  const PermutationType* permutation_;
+  PermElem line_;
+  PermElem offset_;
+  PermElem line_base_;
+  PermElem next_line_base_;
+  uint64 line_key_;
+};
+
+// Issues software prefetch of data the iterator will reach soon;
+// only iterators with locality (blocked permutations) do so
+template <class Iterator>
+inline void Prefetch(const Iterator& /*it*/, const uint8* /*data*/) {}
+
+template <class LinePermutation>
+inline void Prefetch(
+    const PermuteIterator<BlockedPermutation<LinePermutation> >& it,
+    const uint8* data) {
+  it.Prefetch(data);
+}
+
+// Creates iterators over consecutive indices of the permutation
+template <class PermutationType>
+class PermuteOp {
+public:
+  typedef PermuteIterator<PermutationType> Iterator;
+  explicit PermuteOp(const Permutation* permutation)
+    : permutation_(static_cast<const PermutationType*>(permutation)) {}
+  Iterator At(PermElem index) const { return Iterator(permutation_, index); }
+private:
+  const PermutationType* permutation_;
+};
+
+// Affine permutations step from one element to the next without multiplication
+template <class AffineType>
+class AffinePermuteOp {
+public:
+  typedef AffinePermutation::Iterator Iterator;
+  explicit AffinePermuteOp(const Permutation* permutation)
+    : permutation_(static_cast<const AffineType*>(permutation)) {}
+  Iterator At(PermElem index) const { return permutation_->IteratorAt(index); }
+private:
+  const AffineType* permutation_;
+};
+
+template <>
+class PermuteOp<AffinePermutation>
+  : public AffinePermuteOp<AffinePermutation> {
+public:
+  explicit PermuteOp(const Permutation* permutation)
+    : AffinePermuteOp<AffinePermutation>(permutation) {}
+};
+
+template <>
+class PermuteOp<Affine64Permutation>
+  : public AffinePermuteOp<Affine64Permutation> {
+public:
+  explicit PermuteOp(const Permutation* permutation)
+    : AffinePermuteOp<Affine64Permutation>(permutation) {}
+};
+
+// LSB encoder copies data to codewords byte by byte, so its block of
+// any size is processed as that many one-byte blocks (see block_scale_)
+class LsbCodec {
+public:
+  uint32 GetDataBlockSize() const { return 1; }
+  uint32 GetCodewordBlockSize() const { return 1; }
+  void EmbedBlock(uint8* codeword, const uint8* data) const {
+    *codeword = *data;
+  }
+  void ExtractBlock(const uint8* codeword, uint8* data) const {
+    *data = *codeword;
+  }
+};
+
+// Fallback for encoders without specialized kernel
+class EncoderCodec {
+public:
+  explicit EncoderCodec(Encoder* encoder) : encoder_(encoder) {}
+  uint32 GetDataBlockSize() const { return encoder_->GetDataBlockSize(); }
+  uint32 GetCodewordBlockSize() const {
+    return encoder_->GetCodewordBlockSize();
+  }
+  void EmbedBlock(uint8* codeword, const uint8* data) const {
+    encoder_->Embed(codeword, data);
+  }
+  void ExtractBlock(const uint8* codeword, uint8* data) const {
+    encoder_->Extract(codeword, data);
+  }
+private:
+  Encoder* encoder_;
+};
+
+// number of bits which differ in two buffers of 'size' bytes
+static inline uint64 BitsModified(const uint8* before, const uint8* after,
+                                  std::size_t size) {
+  uint64 bits_modified = 0;
+  std::size_t i = 0;
+  for (; i + sizeof(uint64) <= size; i += sizeof(uint64)) {
+    uint64 a, b;
+    memcpy(&a, before + i, sizeof(uint64));
+    memcpy(&b, after + i, sizeof(uint64));
+    bits_modified += StegoMath::Popcount(a ^ b);
+  }
+  for (; i < size; ++i)
+    bits_modified += StegoMath::Popcount(before[i] ^ after[i]);
+  return bits_modified;
+}
+
+template <class LocalPermutation>
+class BitLayerImpl : public CarrierKernel::BitLayer {
+public:
+  explicit BitLayerImpl(const Permutation* permutation)
+    : permute_(permutation) {}
+
+  void UnpackBits(const uint8* samples, uint64 count, uint8* buffer) const {
+    auto it = permute_.At(0);
+    for (uint64 i = 0; i < count; ++i, ++it) {
+      if (samples[i] & 0x01) {
+        PermElem index = *it;
+        buffer[index / 8] |= static_cast<uint8>(1 << (index % 8));
+      }
+    }
+  }
+
+  void PackBits(const uint8* buffer, uint64 count, uint8* samples) const {
+    auto it = permute_.At(0);
+    for (uint64 i = 0; i < count; ++i, ++it) {
+      PermElem index = *it;
+      samples[i] = (samples[i] & 0xFE) | ((buffer[index / 8] >> (index % 8)) & 0x01);
+    }
+  }
+
+private:
+  PermuteOp<LocalPermutation> permute_;
+};
+
+template <class Codec, class GlobalPermutation>
+class BlockLayerImpl : public CarrierKernel::BlockLayer {
+public:
+  BlockLayerImpl(Codec codec, VirtualStorage* storage)
+    : codec_(codec),
+      storage_(storage),
+      permute_(storage->GetPermutation().get()) {}
+
+  // Decodes blocks and scatters decoded bytes to the storage;
+  // blocks (or their parts) beyond 'bytes' are not stored
+  void ExtractBlocks(const uint8* codewords, uint64 block_count,
+                     uint64 offset, uint64 bytes) const {
+    const uint32 data_block_size = codec_.GetDataBlockSize();
+    const uint32 codeword_block_size = codec_.GetCodewordBlockSize();
+    uint8* storage = storage_->GetRawPointer();
+    std::vector<uint8> data(data_block_size);
+    auto it = permute_.At(offset);
+
+    uint64 full_blocks = std::min(block_count, bytes / data_block_size);
+    for (uint64 b = 0; b < full_blocks; ++b) {
+      codec_.ExtractBlock(&codewords[b * codeword_block_size], &data[0]);
+      for (uint32 i = 0; i < data_block_size; ++i, ++it) {
+        Prefetch(it, storage);
+        storage[*it] = data[i];
+      }
+    }
+
+    uint64 tail = bytes - full_blocks * data_block_size;
+    if (full_blocks < block_count && tail) {
+      codec_.ExtractBlock(&codewords[full_blocks * codeword_block_size], &data[0]);
+      for (uint32 i = 0; i < tail; ++i, ++it) {
+        storage[*it] = data[i];
+      }
+    }
+  }
+
+  // Gathers bytes from the storage and encodes them into blocks;
+  // bytes beyond 'bytes' are embedded as zeros. Returns number of bits
+  // of codewords changed, counted for groups of blocks of about one
+  // cache line, while their original content is still in L1 cache
+  uint64 EmbedBlocks(uint8* codewords, uint64 block_count,
+                     uint64 offset, uint64 bytes) const {
+    const uint32 data_block_size = codec_.GetDataBlockSize();
+    const uint32 codeword_block_size = codec_.GetCodewordBlockSize();
+    const uint64 group_blocks = std::max<uint64>(
+          1, kCountGroupSize / codeword_block_size);
+    const uint8* storage = storage_->GetRawPointer();
+    std::vector<uint8> data(data_block_size);
+    std::vector<uint8> original(group_blocks * codeword_block_size);
+    uint64 bits_modified = 0;
+    auto it = permute_.At(offset);
+
+    uint64 full_blocks = std::min(block_count, bytes / data_block_size);
+    uint64 tail = bytes - full_blocks * data_block_size;
+    for (uint64 first = 0; first < block_count; first += group_blocks) {
+      uint64 last = std::min(block_count, first + group_blocks);
+      uint8* group = &codewords[first * codeword_block_size];
+      std::size_t group_size = (last - first) * codeword_block_size;
+      memcpy(&original[0], group, group_size);
+
+      for (uint64 b = first; b < last; ++b) {
+        if (b < full_blocks) {
+          for (uint32 i = 0; i < data_block_size; ++i, ++it) {
+            Prefetch(it, storage);
+            data[i] = storage[*it];
+          }
+        } else {
+          memset(&data[0], 0, data_block_size);
+          for (uint32 i = 0; i < data_block_size && tail; ++i, --tail, ++it) {
+            data[i] = storage[*it];
+          }
+        }
+        codec_.EmbedBlock(&codewords[b * codeword_block_size], &data[0]);
+      }
+
+      bits_modified += BitsModified(&original[0], group, group_size);
+    }
+
+    return bits_modified;
+  }
+
+private:
+  // codeword bytes of blocks counted at once (one cache line)
+  static const uint32 kCountGroupSize = 64;
+
+  Codec codec_;
+  VirtualStorage* storage_;
+  PermuteOp<GlobalPermutation> permute_;
+};
+
+static CarrierKernel::BitLayer* NewBitLayer(const Permutation* permutation) {
+  if (dynamic_cast<const FeistelMixPermutation*>(permutation))
+    return new BitLayerImpl<FeistelMixPermutation>(permutation);
+  if (dynamic_cast<const BlockedFeistelMixPermutation*>(permutation))
+    return new BitLayerImpl<BlockedFeistelMixPermutation>(permutation);
+  if (dynamic_cast<const ArxFeistelPermutation*>(permutation))
+    return new BitLayerImpl<ArxFeistelPermutation>(permutation);
+  if (dynamic_cast<const ExactFeistelMixPermutation*>(permutation))
+    return new BitLayerImpl<ExactFeistelMixPermutation>(permutation);
+  if (dynamic_cast<const ExactFeistelNumPermutation*>(permutation))
+    return new BitLayerImpl<ExactFeistelNumPermutation>(permutation);
+  if (dynamic_cast<const FeistelNumPermutation*>(permutation))
+    return new BitLayerImpl<FeistelNumPermutation>(permutation);
+  // Affine64Permutation is derived from AffinePermutation, test it first
+  if (dynamic_cast<const Affine64Permutation*>(permutation))
+    return new BitLayerImpl<Affine64Permutation>(permutation);
+  if (dynamic_cast<const AffinePermutation*>(permutation))
+    return new BitLayerImpl<AffinePermutation>(permutation);
+  if (dynamic_cast<const IdentityPermutation*>(permutation))
+    return new BitLayerImpl<IdentityPermutation>(permutation);
+  return new BitLayerImpl<Permutation>(permutation);
+}
+
+template <class Codec>
+static CarrierKernel::BlockLayer* NewBlockLayer(Codec codec,
+                                                VirtualStorage* storage) {
+  const Permutation* permutation = storage->GetPermutation().get();
+
+  if (dynamic_cast<const FeistelMixPermutation*>(permutation))
+    return new BlockLayerImpl<Codec, FeistelMixPermutation>(codec, storage);
+  if (dynamic_cast<const BlockedFeistelMixPermutation*>(permutation))
+    return new BlockLayerImpl<Codec, BlockedFeistelMixPermutation>(codec, storage);
+  if (dynamic_cast<const ArxFeistelPermutation*>(permutation))
+    return new BlockLayerImpl<Codec, ArxFeistelPermutation>(codec, storage);
+  if (dynamic_cast<const ExactFeistelMixPermutation*>(permutation))
+    return new BlockLayerImpl<Codec, ExactFeistelMixPermutation>(codec, storage);
+  if (dynamic_cast<const ExactFeistelNumPermutation*>(permutation))
+    return new BlockLayerImpl<Codec, ExactFeistelNumPermutation>(codec, storage);
+  if (dynamic_cast<const FeistelNumPermutation*>(permutation))
+    return new BlockLayerImpl<Codec, FeistelNumPermutation>(codec, storage);
+  if (dynamic_cast<const Affine64Permutation*>(permutation))
+    return new BlockLayerImpl<Codec, Affine64Permutation>(codec, storage);
+  if (dynamic_cast<const AffinePermutation*>(permutation))
+    return new BlockLayerImpl<Codec, AffinePermutation>(codec, storage);
+  if (dynamic_cast<const IdentityPermutation*>(permutation))
+    return new BlockLayerImpl<Codec, IdentityPermutation>(codec, storage);
+  return new BlockLayerImpl<Codec, Permutation>(codec, storage);
+}
+
+static CarrierKernel::BlockLayer* NewBlockLayer(Encoder* encoder,
+                                                VirtualStorage* storage) {
+  if (HammingEncoder* hamming = dynamic_cast<HammingEncoder*>(encoder)) {
+    switch (hamming->GetParityBits()) {
+      case 3: return NewBlockLayer(HammingCodec<3>(), storage);
+      case 4: return NewBlockLayer(HammingCodec<4>(), storage);
+      case 5: return NewBlockLayer(HammingCodec<5>(), storage);
+      case 6: return NewBlockLayer(HammingCodec<6>(), storage);
+      case 7: return NewBlockLayer(HammingCodec<7>(), storage);
+      case 8: return NewBlockLayer(HammingCodec<8>(), storage);
+    }
+  }
+  if (dynamic_cast<LsbEncoder*>(encoder))
+    return NewBlockLayer(LsbCodec(), storage);
+  return NewBlockLayer(EncoderCodec(encoder), storage);
+}
+
+/**
+ * @brief Selects kernel implementation for the carrier
+ *
+ * Permutations may be initialized later, kernel reads their state
+ * at the time of UnpackBits/PackBits/ExtractBlocks/EmbedBlocks calls.
+ * Encoder parameters and types of permutations must not change
+ * during the lifetime of the kernel.
+ *
+ * @param[in] encoder Encoder of the carrier
+ * @param[in] local_permutation Local permutation of the carrier
+ * @param[in] storage Virtual storage with global permutation set
+ */
+CarrierKernel::CarrierKernel(std::shared_ptr<Encoder> encoder,
+                             std::shared_ptr<Permutation> local_permutation,
+                             std::shared_ptr<VirtualStorage> storage)
+  : encoder_(encoder),
+    local_permutation_(local_permutation),
+    storage_(storage),
+    block_scale_(1) {
+  if (!encoder_)
+    throw std::invalid_argument("CarrierKernel: 'encoder' is nullptr");
+  if (!local_permutation_)
+    throw std::invalid_argument("CarrierKernel: 'local_permutation' is nullptr");
+  if (!storage_ || !storage_->GetPermutation())
+    throw std::invalid_argument("CarrierKernel: storage has no permutation");
+
+  bit_layer_.reset(NewBitLayer(local_permutation_.get()));
+  block_layer_.reset(NewBlockLayer(encoder_.get(), storage_.get()));
+  if (dynamic_cast<LsbEncoder*>(encoder_.get()))
+    block_scale_ = encoder_->GetDataBlockSize();
+}
+
+CarrierKernel::~CarrierKernel() {}
+
+/**
+ * @brief Sets bits of the carrier buffer from LSBs of samples
+ *
+ * For i < count, sets bit Permute(i) of 'buffer' if LSB of samples[i] is 1.
+ * Buffer has to be cleared before.
+ *
+ * @param[in] samples Carrier samples (pixels, DCT coefficients, ..)
+ * @param[in] count Number of samples, at most size of local permutation
+ * @param[out] buffer Carrier buffer
+ */
+void CarrierKernel::UnpackBits(const uint8* samples, uint64 count,
+                               uint8* buffer) const {
+  bit_layer_->UnpackBits(samples, count, buffer);
+}
+
+/**
+ * @brief Writes bits of the carrier buffer into LSBs of samples
+ *
+ * Inverse operation to CarrierKernel::UnpackBits.
+ *
+ * @param[in] buffer Carrier buffer
+ * @param[in] count Number of samples, at most size of local permutation
+ * @param[in,out] samples Carrier samples
+ */
+void CarrierKernel::PackBits(const uint8* buffer, uint64 count,
+                             uint8* samples) const {
+  bit_layer_->PackBits(buffer, count, samples);
+}
+
+/**
+ * @brief Decodes codeword blocks into the virtual storage
+ *
+ * @param[in] codewords Carrier buffer with 'block_count' codeword blocks
+ * @param[in] block_count Number of encoder blocks used by the carrier
+ * @param[in] offset Offset of the carrier's part of the storage
+ * @param[in] bytes Number of bytes of the carrier's part inside the storage
+ */
+void CarrierKernel::ExtractBlocks(const uint8* codewords, uint64 block_count,
+                                  uint64 offset, uint64 bytes) const {
+  block_layer_->ExtractBlocks(codewords, block_count * block_scale_, offset,
+                              bytes);
+}
+
+/**
+ * @brief Encodes the virtual storage into codeword blocks
+ *
+ * @param[in,out] codewords Carrier buffer with 'block_count' codeword blocks
+ * @param[in] block_count Number of encoder blocks used by the carrier
+ * @param[in] offset Offset of the carrier's part of the storage
+ * @param[in] bytes Number of bytes of the carrier's part inside the storage
+ * @return Number of bits of 'codewords' changed
+ */
+uint64 CarrierKernel::EmbedBlocks(uint8* codewords, uint64 block_count,
+                                  uint64 offset, uint64 bytes) const {
+  return block_layer_->EmbedBlocks(codewords, block_count * block_scale_,
+                                   offset, bytes);
+}
+
+} // stego_disk
@@ -0,0 +1,68 @@
+/**
+* @file carrier_kernel.h
+* @author Martin Kosdy
+* @author Matus Kysel
+* @date 2016
+* @brief Specialized load/save kernels of carrier files
+*
+*/
+
+#ifndef STEGODISK_CARRIERFILES_CARRIERKERNEL_H_
+#define STEGODISK_CARRIERFILES_CARRIERKERNEL_H_
+
+#include <memory>
+
+#include "utils/stego_types.h"
+#include "encoders/encoder.h"
+#include "permutations/permutation.h"
+#include "virtual_storage/virtual_storage.h"
+
+namespace stego_disk {
+
+/**
+ * The CarrierKernel class.
+ *
+ * Moves data between carrier samples and the virtual storage:
+ *  - bit layer: LSB of sample i <-> bit Permute(i) of the carrier buffer
+ *    (local permutation),
+ *  - block layer: codeword blocks of the carrier buffer <-> bytes of the storage
+ *    at globally permuted positions (encoder + global permutation).
+ *
+ * Both layers are templates instantiated for every known permutation
+ * and encoder (Hamming code separately for each number of parity bits),
+ * so the inner loops have no virtual calls and no per-bit range checks.
+ * Implementation is selected once, when the kernel is created;
+ * unknown encoders or permutations fall back to their virtual interface.
+ */
+class CarrierKernel {
+
+public:
+  CarrierKernel(std::shared_ptr<Encoder> encoder,
+                std::shared_ptr<Permutation> local_permutation,
+                std::shared_ptr<VirtualStorage> storage);
+  ~CarrierKernel();
+
+  void UnpackBits(const uint8* samples, uint64 count, uint8* buffer) const;
+  void PackBits(const uint8* buffer, uint64 count, uint8* samples) const;
+
+  void ExtractBlocks(const uint8* codewords, uint64 block_count,
+                     uint64 offset, uint64 bytes) const;
+  uint64 EmbedBlocks(uint8* codewords, uint64 block_count,
+                     uint64 offset, uint64 bytes) const;
+
+  class BitLayer;
+  class BlockLayer;
+
+private:
+  std::shared_ptr<Encoder> encoder_;
+  std::shared_ptr<Permutation> local_permutation_;
+  std::shared_ptr<VirtualStorage> storage_;
+  std::unique_ptr<BitLayer> bit_layer_;
+  std::unique_ptr<BlockLayer> block_layer_;
+  // blocks of the block layer per block of the encoder
+  uint64 block_scale_;
+};
+
+} // stego_disk
+
+#endif // STEGODISK_CARRIERFILES_CARRIERKERNEL_H_
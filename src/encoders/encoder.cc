@@ -51,6 +51,64 @@ uint32 Encoder::GetDataBlockSize() {
   return data_block_size_;
 }
 
+/**
+ * @brief Transform consecutive blocks of user data
+ *
+ * Embeds 'block_count' data blocks stored one after another in 'data' into
+ * 'block_count' codeword blocks stored one after another in 'codewords'.
+ * Blocks are independent, so disjoint block ranges of one buffer can be
+ * processed by several threads at once.
+ * Default implementation calls Embed for each block, derived classes
+ * may override it with something faster.
+ *
+ * @param[in,out] codewords Buffer of block_count * GetCodewordBlockSize() bytes
+ * @param[in] data Buffer of block_count * GetDataBlockSize() bytes
+ * @param[in] block_count Number of blocks to be processed
+ * @return Exception std::invalid_argument, if 'codewords' or 'data' are NULL pointer, otherwise 0
+ */
+int Encoder::EmbedBlocks(uint8* codewords, const uint8* data,
+                         uint64 block_count) {
+  if (block_count == 0) return 0;
+  if ( !codewords )
+    throw std::invalid_argument("Encoder::embedBlocks: 'codewords' is NULL");
+  if ( !data )
+    throw std::invalid_argument("Encoder::embedBlocks: 'data' is NULL");
+
+  for (uint64 b = 0; b < block_count; ++b) {
+    Embed(&codewords[b * codeword_block_size_], &data[b * data_block_size_]);
+  }
+  return 0;
+}
+
+/**
+ * @brief Transform consecutive codeword blocks into user data
+ *
+ * Extracts 'block_count' codeword blocks stored one after another in 'codewords'
+ * into 'block_count' data blocks stored one after another in 'data'.
+ * Blocks are independent, so disjoint block ranges of one buffer can be
+ * processed by several threads at once.
+ * Default implementation calls Extract for each block, derived classes
+ * may override it with something faster.
+ *
+ * @param[in] codewords Buffer of block_count * GetCodewordBlockSize() bytes
+ * @param[out] data Buffer of block_count * GetDataBlockSize() bytes
+ * @param[in] block_count Number of blocks to be processed
+ * @return Exception std::invalid_argument, if 'codewords' or 'data' are NULL pointer, otherwise 0
+ */
+int Encoder::ExtractBlocks(const uint8* codewords, uint8* data,
+                           uint64 block_count) {
+  if (block_count == 0) return 0;
+  if ( !codewords )
+    throw std::invalid_argument("Encoder::extractBlocks: 'codewords' is NULL");
+  if ( !data )
+    throw std::invalid_argument("Encoder::extractBlocks: 'data' is NULL");
+
+  for (uint64 b = 0; b < block_count; ++b) {
+    Extract(&codewords[b * codeword_block_size_], &data[b * data_block_size_]);
+  }
+  return 0;
+}
+
 /**
  * @brief Throws an exception because derived class has no implemented this method
  *
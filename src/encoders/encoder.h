@@ -27,6 +27,10 @@ public:
   virtual ~Encoder();
   virtual int Embed(uint8* codeword, const uint8* data) = 0;
   virtual int Extract(const uint8* codeword, uint8* data) = 0;
+  virtual int EmbedBlocks(uint8* codewords, const uint8* data,
+                          uint64 block_count);
+  virtual int ExtractBlocks(const uint8* codewords, uint8* data,
+                            uint64 block_count);
 
   virtual uint32 GetDataBlockSize();
   virtual uint32 GetCodewordBlockSize();
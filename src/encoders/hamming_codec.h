@@ -0,0 +1,112 @@
+/**
+* @file hamming_codec.h
+* @author Martin Kosdy
+* @author Matus Kysel
+* @date 2016
+* @brief Hamming code specialized on the number of parity bits
+*
+*/
+
+#ifndef STEGODISK_ENCODERS_HAMMINGCODEC_H_
+#define STEGODISK_ENCODERS_HAMMINGCODEC_H_
+
+#include "utils/stego_types.h"
+
+namespace stego_disk {
+
+typedef uint8 HammingSyndromeRow[256];
+
+// per-byte syndrome lookup table shared by all codes, see hamming_encoder.cc
+const HammingSyndromeRow* GetHammingSyndromeTable();
+
+constexpr uint32 HammingGcd(uint32 a, uint32 b) {
+  return b ? HammingGcd(b, a % b) : a;
+}
+
+/**
+ * The HammingCodec class.
+ *
+ * Hamming code with 'kParityBits' parity bits known at compile time,
+ * so block and codeword sizes are constants and loops can be unrolled.
+ * Layout of codewords and data blocks is the same as in HammingEncoder:
+ *  - codeword bit at (1-based, MSB first) position p contributes p to the syndrome,
+ *  - data block is a big-endian sequence of 'kParityBits' bit syndromes.
+ * It is used by HammingEncoder and by carrier kernels (see carrier_kernel.h).
+ */
+template <uint32 kParityBits>
+class HammingCodec {
+public:
+  static const uint32 kTotalBits = (1u << kParityBits) - 1;
+  static const uint32 kDataBlockSize =
+      kParityBits / HammingGcd(kParityBits, 8);
+  static const uint32 kCodewordsInBlock = (kDataBlockSize * 8) / kParityBits;
+  static const uint32 kCodewordBufferSize = (kTotalBits - 1) / 8 + 1;
+  static const uint32 kCodewordBlockSize =
+      kCodewordBufferSize * kCodewordsInBlock;
+
+  HammingCodec() : table_(GetHammingSyndromeTable()) {}
+
+  uint32 GetDataBlockSize() const { return kDataBlockSize; }
+  uint32 GetCodewordBlockSize() const { return kCodewordBlockSize; }
+
+  // Syndrome H * x of one codeword; the last bit of the last byte is not used
+  inline uint32 ComputeH(const uint8* buffer) const {
+    uint32 result = 0;
+    for (uint32 i = 0; i < kCodewordBufferSize - 1; ++i) {
+      result ^= table_[i][buffer[i]];
+    }
+    return result ^ table_[kCodewordBufferSize - 1]
+                          [buffer[kCodewordBufferSize - 1] & 0xFE];
+  }
+
+  // Flips at most one bit in each codeword, so that its syndrome equals data
+  inline void EmbedBlock(uint8* codeword, const uint8* data) const {
+    uint64 message = 0;
+    for (uint32 i = 0; i < kDataBlockSize; ++i) {
+      message = (message << 8) | data[i];
+    }
+
+    uint32 shift = kDataBlockSize * 8;
+    for (uint32 i = 0; i < kCodewordsInBlock; ++i) {
+      shift -= kParityBits;
+      uint8* buffer = &codeword[i * kCodewordBufferSize];
+      uint32 h = ComputeH(buffer) ^
+                 static_cast<uint32>((message >> shift) & kTotalBits);
+      if (h) buffer[(h - 1) / 8] ^= static_cast<uint8>(1 << (7 - ((h - 1) % 8)));
+    }
+  }
+
+  // Concatenates syndromes of all codewords in the block
+  inline void ExtractBlock(const uint8* codeword, uint8* data) const {
+    uint64 message = 0;
+    for (uint32 i = 0; i < kCodewordsInBlock; ++i) {
+      message = (message << kParityBits) |
+                ComputeH(&codeword[i * kCodewordBufferSize]);
+    }
+    for (uint32 i = kDataBlockSize; i > 0; --i) {
+      data[i - 1] = static_cast<uint8>(message);
+      message >>= 8;
+    }
+  }
+
+  inline void EmbedBlocks(uint8* codewords, const uint8* data,
+                          uint64 block_count) const {
+    for (uint64 b = 0; b < block_count; ++b) {
+      EmbedBlock(&codewords[b * kCodewordBlockSize], &data[b * kDataBlockSize]);
+    }
+  }
+
+  inline void ExtractBlocks(const uint8* codewords, uint8* data,
+                            uint64 block_count) const {
+    for (uint64 b = 0; b < block_count; ++b) {
+      ExtractBlock(&codewords[b * kCodewordBlockSize], &data[b * kDataBlockSize]);
+    }
+  }
+
+private:
+  const HammingSyndromeRow* table_;
+};
+
+} // stego_disk
+
+#endif // STEGODISK_ENCODERS_HAMMINGCODEC_H_
@@ -12,6 +12,7 @@
 #include <string.h>
 #include <algorithm>
 
+#include "hamming_codec.h"
 #include "utils/stego_math.h"
 #include "utils/stego_errors.h"
 #include "logging/logger.h"
@@ -20,6 +21,40 @@ namespace stego_disk {
 
 const string HammingEncoder::kEncoderHammingCodeName = ENCODER_HAMMING_CODE_NAME_DEF;
 
+// codeword of the longest supported code (2^8 - 1 bits) occupies 32 bytes
+#define HAMMING_MAX_CODEWORD_BUFFER_SIZE   32
+
+/**
+ * @brief Per-byte syndrome lookup table
+ *
+ * Bit at (1-based, MSB first) position p of the codeword contributes p
+ * to the syndrome H * x. value[i][b] is the contribution of byte value b
+ * at byte offset i of the codeword. Positions do not depend on the number
+ * of parity bits, so one table serves all codes with parity bits in <3;8>.
+ * Position 2^k (last bit of the last byte) is not part of the code
+ * and has to be masked out by the caller.
+ */
+struct HammingSyndromeTable {
+  HammingSyndromeTable() {
+    for (uint32 i = 0; i < HAMMING_MAX_CODEWORD_BUFFER_SIZE; ++i) {
+      for (uint32 b = 0; b < 256; ++b) {
+        uint32 h = 0;
+        for (uint32 j = 0; j < 8; ++j) {
+          if ((b >> (7 - j)) & 0x01) h ^= (i * 8 + j + 1);
+        }
+        value[i][b] = static_cast<uint8>(h);
+      }
+    }
+  }
+
+  uint8 value[HAMMING_MAX_CODEWORD_BUFFER_SIZE][256];
+};
+
+const HammingSyndromeRow* GetHammingSyndromeTable() {
+  static const HammingSyndromeTable table;
+  return table.value;
+}
+
 /**
  * @brief Get minimal value for parameter 'parity_bits'
  *
@@ -269,25 +304,12 @@ const string HammingEncoder::GetNameInstance() const {
  * @return Exception std::invalid_argument, if 'codeword' or 'data' are NULL pointer
  */
 int HammingEncoder::Embed(uint8 *codeword, const uint8 *data) {
-  uint64 h;
-  int bit_offset = 0;
-
   if ( !codeword )
     throw std::invalid_argument("HammingEncoder::embed: 'codeword' is NULL");
   if ( !data )
     throw std::invalid_argument("HammingEncoder::embed: 'data' is NULL");
 
-  for (uint32 i = 0; i < codewords_in_block_; ++i) {
-    h = ComputeH(&codeword[i * codeword_buffer_size_]);
-    h ^= ReadBitsFromBuffer(data, bit_offset, parity_bits_); // h = h xor m
-
-    if (h != 0) {
-      SwapBitInCodeword(&codeword[i*codeword_buffer_size_],
-          static_cast<int>(h));
-    }
-
-    bit_offset += parity_bits_;
-  }
+  EmbedBlocksUnchecked(codeword, data, 1);
 
   return 0;
 }
@@ -311,146 +333,120 @@ int HammingEncoder::Extract(const uint8 *codeword, uint8 *data) {
   if ( !data )
     throw std::invalid_argument("HammingEncoder::extract: 'data' is NULL");
 
-  memset(data, 0, data_block_size_);
-
-  uint64 h;
-  int bit_offset = 0;
-
-  for (uint32 i = 0; i < codewords_in_block_; ++i) {
-    h = ComputeH(&codeword[i * codeword_buffer_size_]);
-    WriteBitsToBuffer(h, bit_offset, data);
-    bit_offset += parity_bits_;
-  }
+  ExtractBlocksUnchecked(codeword, data, 1);
 
   return STEGO_NO_ERROR;
 }
 
 /**
- * @brief Writes value (bit representation) to offset in buffer
+ * @brief Transform consecutive blocks of user data with Hamming encoder
  *
- * Writes bit representation of 'value' into 'buffer' starting at 'offset' position.
- * This helper function is invoked internally from HammingEncoder::extract method.
- * Method doesn't make any variables validity test.
+ * Same as HammingEncoder::embed, but for 'block_count' blocks stored
+ * one after another in 'codewords' and 'data'.
+ * Input buffers are checked only once for the whole range.
+ *
+ * @param[in] data Initialized buffer with user data
+ * @param[out] codewords Buffer with encoded user data
+ * @param[in] block_count Number of blocks to be processed
+ * @return Exception std::invalid_argument, if 'codewords' or 'data' are NULL pointer
+ */
+int HammingEncoder::EmbedBlocks(uint8 *codewords, const uint8 *data,
+                                uint64 block_count) {
+  if (block_count == 0) return 0;
+  if ( !codewords )
+    throw std::invalid_argument("HammingEncoder::embedBlocks: "
+                                "'codewords' is NULL");
+  if ( !data )
+    throw std::invalid_argument("HammingEncoder::embedBlocks: 'data' is NULL");
+
+  EmbedBlocksUnchecked(codewords, data, block_count);
+
+  return 0;
+}
+
+/**
+ * @brief Transform consecutive blocks of data with Hamming decoder
  *
- * @param[in] value Value to be written into buffer
- * @param[in] offset Starting position from beginning of the buffer in bits
- * @param[out] buffer Initialized memory storage
+ * Same as HammingEncoder::extract, but for 'block_count' blocks stored
+ * one after another in 'codewords' and 'data'.
+ * Input buffers are checked only once for the whole range.
  *
- * @return Nothing
+ * @param[in] codewords Initialized buffer with encoded user data
+ * @param[out] data Buffer with decoded user data
+ * @param[in] block_count Number of blocks to be processed
+ * @return Exception std::invalid_argument, if 'codewords' or 'data' are NULL pointer
  */
-void HammingEncoder::WriteBitsToBuffer(uint64 value, int offset,
-                                       uint8 *buffer) {
-  int shr_value;
-  uint8 tmp_value;
-  int written_bts = 0;
-
-  while (written_bts < static_cast<int>(parity_bits_)) {
-    int byte_offset = offset / 8;
-    int bit_offset = offset % 8;
-    shr_value = parity_bits_ - 8 + bit_offset - written_bts;
-    if (shr_value < 0) {
-      tmp_value = (value << -shr_value) & ((0xFF << -shr_value) & 0xFF);
-    } else {
-      tmp_value = (value >> shr_value) & 0xFF;
-    }
-    buffer[byte_offset] ^= tmp_value;
+int HammingEncoder::ExtractBlocks(const uint8 *codewords, uint8 *data,
+                                  uint64 block_count) {
+  if (block_count == 0) return STEGO_NO_ERROR;
+  if ( !codewords )
+    throw std::invalid_argument("HammingEncoder::extractBlocks: "
+                                "'codewords' is NULL");
+  if ( !data )
+    throw std::invalid_argument("HammingEncoder::extractBlocks: "
+                                "'data' is NULL");
 
-    if (shr_value <= 0) {
-      written_bts += (parity_bits_ - written_bts);
-    } else {
-      written_bts += ((parity_bits_ - written_bts) - shr_value);
-    }
+  ExtractBlocksUnchecked(codewords, data, block_count);
 
-    if (shr_value <= 0) {
-      offset += parity_bits_;
-    } else {
-      offset += (parity_bits_ - shr_value);
-    }
-  }
+  return STEGO_NO_ERROR;
 }
 
 /**
- * @brief Reads value (bit representation) at offset from buffer
+ * @brief Embeds data blocks using code specialized on 'parity_bits_'
  *
- * Reads bit representation of 'result' from 'buffer' starting at 'offset' position.
- * This helper function is invoked internally from HammingEncoder::embed method.
+ * Dispatches to HammingCodec instantiated for the current number
+ * of parity bits, so that all block sizes are compile-time constants.
  * Method doesn't make any variables validity test.
  *
- * @param[in] buffer Initialized memory storage with valid data
- * @param[in] offset Starting position for reading from beginning of the buffer in bits
- * @param[in] length Number of bits to be read from buffer
+ * @param[in,out] codewords Buffer of 'block_count' codeword blocks
+ * @param[in] data Buffer of 'block_count' data blocks
+ * @param[in] block_count Number of blocks to be processed
  *
- * @return Readed bits from buffer represented as number
+ * @return Nothing
  */
-uint64 HammingEncoder::ReadBitsFromBuffer(const uint8 *buffer, int offset,
-                                          int length) {
-  uint8 tmp_value;
-  uint64 tmp_long_value;
-  uint64 result = 0;
-  int written_bts = 0;
-  int tmp_written_bits;
-
-  while (written_bts < length) {
-    int byte_offset = offset / 8;
-    int bit_offset = offset % 8;
-    tmp_value = (buffer[byte_offset] << bit_offset) & 0xFF;
-    tmp_written_bits = 8 - bit_offset;
-
-    if (length - written_bts < tmp_written_bits) {
-      tmp_value >>= tmp_written_bits - (length - written_bts);
-      tmp_written_bits -= (tmp_written_bits - (length - written_bts));
-    }
-    tmp_value = tmp_value >> bit_offset;
-    tmp_long_value = tmp_value;
-    result ^= tmp_long_value << (length - written_bts - tmp_written_bits);
-    offset += tmp_written_bits;
-    written_bts += tmp_written_bits;
+void HammingEncoder::EmbedBlocksUnchecked(uint8 *codewords, const uint8 *data,
+                                          uint64 block_count) const {
+  switch (parity_bits_) {
+    case 3: HammingCodec<3>().EmbedBlocks(codewords, data, block_count); break;
+    case 4: HammingCodec<4>().EmbedBlocks(codewords, data, block_count); break;
+    case 5: HammingCodec<5>().EmbedBlocks(codewords, data, block_count); break;
+    case 6: HammingCodec<6>().EmbedBlocks(codewords, data, block_count); break;
+    case 7: HammingCodec<7>().EmbedBlocks(codewords, data, block_count); break;
+    case 8: HammingCodec<8>().EmbedBlocks(codewords, data, block_count); break;
   }
-  return result;
 }
 
 /**
- * @brief Multiply input vector by control matrix H
+ * @brief Extracts data blocks using code specialized on 'parity_bits_'
  *
- * Multiply input vector stored in 'buffer' by control matrix of Hamming code H.
- * This function is used from HammingEncoder::extract and HammingEncoder::embed.
- * There is no control of validity of input argument.
+ * Counterpart of HammingEncoder::EmbedBlocksUnchecked.
+ * Method doesn't make any variables validity test.
  *
- * @param[in] buffer Input vector to be multipled
+ * @param[in] codewords Buffer of 'block_count' codeword blocks
+ * @param[out] data Buffer of 'block_count' data blocks
+ * @param[in] block_count Number of blocks to be processed
  *
- * @return Multiplication result
+ * @return Nothing
  */
-uint64 HammingEncoder::ComputeH(const uint8 *buffer) {
-  uint64 tmp_hline = 1;
-  uint64 result = 0;
-
-  for (uint32 i = 0; i < codeword_buffer_size_; ++i) {
-    for (int j = 7; j >= 0; --j) {
-      if (tmp_hline <= static_cast<uint64>(total_bits_)) {
-        if ((buffer[i] >> j) & 0x01) result ^= tmp_hline;
-        ++tmp_hline;
-      }
-    }
+void HammingEncoder::ExtractBlocksUnchecked(const uint8 *codewords, uint8 *data,
+                                            uint64 block_count) const {
+  switch (parity_bits_) {
+    case 3: HammingCodec<3>().ExtractBlocks(codewords, data, block_count); break;
+    case 4: HammingCodec<4>().ExtractBlocks(codewords, data, block_count); break;
+    case 5: HammingCodec<5>().ExtractBlocks(codewords, data, block_count); break;
+    case 6: HammingCodec<6>().ExtractBlocks(codewords, data, block_count); break;
+    case 7: HammingCodec<7>().ExtractBlocks(codewords, data, block_count); break;
+    case 8: HammingCodec<8>().ExtractBlocks(codewords, data, block_count); break;
   }
-  return result;
 }
 
 /**
- * @brief Swap value of the bit in codeword
- *
- * Swap value of the 'bit_in'-th bit in codeword buffer.
- * Function is used internally from HammingEncoder::embed.
- * There is no check of validity of the input args.
+ * @brief Get the number of parity bits of the code
  *
- * @param[in] bit_in Position (in bits) of the bit to be changed in input 'buffer'
- * @param buffer Initialized buffer with valid data (codewords)
- *
- * @return Nothing
+ * @return Number of parity bits, in range <GetParityBitsMin(); GetParityBitsMax()>
  */
-void HammingEncoder::SwapBitInCodeword(uint8 *buffer, int bit_in){
-  if (!bit_in)
-    return;
-  buffer[(bit_in - 1) / 8] ^= 1 << (7 - ((bit_in - 1) % 8));
+uint32 HammingEncoder::GetParityBits() const {
+  return parity_bits_;
 }
 
 } // stego_disk
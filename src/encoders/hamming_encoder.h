@@ -24,6 +24,8 @@ public:
 
   int Embed(uint8 *codeword, const uint8 *data);
   int Extract(const uint8 *codeword, uint8 *data);
+  int EmbedBlocks(uint8 *codewords, const uint8 *data, uint64 block_count);
+  int ExtractBlocks(const uint8 *codewords, uint8 *data, uint64 block_count);
 
   void SetArgByName(const string &arg, const string &val);
 
@@ -34,13 +36,14 @@ public:
 
   static int GetParityBitsMin();
   static int GetParityBitsMax();
+  uint32 GetParityBits() const;
 
 private:
   void Init(uint32 parity_bits);
-  uint64 ComputeH(const uint8 *buffer);
-  void SwapBitInCodeword(uint8 *buffer, int bit_in);
-  void WriteBitsToBuffer(uint64 value, int offset, uint8 *buffer);
-  uint64 ReadBitsFromBuffer(const uint8 *buffer, int offset, int length);
+  void EmbedBlocksUnchecked(uint8 *codewords, const uint8 *data,
+                            uint64 block_count) const;
+  void ExtractBlocksUnchecked(const uint8 *codewords, uint8 *data,
+                              uint64 block_count) const;
 
   uint32 parity_bits_;
   uint32 total_bits_;
@@ -206,6 +206,52 @@ int LsbEncoder::Extract(const uint8 *codeword, uint8 *data) {
   return 0;
 }
 
+/**
+ * @brief Transform consecutive blocks of user data with Lsb encoder
+ *
+ * Codeword and data blocks are identical for Lsb encoder,
+ * so the whole range is copied at once.
+ *
+ * @param[in] data Initialized buffer with user data
+ * @param[out] codewords Buffer with encoded user data
+ * @param[in] block_count Number of blocks to be processed
+ * @return Exception std::invalid_argument, if 'codewords' or 'data' are NULL pointer, otherwise 0
+ */
+int LsbEncoder::EmbedBlocks(uint8 *codewords, const uint8 *data,
+                            uint64 block_count) {
+  if (block_count == 0) return 0;
+  if ( !codewords )
+    throw std::invalid_argument("LsbEncoder::embedBlocks: 'codewords' is NULL");
+  if ( !data )
+    throw std::invalid_argument("LsbEncoder::embedBlocks: 'data' is NULL");
+  if (codewords != data)
+    memcpy(codewords, data, block_count * data_block_size_);
+  return 0;
+}
+
+/**
+ * @brief Transform consecutive blocks of data with Lsb decoder
+ *
+ * Codeword and data blocks are identical for Lsb encoder,
+ * so the whole range is copied at once.
+ *
+ * @param[in] codewords Initialized buffer with encoded user data
+ * @param[out] data Buffer with decoded user data
+ * @param[in] block_count Number of blocks to be processed
+ * @return Exception std::invalid_argument, if 'codewords' or 'data' are NULL pointer, otherwise 0
+ */
+int LsbEncoder::ExtractBlocks(const uint8 *codewords, uint8 *data,
+                              uint64 block_count) {
+  if (block_count == 0) return 0;
+  if ( !codewords )
+    throw std::invalid_argument("LsbEncoder::extractBlocks: 'codewords' is NULL");
+  if ( !data )
+    throw std::invalid_argument("LsbEncoder::extractBlocks: 'data' is NULL");
+  if (codewords != data)
+    memcpy(data, codewords, block_count * codeword_block_size_);
+  return 0;
+}
+
 /**
  * @brief Set parameter param of the encoder with value val
  *
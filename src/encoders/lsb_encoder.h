@@ -24,6 +24,8 @@ public:
 
     int Embed(uint8 *codeword, const uint8 *data);
     int Extract(const uint8 *codeword, uint8 *data);
+    int EmbedBlocks(uint8 *codewords, const uint8 *data, uint64 block_count);
+    int ExtractBlocks(const uint8 *codewords, uint8 *data, uint64 block_count);
 
     void SetArgByName(const string &arg, const string &val);
 
@@ -0,0 +1,36 @@
+/**
+* @file capacity_estimate.h
+* @author Martin Kosdy
+* @author Matus Kysel
+* @date 2016
+* @brief Storage configurations and their estimated capacities
+*
+*/
+
+#ifndef STEGODISK_FILEMANAGEMENT_CAPACITYESTIMATE_H_
+#define STEGODISK_FILEMANAGEMENT_CAPACITYESTIMATE_H_
+
+#include <memory>
+
+#include "encoders/encoder.h"
+#include "permutations/permutation_factory.h"
+#include "utils/stego_types.h"
+
+namespace stego_disk {
+
+struct CapacityConfig {
+  std::shared_ptr<Encoder> encoder;
+  PermutationFactory::PermutationType global_permutation;
+  // formats with a permutation in StegoConfig::file_config() keep it
+  PermutationFactory::PermutationType local_permutation;
+};
+
+struct CapacityEstimate {
+  CapacityConfig config;
+  uint64 carrier_capacity;    // sum of capacities of carriers in bytes
+  uint64 capacity;            // size of the loaded storage, 0 if too small
+};
+
+} // stego_disk
+
+#endif // STEGODISK_FILEMANAGEMENT_CAPACITYESTIMATE_H_
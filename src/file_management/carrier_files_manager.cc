@@ -15,6 +15,7 @@
 #include <stdlib.h>
 
 #include <iostream>
+#include <map>
 #include <vector>
 #include <string>
 #include <algorithm>
@@ -34,12 +35,17 @@ using namespace std;
 
 namespace stego_disk {
 
-CarrierFilesManager::CarrierFilesManager() :
+/**
+ * @param[in] min_carriers_per_task Smallest number of carriers processed
+ *            by one task of parallel loops over all carriers
+ */
+CarrierFilesManager::CarrierFilesManager(std::size_t min_carriers_per_task) :
   capacity_(0),
   files_in_directory_(0),
   virtual_storage_(std::shared_ptr<VirtualStorage>(nullptr)),
   encoder_(std::shared_ptr<Encoder>(nullptr)),
   thread_pool_(new ThreadPool(0)), //std::make_unique<ThreadPool>(0) c++14
+  min_carriers_per_task_(std::max<std::size_t>(1, min_carriers_per_task)),
   is_active_encoder_(false) {}
 
 CarrierFilesManager::~CarrierFilesManager() {
@@ -51,6 +57,7 @@ std::string CarrierFilesManager::GetPath() const {
 }
 
 int CarrierFilesManager::LoadDirectory(const std::string &directory) {
+  TraceScope trace("storage", "LoadDirectory");
 
   carrier_files_.clear();
   capacity_ = 0;
@@ -58,7 +65,10 @@ int CarrierFilesManager::LoadDirectory(const std::string &directory) {
 
   base_path_ = directory;
 
+  PhaseTimer walk_timer(&counters_, StegoStats::STORAGE,
+                        StegoStats::DIRECTORY_WALK);
   vector<File> files = File::GetFilesInDir(directory, "");
+  walk_timer.Stop();
 
   files_in_directory_ = files.size();
 
@@ -67,18 +77,25 @@ int CarrierFilesManager::LoadDirectory(const std::string &directory) {
   }
 
   std::vector<std::future<CarrierFilePtr>> carrier_files;
+  PerfCounters *counters = &counters_;
+
+  // headers are parsed (JPEG coefficients are counted) while creating carriers
+  auto create_carrier = [counters](File file) {
+    PhaseTimer timer(counters, StegoStats::GetFormat(file.GetExtension()),
+                     StegoStats::CAPACITY_SCAN, file.GetSize());
+    return CarrierFileFactory::CreateCarrierFile(file);
+  };
 
   for(auto &file: files) {
     if(StegoConfig::exclude_list().find(file.GetExtension()) == StegoConfig::exclude_list().end()) {
-      carrier_files.emplace_back(thread_pool_->enqueue(
-                                   &CarrierFileFactory::CreateCarrierFile,
-                                   file));
+      carrier_files.emplace_back(thread_pool_->enqueue(create_carrier, file));
     }
   }
 
   for(auto &&file: carrier_files) {
     auto result = file.get();
     if (result != nullptr) {
+      result->SetPerfCounters(&counters_);
       carrier_files_.push_back(result);
     }
   }
@@ -90,6 +107,7 @@ int CarrierFilesManager::LoadDirectory(const std::string &directory) {
               "' has raw capacity " << carrier_files_[i]->GetRawCapacity());
   }
 
+  // sort keys are computed once by each carrier
   std::sort(carrier_files_.begin(), carrier_files_.end(),
             CarrierFile::CompareBySharedPointers);
 
@@ -99,6 +117,7 @@ int CarrierFilesManager::LoadDirectory(const std::string &directory) {
 // return false, if checksum is not valid, true otherwise
 // TODO mY check PERMUTATION init by PASSWORD
 bool CarrierFilesManager::LoadVirtualStorage(std::shared_ptr<VirtualStorage> storage) {
+  TraceScope trace("storage", "LoadVirtualStorage");
   if (!storage)
     throw std::invalid_argument("CarrierFilesManager::loadVirtualStorage: "
                                 "arg 'storage' is nullptr");
@@ -109,8 +128,13 @@ bool CarrierFilesManager::LoadVirtualStorage(std::shared_ptr<VirtualStorage> sto
     throw std::invalid_argument("CarrierFilesManager::loadVirtualStorage: "
                                 "encoder is not applied yet");
 
-  try { storage->ApplyPermutation(this->GetCapacity(), master_key_); }
-  catch (...) { throw; }
+  storage->SetPerfCounters(&counters_);
+  {
+    PhaseTimer timer(&counters_, StegoStats::STORAGE,
+                     StegoStats::PERMUTATION_INIT, this->GetCapacity());
+    try { storage->ApplyPermutation(this->GetCapacity(), master_key_); }
+    catch (...) { throw; }
+  }
 
   uint64 offset = 0;
 
@@ -155,12 +179,17 @@ bool CarrierFilesManager::LoadVirtualStorage(std::shared_ptr<VirtualStorage> sto
 }
 
 int CarrierFilesManager::SaveVirtualStorage() {
+  TraceScope trace("storage", "SaveVirtualStorage");
   if (!virtual_storage_) return SE_UNINITIALIZED;
 
+  counters_.BeginSave(virtual_storage_->GetUsableCapacity());
+
   virtual_storage_->WriteChecksum();
 
   SaveAllFiles();
 
+  counters_.EndSave();
+
   return STEGO_NO_ERROR;
 }
 
@@ -205,11 +234,19 @@ void CarrierFilesManager::ApplyEncoder() {
   uint64 raw_cap = 0;
 
   // mY from CFM::loadVS
+  PhaseTimer key_timer(&counters_, StegoStats::STORAGE,
+                       StegoStats::KEY_DERIVATION);
   GenerateMasterKey();
   DeriveSubkeys();
+  key_timer.Stop();
+
+  // capacity of a carrier depends on its subkey (size of its permutation)
+  ForEachCarrierRange([this](std::size_t begin, std::size_t end) {
+    for (std::size_t i = begin; i < end; ++i)
+      carrier_files_[i]->SetEncoder(encoder_);
+  });
 
   for (size_t i = 0; i < carrier_files_.size(); ++i) {
-    carrier_files_[i]->SetEncoder(encoder_);
     capacity += carrier_files_[i]->GetCapacity();
     raw_cap += carrier_files_[i]->GetRawCapacity();
     LOG_DEBUG("CarrierFilesManager::applyEncoder: file '" <<
@@ -248,11 +285,18 @@ void CarrierFilesManager::GenerateMasterKey() {
   LOG_DEBUG("CarrierFilesManager::generateMasterKey: PSWD HASH is "
             << StegoMath::HexBufferToStr(password_hash_.GetState()));
 
+  // keys generated from params of individual carrier files (see
+  // CarrierFile::GetPermKey) are independent, only appending is serial
+  std::vector<Key> perm_keys(carrier_files_.size());
+  ForEachCarrierRange([this, &perm_keys](std::size_t begin, std::size_t end) {
+    for (std::size_t i = begin; i < end; ++i)
+      perm_keys[i] = carrier_files_[i]->GetPermKey();
+  });
+
   Hash master_hey_hash(password_hash_);
 
-  // add keys generated from params of individual carrier files
   for (size_t i = 0; i < carrier_files_.size(); ++i) {
-    master_hey_hash.Append(carrier_files_[i]->GetPermKey().GetData());
+    master_hey_hash.Append(perm_keys[i].GetData());
   }
 
   master_key_ = Key(master_hey_hash.GetState());
@@ -267,27 +311,69 @@ void CarrierFilesManager::DeriveSubkeys() {
   LOG_DEBUG("CarrierFilesManager::deriveSubkeys: master key is "
             << StegoMath::HexBufferToStr(master_key_.GetData()));
 
-  Hash hash;
+  // hash of the master key is the same for all subkeys
+  Hash master_key_hash(master_key_.GetData().GetConstRawPointer(),
+                       master_key_.GetData().GetSize());
 
-  for (uint64 i = 0; i < carrier_files_.size(); ++i) {
+  ForEachCarrierRange([this, &master_key_hash](std::size_t begin,
+                                                std::size_t end) {
+    for (uint64 i = begin; i < end; ++i) {
+
+      // subkey = hash ( hash(master_key | file_index) | hash(file_path) )
 
-    // subkey = hash ( hash(master_key | file_index) | hash(file_path) )
+      Hash hash(master_key_hash);
+      hash.Append(std::to_string(i));
+      hash.Append(carrier_files_[i]->GetFile().GetNormalizedPath());
 
-    hash.Process(master_key_.GetData());
-    hash.Append(std::to_string(i));
-    hash.Append(carrier_files_[i]->GetFile().GetNormalizedPath());
+      carrier_files_[i]->SetSubkey(Key(hash.GetState()));
 
-    carrier_files_[i]->SetSubkey(Key(hash.GetState()));
+      LOG_DEBUG("CarrierFilesManager::deriveSubkeys: subkey for carrier '"
+                << carrier_files_[i]->GetFile().GetAbsolutePath() << "' is " <<
+                StegoMath::HexBufferToStr(hash.GetState()));
+    }
+  });
+
+}
+
+
+/**
+ * @brief Calls function(begin, end) on ranges covering all carriers
+ *
+ * Ranges run as tasks of the thread pool when there are at least two
+ * ranges of min_carriers_per_task_ carriers, at most one per worker
+ * (the pool has at least 4 of them, also on single-core machines), so
+ * the function must not wait for other pool tasks.
+ *
+ * @param[in] function Processes carriers <begin; end)
+ */
+void CarrierFilesManager::ForEachCarrierRange(
+    const std::function<void(std::size_t, std::size_t)> &function) {
+  std::size_t count = carrier_files_.size();
+  std::size_t tasks = std::min(count / min_carriers_per_task_,
+                               thread_pool_->GetThreadCount());
+
+  if (tasks <= 1) {
+    function(0, count);
+    return;
+  }
 
-    LOG_DEBUG("CarrierFilesManager::deriveSubkeys: subkey for carrier '"
-              << carrier_files_[i]->GetFile().GetAbsolutePath() << "' is " <<
-              StegoMath::HexBufferToStr(hash.GetState()));
+  std::vector<std::future<void>> results;
+  std::size_t range = (count - 1) / tasks + 1;
+
+  for (std::size_t begin = 0; begin < count; begin += range) {
+    std::size_t end = std::min(count, begin + range);
+    results.emplace_back(thread_pool_->enqueue(function, begin, end));
   }
 
+  // tasks use data of the caller, all of them must finish before throwing
+  for (auto &&result: results) result.wait();
+  for (auto &&result: results) result.get();
 }
 
 
+
 void CarrierFilesManager::SaveAllFiles() {
+  TraceScope trace("storage", "SaveAllFiles");
   std::vector<std::future<void>> save_results;
 
   for (size_t i = 0; i < carrier_files_.size(); ++i) {
@@ -302,6 +388,29 @@ void CarrierFilesManager::SaveAllFiles() {
 }
 
 
+/**
+ * @brief Snapshot of performance counters of the storage and its carriers
+ */
+StegoStats CarrierFilesManager::GetStats() const {
+  StegoStats stats = StegoStats();
+
+  counters_.Fill(&stats);
+  for (auto &carrier : carrier_files_) {
+    StegoStats::FormatStats &format = stats.formats[carrier->GetStatsFormat()];
+    ++format.carriers;
+    format.raw_capacity += carrier->GetRawCapacity();
+  }
+  stats.hash_calls = Hash::GetCallCount();
+  stats.hash_bytes = Hash::GetByteCount();
+
+  return stats;
+}
+
+void CarrierFilesManager::ResetStats() {
+  counters_.Reset();
+  Hash::ResetCounters();
+}
+
 uint64 CarrierFilesManager::GetCapacity() {
   if (!encoder_)
     throw std::invalid_argument("CarrierFilesManager::GetCapacity: "
@@ -332,4 +441,140 @@ uint64 CarrierFilesManager::GetCapacityUsingEncoder(
   return capacity;
 }
 
+/**
+ * @brief Capacities of storage configurations, without loading carriers
+ *
+ * Uses raw capacities found while opening the directory and follows
+ * ApplyEncoder and LoadVirtualStorage: sizes of local permutations
+ * of carriers, blocks of the encoder and the size of the global
+ * permutation, minus the checksum.
+ *
+ * Local permutation of a configuration applies to carriers of formats
+ * without their own permutation in StegoConfig::file_config(), others
+ * keep the permutation of their format (as set by CarrierFileFactory).
+ *
+ * Sizes of all permutations depend only on the requested size (the key
+ * is only checked, the affine multiplier is always coprime with its
+ * prime modulus), so carriers of equal raw capacity and local
+ * permutation share one evaluation, with a zero key of the length of
+ * subkeys instead of keys derived from the password.
+ *
+ * Capacity is zero for configurations which can't be loaded and saved:
+ * each carrier has to hold a part of the storage (blocks of carriers
+ * without any used block are neither extracted nor embedded), and the
+ * storage has to be larger than its checksum.
+ *
+ * @param[in] configs Configurations to evaluate
+ * @return Estimate for each configuration, in the same order
+ */
+std::vector<CapacityEstimate> CarrierFilesManager::EstimateCapacity(
+    const std::vector<CapacityConfig> &configs) {
+  TraceScope trace("storage", "EstimateCapacity");
+  typedef PermutationFactory::PermutationType PermutationType;
+  std::vector<CapacityEstimate> estimates;
+
+  for (auto &config : configs) {
+    if (!config.encoder)
+      throw std::invalid_argument("CarrierFilesManager::EstimateCapacity: "
+                                  "encoder of a configuration is nullptr");
+    CapacityEstimate estimate = { config, 0, 0 };
+    estimates.push_back(estimate);
+  }
+  if (carrier_files_.empty()) return estimates;
+
+  MemoryBuffer zero_key(Hash::GetDefaultStateSize());
+  zero_key.Clear();
+  Key key(zero_key);
+
+  // distinct raw capacities and number of carriers with each of them,
+  // separately for carriers with permutations set by their format
+  std::map<uint64, uint64> raw_capacities;
+  std::map<PermutationType, std::map<uint64, uint64>> format_raw_capacities;
+  for (auto &carrier : carrier_files_) {
+    auto format = StegoConfig::file_config().find(
+                    carrier->GetFile().GetExtension());
+    if (format == StegoConfig::file_config().end())
+      ++raw_capacities[carrier->GetRawCapacity()];
+    else
+      ++format_raw_capacities[format->second.second][carrier->GetRawCapacity()];
+  }
+
+  auto last_format = StegoConfig::file_config().find(
+                       carrier_files_.back()->GetFile().GetExtension());
+  bool last_uses_config = last_format == StegoConfig::file_config().end();
+  uint64 last_raw_capacity = carrier_files_.back()->GetRawCapacity();
+
+  // permutation sizes in bits, per local permutation type and raw capacity
+  std::map<std::pair<PermutationType, uint64>, uint64> local_sizes;
+  auto local_size = [&local_sizes, &key](PermutationType type,
+                                         uint64 raw_capacity) {
+    auto size = local_sizes.find(std::make_pair(type, raw_capacity));
+    if (size == local_sizes.end()) {
+      uint64 bits = PermutationFactory::GetPermutation(type)
+                      ->GetSizeUsingParams(raw_capacity * 8, key);
+      size = local_sizes.emplace(std::make_pair(type, raw_capacity),
+                                 bits).first;
+    }
+    return size->second;
+  };
+
+  for (auto &estimate : estimates) {
+    const CapacityConfig &config = estimate.config;
+
+    std::vector<std::pair<PermutationType,
+                          const std::map<uint64, uint64> *>> groups;
+    groups.emplace_back(config.local_permutation, &raw_capacities);
+    for (auto &format : format_raw_capacities)
+      groups.emplace_back(format.first, &format.second);
+
+    uint64 codeword_block_size = config.encoder->GetCodewordBlockSize();
+    uint64 data_block_size = config.encoder->GetDataBlockSize();
+    uint64 carrier_capacity = 0;
+    bool every_carrier_used = true;
+    for (auto &group : groups) {
+      for (auto &raw_capacity : *group.second) {
+        uint64 block_count = (local_size(group.first, raw_capacity.first) / 8) /
+                             codeword_block_size;
+        if (block_count == 0) every_carrier_used = false;
+        carrier_capacity += raw_capacity.second * block_count * data_block_size;
+      }
+    }
+    estimate.carrier_capacity = carrier_capacity;
+    if (carrier_capacity == 0) continue;
+
+    PermutationType last_permutation = last_uses_config
+                                       ? config.local_permutation
+                                       : last_format->second.second;
+    uint64 last_blocks = (local_size(last_permutation, last_raw_capacity) / 8) /
+                         codeword_block_size;
+    uint64 last_capacity = last_blocks * data_block_size;
+
+    auto global = PermutationFactory::GetPermutation(config.global_permutation);
+    uint64 raw_capacity = global->GetSizeUsingParams(carrier_capacity, key);
+    // the global permutation has to reach into the last carrier
+    if (raw_capacity <= carrier_capacity - last_capacity)
+      every_carrier_used = false;
+
+    if (every_carrier_used && raw_capacity > SFS_STORAGE_HASH_LENGTH)
+      estimate.capacity = raw_capacity - SFS_STORAGE_HASH_LENGTH;
+  }
+
+  return estimates;
+}
+
+std::vector<CapacityConfig> CarrierFilesManager::GetAllCapacityConfigs() {
+  std::vector<CapacityConfig> configs;
+  auto permutations = PermutationFactory::GetPermutationTypes();
+
+  for (auto &encoder : EncoderFactory::GetAllEncoders()) {
+    for (auto global : permutations) {
+      for (auto local : permutations) {
+        CapacityConfig config = { encoder, global, local };
+        configs.push_back(config);
+      }
+    }
+  }
+  return configs;
+}
+
 } // stego_disk
@@ -10,13 +10,16 @@
 #ifndef STEGODISK_FILEMANAGEMENT_CARRIERFILESMANAGER_H_
 #define STEGODISK_FILEMANAGEMENT_CARRIERFILESMANAGER_H_
 
+#include <functional>
 #include <iostream>
 #include <vector>
 #include <string>
 #include <memory>
 
+#include "capacity_estimate.h"
 #include "hash/hash.h"
 #include "keys/key.h"
+#include "utils/perf_counters.h"
 #include "utils/thread_pool.h"
 
 namespace stego_disk {
@@ -28,7 +31,8 @@ class CarrierFile;
 class CarrierFilesManager {
 
 public:
-  CarrierFilesManager();
+  explicit CarrierFilesManager(
+      std::size_t min_carriers_per_task = kMinCarriersPerTask);
   ~CarrierFilesManager();
   int LoadDirectory(const std::string &directory);
   void SaveAllFiles();
@@ -38,6 +42,11 @@ public:
   std::string GetPath() const;
   uint64 GetCapacityUsingEncoder(std::shared_ptr<Encoder> encoder);
 
+  std::vector<CapacityEstimate> EstimateCapacity(
+      const std::vector<CapacityConfig> &configs);
+  // all EncoderFactory::GetAllEncoders x global x local permutation types
+  static std::vector<CapacityConfig> GetAllCapacityConfigs();
+
   void ApplyEncoder();
   void SetEncoder(std::shared_ptr<Encoder> encoder);
   void UnSetEncoder();
@@ -48,9 +57,19 @@ public:
   bool LoadVirtualStorage(std::shared_ptr<VirtualStorage> storage);
   int SaveVirtualStorage();
 
+  StegoStats GetStats() const;
+  void ResetStats();
+
+  // default smallest number of carriers processed by one task of
+  // parallel loops
+  static const std::size_t kMinCarriersPerTask = 1024;
+
 private:
   void Init();
 
+  void ForEachCarrierRange(
+      const std::function<void(std::size_t, std::size_t)> &function);
+
   void AddFileAtPath(std::string &path);
 
   void GenerateMasterKey();
@@ -69,7 +88,9 @@ private:
   std::shared_ptr<VirtualStorage> virtual_storage_;
   std::shared_ptr<Encoder> encoder_;
   std::unique_ptr<ThreadPool> thread_pool_;
+  std::size_t min_carriers_per_task_;
   bool is_active_encoder_;
+  PerfCounters counters_;
 };
 
 } // stego_disk
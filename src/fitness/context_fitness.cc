@@ -7,7 +7,16 @@
 */
 
 #include "context_fitness.h"
+
+#include <string.h>
+
+#include <algorithm>
+#include <limits>
+#include <map>
+#include <mutex>
+
 #include "carrier_files/carrier_file.h"
+#include "utils/thread_pool.h"
 
 namespace stego_disk {
 
@@ -16,100 +25,162 @@ ContextFitness::ContextFitness(std::shared_ptr<CarrierFile> file) : Fitness(file
 
 ContextFitness::~ContextFitness() {}
 
-bool ContextFitness::CheckSubboxValidity(const std::array<unsigned char, 4> &subbox) const {
-  unsigned char validity = 1;
-
-  validity <<= !(subbox[0] - subbox[1]);
-  validity <<= !(subbox[0] - subbox[2]);
-  validity <<= !(subbox[0] - subbox[3]);
-  validity <<= !(subbox[1] - subbox[2]);
-  validity <<= !(subbox[1] - subbox[3]);
-  validity <<= !(subbox[2] - subbox[3]);
-
-  if (validity > 2)
-    return false;
-
-  return true;
+// number of equal pairs among three pixels
+static inline uint8 EqualPairs(uint8 a, uint8 b, uint8 c) {
+  return static_cast<uint8>((a == b) + (a == c) + (b == c));
 }
 
+// sub-box (a, b, c, central) is valid with at most one equal pair
+static inline uint8 CheckSubbox(uint8 a, uint8 b, uint8 c,
+                                uint8 zero, uint8 one) {
+  uint8 pairs = EqualPairs(a, b, c);
+  uint8 with_zero = static_cast<uint8>(pairs + (zero == a) + (zero == b) +
+                                       (zero == c));
+  uint8 with_one = static_cast<uint8>(pairs + (one == a) + (one == b) +
+                                      (one == c));
+  return static_cast<uint8>((with_zero <= 1) & (with_one <= 1));
+}
 
-bool ContextFitness::CheckValidity(const std::array<unsigned char, 9> &box) const {
-  bool zero, one;
-  unsigned char central_pixel;
-
-  central_pixel = box[4] & 0xFE;
-  zero = (CheckSubboxValidity(std::array<unsigned char, 4>{{box[0], box[1], box[3], central_pixel}}) &&
-          CheckSubboxValidity(std::array<unsigned char, 4>{{box[1], box[2], central_pixel, box[5]}}) &&
-          CheckSubboxValidity(std::array<unsigned char, 4>{{box[3], central_pixel, box[6], box[7]}}) &&
-          CheckSubboxValidity(std::array<unsigned char, 4>{{central_pixel, box[5], box[7], box[8]}}));
-
-  central_pixel |= 0x01;
+/**
+ * @brief Selects central pixels of 3x3 blocks in given rows of blocks
+ *
+ * Pixels of kBatchSize blocks are gathered into one array per box
+ * position, so the validity of the whole batch is computed by
+ * branch-free loops over bytes, which are vectorized by the compiler.
+ *
+ * @param[in] image Pixels, 'width' per row
+ * @param[in] width Image width
+ * @param[in] first_row First row of blocks
+ * @param[in] end_row Row of blocks after the last one
+ * @param[out] indices Selected positions are appended
+ */
+void ContextFitness::SelectRows(const uint8 *image, uint32 width,
+                                uint32 first_row, uint32 end_row,
+                                std::vector<uint32> *indices) {
+  const uint32 blocks = width / 3;
+  const uint32 batch_size = kBatchSize;
+  uint8 box[9][kBatchSize];
+  uint8 valid[kBatchSize];
+
+  // lanes after the last block of a row keep old values, they are ignored
+  memset(box, 0, sizeof(box));
+
+  for (uint32 row = first_row; row < end_row; ++row) {
+    const uint64 center_row = static_cast<uint64>(row) * 3 + 1;
+    const uint8 *up = image + (center_row - 1) * width;
+    const uint8 *middle = image + center_row * width;
+    const uint8 *down = image + (center_row + 1) * width;
+
+    for (uint32 first = 0; first < blocks; first += batch_size) {
+      const uint32 count = std::min(batch_size, blocks - first);
+
+      for (uint32 l = 0; l < count; ++l) {
+        uint32 x = (first + l) * 3 + 1;
+        box[0][l] = up[x - 1];
+        box[1][l] = up[x];
+        box[2][l] = up[x + 1];
+        box[3][l] = middle[x - 1];
+        box[4][l] = middle[x];
+        box[5][l] = middle[x + 1];
+        box[6][l] = down[x - 1];
+        box[7][l] = down[x];
+        box[8][l] = down[x + 1];
+      }
 
-  one = (CheckSubboxValidity(std::array<unsigned char, 4>{{box[0], box[1], box[3], central_pixel}}) &&
-         CheckSubboxValidity(std::array<unsigned char, 4>{{box[1], box[2], central_pixel, box[5]}}) &&
-         CheckSubboxValidity(std::array<unsigned char, 4>{{box[3], central_pixel, box[6], box[7]}}) &&
-         CheckSubboxValidity(std::array<unsigned char, 4>{{central_pixel, box[5], box[7], box[8]}}));
+      for (uint32 l = 0; l < batch_size; ++l) {
+        uint8 zero = box[4][l] & 0xFE;
+        uint8 one = box[4][l] | 0x01;
+        valid[l] = CheckSubbox(box[0][l], box[1][l], box[3][l], zero, one) &
+                   CheckSubbox(box[1][l], box[2][l], box[5][l], zero, one) &
+                   CheckSubbox(box[3][l], box[6][l], box[7][l], zero, one) &
+                   CheckSubbox(box[5][l], box[7][l], box[8][l], zero, one);
+      }
 
-  return zero && one;
+      for (uint32 l = 0; l < count; ++l) {
+        if (valid[l])
+          indices->push_back(static_cast<uint32>(center_row * width +
+                                                 (first + l) * 3 + 1));
+      }
+    }
+  }
 }
 
-
 uint64 ContextFitness::SelectBytes(const MemoryBuffer &in, MemoryBuffer *out) {
   if(file_->IsGrayscale()) {
-    uint64 counter  = 0, i_max, j_max, i_ind, j_ind, index;
-
-    i_max = file_->GetHeight() / 3;
-    j_max = file_->GetWidth() / 3;
-    i_ind = 1;
-
-    for (uint64 i = 0; i < i_max; ++i) {
-      j_ind = 2;
-      for (uint64 j = 0; j < j_max; ++j) {
-
-        index = i_ind * file_->GetWidth() + j_ind - 1;
-        if (CheckValidity(std::array<unsigned char, 9>{{in[index - file_->GetWidth() - 1],
-                          in[index - file_->GetWidth()], in[index - file_->GetWidth() + 1],
-                          in[index - 1], in[index], in[index + 1],
-                          in[index + file_->GetWidth() - 1], in[index + file_->GetWidth()],
-                          in[index + file_->GetWidth() + 1]}})) {
-          ++counter;
-
-          if(selected_bits_.empty())
-            selected_bits_.push_front(index);
-          else
-            selected_bits_.insert_after(selected_bits_.end(), index);
-        }
-        j_ind += 3;
-      }
-      i_ind += 3;
+    const uint32 width = file_->GetWidth();
+    const uint32 rows = file_->GetHeight() / 3;
+    const uint64 pixels = static_cast<uint64>(width) * file_->GetHeight();
+
+    if (in.GetSize() < pixels)
+      throw std::out_of_range("ContextFitness: image is smaller than its "
+                              "dimensions");
+    if (pixels > std::numeric_limits<uint32>::max())
+      throw std::length_error("ContextFitness: image is too big");
+
+    selected_indices_.clear();
+
+    // carriers are loaded by the manager's thread pool, more threads
+    // started by its workers would only compete for the same cores;
+    // a row of contexts covers three rows of pixels
+    const uint8 *image = in.GetConstRawPointer();
+    uint64 min_rows = kMinPixelsPerThread / (3 * static_cast<uint64>(width));
+    std::map<uint64, std::vector<uint32>> parts;
+    std::mutex parts_mutex;
+
+    ThreadPool::ForEachRange(rows, min_rows,
+                             [&](uint64 begin, uint64 end) {
+      std::vector<uint32> part;
+      SelectRows(image, width, static_cast<uint32>(begin),
+                 static_cast<uint32>(end), &part);
+      std::lock_guard<std::mutex> lock(parts_mutex);
+      parts[begin].swap(part);
+    });
+
+    if (parts.size() == 1) {
+      selected_indices_.swap(parts.begin()->second);
+    } else {
+      std::size_t total = 0;
+      for (auto &part : parts) total += part.second.size();
+      selected_indices_.reserve(total);
+      for (auto &part : parts)
+        selected_indices_.insert(selected_indices_.end(), part.second.begin(),
+                                 part.second.end());
     }
-    out->Resize(counter);
 
-    for(auto & element : selected_bits_) {
-      *out = in[element];
-      ++out;
-    }
-    return counter;
+    out->Resize(selected_indices_.size());
+
+    uint8 *selected = out->GetRawPointer();
+    for (std::size_t i = 0; i < selected_indices_.size(); ++i)
+      selected[i] = image[selected_indices_[i]];
+
+    return selected_indices_.size();
 
   } else {
-    delete out;
-    out = new MemoryBuffer(in);
+    *out = in;
     return in.GetSize();
   }
 }
+
 void ContextFitness::InsertBytes(const MemoryBuffer &in, MemoryBuffer *out) const {
   if(file_->IsGrayscale()) {
-    out->Resize(in.GetSize());
-    uint64 index = 0;
-    for(auto & element : selected_bits_) {
-      (*out)[element] = in[index];
-      ++index;
-    }
+    if (in.GetSize() != selected_indices_.size())
+      throw std::length_error("ContextFitness: number of bytes differs from "
+                              "number of selected bytes");
+    if (!selected_indices_.empty() && out->GetSize() <= selected_indices_.back())
+      throw std::out_of_range("ContextFitness: output is smaller than image");
+
+    const uint8 *selected = in.GetConstRawPointer();
+    uint8 *image = out->GetRawPointer();
+    for (std::size_t i = 0; i < selected_indices_.size(); ++i)
+      image[selected_indices_[i]] = selected[i];
 
   } else {
-    delete out;
-    out = new MemoryBuffer(in);
+    *out = in;
   }
 }
 
+const std::vector<uint32>& ContextFitness::GetSelectedIndices() const {
+  return selected_indices_;
+}
+
 } // stego_disk
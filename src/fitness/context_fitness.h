@@ -9,13 +9,22 @@
 #ifndef STEGODISK_FITNESS_CONTEXTFITNESS_H_
 #define STEGODISK_FITNESS_CONTEXTFITNESS_H_
 
-#include <array>
-#include <forward_list>
+#include <vector>
 
 #include "fitness.h"
 
 namespace stego_disk {
 
+/**
+ * The ContextFitness class.
+ *
+ * Grayscale images are split into 3x3 blocks and the central pixel
+ * of a block is selected, when each of its four 2x2 sub-boxes has at
+ * most one pair of equal pixels for both values of the central LSB.
+ * Blocks are evaluated in batches of kBatchSize, rows of blocks are
+ * split between threads for large images, unless SelectBytes is called
+ * from a ThreadPool worker.
+ */
 class ContextFitness : public Fitness {
 
 public:
@@ -23,13 +32,21 @@ public:
   ~ContextFitness();
 
   uint64 SelectBytes(const MemoryBuffer &in, MemoryBuffer *out);
+  // 'out' holds the image passed to SelectBytes, selected bytes are replaced
   void InsertBytes(const MemoryBuffer &in, MemoryBuffer *out) const;
 
+  // image positions of the selected bytes, in order
+  const std::vector<uint32>& GetSelectedIndices() const;
+
+  static const uint32 kBatchSize = 32;
+  static const uint64 kMinPixelsPerThread = 1 << 20;
+
 private:
-  bool CheckSubboxValidity(const std::array<unsigned char, 4> &subbox) const;
-  bool CheckValidity(const std::array<unsigned char, 9>& box) const;
+  static void SelectRows(const uint8 *image, uint32 width,
+                         uint32 first_row, uint32 end_row,
+                         std::vector<uint32> *indices);
 
-  std::forward_list<uint64> selected_bits_;
+  std::vector<uint32> selected_indices_;
 
 };
 
@@ -0,0 +1,400 @@
+/**
+* @file fuse_lowlevel_service.cc
+* @author Martin Kosdy
+* @author Matus Kysel
+* @date 2016
+* @brief File containing low-level FUSE implementation of the virtual disc
+*
+*/
+
+#include "fuse_lowlevel_service.h"
+
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <vector>
+
+namespace Stego {
+#ifdef __APPLE__
+    const char *FuseLowlevelService::virtual_file_name_ = "virtualdisc.dmg";
+#else
+    const char *FuseLowlevelService::virtual_file_name_ = "virtualdisc.iso";
+#endif
+
+    stego_disk::StegoStorage *FuseLowlevelService::stego_storage_ = nullptr;
+    stego_disk::uint64 FuseLowlevelService::capacity_ = 0;
+    bool FuseLowlevelService::fuse_mounted_ = false;
+    struct fuse_chan *FuseLowlevelService::channel_ = nullptr;
+
+    static struct fuse_lowlevel_ops stegofs_ll_ops;
+
+    // size of the file and its attributes never change while mounted
+    static const double kAttrTimeout = 86400.0;
+
+    // requests are served by a single thread, buffers are reused
+    static std::vector<char> transfer_buffer;
+
+    static void sfs_ll_init(void *userdata, struct fuse_conn_info *conn);
+
+    static void sfs_ll_destroy(void *userdata);
+
+    static void sfs_ll_lookup(fuse_req_t req, fuse_ino_t parent, const char *name);
+
+    static void sfs_ll_getattr(fuse_req_t req, fuse_ino_t ino,
+                               struct fuse_file_info *fi);
+
+    static void sfs_ll_setattr(fuse_req_t req, fuse_ino_t ino, struct stat *attr,
+                               int to_set, struct fuse_file_info *fi);
+
+    static void sfs_ll_readdir(fuse_req_t req, fuse_ino_t ino, size_t size,
+                               off_t off, struct fuse_file_info *fi);
+
+    static void sfs_ll_open(fuse_req_t req, fuse_ino_t ino,
+                            struct fuse_file_info *fi);
+
+    static void sfs_ll_read(fuse_req_t req, fuse_ino_t ino, size_t size,
+                            off_t off, struct fuse_file_info *fi);
+
+    static void sfs_ll_write(fuse_req_t req, fuse_ino_t ino, const char *buf,
+                             size_t size, off_t off, struct fuse_file_info *fi);
+
+#if FUSE_VERSION >= 29
+    static void sfs_ll_write_buf(fuse_req_t req, fuse_ino_t ino,
+                                 struct fuse_bufvec *bufv, off_t off,
+                                 struct fuse_file_info *fi);
+#endif
+
+    static void sfs_ll_flush(fuse_req_t req, fuse_ino_t ino,
+                             struct fuse_file_info *fi);
+
+    static void sfs_ll_fsync(fuse_req_t req, fuse_ino_t ino, int datasync,
+                             struct fuse_file_info *fi);
+
+// =============================================================================
+//      MAIN
+// =============================================================================
+
+    int FuseLowlevelService::Init(stego_disk::StegoStorage *stego_storage) {
+        stego_storage_ = stego_storage;
+
+        capacity_ = stego_storage_->GetSize();
+
+        transfer_buffer.resize(kMaxTransfer);
+
+        // fuse_lowlevel_ops struct initialization
+        stegofs_ll_ops.init = sfs_ll_init;
+        stegofs_ll_ops.destroy = sfs_ll_destroy;
+        stegofs_ll_ops.lookup = sfs_ll_lookup;
+        stegofs_ll_ops.getattr = sfs_ll_getattr;
+        stegofs_ll_ops.setattr = sfs_ll_setattr;
+        stegofs_ll_ops.readdir = sfs_ll_readdir;
+        stegofs_ll_ops.open = sfs_ll_open;
+        stegofs_ll_ops.read = sfs_ll_read;
+        stegofs_ll_ops.write = sfs_ll_write;
+#if FUSE_VERSION >= 29
+        stegofs_ll_ops.write_buf = sfs_ll_write_buf;
+#endif
+        stegofs_ll_ops.flush = sfs_ll_flush;
+        stegofs_ll_ops.fsync = sfs_ll_fsync;
+
+        return 0;
+    }
+
+    int FuseLowlevelService::MountFuse(const std::string &mount_point) {
+
+        fuse_mounted_ = false;
+
+        pid_t pid;
+        if ((pid = fork()) < 0) {
+            LOG_ERROR("fork failed: " << strerror(errno));
+            return -1;
+        }
+        if (pid == 0) {
+            return 0;
+        }
+
+        LOG_INFO("parent pid: " << getpid() << " : starting fuse session");
+        LOG_INFO("mount point: " << mount_point);
+
+        // max_read limits read requests, big_writes allows writes above
+        // 4 KiB (both are further capped by the kernel)
+        std::string options = "allow_other,big_writes,max_read=" +
+                              std::to_string(kMaxTransfer);
+        char arg0[] = "fuse";
+        char arg1[] = "-o";
+        std::vector<char> arg2(options.begin(), options.end());
+        arg2.push_back('\0');
+        char *argv[] = { arg0, arg1, arg2.data(), nullptr };
+        struct fuse_args args = FUSE_ARGS_INIT(3, argv);
+
+        int err = -1;
+        channel_ = fuse_mount(mount_point.c_str(), &args);
+        if (channel_) {
+            struct fuse_session *session = fuse_lowlevel_new(&args, &stegofs_ll_ops,
+                                                             sizeof(stegofs_ll_ops),
+                                                             nullptr);
+            if (session) {
+                if (fuse_set_signal_handlers(session) != -1) {
+                    fuse_session_add_chan(session, channel_);
+                    fuse_mounted_ = true;
+                    // single-threaded loop, see class description
+                    err = fuse_session_loop(session);
+                    fuse_remove_signal_handlers(session);
+                    fuse_session_remove_chan(channel_);
+                }
+                fuse_session_destroy(session);
+            }
+            fuse_unmount(mount_point.c_str(), channel_);
+            channel_ = nullptr;
+        }
+        fuse_opt_free_args(&args);
+
+        LOG_INFO("fuse session returned " << err);
+        return 1;
+    }
+
+    void FuseLowlevelService::UnmountFuse(const std::string &mount_point) {
+        LOG_INFO("unmounting: " << mount_point);
+
+        fuse_mounted_ = false;
+
+        fuse_unmount(mount_point.c_str(), channel_);
+    }
+
+// =============================================================================
+//      FUSE CALLBACK METHODS
+// =============================================================================
+
+    static int sfs_ll_stat(fuse_ino_t ino, struct stat *stbuf) {
+        memset(stbuf, 0, sizeof(struct stat));
+        stbuf->st_ino = ino;
+
+        if (ino == FUSE_ROOT_ID) { /* The root directory of our file system. */
+            stbuf->st_mode = S_IFDIR | 0755;
+            stbuf->st_nlink = 2;
+        } else if (ino == FuseLowlevelService::kFileInode) { /* The only file we have. */
+            stbuf->st_mode = S_IFREG | 0777;
+            stbuf->st_nlink = 1;
+            stbuf->st_size = FuseLowlevelService::capacity_;
+        } else /* We reject everything else. */
+            return -1;
+
+        return 0;
+    }
+
+    // trims the request to the file size, returns false past the end of file
+    static bool sfs_ll_trim(off_t off, size_t *size) {
+        stego_disk::uint64 offset64 = off;
+
+        if (offset64 >= FuseLowlevelService::capacity_)
+            return false;
+
+        if (offset64 + *size > FuseLowlevelService::capacity_)
+            *size = static_cast<size_t>(FuseLowlevelService::capacity_ - offset64);
+
+        return true;
+    }
+
+    static void sfs_ll_init(void *, struct fuse_conn_info *conn) { // userdata, conn
+        LOG_DEBUG("SFS_LL_INIT CALLED");
+
+        conn->max_write = FuseLowlevelService::kMaxTransfer;
+        conn->max_readahead = FuseLowlevelService::kMaxTransfer;
+
+#ifdef FUSE_CAP_BIG_WRITES
+        conn->want |= conn->capable & FUSE_CAP_BIG_WRITES;
+#endif
+#ifdef FUSE_CAP_SPLICE_READ
+        // data of writes can arrive in a pipe (see sfs_ll_write_buf),
+        // replies are memory buffers, splicing them does not save a copy
+        conn->want |= conn->capable & FUSE_CAP_SPLICE_READ;
+#endif
+#ifdef FUSE_CAP_WRITEBACK_CACHE
+        if (conn->capable & FUSE_CAP_WRITEBACK_CACHE)
+            conn->want |= FUSE_CAP_WRITEBACK_CACHE;
+        else
+            LOG_WARN("fuse connection: kernel does not offer writeback cache, "
+                     "every write is sent to the storage");
+#else
+        // libfuse 2 passes only the capabilities it knows to the kernel
+        LOG_WARN("fuse connection: libfuse " << FUSE_MAJOR_VERSION << "."
+                 << FUSE_MINOR_VERSION << " can not negotiate writeback "
+                 "cache, every write is sent to the storage");
+#endif
+
+        LOG_INFO("fuse connection: capable 0x" << std::hex << conn->capable
+                 << ", want 0x" << conn->want << std::dec
+                 << ", max_write " << conn->max_write);
+    }
+
+    static void sfs_ll_destroy(void *) { // userdata
+        FuseLowlevelService::stego_storage_->Save();
+        FuseLowlevelService::fuse_mounted_ = false;
+        LOG_INFO("SFS_LL_DESTROY CALLED @pid: " << getpid());
+    }
+
+    static void sfs_ll_lookup(fuse_req_t req, fuse_ino_t parent, const char *name) {
+        if (parent != FUSE_ROOT_ID ||
+            strcmp(name, FuseLowlevelService::virtual_file_name_) != 0) {
+            fuse_reply_err(req, ENOENT);
+            return;
+        }
+
+        struct fuse_entry_param entry;
+        memset(&entry, 0, sizeof(entry));
+        entry.ino = FuseLowlevelService::kFileInode;
+        entry.attr_timeout = kAttrTimeout;
+        entry.entry_timeout = kAttrTimeout;
+        sfs_ll_stat(entry.ino, &entry.attr);
+
+        fuse_reply_entry(req, &entry);
+    }
+
+    static void sfs_ll_getattr(fuse_req_t req, fuse_ino_t ino,
+                               struct fuse_file_info *) { // fi
+        struct stat stbuf;
+
+        if (sfs_ll_stat(ino, &stbuf) == -1)
+            fuse_reply_err(req, ENOENT);
+        else
+            fuse_reply_attr(req, &stbuf, kAttrTimeout);
+    }
+
+    // size is fixed, other attributes are ignored (as chmod/truncate
+    // of FuseService); kernel with writeback cache sends times here
+    static void sfs_ll_setattr(fuse_req_t req, fuse_ino_t ino, struct stat *,
+                               int, struct fuse_file_info *fi) { // attr, to_set
+        sfs_ll_getattr(req, ino, fi);
+    }
+
+    static void sfs_ll_readdir(fuse_req_t req, fuse_ino_t ino, size_t size,
+                               off_t off, struct fuse_file_info *) { // fi
+        if (ino != FUSE_ROOT_ID) { /* We only recognize the root directory. */
+            fuse_reply_err(req, ENOTDIR);
+            return;
+        }
+
+        if (!FuseLowlevelService::fuse_mounted_) {
+            FuseLowlevelService::fuse_mounted_ = true;
+        }
+
+        const char *names[] = { ".", "..", FuseLowlevelService::virtual_file_name_ };
+        const fuse_ino_t inodes[] = { FUSE_ROOT_ID, FUSE_ROOT_ID,
+                                      FuseLowlevelService::kFileInode };
+
+        std::vector<char> entries;
+        for (size_t i = 0; i < 3; ++i) {
+            struct stat stbuf;
+            memset(&stbuf, 0, sizeof(stbuf));
+            stbuf.st_ino = inodes[i];
+            size_t entry_size = fuse_add_direntry(req, nullptr, 0, names[i],
+                                                  nullptr, 0);
+            size_t position = entries.size();
+            entries.resize(position + entry_size);
+            fuse_add_direntry(req, &entries[position], entry_size, names[i],
+                              &stbuf, position + entry_size);
+        }
+
+        if (static_cast<size_t>(off) < entries.size())
+            fuse_reply_buf(req, &entries[off],
+                           std::min(entries.size() - off, size));
+        else
+            fuse_reply_buf(req, nullptr, 0);
+    }
+
+    static void sfs_ll_open(fuse_req_t req, fuse_ino_t ino,
+                            struct fuse_file_info *fi) {
+        if (ino == FUSE_ROOT_ID) {
+            fuse_reply_err(req, EISDIR);
+            return;
+        }
+        if (ino != FuseLowlevelService::kFileInode) {
+            fuse_reply_err(req, ENOENT);
+            return;
+        }
+
+        // file is changed only through this mount, page cache stays valid
+        fi->keep_cache = 1;
+        fuse_reply_open(req, fi);
+    }
+
+    static void sfs_ll_read(fuse_req_t req, fuse_ino_t ino, size_t size,
+                            off_t off, struct fuse_file_info *) { // fi
+        if (ino != FuseLowlevelService::kFileInode) {
+            fuse_reply_err(req, ENOENT);
+            return;
+        }
+
+        if (!sfs_ll_trim(off, &size)) { /* Trying to read past the end of file. */
+            fuse_reply_buf(req, nullptr, 0);
+            return;
+        }
+
+        // bytes are spread over the storage by the global permutation,
+        // they are gathered once into the reused buffer; the kernel copies
+        // the reply once more (splice would not avoid it for a memory
+        // buffer, libfuse writes such buffers to the device anyway)
+        if (transfer_buffer.size() < size)
+            transfer_buffer.resize(size);
+        FuseLowlevelService::stego_storage_->Read(transfer_buffer.data(), off, size);
+
+        fuse_reply_buf(req, transfer_buffer.data(), size);
+    }
+
+    static void sfs_ll_write(fuse_req_t req, fuse_ino_t ino, const char *buf,
+                             size_t size, off_t off, struct fuse_file_info *) { // fi
+        if (ino != FuseLowlevelService::kFileInode) {
+            fuse_reply_err(req, ENOENT);
+            return;
+        }
+
+        if (!sfs_ll_trim(off, &size)) { /* Trying to write past the end of file. */
+            fuse_reply_err(req, EFBIG);
+            return;
+        }
+
+        FuseLowlevelService::stego_storage_->Write(buf, off, size);
+        fuse_reply_write(req, size);
+    }
+
+#if FUSE_VERSION >= 29
+    // data of spliced writes are in a pipe, otherwise in memory
+    static void sfs_ll_write_buf(fuse_req_t req, fuse_ino_t ino,
+                                 struct fuse_bufvec *bufv, off_t off,
+                                 struct fuse_file_info *fi) {
+        if (bufv->count == 1 && !(bufv->buf[0].flags & FUSE_BUF_IS_FD)) {
+            sfs_ll_write(req, ino, static_cast<const char *>(bufv->buf[0].mem),
+                         bufv->buf[0].size, off, fi);
+            return;
+        }
+
+        size_t size = fuse_buf_size(bufv);
+        if (transfer_buffer.size() < size)
+            transfer_buffer.resize(size);
+
+        struct fuse_bufvec dst = FUSE_BUFVEC_INIT(size);
+        dst.buf[0].mem = transfer_buffer.data();
+
+        ssize_t copied = fuse_buf_copy(&dst, bufv, FUSE_BUF_SPLICE_NONBLOCK);
+        if (copied < 0) {
+            fuse_reply_err(req, static_cast<int>(-copied));
+            return;
+        }
+
+        sfs_ll_write(req, ino, transfer_buffer.data(),
+                     static_cast<size_t>(copied), off, fi);
+    }
+#endif
+
+    static void sfs_ll_flush(fuse_req_t req, fuse_ino_t,
+                             struct fuse_file_info *) { // ino, fi
+        fuse_reply_err(req, 0);
+    }
+
+    static void sfs_ll_fsync(fuse_req_t req, fuse_ino_t, int,
+                             struct fuse_file_info *) { // ino, datasync, fi
+        fuse_reply_err(req, 0);
+    }
+}
@@ -0,0 +1,62 @@
+/**
+* @file fuse_lowlevel_service.h
+* @author Martin Kosdy
+* @author Matus Kysel
+* @date 2016
+* @brief File FUSE support for this library using low-level FUSE API
+*
+*/
+
+#ifndef STEGODISK_FUSE_FUSELOWLEVELSERVICE_H_
+#define STEGODISK_FUSE_FUSELOWLEVELSERVICE_H_
+
+#define FUSE_USE_VERSION 26
+#define _FILE_OFFSET_BITS 64
+
+#ifdef __APPLE__
+#include <osxfuse/fuse_lowlevel.h>
+#else
+#include <fuse_lowlevel.h>
+#endif
+
+#include <string>
+
+#include "logging/logger.h"
+#include "stego_storage.h"
+
+namespace Stego {
+
+    /**
+     * The FuseLowlevelService class.
+     *
+     * Exposes the storage as a single file (same as FuseService), but
+     * requests are dispatched by inode numbers instead of path strings,
+     * transfers are up to kMaxTransfer bytes and writes can be spliced
+     * from the kernel. Writes are cached by the kernel (writeback cache)
+     * only when both libfuse and the kernel support it, a warning is
+     * logged otherwise. Requests are processed on a single thread,
+     * StegoStorage is not thread safe.
+     */
+    class FuseLowlevelService {
+
+    public:
+        static const fuse_ino_t kFileInode = 2;
+        static const size_t kMaxTransfer = 1 << 20;
+
+        static stego_disk::StegoStorage *stego_storage_;
+        static stego_disk::uint64 capacity_;
+        static bool fuse_mounted_;
+        static const char *virtual_file_name_;
+
+        static int Init(stego_disk::StegoStorage *stego_storage);
+
+        static int MountFuse(const std::string &mount_point);
+
+        static void UnmountFuse(const std::string &mount_point);
+
+    private:
+        static struct fuse_chan *channel_;
+    };
+}
+
+#endif // STEGODISK_FUSE_FUSELOWLEVELSERVICE_H_
@@ -9,88 +9,200 @@
 
 #include "hash.h"
 
+#include <atomic>
+#include <mutex>
 #include <stdexcept>
+#include <vector>
 
 #include "keccak_hash_impl.h"
 #include "utils/stego_types.h"
 
 namespace stego_disk {
 
-std::unique_ptr<HashImpl> Hash::default_hash_impl_ = std::unique_ptr<HashImpl>(new KeccakHashImpl());
+std::shared_ptr<HashImpl> Hash::default_hash_impl_ = std::make_shared<KeccakHashImpl>();
+std::shared_ptr<HashImpl> Hash::storage_hash_impl_ = std::make_shared<KeccakHashImpl>();
+
+// hashing statistics of one thread, written only by the owning thread,
+// so workers hashing in parallel don't contend for shared counters
+struct HashCounters {
+  HashCounters() : calls(0), bytes(0), closed(false) {}
+
+  std::atomic<uint64> calls;
+  std::atomic<uint64> bytes;
+  std::atomic<bool> closed;     // owning thread has exited
+};
+
+struct HashCountersState {
+  HashCountersState() : retired_calls(0), retired_bytes(0),
+                        reset_calls(0), reset_bytes(0) {}
+
+  // guards all members
+  std::mutex mutex;
+  std::vector<std::shared_ptr<HashCounters>> threads;
+  uint64 retired_calls;         // totals of exited threads
+  uint64 retired_bytes;
+  uint64 reset_calls;           // totals at the last ResetCounters
+  uint64 reset_bytes;
+};
+
+// never destroyed, threads may hash while static objects are destroyed
+static HashCountersState& CountersState() {
+  static HashCountersState *state = new HashCountersState();
+  return *state;
+}
+
+struct HashCountersOwner {
+  ~HashCountersOwner() {
+    if (counters) counters->closed.store(true, std::memory_order_release);
+  }
+  std::shared_ptr<HashCounters> counters;
+};
+
+static thread_local HashCountersOwner hash_counters_owner;
+
+static HashCounters* ThreadCounters() {
+  if (!hash_counters_owner.counters) {
+    hash_counters_owner.counters = std::make_shared<HashCounters>();
+    HashCountersState &state = CountersState();
+    std::lock_guard<std::mutex> lock(state.mutex);
+    state.threads.push_back(hash_counters_owner.counters);
+  }
+  return hash_counters_owner.counters.get();
+}
+
+// sums counters of all threads, counters of exited threads are merged
+// into retired totals; state.mutex has to be locked
+static void SumCounters(HashCountersState &state, uint64 &calls,
+                        uint64 &bytes) {
+  calls = state.retired_calls;
+  bytes = state.retired_bytes;
+  for (auto it = state.threads.begin(); it != state.threads.end();) {
+    HashCounters &counters = **it;
+    bool closed = counters.closed.load(std::memory_order_acquire);
+    uint64 thread_calls = counters.calls.load(std::memory_order_relaxed);
+    uint64 thread_bytes = counters.bytes.load(std::memory_order_relaxed);
+    calls += thread_calls;
+    bytes += thread_bytes;
+
+    if (closed) {
+      state.retired_calls += thread_calls;
+      state.retired_bytes += thread_bytes;
+      it = state.threads.erase(it);
+    } else {
+      ++it;
+    }
+  }
+}
 
 
 void Hash::Init() {
-  if (default_hash_impl_ == nullptr)
-    throw std::runtime_error("Hash: default hash implementation not set");
+  if (impl_ == nullptr)
+    throw std::runtime_error("Hash: hash implementation not set");
 
-  state_.Resize(default_hash_impl_->GetStateSize());
+  state_.Resize(impl_->GetStateSize());
   state_.Clear();
+  impl_->Init(context_);
 }
 
-Hash::Hash() {
+Hash::Hash() : impl_(GetHashImpl(Purpose::KEYS)) {
   Init();
 }
 
+Hash::Hash(Purpose purpose) : impl_(GetHashImpl(purpose)) {
+  Init();
+}
 
-Hash::Hash(const std::string& data) {
+Hash::Hash(const std::string& data) : impl_(GetHashImpl(Purpose::KEYS)) {
   Init();
   Process(data);
 }
 
-Hash::Hash(const uint8* data, std::size_t length) {
+Hash::Hash(const uint8* data, std::size_t length) : impl_(GetHashImpl(Purpose::KEYS)) {
   Init();
   Process(data, length);
 }
 
 void Hash::Process(const std::string& data) {
-  if (default_hash_impl_ == nullptr)
-    throw std::runtime_error("Hash: default hash implementation not set");
+  if (impl_ == nullptr)
+    throw std::runtime_error("Hash: hash implementation not set");
 
-  default_hash_impl_->Process(state_,
-                              (uint8*)data.c_str(),
-                              data.length());
+  Count(1, data.length());
+  impl_->Process(state_,
+                 (uint8*)data.c_str(),
+                 data.length());
 }
 
 void Hash::Process(const MemoryBuffer& data) {
-  if (default_hash_impl_ == nullptr)
-    throw std::runtime_error("Hash: default hash implementation not set");
+  if (impl_ == nullptr)
+    throw std::runtime_error("Hash: hash implementation not set");
 
   if (data.GetSize() == 0)
     throw std::invalid_argument("Hash: input data cannot be empty");
 
-  default_hash_impl_->Process(state_,
-                              data.GetConstRawPointer(),
-                              data.GetSize());
+  Count(1, data.GetSize());
+  impl_->Process(state_,
+                 data.GetConstRawPointer(),
+                 data.GetSize());
 }
 
 void Hash::Process(const uint8* data, std::size_t length) {
-  if (default_hash_impl_ == nullptr)
-    throw std::runtime_error("Hash: default hash implementation not set");
+  if (impl_ == nullptr)
+    throw std::runtime_error("Hash: hash implementation not set");
 
-  default_hash_impl_->Process(state_, data, length);
+  Count(1, length);
+  impl_->Process(state_, data, length);
 }
 
 void Hash::Append(const std::string& data) {
-  if (default_hash_impl_ == nullptr)
-    throw std::runtime_error("Hash: default hash implementation not set");
+  if (impl_ == nullptr)
+    throw std::runtime_error("Hash: hash implementation not set");
 
-  default_hash_impl_->Append(state_,
-                             (uint8*)data.c_str(),
-                             data.length());
+  Count(1, data.length());
+  impl_->Append(state_,
+                (uint8*)data.c_str(),
+                data.length());
 }
 
 void Hash::Append(const uint8* data, std::size_t length) {
-  if (default_hash_impl_ == nullptr)
-    throw std::runtime_error("Hash: default hash implementation not set");
+  if (impl_ == nullptr)
+    throw std::runtime_error("Hash: hash implementation not set");
 
-  default_hash_impl_->Append(state_, data, length);
+  Count(1, length);
+  impl_->Append(state_, data, length);
 }
 
 void Hash::Append(const MemoryBuffer& data) {
-  if (default_hash_impl_ == nullptr)
-    throw std::runtime_error("Hash: default hash implementation not set");
+  if (impl_ == nullptr)
+    throw std::runtime_error("Hash: hash implementation not set");
+
+  Count(1, data.GetSize());
+  impl_->Append(state_, data.GetConstRawPointer(), data.GetSize());
+}
+
+void Hash::Update(const std::string& data) {
+  Update((uint8*)data.c_str(), data.length());
+}
+
+void Hash::Update(const MemoryBuffer& data) {
+  Update(data.GetConstRawPointer(), data.GetSize());
+}
+
+void Hash::Update(const uint8* data, uint64 length) {
+  if (impl_ == nullptr)
+    throw std::runtime_error("Hash: hash implementation not set");
 
-  default_hash_impl_->Append(state_, data.GetConstRawPointer(), data.GetSize());
+  Count(1, length);
+  impl_->Update(context_, data, length);
+}
+
+void Hash::Final() {
+  if (impl_ == nullptr)
+    throw std::runtime_error("Hash: hash implementation not set");
+
+  if (state_.GetSize() != impl_->GetStateSize())
+    state_.Resize(impl_->GetStateSize());
+
+  impl_->Final(context_, state_.GetRawPointer());
 }
 
 const MemoryBuffer& Hash::GetState() const {
@@ -101,4 +213,84 @@ std::size_t Hash::GetStateSize() const {
   return state_.GetSize();
 }
 
+void Hash::SetDefaultHashImpl(std::unique_ptr<HashImpl> new_hash_impl) {
+  SetHashImpl(Purpose::KEYS, std::move(new_hash_impl));
+}
+
+void Hash::SetHashImpl(Purpose purpose, std::shared_ptr<HashImpl> hash_impl) {
+  if (hash_impl == nullptr)
+    throw std::invalid_argument("Hash: hash implementation cannot be null");
+
+  if (purpose == Purpose::STORAGE)
+    std::atomic_store(&storage_hash_impl_, hash_impl);
+  else
+    std::atomic_store(&default_hash_impl_, hash_impl);
+}
+
+std::shared_ptr<HashImpl> Hash::GetHashImpl(Purpose purpose) {
+  if (purpose == Purpose::STORAGE)
+    return std::atomic_load(&storage_hash_impl_);
+  return std::atomic_load(&default_hash_impl_);
+}
+
+std::size_t Hash::GetDefaultStateSize() {
+  std::shared_ptr<HashImpl> impl = GetHashImpl(Purpose::KEYS);
+  if (impl == nullptr)
+    throw std::runtime_error("Hash: default hash implementation not set");
+
+  return impl->GetStateSize();
+}
+
+/**
+ * @brief Hashes several independent messages of the same length
+ *
+ * Same as calling Process for each message separately, but the hash
+ * implementation may compute several hashes at once (see HashImpl).
+ *
+ * @param[in] data Pointers to 'count' messages of 'length' bytes
+ * @param[in] length Length of each message
+ * @param[out] digests Pointers to 'count' buffers of GetDefaultStateSize() bytes
+ * @param[in] count Number of messages
+ */
+void Hash::ProcessMany(const uint8* const* data, std::size_t length,
+                       uint8* const* digests, std::size_t count) {
+  std::shared_ptr<HashImpl> impl = GetHashImpl(Purpose::KEYS);
+  if (impl == nullptr)
+    throw std::runtime_error("Hash: default hash implementation not set");
+
+  Count(count, static_cast<uint64>(length) * count);
+  impl->ProcessMany(data, length, digests, count);
+}
+
+uint64 Hash::GetCallCount() {
+  HashCountersState &state = CountersState();
+  std::lock_guard<std::mutex> lock(state.mutex);
+  uint64 calls, bytes;
+  SumCounters(state, calls, bytes);
+  return calls - state.reset_calls;
+}
+
+uint64 Hash::GetByteCount() {
+  HashCountersState &state = CountersState();
+  std::lock_guard<std::mutex> lock(state.mutex);
+  uint64 calls, bytes;
+  SumCounters(state, calls, bytes);
+  return bytes - state.reset_bytes;
+}
+
+void Hash::ResetCounters() {
+  HashCountersState &state = CountersState();
+  std::lock_guard<std::mutex> lock(state.mutex);
+  SumCounters(state, state.reset_calls, state.reset_bytes);
+}
+
+void Hash::Count(uint64 calls, uint64 length) {
+  // only the owning thread writes, plain load and store are enough
+  HashCounters *counters = ThreadCounters();
+  counters->calls.store(counters->calls.load(std::memory_order_relaxed) + calls,
+                        std::memory_order_relaxed);
+  counters->bytes.store(counters->bytes.load(std::memory_order_relaxed) + length,
+                        std::memory_order_relaxed);
+}
+
 } // stego_disk
@@ -20,7 +20,14 @@ namespace stego_disk {
 
 class Hash final {
 public:
+  // each purpose has its own hash implementation, see SetHashImpl
+  enum class Purpose {
+    KEYS,     // passwords, keys and permutation tables
+    STORAGE   // integrity checksum of the virtual storage
+  };
+
   Hash();
+  explicit Hash(Purpose purpose);
   Hash(const std::string& data);
   Hash(const uint8* data, std::size_t length);
 
@@ -34,18 +41,40 @@ public:
   const MemoryBuffer& GetState() const;
   std::size_t GetStateSize() const;
 
-private:
+  // streaming interface: after Final, state is the hash of all data
+  // passed to Update since Init; copy the instance to clone the computation
   void Init();
-  MemoryBuffer state_;
+  void Update(const std::string& data);
+  void Update(const MemoryBuffer& data);
+  void Update(const uint8* data, uint64 length);
+  void Final();
 
-  //TODO: implementation could be stored as shared ptr in each hash instance
-  //  std::shared_ptr<HashImpl> hashImpl;
+private:
+  MemoryBuffer state_;
+  HashContext context_;
+  std::shared_ptr<HashImpl> impl_;
 
   // static stuff
 public:
   static void SetDefaultHashImpl(std::unique_ptr<HashImpl> new_hash_impl);
+  // instances created afterwards use the new implementation, the swap is
+  // atomic so instances may be created on other threads meanwhile
+  static void SetHashImpl(Purpose purpose, std::shared_ptr<HashImpl> hash_impl);
+  static std::shared_ptr<HashImpl> GetHashImpl(Purpose purpose);
+  static std::size_t GetDefaultStateSize();
+  static void ProcessMany(const uint8* const* data, std::size_t length,
+                          uint8* const* digests, std::size_t count);
+
+  // totals of hashing calls and hashed bytes of the process, for statistics
+  static uint64 GetCallCount();
+  static uint64 GetByteCount();
+  static void ResetCounters();
 private:
-  static std::unique_ptr<HashImpl> default_hash_impl_;
+  // adds to counters of the calling thread, see hash.cc
+  static void Count(uint64 calls, uint64 length);
+
+  static std::shared_ptr<HashImpl> default_hash_impl_;
+  static std::shared_ptr<HashImpl> storage_hash_impl_;
 
 };
 
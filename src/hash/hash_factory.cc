@@ -0,0 +1,63 @@
+/**
+* @file hash_factory.cc
+* @author Martin Kosdy
+* @author Matus Kysel
+* @date 2016
+* @brief Hash factory
+*
+*/
+
+#include "hash_factory.h"
+
+#include <algorithm>
+
+#include "keccak_hash_impl.h"
+#include "kangaroo_twelve_hash_impl.h"
+
+namespace stego_disk {
+
+/**
+ * @brief Get instance of the hash implementation by type
+ *
+ * @param[in] hash Type of hash to be created
+ * @param[in] state_size Size of the digest in bytes
+ * @return On success instance of hash implementation, nullptr otherwise
+ */
+std::shared_ptr<HashImpl> HashFactory::GetHashImpl(const HashType hash,
+                                                   std::size_t state_size) {
+  switch(hash) {
+    case HashType::KECCAK:
+      return std::make_shared<KeccakHashImpl>(state_size);
+    case HashType::KANGAROO_TWELVE:
+      return std::make_shared<KangarooTwelveHashImpl>(state_size);
+    default:
+      return nullptr;
+  }
+}
+
+HashFactory::HashType HashFactory::GetDefaultHashType() {
+  return kDefaultHash;
+}
+
+HashFactory::HashType HashFactory::GetHashType(const std::string &hash) {
+  std::string l_hash(hash.size(), '\0');
+  std::transform(hash.begin(), hash.end(), l_hash.begin(), ::tolower);
+
+  if (l_hash == "keccak") {
+    return HashType::KECCAK;
+  } else if (l_hash == "k12" || l_hash == "kangarootwelve") {
+    return HashType::KANGAROO_TWELVE;
+  } else {
+    return GetDefaultHashType();
+  }
+}
+
+const std::string HashFactory::GetHashName(const HashType hash) {
+  if (hash == HashType::KANGAROO_TWELVE) {
+    return "k12";
+  } else {
+    return "keccak";
+  }
+}
+
+} // stego_disk
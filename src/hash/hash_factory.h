@@ -0,0 +1,48 @@
+/**
+* @file hash_factory.h
+* @author Martin Kosdy
+* @author Matus Kysel
+* @date 2016
+* @brief Hash factory
+*
+*/
+
+#ifndef STEGODISK_HASH_HASHFACTORY_H_
+#define STEGODISK_HASH_HASHFACTORY_H_
+
+#include <memory>
+#include <string>
+
+#include "hash_impl.h"
+
+namespace stego_disk {
+
+class HashFactory final
+{
+private:
+  HashFactory();
+
+public:
+
+  enum class HashType {
+    KECCAK,
+    KANGAROO_TWELVE
+  };
+
+  // Get instance of hash implementation based on its type
+  static std::shared_ptr<HashImpl> GetHashImpl(const HashType hash,
+                                               std::size_t state_size);
+
+  static HashType GetDefaultHashType();
+
+  static HashType GetHashType(const std::string &hash);
+
+  static const std::string GetHashName(const HashType hash);
+
+private:
+  static const HashType kDefaultHash = HashType::KECCAK;
+};
+
+} // stego_disk
+
+#endif // STEGODISK_HASH_HASHFACTORY_H_
@@ -17,16 +17,32 @@ void HashImpl::Append(MemoryBuffer& state,
     throw std::length_error("HashImpl: input state size doesnt "
                             "match with current state size");
 
-  MemoryBuffer hashed_input(state_size_);
-  this->Process(hashed_input, data, length);
+  if (data == nullptr)
+    throw std::invalid_argument("data pointer cannot be null");
 
-  MemoryBuffer buffer(state_size_ * 2);
-  // 1st half - hash(input)
-  buffer.Write(0, hashed_input.GetRawPointer(), hashed_input.GetSize());
-  // 2nd half - oldState
-  buffer.Write(state_size_, state.GetRawPointer(), state_size_);
+  HashContext context;
+  uint8 hashed_input[kMaxStateSize];
 
-  this->Process(state, buffer.GetRawPointer(), buffer.GetSize());
+  Init(context);
+  Update(context, data, length);
+  Final(context, hashed_input);
+
+  // hash(input) | oldState
+  Init(context);
+  Update(context, hashed_input, state_size_);
+  Update(context, state.GetConstRawPointer(), state_size_);
+  Final(context, state.GetRawPointer());
+}
+
+void HashImpl::ProcessMany(const uint8* const* data, std::size_t length,
+                           uint8* const* digests, std::size_t count) {
+  HashContext context;
+
+  for (std::size_t i = 0; i < count; ++i) {
+    Init(context);
+    Update(context, data[i], length);
+    Final(context, digests[i]);
+  }
 }
 
 } // stego_disk
@@ -18,6 +18,11 @@
 
 namespace stego_disk {
 
+// State of streaming hash computation; plain data, copy it to clone the computation
+struct HashContext {
+  uint64 data[64];
+};
+
 class HashImpl {
 
 public:
@@ -29,8 +34,21 @@ public:
   virtual void Append(MemoryBuffer& state,
                       const uint8* data, std::size_t length);
 
+  // streaming interface: Final writes GetStateSize() bytes of digest
+  virtual void Init(HashContext& context) = 0;
+  virtual void Update(HashContext& context,
+                      const uint8* data, uint64 length) = 0;
+  virtual void Final(HashContext& context, uint8* digest) = 0;
+
+  // multi-buffer interface: hashes 'count' independent messages of the same
+  // length, digests[i] receives GetStateSize() bytes
+  virtual void ProcessMany(const uint8* const* data, std::size_t length,
+                           uint8* const* digests, std::size_t count);
+
   std::size_t GetStateSize() { return state_size_; }
 
+  static const std::size_t kMaxStateSize = 64;
+
 protected:
   size_t state_size_;
 
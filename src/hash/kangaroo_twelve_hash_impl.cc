@@ -0,0 +1,225 @@
+/**
+* @file kangaroo_twelve_hash_impl.cc
+* @author Martin Kosdy
+* @author Matus Kysel
+* @date 2016
+* @brief Implementation of tree hash function KangarooTwelve
+*
+*/
+
+#include "kangaroo_twelve_hash_impl.h"
+
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "utils/keccak/keccak.h"
+#include "utils/thread_pool.h"
+
+namespace stego_disk {
+
+// domain separation bytes of TurboSHAKE128 calls
+static const uint8 kSingleNodeDomain = 0x07;
+static const uint8 kFinalNodeDomain = 0x06;
+static const uint8 kLeafDomain = 0x0B;
+
+// appended to the first chunk when the message has more chunks
+static const uint8 kFirstChunkSuffix[8] = { 0x03, 0, 0, 0, 0, 0, 0, 0 };
+
+// customization string is empty, its encoded length is appended to message
+static const uint8 kEmptyCustomization[1] = { 0x00 };
+
+struct KangarooTwelveContext {
+  keccak_ctx_t final_node;  // first chunk, then chaining values of the others
+  keccak_ctx_t leaf;        // current chunk if it is not the first one
+  uint64 chunk;             // index of the current chunk
+  uint64 chunk_position;    // bytes of the current chunk absorbed so far
+};
+
+static_assert(sizeof(KangarooTwelveContext) <= sizeof(HashContext),
+              "HashContext is too small for KangarooTwelveContext");
+
+KangarooTwelveHashImpl::KangarooTwelveHashImpl(std::size_t state_size) {
+    if (state_size == 0 || state_size > kMaxStateSize)
+        throw std::invalid_argument("KangarooTwelveHashImpl: state size "
+                                    "should be in <1," +
+                                    std::to_string(kMaxStateSize) + ">");
+    state_size_ = state_size;
+}
+
+KangarooTwelveHashImpl::~KangarooTwelveHashImpl() {}
+
+void KangarooTwelveHashImpl::Process(MemoryBuffer& state,
+                                     const uint8* data, std::size_t length) {
+    if (state_size_ != state.GetSize())
+        throw std::length_error("KangarooTwelveHashImpl: input state size "
+                                "doesnt match with current state size");
+
+    if (data == nullptr)
+        throw std::invalid_argument("data pointer cannot be null");
+
+    HashContext context;
+    Init(context);
+    Update(context, data, length);
+    Final(context, state.GetRawPointer());
+}
+
+void KangarooTwelveHashImpl::Init(HashContext& context) {
+    KangarooTwelveContext* ctx =
+        reinterpret_cast<KangarooTwelveContext*>(&context);
+
+    turboshake128_init(&ctx->final_node);
+    turboshake128_init(&ctx->leaf);
+    ctx->chunk = 0;
+    ctx->chunk_position = 0;
+}
+
+/**
+ * @brief Absorbs next part of the message
+ *
+ * Chunk is closed only when data of the next chunk arrives, because
+ * the last chunk is processed differently (see Final). Whole chunks,
+ * which are certainly not the last one, are hashed in parallel.
+ *
+ * @param[in,out] context Computation state
+ * @param[in] data Next part of the message
+ * @param[in] length Length of data
+ */
+void KangarooTwelveHashImpl::Update(HashContext& context,
+                                    const uint8* data, uint64 length) {
+    if (data == nullptr && length)
+        throw std::invalid_argument("data pointer cannot be null");
+
+    KangarooTwelveContext* ctx =
+        reinterpret_cast<KangarooTwelveContext*>(&context);
+    const uint64 chunk_size = kChunkSize;
+    const uint64 max_batch = kMaxChunksPerBatch;
+
+    while (length > 0) {
+        if (ctx->chunk_position == chunk_size) {
+            if (ctx->chunk == 0) {
+                keccak_update(&ctx->final_node, kFirstChunkSuffix,
+                              sizeof(kFirstChunkSuffix));
+            } else {
+                uint8 chaining_value[kChainingValueSize];
+                turboshake128_final(&ctx->leaf, kLeafDomain, chaining_value,
+                                    kChainingValueSize);
+                keccak_update(&ctx->final_node, chaining_value,
+                              kChainingValueSize);
+            }
+            turboshake128_init(&ctx->leaf);
+            ctx->chunk++;
+            ctx->chunk_position = 0;
+        }
+
+        if (ctx->chunk > 0 && ctx->chunk_position == 0 &&
+            length > chunk_size) {
+            uint64 count = std::min((length - 1) / chunk_size, max_batch);
+            std::vector<uint8> chaining_values(count * kChainingValueSize);
+
+            HashChunks(data, count, chaining_values.data());
+            keccak_update(&ctx->final_node, chaining_values.data(),
+                          chaining_values.size());
+
+            ctx->chunk += count;
+            data += count * chunk_size;
+            length -= count * chunk_size;
+            continue;
+        }
+
+        uint64 part = std::min(length, chunk_size - ctx->chunk_position);
+        keccak_update(ctx->chunk == 0 ? &ctx->final_node : &ctx->leaf,
+                      data, static_cast<size_t>(part));
+        ctx->chunk_position += part;
+        data += part;
+        length -= part;
+    }
+}
+
+void KangarooTwelveHashImpl::Final(HashContext& context, uint8* digest) {
+    KangarooTwelveContext* ctx =
+        reinterpret_cast<KangarooTwelveContext*>(&context);
+
+    Update(context, kEmptyCustomization, sizeof(kEmptyCustomization));
+
+    if (ctx->chunk == 0) {
+        turboshake128_final(&ctx->final_node, kSingleNodeDomain,
+                            digest, state_size_);
+        return;
+    }
+
+    uint8 chaining_value[kChainingValueSize];
+    turboshake128_final(&ctx->leaf, kLeafDomain, chaining_value,
+                        kChainingValueSize);
+    keccak_update(&ctx->final_node, chaining_value, kChainingValueSize);
+
+    // number of chaining values: big endian without leading zeros,
+    // followed by the number of its bytes, and 0xFF 0xFF
+    uint8 suffix[sizeof(uint64) + 3];
+    std::size_t suffix_length = 0;
+    for (uint64 n = ctx->chunk; n > 0; n >>= 8)
+        suffix_length++;
+    for (std::size_t i = 0; i < suffix_length; ++i)
+        suffix[i] = static_cast<uint8>(ctx->chunk >> (8 * (suffix_length - 1 - i)));
+    suffix[suffix_length] = static_cast<uint8>(suffix_length);
+    suffix[suffix_length + 1] = 0xFF;
+    suffix[suffix_length + 2] = 0xFF;
+    keccak_update(&ctx->final_node, suffix, suffix_length + 3);
+
+    turboshake128_final(&ctx->final_node, kFinalNodeDomain,
+                        digest, state_size_);
+}
+
+/**
+ * @brief Computes chaining values of whole chunks
+ *
+ * Chunks are split into contiguous ranges hashed in parallel,
+ * when more cores are available and the caller is not a ThreadPool
+ * worker (the pool keeps the cores busy already).
+ *
+ * @param[in] data 'count' chunks of kChunkSize bytes
+ * @param[in] count Number of chunks
+ * @param[out] chaining_values 'count' x kChainingValueSize bytes
+ */
+void KangarooTwelveHashImpl::HashChunks(const uint8* data, uint64 count,
+                                        uint8* chaining_values) {
+    ThreadPool::ForEachRange(count, kMinChunksPerThread,
+                             [=](uint64 begin, uint64 end) {
+        HashChunksRange(data + begin * kChunkSize, end - begin,
+                        chaining_values + begin * kChainingValueSize);
+    });
+}
+
+/**
+ * @brief Computes chaining values of whole chunks on the calling thread
+ *
+ * @param[in] data 'count' chunks of kChunkSize bytes
+ * @param[in] count Number of chunks
+ * @param[out] chaining_values 'count' x kChainingValueSize bytes
+ */
+void KangarooTwelveHashImpl::HashChunksRange(const uint8* data, uint64 count,
+                                             uint8* chaining_values) {
+    uint64 i = 0;
+
+    for ( ; i + 4 <= count; i += 4) {
+        const uint8* in[4];
+        uint8* out[4];
+        for (uint64 k = 0; k < 4; ++k) {
+            in[k] = data + (i + k) * kChunkSize;
+            out[k] = chaining_values + (i + k) * kChainingValueSize;
+        }
+        turboshake128_x4(in, kChunkSize, kLeafDomain, out, kChainingValueSize);
+    }
+
+    for ( ; i < count; ++i) {
+        keccak_ctx_t leaf;
+        turboshake128_init(&leaf);
+        keccak_update(&leaf, data + i * kChunkSize, kChunkSize);
+        turboshake128_final(&leaf, kLeafDomain,
+                            chaining_values + i * kChainingValueSize,
+                            kChainingValueSize);
+    }
+}
+
+} // stego_disk
@@ -0,0 +1,60 @@
+/**
+* @file kangaroo_twelve_hash_impl.h
+* @author Martin Kosdy
+* @author Matus Kysel
+* @date 2016
+* @brief Implementation of tree hash function KangarooTwelve
+*
+*/
+
+#ifndef STEGODISK_HASH_KANGAROOTWELVEHASHIMPL_H_
+#define STEGODISK_HASH_KANGAROOTWELVEHASHIMPL_H_
+
+#include <memory>
+
+#include "hash_impl.h"
+#include "utils/stego_header.h"
+#include "utils/memory_buffer.h"
+
+namespace stego_disk {
+
+/**
+ * The KangarooTwelveHashImpl class.
+ *
+ * KangarooTwelve (KT128, RFC 9861) with empty customization string.
+ * Message is split into 8 KiB chunks, all chunks except the first one
+ * are hashed independently by TurboSHAKE128 (12-round Keccak) and only
+ * their 32-byte chaining values are absorbed into the final node.
+ * Chunks of long inputs are therefore hashed in parallel, 4 at once
+ * on each thread (see turboshake128_x4).
+ */
+class KangarooTwelveHashImpl : public HashImpl {
+
+public:
+    KangarooTwelveHashImpl(std::size_t state_size = 32);
+    virtual ~KangarooTwelveHashImpl();
+
+    virtual void Process(MemoryBuffer& state, const uint8* data, std::size_t length);
+
+    virtual void Init(HashContext& context);
+    virtual void Update(HashContext& context, const uint8* data, uint64 length);
+    virtual void Final(HashContext& context, uint8* digest);
+
+    static const uint64 kChunkSize = 8192;
+    static const std::size_t kChainingValueSize = 32;
+
+private:
+    static void HashChunks(const uint8* data, uint64 count, uint8* chaining_values);
+    static void HashChunksRange(const uint8* data, uint64 count,
+                                uint8* chaining_values);
+
+    // minimal number of chunks hashed by one thread
+    static const uint64 kMinChunksPerThread = 64;
+    // maximal number of chunks hashed in parallel before absorbing their
+    // chaining values, bounds the size of the temporary buffer
+    static const uint64 kMaxChunksPerBatch = 4096;
+};
+
+} // stego_disk
+
+#endif // STEGODISK_HASH_KANGAROOTWELVEHASHIMPL_H_
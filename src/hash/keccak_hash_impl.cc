@@ -10,13 +10,20 @@
 #include "keccak_hash_impl.h"
 
 #include <stdexcept>
+#include <string>
 
 #include "utils/keccak/keccak.h"
 
 namespace stego_disk {
 
+static_assert(sizeof(keccak_ctx_t) <= sizeof(HashContext),
+              "HashContext is too small for keccak_ctx_t");
+
 KeccakHashImpl::KeccakHashImpl(std::size_t state_size) {
-    //TODO: check if stateSize is valid
+    if (state_size == 0 || state_size > kMaxStateSize)
+        throw std::invalid_argument("KeccakHashImpl: state size should be "
+                                    "in <1," + std::to_string(kMaxStateSize) +
+                                    ">");
     state_size_ = state_size;
 }
 
@@ -31,10 +38,43 @@ void KeccakHashImpl::Process(MemoryBuffer& state,
     if (data == nullptr)
         throw std::invalid_argument("data pointer cannot be null");
 
-    //TOOD: rewrite implementation (int data types)
-    //TODO: create new optimized version (sth like FastKeccakImpl / NISTKeccakImpl)
-    keccak(data, static_cast<int>(length),
-           state.GetRawPointer(), static_cast<int>(state_size_));
+    HashContext context;
+    Init(context);
+    Update(context, data, length);
+    Final(context, state.GetRawPointer());
+}
+
+void KeccakHashImpl::Init(HashContext& context) {
+    keccak_init(reinterpret_cast<keccak_ctx_t*>(&context),
+                static_cast<int>(state_size_));
+}
+
+void KeccakHashImpl::Update(HashContext& context,
+                            const uint8* data, uint64 length) {
+    if (data == nullptr && length)
+        throw std::invalid_argument("data pointer cannot be null");
+
+    keccak_update(reinterpret_cast<keccak_ctx_t*>(&context), data,
+                  static_cast<size_t>(length));
+}
+
+void KeccakHashImpl::Final(HashContext& context, uint8* digest) {
+    keccak_final(reinterpret_cast<keccak_ctx_t*>(&context), digest);
+}
+
+void KeccakHashImpl::ProcessMany(const uint8* const* data, std::size_t length,
+                                 uint8* const* digests, std::size_t count) {
+    std::size_t i = 0;
+
+    // groups of 4 messages are hashed at once by interleaved implementation
+    if (keccak_x4_native()) {
+        for ( ; i + 4 <= count; i += 4) {
+            keccak_x4(&data[i], length, &digests[i],
+                      static_cast<int>(state_size_));
+        }
+    }
+
+    HashImpl::ProcessMany(&data[i], length, &digests[i], count - i);
 }
 
 } // stego_disk
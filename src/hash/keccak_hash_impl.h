@@ -25,6 +25,13 @@ public:
     virtual ~KeccakHashImpl();
 
     virtual void Process(MemoryBuffer& state, const uint8* data, std::size_t length);
+
+    virtual void Init(HashContext& context);
+    virtual void Update(HashContext& context, const uint8* data, uint64 length);
+    virtual void Final(HashContext& context, uint8* digest);
+
+    virtual void ProcessMany(const uint8* const* data, std::size_t length,
+                             uint8* const* digests, std::size_t count);
 };
 
 } // stego_disk
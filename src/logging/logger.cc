@@ -9,41 +9,264 @@
 
 #include "logger.h"
 
+#ifndef _WIN32
+#include <pthread.h>
+#endif
 #include <ctype.h>
-#include <iostream>
+#include <stdint.h>
+#include <stdlib.h>
+
 #include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
 #include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
 
 
 LoggerVerbosityLevel Logger::verbosity_level_ = kLoggerVerbosityDisabled;
 std::ostream *Logger::ofs_ = &std::cout;
 
+// messages queued by one thread; must be a power of two
+static const std::size_t kLogRingSize = 1024;
+// how long the writer sleeps when there is nothing to write
+static const int kLogWriterPeriodMs = 20;
+
+struct LogEntry {
+  uint64_t sequence;
+  std::string text;
+};
+
+// single producer (owning thread), single consumer (writer thread)
+struct LogRing {
+  LogRing() : head(0), tail(0), closed(false), entries(kLogRingSize) {}
+
+  std::atomic<uint64_t> head;   // next entry written by the owning thread
+  std::atomic<uint64_t> tail;   // next entry read by the writer thread
+  std::atomic<bool> closed;     // owning thread has exited
+  std::vector<LogEntry> entries;
+};
+
+struct LoggerState {
+  LoggerState() : writer(nullptr), running(false), exited(false), stop(false),
+                  next_sequence(0), written(0) {}
+
+  // guards rings, the output stream and the writer thread
+  std::mutex mutex;
+  std::vector<std::shared_ptr<LogRing>> rings;
+  std::thread *writer;
+  std::atomic<bool> running;
+  std::atomic<bool> exited;     // writer stopped at exit, write synchronously
+  bool stop;
+  std::condition_variable wake;
+  std::condition_variable written_cv;
+  std::atomic<uint64_t> next_sequence;
+  uint64_t written;
+};
+
+// never destroyed, threads may log while static objects are destroyed
+static LoggerState& State() {
+  static LoggerState *state = new LoggerState();
+  return *state;
+}
+
+struct LogRingOwner {
+  ~LogRingOwner() {
+    if (ring) ring->closed.store(true, std::memory_order_release);
+  }
+  std::shared_ptr<LogRing> ring;
+};
+
+static thread_local LogRingOwner log_ring_owner;
+
+static LogRing* ThreadRing() {
+  if (!log_ring_owner.ring) {
+    log_ring_owner.ring = std::make_shared<LogRing>();
+    LoggerState &state = State();
+    std::lock_guard<std::mutex> lock(state.mutex);
+    state.rings.push_back(log_ring_owner.ring);
+  }
+  return log_ring_owner.ring.get();
+}
+
+static void WriterLoop() {
+  LoggerState &state = State();
+  std::vector<LogEntry> batch;
+  std::unique_lock<std::mutex> lock(state.mutex);
+
+  while (true) {
+    batch.clear();
+    for (auto it = state.rings.begin(); it != state.rings.end();) {
+      LogRing &ring = **it;
+      bool closed = ring.closed.load(std::memory_order_acquire);
+      uint64_t tail = ring.tail.load(std::memory_order_relaxed);
+      uint64_t head = ring.head.load(std::memory_order_acquire);
+      for (; tail != head; ++tail)
+        batch.push_back(std::move(ring.entries[tail & (kLogRingSize - 1)]));
+      ring.tail.store(tail, std::memory_order_release);
+
+      if (closed) it = state.rings.erase(it);
+      else ++it;
+    }
+
+    std::sort(batch.begin(), batch.end(),
+              [](const LogEntry &a, const LogEntry &b) {
+      return a.sequence < b.sequence;
+    });
+    for (auto &entry : batch)
+      *Logger::ofs_ << entry.text << '\n';
+    if (!batch.empty()) Logger::ofs_->flush();
+
+    state.written += batch.size();
+    state.written_cv.notify_all();
+
+    if (batch.empty()) {
+      if (state.stop) break;
+      state.wake.wait_for(lock, std::chrono::milliseconds(kLogWriterPeriodMs));
+    }
+  }
+}
+
+static void StopWriter() {
+  LoggerState &state = State();
+  std::thread *writer;
+  {
+    std::lock_guard<std::mutex> lock(state.mutex);
+    if (!state.writer) return;
+    state.stop = true;
+    writer = state.writer;
+    state.writer = nullptr;
+  }
+  state.wake.notify_one();
+  writer->join();
+  delete writer;
+
+  std::lock_guard<std::mutex> lock(state.mutex);
+  state.exited.store(true);
+  state.running.store(false);
+  state.written_cv.notify_all();
+}
+
+#ifndef _WIN32
+// fork copies only the calling thread: queued messages are written by the
+// parent before forking, the child starts its own writer when it logs
+static void BeforeFork() {
+  Logger::Flush();
+  State().mutex.lock();
+}
+
+static void AfterForkParent() {
+  State().mutex.unlock();
+}
+
+static void AfterForkChild() {
+  LoggerState &state = State();
+  state.writer = nullptr;  // the thread does not exist in the child
+  state.running.store(false);
+  state.mutex.unlock();
+}
+#endif
+
+static void StartWriter() {
+  LoggerState &state = State();
+  std::lock_guard<std::mutex> lock(state.mutex);
+  if (state.running.load() || state.exited.load()) return;
+
+  static bool handlers_registered = false;
+  if (!handlers_registered) {
+    atexit(StopWriter);
+#ifndef _WIN32
+    pthread_atfork(BeforeFork, AfterForkParent, AfterForkChild);
+#endif
+    handlers_registered = true;
+  }
+
+  state.stop = false;
+  state.writer = new std::thread(WriterLoop);
+  state.running.store(true);
+}
+
 bool Logger::ShouldPrint(LoggerVerbosityLevel verbosity_level) {
   if (verbosity_level_ == kLoggerVerbosityDisabled) return false;
   if (verbosity_level <= verbosity_level_) return true;
   return false;
 }
 
+void Logger::Write(LoggerVerbosityLevel verbosity_level, std::string message) {
+  LoggerState &state = State();
+  if (!state.running.load(std::memory_order_acquire)) StartWriter();
+
+  if (state.exited.load(std::memory_order_acquire)) {
+    std::lock_guard<std::mutex> lock(state.mutex);
+    *ofs_ << message << std::endl;
+    return;
+  }
+
+  LogRing *ring = ThreadRing();
+  uint64_t head = ring->head.load(std::memory_order_relaxed);
+
+  // ring is full, wait until the writer makes room
+  while (head - ring->tail.load(std::memory_order_acquire) >= kLogRingSize) {
+    state.wake.notify_one();
+    std::this_thread::yield();
+  }
+
+  LogEntry &entry = ring->entries[head & (kLogRingSize - 1)];
+  entry.sequence = state.next_sequence.fetch_add(1, std::memory_order_relaxed);
+  entry.text = std::move(message);
+  ring->head.store(head + 1, std::memory_order_release);
+
+  if (verbosity_level <= kLoggerVerbosityError) Flush();
+}
+
+void Logger::Flush() {
+  LoggerState &state = State();
+  if (!state.running.load()) return;
+
+  std::unique_lock<std::mutex> lock(state.mutex);
+  uint64_t target = state.next_sequence.load();
+  state.wake.notify_one();
+  state.written_cv.wait(lock, [&state, target]() {
+    return state.written >= target || !state.running.load();
+  });
+}
+
 void Logger::LoggerClose() {
+  Flush();
   if ( ofs_ != &std::cout ) {
     ((std::ofstream*)ofs_)->close();
   }
 }
 
-void Logger::SetVerbosityLevel(LoggerVerbosityLevel verbosity_level, std::string out) {
-  verbosity_level_ = verbosity_level;
-  if ( out.length() != 0 ) {
+void Logger::SetOutput(const std::string &out) {
+  if ( out.length() == 0 ) return;
 
-    if (out == "stdout" || out == "cout") ofs_ = &std::cout;
-    else ofs_ = new std::ofstream( out, std::ios::out );
+  Flush();
+  std::lock_guard<std::mutex> lock(State().mutex);
 
-    if ( ((std::ofstream*)ofs_)->is_open() ) {
+  if (out == "stdout" || out == "cout") {
+    ofs_ = &std::cout;
+  } else {
+    std::ofstream *file = new std::ofstream( out, std::ios::out );
+    if ( file->is_open() ) {
+      ofs_ = file;
       *ofs_ << "Log started" << std::endl;
-    } else
+    } else {
+      delete file;
       ofs_ = &std::cout;
+    }
   }
 }
 
+void Logger::SetVerbosityLevel(LoggerVerbosityLevel verbosity_level, std::string out) {
+  verbosity_level_ = verbosity_level;
+  SetOutput(out);
+}
+
 void Logger::SetVerbosityLevel(std::string &verbosity_level, std::string out) {
   std::transform(verbosity_level.begin(), verbosity_level.end(),
                  verbosity_level.begin(), ::toupper);
@@ -64,15 +287,5 @@ void Logger::SetVerbosityLevel(std::string &verbosity_level, std::string out) {
     Logger::SetVerbosityLevel(kLoggerVerbosityDisabled);
   }
 
-  if ( out.length() != 0 ) {
-
-    if (out == "stdout" || out == "cout") ofs_ = &std::cout;
-    else ofs_ = new std::ofstream( out, std::ios::out );
-
-    if ( ((std::ofstream*)ofs_)->is_open() ) {
-      *ofs_ << "Log started" << std::endl;
-    } else {
-      ofs_ = &std::cout;
-    }
-  }
+  SetOutput(out);
 }
@@ -11,6 +11,8 @@
 #define STEGODISK_LOGGING_LOGGER_H_
 
 #include <iostream>
+#include <sstream>
+#include <string>
 
 typedef enum LoggerVerbosityLevel {
   kLoggerVerbosityDisabled = 0,
@@ -22,6 +24,25 @@ typedef enum LoggerVerbosityLevel {
   kLoggerVerbosityTrace = 6
 } LoggerVerbosityLevel;
 
+// Most verbose level compiled in; messages above it (including evaluation
+// of their expressions) are removed by the compiler. Release builds keep
+// INFO and more severe messages, see LOG_LEVEL in CMakeLists.txt.
+#ifndef STEGODISK_LOG_LEVEL
+#ifdef NDEBUG
+#define STEGODISK_LOG_LEVEL kLoggerVerbosityInfo
+#else
+#define STEGODISK_LOG_LEVEL kLoggerVerbosityTrace
+#endif
+#endif
+
+/**
+ * The Logger class.
+ *
+ * Messages are formatted by the calling thread and queued in its own
+ * lock-free ring buffer; a background thread writes them to the output
+ * stream in order of logging. ERROR and FATAL messages are written before
+ * the logging call returns.
+ */
 class Logger {
 public:
   static void SetVerbosityLevel(LoggerVerbosityLevel verbosity_level,
@@ -30,22 +51,34 @@ public:
   static bool ShouldPrint(LoggerVerbosityLevel verbosity_level);
   static void LoggerClose();
 
+  static void Write(LoggerVerbosityLevel verbosity_level, std::string message);
+  // blocks until all messages logged so far are written
+  static void Flush();
+
 public:
   static LoggerVerbosityLevel verbosity_level_;
   static std::ostream *ofs_;
+
+private:
+  static void SetOutput(const std::string &out);
 };
 
-#define LOG_TRACE(expression) if (Logger::ShouldPrint(kLoggerVerbosityTrace)) \
-{ *Logger::ofs_ << "TRACE: " << expression << std::endl; }
-#define LOG_DEBUG(expression) if (Logger::ShouldPrint(kLoggerVerbosityDebug)) \
-{ *Logger::ofs_ << "DEBUG: " << expression << std::endl; }
-#define LOG_INFO(expression) if (Logger::ShouldPrint(kLoggerVerbosityInfo)) \
-{ *Logger::ofs_ << "INFO: " << expression << std::endl; }
-#define LOG_WARN(expression) if (Logger::ShouldPrint(kLoggerVerbosityWarning)) \
-{ *Logger::ofs_ << "WARN: " << expression << std::endl; }
-#define LOG_ERROR(expression) if (Logger::ShouldPrint(kLoggerVerbosityError)) \
-{ *Logger::ofs_ << "ERROR: " << expression << std::endl; }
-#define LOG_FATAL(expression) if (Logger::ShouldPrint(kLoggerVerbosityFatal)) \
-{ *Logger::ofs_ << "FATAL: " << expression << std::endl; }
+#define LOG_MESSAGE(level, prefix, expression) \
+if ((level) <= STEGODISK_LOG_LEVEL && Logger::ShouldPrint(level)) \
+{ std::ostringstream log_stream; log_stream << prefix << expression; \
+  Logger::Write(level, log_stream.str()); }
+
+#define LOG_TRACE(expression) \
+LOG_MESSAGE(kLoggerVerbosityTrace, "TRACE: ", expression)
+#define LOG_DEBUG(expression) \
+LOG_MESSAGE(kLoggerVerbosityDebug, "DEBUG: ", expression)
+#define LOG_INFO(expression) \
+LOG_MESSAGE(kLoggerVerbosityInfo, "INFO: ", expression)
+#define LOG_WARN(expression) \
+LOG_MESSAGE(kLoggerVerbosityWarning, "WARN: ", expression)
+#define LOG_ERROR(expression) \
+LOG_MESSAGE(kLoggerVerbosityError, "ERROR: ", expression)
+#define LOG_FATAL(expression) \
+LOG_MESSAGE(kLoggerVerbosityFatal, "FATAL: ", expression)
 
 #endif // STEGODISK_LOGGING_LOGGER_H_
@@ -25,6 +25,7 @@ static void PrintHelp(char *name) {
               << "\t-f,--fuse <DIRECTORY>\tSpecify the directory for FUSE, if is blank default is used\n"
               << "\t-i,--img <DIRECTORY>\tSpecify the directory for images, if is blank default is used\n"
               << "\t-p,--password <PASSWORD>\tSpecify if the password should be used, if is blank default is used\n"
+              << "\t-l,--lowlevel\t\tUse low-level FUSE interface (big transfers, splice, writeback cache)\n"
               << std::endl;
 }
 
@@ -35,6 +36,7 @@ int main(int argc, char *argv[]) {
     std::string dir = DST_DIRECTORY;
     std::string images = SRC_DIRECTORY;
     std::string password = PASSWORD;
+    bool lowlevel = false;
 
     for (int i = 1; i < argc; ++i) {
         std::string arg = argv[i];
@@ -62,6 +64,8 @@ int main(int argc, char *argv[]) {
                 LOG_ERROR("--password option requires one argument.");
                 return -1;
             }
+        } else if ((arg == "-l") || (arg == "--lowlevel")) {
+            lowlevel = true;
         } else {
             LOG_ERROR("Unknown argument: " << argv[i]);
         }
@@ -76,6 +80,18 @@ int main(int argc, char *argv[]) {
     size_t size = stego_storage->GetSize();
     LOG_INFO("Storage size = " << size << "B");
 
+    if (lowlevel) {
+        if (Stego::FuseLowlevelService::Init(stego_storage.get()) != 0) {
+            return false;
+        }
+
+        if (Stego::FuseLowlevelService::MountFuse(dir) != 0) {
+            return false;
+        }
+
+        return 0;
+    }
+
     if (Stego::FuseService::Init(stego_storage.get()) != 0) {
         return false;
     }
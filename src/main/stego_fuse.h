@@ -7,6 +7,7 @@
 
 #include "stego_storage.h"
 #include "fuse/fuse_service.h"
+#include "fuse/fuse_lowlevel_service.h"
 #include "logging/logger.h"
 
 #include "config.h"
@@ -0,0 +1,146 @@
+//
+// Created by m4jky
+//
+
+#include <signal.h>
+
+#include <iostream>
+#include <memory>
+#include <string>
+
+#include "stego_storage.h"
+#include "nbd/nbd_server.h"
+#include "logging/logger.h"
+#include "utils/tracer.h"
+
+#include "config.h"
+
+#define SOCKET_PATH "/tmp/stego_nbd.sock"
+
+static stego_disk::NbdServer *nbd_server = nullptr;
+
+static void StopServer(int) {
+    if (nbd_server) nbd_server->Stop();
+}
+
+bool LoggerInit() {
+
+    std::string logging_level("INFO");
+
+    char *env_logging_level = NULL;
+    if ((env_logging_level = getenv("LOGGING_LEVEL"))) {
+        logging_level.assign(env_logging_level);
+    }
+
+    Logger::SetVerbosityLevel(logging_level, std::string("/tmp/stego_nbd_log.txt"));
+
+    return true;
+}
+
+// timeline of Open, Load, Save and carrier operations is written to
+// TRACE_FILE (Chrome trace event JSON), if the variable is set
+static std::string TracerInit() {
+    std::string trace_file;
+
+    char *env_trace_file = NULL;
+    if ((env_trace_file = getenv("TRACE_FILE"))) {
+        trace_file.assign(env_trace_file);
+        stego_disk::Tracer::Start();
+    }
+
+    return trace_file;
+}
+
+static void PrintHelp(char *name) {
+    std::cerr << "Usage: " << name << " <option(s)> \n"
+              << "Options:\n"
+              << "\t-h,--help\t\tShow this help message\n"
+              << "\t-s,--socket <PATH>\tSpecify the UNIX socket for NBD, if is blank " SOCKET_PATH " is used\n"
+              << "\t-i,--img <DIRECTORY>\tSpecify the directory for images, if is blank default is used\n"
+              << "\t-p,--password <PASSWORD>\tSpecify if the password should be used, if is blank default is used\n"
+              << "\t-t,--threads <COUNT>\tNumber of worker threads\n"
+              << "\n"
+              << "Environment: LOGGING_LEVEL, TRACE_FILE (Chrome trace JSON written on exit)\n"
+              << "Attach with: nbd-client -unix <PATH> /dev/nbd0\n"
+              << std::endl;
+}
+
+int main(int argc, char *argv[]) {
+
+    if (!LoggerInit()) return -1;
+    std::string trace_file = TracerInit();
+
+    std::string socket_path = SOCKET_PATH;
+    std::string images = SRC_DIRECTORY;
+    std::string password = PASSWORD;
+    unsigned int threads = stego_disk::NbdServer::kDefaultThreads;
+
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if ((arg == "-h") || (arg == "--help")) {
+            PrintHelp(argv[0]);
+            return 0;
+        } else if ((arg == "-s") || (arg == "--socket")) {
+            if (++i < argc) {
+                socket_path = argv[i];
+            } else {
+                LOG_ERROR("--socket option requires one argument.");
+                return -1;
+            }
+        } else if ((arg == "-i") || (arg == "--img")) {
+            if (++i < argc) {
+                images = argv[i];
+            } else {
+                LOG_ERROR("--img option requires one argument.");
+                return -1;
+            }
+        } else if ((arg == "-p") || (arg == "--password")) {
+            if (++i < argc) {
+                password = argv[i];
+            } else {
+                LOG_ERROR("--password option requires one argument.");
+                return -1;
+            }
+        } else if ((arg == "-t") || (arg == "--threads")) {
+            if (++i < argc) {
+                threads = static_cast<unsigned int>(std::stoul(argv[i]));
+            } else {
+                LOG_ERROR("--threads option requires one argument.");
+                return -1;
+            }
+        } else {
+            LOG_ERROR("Unknown argument: " << argv[i]);
+        }
+    }
+
+    std::unique_ptr<stego_disk::StegoStorage> stego_storage(new stego_disk::StegoStorage());
+    stego_storage->Configure();
+    LOG_INFO("Opening storage");
+    stego_storage->Open(images, password);
+    LOG_INFO("Loading storage");
+    stego_storage->Load();
+    LOG_INFO("Storage size = " << stego_storage->GetSize() << "B");
+
+    {
+        stego_disk::NbdServer server(stego_storage.get(), threads);
+        nbd_server = &server;
+
+        signal(SIGPIPE, SIG_IGN);
+        signal(SIGINT, StopServer);
+        signal(SIGTERM, StopServer);
+
+        server.Serve(socket_path);
+        nbd_server = nullptr;
+    }
+
+    LOG_INFO("Saving storage");
+    stego_storage->Save();
+
+    if (!trace_file.empty()) {
+        stego_disk::Tracer::Stop();
+        if (!stego_disk::Tracer::WriteJson(trace_file))
+            LOG_ERROR("Unable to write trace to " << trace_file);
+    }
+
+    return 0;
+}
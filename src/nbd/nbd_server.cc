@@ -0,0 +1,569 @@
+/**
+* @file nbd_server.cc
+* @author Martin Kosdy
+* @author Matus Kysel
+* @date 2016
+* @brief Network block device (NBD) export of the storage - implementation
+*
+*/
+
+#include "nbd_server.h"
+
+#include <errno.h>
+#include <poll.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <stdexcept>
+
+#include "logging/logger.h"
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+namespace stego_disk {
+
+// handshake
+static const uint64 kNbdMagic = 0x4e42444d41474943ULL;        // "NBDMAGIC"
+static const uint64 kNbdOptionMagic = 0x49484156454F5054ULL;  // "IHAVEOPT"
+static const uint64 kNbdReplyMagic = 0x3e889045565a9ULL;
+static const uint16 kNbdFlagFixedNewstyle = 1 << 0;
+static const uint16 kNbdFlagNoZeroes = 1 << 1;
+static const uint32 kNbdFlagClientNoZeroes = 1 << 1;
+
+static const uint32 kNbdOptExportName = 1;
+static const uint32 kNbdOptAbort = 2;
+static const uint32 kNbdOptList = 3;
+static const uint32 kNbdOptInfo = 6;
+static const uint32 kNbdOptGo = 7;
+
+static const uint32 kNbdRepAck = 1;
+static const uint32 kNbdRepServer = 2;
+static const uint32 kNbdRepInfo = 3;
+static const uint32 kNbdRepErrUnsup = (1U << 31) + 1;
+static const uint32 kNbdRepErrInvalid = (1U << 31) + 3;
+
+static const uint16 kNbdInfoExport = 0;
+static const uint16 kNbdInfoBlockSize = 3;
+
+// transmission
+static const uint16 kNbdFlagHasFlags = 1 << 0;
+static const uint16 kNbdFlagSendFlush = 1 << 2;
+static const uint16 kNbdFlagSendFua = 1 << 3;
+static const uint16 kNbdFlagSendWriteZeroes = 1 << 6;
+static const uint16 kNbdFlagCanMultiConn = 1 << 8;
+static const uint16 kTransmissionFlags = kNbdFlagHasFlags | kNbdFlagSendFlush |
+                                         kNbdFlagSendFua |
+                                         kNbdFlagSendWriteZeroes |
+                                         kNbdFlagCanMultiConn;
+
+static const uint32 kNbdRequestMagic = 0x25609513;
+static const uint32 kNbdSimpleReplyMagic = 0x67446698;
+static const uint16 kNbdCmdFlagFua = 1 << 0;
+
+static const uint16 kNbdCmdRead = 0;
+static const uint16 kNbdCmdWrite = 1;
+static const uint16 kNbdCmdDisc = 2;
+static const uint16 kNbdCmdFlush = 3;
+static const uint16 kNbdCmdWriteZeroes = 6;
+
+static const uint32 kNbdPreferredBlockSize = 4096;
+
+// poll timeout of the listening socket, bounds reaction time to Stop
+static const int kAcceptTimeoutMs = 200;
+
+/**
+ * @brief Removes a socket left at the path, other files are kept
+ *
+ * @return False if the path exists and is not a socket
+ */
+static bool RemoveSocketFile(const std::string& path) {
+  struct stat status;
+  if (lstat(path.c_str(), &status) < 0) return errno == ENOENT;
+  if (!S_ISSOCK(status.st_mode)) return false;
+
+  unlink(path.c_str());
+  return true;
+}
+
+static void PutUint16(uint8* buffer, uint16 value) {
+  buffer[0] = static_cast<uint8>(value >> 8);
+  buffer[1] = static_cast<uint8>(value);
+}
+
+static void PutUint32(uint8* buffer, uint32 value) {
+  for (int i = 0; i < 4; ++i)
+    buffer[i] = static_cast<uint8>(value >> (24 - 8 * i));
+}
+
+static void PutUint64(uint8* buffer, uint64 value) {
+  for (int i = 0; i < 8; ++i)
+    buffer[i] = static_cast<uint8>(value >> (56 - 8 * i));
+}
+
+static uint16 GetUint16(const uint8* buffer) {
+  return static_cast<uint16>((buffer[0] << 8) | buffer[1]);
+}
+
+static uint32 GetUint32(const uint8* buffer) {
+  uint32 value = 0;
+  for (int i = 0; i < 4; ++i)
+    value = (value << 8) | buffer[i];
+  return value;
+}
+
+static uint64 GetUint64(const uint8* buffer) {
+  uint64 value = 0;
+  for (int i = 0; i < 8; ++i)
+    value = (value << 8) | buffer[i];
+  return value;
+}
+
+static bool ReceiveAll(int fd, void* buffer, std::size_t length) {
+  uint8* position = static_cast<uint8*>(buffer);
+  while (length > 0) {
+    ssize_t received = recv(fd, position, length, 0);
+    if (received < 0 && errno == EINTR) continue;
+    if (received <= 0) return false;
+    position += received;
+    length -= static_cast<std::size_t>(received);
+  }
+  return true;
+}
+
+static bool SendAll(int fd, const void* buffer, std::size_t length) {
+  const uint8* position = static_cast<const uint8*>(buffer);
+  while (length > 0) {
+    ssize_t sent = send(fd, position, length, MSG_NOSIGNAL);
+    if (sent < 0 && errno == EINTR) continue;
+    if (sent <= 0) return false;
+    position += sent;
+    length -= static_cast<std::size_t>(sent);
+  }
+  return true;
+}
+
+/**
+ * One client connection. Replies can be sent by several workers,
+ * each reply (header and data) is sent under 'send_mutex'.
+ */
+class NbdServer::Connection {
+public:
+  explicit Connection(int fd) : fd(fd), in_flight(0), alive(true) {}
+  ~Connection() { close(fd); }
+
+  bool SendOptionReply(uint32 option, uint32 type,
+                       const uint8* data, uint32 length) {
+    uint8 header[20];
+    PutUint64(header, kNbdReplyMagic);
+    PutUint32(header + 8, option);
+    PutUint32(header + 12, type);
+    PutUint32(header + 16, length);
+    return SendAll(fd, header, sizeof(header)) &&
+           (length == 0 || SendAll(fd, data, length));
+  }
+
+  void SendReply(uint64 handle, uint32 error, const uint8* data,
+                 std::size_t length) {
+    uint8 header[16];
+    PutUint32(header, kNbdSimpleReplyMagic);
+    PutUint32(header + 4, error);
+    PutUint64(header + 8, handle);
+
+    std::lock_guard<std::mutex> lock(send_mutex);
+    if (!alive) return;
+    if (!SendAll(fd, header, sizeof(header)) ||
+        (length && !SendAll(fd, data, length))) {
+      alive = false;
+      shutdown(fd, SHUT_RDWR);
+    }
+  }
+
+  const int fd;
+  std::mutex send_mutex;
+
+  // requests submitted to workers and not replied yet
+  int in_flight;
+  std::mutex in_flight_mutex;
+  std::condition_variable in_flight_cv;
+
+  bool alive;
+};
+
+NbdServer::NbdServer(StegoStorage* storage, unsigned int threads)
+  : storage_(storage),
+    size_(0),
+    stop_(false),
+    listen_fd_(-1) {
+  if (!storage_)
+    throw std::invalid_argument("NbdServer: 'storage' is nullptr");
+
+  size_ = storage_->GetSize();
+
+  if (threads == 0) threads = 1;
+  for (unsigned int i = 0; i < threads; ++i)
+    workers_.emplace_back(&NbdServer::WorkerLoop, this);
+}
+
+NbdServer::~NbdServer() {
+  Stop();
+
+  {
+    std::lock_guard<std::mutex> lock(tasks_mutex_);
+    tasks_.push(std::function<void()>());  // empty task ends the workers
+  }
+  tasks_cv_.notify_all();
+  for (auto& worker : workers_)
+    worker.join();
+}
+
+void NbdServer::Stop() {
+  stop_ = true;
+}
+
+/**
+ * @brief Listens on the UNIX socket and serves clients until Stop
+ *
+ * Socket file is (re)created and removed at the end, a file at the
+ * path which is not a socket is never removed. Threads of closed
+ * connections are joined while serving. Connections which are open
+ * when Stop is called are shut down and their unfinished requests
+ * completed before returning.
+ *
+ * @param[in] socket_path Path of the UNIX socket
+ */
+void NbdServer::Serve(const std::string& socket_path) {
+  struct sockaddr_un address;
+  memset(&address, 0, sizeof(address));
+  address.sun_family = AF_UNIX;
+  if (socket_path.size() >= sizeof(address.sun_path))
+    throw std::invalid_argument("NbdServer: socket path is too long");
+  strncpy(address.sun_path, socket_path.c_str(), sizeof(address.sun_path) - 1);
+
+  int listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (listen_fd < 0)
+    throw std::runtime_error("NbdServer: socket failed: " +
+                             std::string(strerror(errno)));
+
+  if (!RemoveSocketFile(socket_path)) {
+    close(listen_fd);
+    throw std::runtime_error("NbdServer: '" + socket_path +
+                             "' exists and is not a socket");
+  }
+  if (bind(listen_fd, reinterpret_cast<struct sockaddr*>(&address),
+           sizeof(address)) < 0 || listen(listen_fd, SOMAXCONN) < 0) {
+    std::string error = strerror(errno);
+    close(listen_fd);
+    throw std::runtime_error("NbdServer: cannot listen on '" + socket_path +
+                             "': " + error);
+  }
+  listen_fd_ = listen_fd;
+
+  LOG_INFO("NbdServer: serving " << size_ << "B on " << socket_path);
+
+  while (!stop_) {
+    ReapConnections();
+
+    struct pollfd poll_fd = { listen_fd, POLLIN, 0 };
+    int ready = poll(&poll_fd, 1, kAcceptTimeoutMs);
+    if (ready <= 0) continue;
+
+    int fd = accept(listen_fd, nullptr, nullptr);
+    if (fd < 0) continue;
+
+    LOG_DEBUG("NbdServer: client connected, fd " << fd);
+    auto connection = std::make_shared<Connection>(fd);
+    std::lock_guard<std::mutex> lock(connections_mutex_);
+    connection_fds_.insert(fd);
+    connection_threads_.emplace_back(&NbdServer::HandleConnection, this,
+                                     connection);
+  }
+
+  listen_fd_ = -1;
+  close(listen_fd);
+  RemoveSocketFile(socket_path);
+
+  {
+    std::lock_guard<std::mutex> lock(connections_mutex_);
+    for (int fd : connection_fds_)
+      shutdown(fd, SHUT_RDWR);
+  }
+  for (auto& thread : connection_threads_)
+    thread.join();
+  connection_threads_.clear();
+  finished_threads_.clear();
+
+  LOG_INFO("NbdServer: stopped");
+}
+
+void NbdServer::ReapConnections() {
+  std::vector<std::thread> finished;
+  {
+    std::lock_guard<std::mutex> lock(connections_mutex_);
+    for (auto id : finished_threads_) {
+      auto it = std::find_if(connection_threads_.begin(),
+                             connection_threads_.end(),
+                             [id](const std::thread& thread) {
+                               return thread.get_id() == id; });
+      if (it == connection_threads_.end()) continue;
+      finished.push_back(std::move(*it));
+      connection_threads_.erase(it);
+    }
+    finished_threads_.clear();
+  }
+
+  // threads have released the mutex, they only return
+  for (auto& thread : finished)
+    thread.join();
+}
+
+void NbdServer::HandleConnection(std::shared_ptr<Connection> connection) {
+  if (Handshake(*connection))
+    Transmission(connection);
+
+  // wait for replies of submitted requests
+  std::unique_lock<std::mutex> lock(connection->in_flight_mutex);
+  connection->in_flight_cv.wait(lock, [&] { return connection->in_flight == 0; });
+  lock.unlock();
+
+  std::lock_guard<std::mutex> connections_lock(connections_mutex_);
+  connection_fds_.erase(connection->fd);
+  finished_threads_.push_back(std::this_thread::get_id());
+  LOG_DEBUG("NbdServer: client disconnected, fd " << connection->fd);
+}
+
+/**
+ * @brief Fixed newstyle negotiation
+ *
+ * Supports EXPORT_NAME, INFO, GO, LIST and ABORT options, any export
+ * name refers to the storage.
+ *
+ * @return True if the transmission phase should start
+ */
+bool NbdServer::Handshake(Connection& connection) {
+  int fd = connection.fd;
+
+  uint8 greeting[18];
+  PutUint64(greeting, kNbdMagic);
+  PutUint64(greeting + 8, kNbdOptionMagic);
+  PutUint16(greeting + 16, kNbdFlagFixedNewstyle | kNbdFlagNoZeroes);
+  if (!SendAll(fd, greeting, sizeof(greeting))) return false;
+
+  uint8 client_flags[4];
+  if (!ReceiveAll(fd, client_flags, sizeof(client_flags))) return false;
+  bool no_zeroes = (GetUint32(client_flags) & kNbdFlagClientNoZeroes) != 0;
+
+  while (true) {
+    uint8 header[16];
+    if (!ReceiveAll(fd, header, sizeof(header))) return false;
+    if (GetUint64(header) != kNbdOptionMagic) return false;
+
+    uint32 option = GetUint32(header + 8);
+    uint32 length = GetUint32(header + 12);
+    if (length > 4096) return false;
+
+    std::vector<uint8> data(length);
+    if (length && !ReceiveAll(fd, data.data(), length)) return false;
+
+    switch (option) {
+      case kNbdOptExportName: {
+        uint8 reply[10 + 124];
+        memset(reply, 0, sizeof(reply));
+        PutUint64(reply, size_);
+        PutUint16(reply + 8, kTransmissionFlags);
+        return SendAll(fd, reply, no_zeroes ? 10 : sizeof(reply));
+      }
+
+      case kNbdOptInfo:
+      case kNbdOptGo: {
+        if (length < 6 || GetUint32(data.data()) > length - 6) {
+          if (!connection.SendOptionReply(option, kNbdRepErrInvalid,
+                                          nullptr, 0))
+            return false;
+          break;
+        }
+
+        uint8 info[12];
+        PutUint16(info, kNbdInfoExport);
+        PutUint64(info + 2, size_);
+        PutUint16(info + 10, kTransmissionFlags);
+
+        uint8 block_size[14];
+        PutUint16(block_size, kNbdInfoBlockSize);
+        PutUint32(block_size + 2, 1);
+        PutUint32(block_size + 6, kNbdPreferredBlockSize);
+        PutUint32(block_size + 10, kMaxPayload);
+
+        if (!connection.SendOptionReply(option, kNbdRepInfo, info,
+                                        sizeof(info)) ||
+            !connection.SendOptionReply(option, kNbdRepInfo, block_size,
+                                        sizeof(block_size)) ||
+            !connection.SendOptionReply(option, kNbdRepAck, nullptr, 0))
+          return false;
+        if (option == kNbdOptGo) return true;
+        break;
+      }
+
+      case kNbdOptList: {
+        uint8 server[4];
+        PutUint32(server, 0);  // single export with empty name
+        if (!connection.SendOptionReply(option, kNbdRepServer, server,
+                                        sizeof(server)) ||
+            !connection.SendOptionReply(option, kNbdRepAck, nullptr, 0))
+          return false;
+        break;
+      }
+
+      case kNbdOptAbort:
+        connection.SendOptionReply(option, kNbdRepAck, nullptr, 0);
+        return false;
+
+      default:
+        if (!connection.SendOptionReply(option, kNbdRepErrUnsup, nullptr, 0))
+          return false;
+    }
+  }
+}
+
+/**
+ * @brief Receives requests and submits them to workers
+ *
+ * Ends on DISC, protocol error or closed connection.
+ */
+void NbdServer::Transmission(std::shared_ptr<Connection> connection) {
+  int fd = connection->fd;
+
+  while (!stop_) {
+    uint8 request[28];
+    if (!ReceiveAll(fd, request, sizeof(request))) return;
+    if (GetUint32(request) != kNbdRequestMagic) return;
+
+    uint16 flags = GetUint16(request + 4);
+    uint16 type = GetUint16(request + 6);
+    uint64 handle = GetUint64(request + 8);
+    uint64 offset = GetUint64(request + 16);
+    uint32 length = GetUint32(request + 24);
+
+    if (type == kNbdCmdDisc) return;
+
+    std::shared_ptr<std::vector<uint8>> data;
+    if (type == kNbdCmdWrite) {
+      // payload has to be consumed, otherwise the stream is lost
+      if (length > kMaxPayload) return;
+      data = std::make_shared<std::vector<uint8>>(length);
+      if (length && !ReceiveAll(fd, data->data(), length)) return;
+    }
+
+    {
+      std::lock_guard<std::mutex> lock(connection->in_flight_mutex);
+      connection->in_flight++;
+    }
+
+    Submit([=]() {
+      Execute(connection, flags, type, handle, offset, length, data);
+
+      std::lock_guard<std::mutex> lock(connection->in_flight_mutex);
+      if (--connection->in_flight == 0)
+        connection->in_flight_cv.notify_all();
+    });
+  }
+}
+
+/**
+ * @brief Executes one request on the storage and sends its reply
+ */
+void NbdServer::Execute(std::shared_ptr<Connection> connection, uint16 flags,
+                        uint16 type, uint64 handle, uint64 offset,
+                        uint32 length, std::shared_ptr<std::vector<uint8>> data) {
+  bool in_range = offset <= size_ && length <= size_ - offset;
+
+  try {
+    switch (type) {
+      case kNbdCmdRead: {
+        if (!in_range || length > kMaxPayload) {
+          connection->SendReply(handle, EINVAL, nullptr, 0);
+          return;
+        }
+        std::vector<uint8> buffer(length);
+        {
+          std::lock_guard<std::mutex> lock(storage_mutex_);
+          storage_->Read(buffer.data(), offset, length);
+        }
+        connection->SendReply(handle, 0, buffer.data(), length);
+        return;
+      }
+
+      case kNbdCmdWrite:
+      case kNbdCmdWriteZeroes: {
+        if (!in_range) {
+          connection->SendReply(handle, ENOSPC, nullptr, 0);
+          return;
+        }
+        {
+          std::lock_guard<std::mutex> lock(storage_mutex_);
+          if (type == kNbdCmdWrite) {
+            storage_->Write(data->data(), offset, length);
+          } else {
+            uint32 max_payload = kMaxPayload;
+            std::vector<uint8> zeroes(std::min(length, max_payload), 0);
+            for (uint64 done = 0; done < length; done += zeroes.size()) {
+              uint64 part = std::min<uint64>(zeroes.size(), length - done);
+              storage_->Write(zeroes.data(), offset + done, part);
+            }
+          }
+          if (flags & kNbdCmdFlagFua)
+            storage_->Save();
+        }
+        connection->SendReply(handle, 0, nullptr, 0);
+        return;
+      }
+
+      case kNbdCmdFlush: {
+        {
+          std::lock_guard<std::mutex> lock(storage_mutex_);
+          storage_->Save();
+        }
+        connection->SendReply(handle, 0, nullptr, 0);
+        return;
+      }
+
+      default:
+        connection->SendReply(handle, EINVAL, nullptr, 0);
+        return;
+    }
+  } catch (std::exception& e) {
+    LOG_ERROR("NbdServer: request " << type << " at " << offset
+              << " failed: " << e.what());
+    connection->SendReply(handle, EIO, nullptr, 0);
+  }
+}
+
+void NbdServer::Submit(std::function<void()> task) {
+  {
+    std::lock_guard<std::mutex> lock(tasks_mutex_);
+    tasks_.push(std::move(task));
+  }
+  tasks_cv_.notify_one();
+}
+
+void NbdServer::WorkerLoop() {
+  while (true) {
+    std::function<void()> task;
+    {
+      std::unique_lock<std::mutex> lock(tasks_mutex_);
+      tasks_cv_.wait(lock, [this] { return !tasks_.empty(); });
+      task = tasks_.front();
+      // empty task is left in the queue for the other workers
+      if (!task) return;
+      tasks_.pop();
+    }
+    task();
+  }
+}
+
+} // stego_disk
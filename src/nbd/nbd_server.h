@@ -0,0 +1,94 @@
+/**
+* @file nbd_server.h
+* @author Martin Kosdy
+* @author Matus Kysel
+* @date 2016
+* @brief Network block device (NBD) export of the storage
+*
+*/
+
+#ifndef STEGODISK_NBD_NBDSERVER_H_
+#define STEGODISK_NBD_NBDSERVER_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "stego_storage.h"
+#include "utils/stego_types.h"
+
+namespace stego_disk {
+
+/**
+ * The NbdServer class.
+ *
+ * Serves StegoStorage as a block device over a UNIX socket using
+ * the NBD protocol (fixed newstyle handshake, simple replies), so it
+ * can be attached by nbd-client on the local machine.
+ *
+ * Each connection has its own receiving thread, requests are executed
+ * by a shared pool of workers and replied as soon as they finish,
+ * possibly out of order. Several connections can be opened at once
+ * (CAN_MULTI_CONN), accesses to the storage are serialized. FLUSH and
+ * writes with FUA are mapped to StegoStorage::Save.
+ */
+class NbdServer {
+
+public:
+  NbdServer(StegoStorage* storage, unsigned int threads = kDefaultThreads);
+  ~NbdServer();
+
+  // listens on 'socket_path' and serves clients until Stop is called
+  void Serve(const std::string& socket_path);
+  // can be called from other threads or a signal handler
+  void Stop();
+
+  static const unsigned int kDefaultThreads = 4;
+  // maximal length of one request
+  static const uint32 kMaxPayload = 32 << 20;
+
+private:
+  class Connection;
+
+  void HandleConnection(std::shared_ptr<Connection> connection);
+  // joins threads of closed connections
+  void ReapConnections();
+  bool Handshake(Connection& connection);
+  void Transmission(std::shared_ptr<Connection> connection);
+
+  void Execute(std::shared_ptr<Connection> connection, uint16 flags,
+               uint16 type, uint64 handle, uint64 offset, uint32 length,
+               std::shared_ptr<std::vector<uint8>> data);
+
+  void Submit(std::function<void()> task);
+  void WorkerLoop();
+
+  StegoStorage* storage_;
+  uint64 size_;
+  std::mutex storage_mutex_;
+
+  std::atomic<bool> stop_;
+  std::atomic<int> listen_fd_;
+
+  std::vector<std::thread> workers_;
+  std::queue<std::function<void()>> tasks_;
+  std::mutex tasks_mutex_;
+  std::condition_variable tasks_cv_;
+
+  std::vector<std::thread> connection_threads_;
+  // ids of connection threads which are about to exit
+  std::vector<std::thread::id> finished_threads_;
+  std::set<int> connection_fds_;
+  std::mutex connections_mutex_;
+};
+
+} // stego_disk
+
+#endif // STEGODISK_NBD_NBDSERVER_H_
@@ -40,7 +40,7 @@ void Affine64Permutation::Init(PermElem requested_size, Key &key)
 PermElem Affine64Permutation::Permute(PermElem index) const {
   CommonPermuteInputCheck(index);
 
-  return (StegoMath::Mulmod(index, key_param_a_, size_) + key_param_b_) % size_;
+  return PermuteUnchecked(index);
 }
 
 } // stego_disk
@@ -31,7 +31,10 @@ PermElem AffinePermutation::GetSizeUsingParams(PermElem requested_size, Key &key
   if (key.GetSize() == 0)
     throw std::runtime_error("AffinePermutation: Invalid key (size=0)");
 
+  // modular arithmetic works with sizes < 2^63 (see ModularMultiplier)
   uint64 prime = requested_size;
+  if (prime > ModularMultiplier::kMaxModulus)
+    prime = ModularMultiplier::kMaxModulus;
 
   uint64 a, b;
 
@@ -73,6 +76,7 @@ PermElem AffinePermutation::GetSizeUsingParams(PermElem requested_size, Key &key
         size_ = prime;
         key_param_a_ = a;
         key_param_b_ = b;
+        multiplier_ = ModularMultiplier(a, prime);
       }
       return prime;
     }
@@ -81,19 +85,12 @@ PermElem AffinePermutation::GetSizeUsingParams(PermElem requested_size, Key &key
 
 PermElem AffinePermutation::GetSizeUsingParams(PermElem requested_size,
                                                Key &key) {
-  if (requested_size > 0xFFFFFFFF) // max size = 2^32 blocks (due to slow mulmod aritmethics for numbers > 2^32)
-    return 0;
-
   return GetSizeUsingParams(requested_size, key, false);
 }
 
 
 void AffinePermutation::Init(PermElem requested_size, Key &key)
 {
-  if (requested_size > 0xFFFFFFFF) // max size = 2^32 blocks (due to slow mulmod aritmethics for numbers > 2^32)
-    throw std::out_of_range("AffinePermutation: "
-                            "max requested size is (2^32)-1");
-
   initialized_ = false;
 
   if (GetSizeUsingParams(requested_size, key, true) == 0)
@@ -105,7 +102,7 @@ void AffinePermutation::Init(PermElem requested_size, Key &key)
 
 PermElem AffinePermutation::Permute(PermElem index) const {
   CommonPermuteInputCheck(index);
-  return ((((index) * key_param_a_) % size_) + key_param_b_) % size_;
+  return PermuteUnchecked(index);
 }
 
 } // stego_disk
@@ -11,6 +11,7 @@
 #define STEGODISK_PERMUTATIONS_AFFINEPERMUTATION_H_
 
 #include "permutation.h"
+#include "utils/stego_math.h"
 
 namespace stego_disk {
 
@@ -24,12 +25,49 @@ public:
   virtual PermElem Permute(PermElem index) const;
   virtual PermElem GetSizeUsingParams(PermElem requested_size, Key &key);
 
+  // Permute without input checks, used by carrier kernels
+  inline PermElem PermuteUnchecked(PermElem index) const {
+    PermElem value = multiplier_.Multiply(index) + key_param_b_;
+    return (value >= size_) ? value - size_ : value;
+  }
+
+  /**
+   * Iterator over Permute(index), Permute(index + 1), ...
+   *
+   * Permute(i + 1) = Permute(i) + a (mod size), so each step
+   * is one addition and a conditional subtraction.
+   * Iterating beyond the last index wraps around to index 0.
+   */
+  class Iterator {
+  public:
+    Iterator(PermElem value, PermElem step, PermElem size)
+      : value_(value), step_(step), size_(size) {}
+
+    inline PermElem operator*() const { return value_; }
+    inline Iterator& operator++() {
+      value_ += step_;
+      if (value_ >= size_) value_ -= size_;
+      return *this;
+    }
+
+  private:
+    PermElem value_;
+    PermElem step_;
+    PermElem size_;
+  };
+
+  // Iterator starting at Permute(index), input is not checked
+  inline Iterator IteratorAt(PermElem index) const {
+    return Iterator(PermuteUnchecked(index), key_param_a_, size_);
+  }
+
   const std::string GetNameInstance() const { return "Affine"; }
 protected:
   PermElem GetSizeUsingParams(PermElem requested_size, Key &key,
                               bool overwrite_members);
   uint64 key_param_a_;
   uint64 key_param_b_;
+  ModularMultiplier multiplier_;
 };
 
 } // stego_disk
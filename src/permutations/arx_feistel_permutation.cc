@@ -0,0 +1,131 @@
+/**
+* @file arx_feistel_permutation.cc
+* @author Martin Kosdy
+* @author Matus Kysel
+* @date 2016
+* @brief Table-free Feistel permutation with ARX round function - implementation
+*
+*/
+
+#include "arx_feistel_permutation.h"
+
+#include <string.h>
+
+#include "hash/hash.h"
+#include "logging/logger.h"
+
+#define AFP_MIN_REQ_SIZE                        1024
+
+namespace stego_disk {
+
+ArxFeistelPermutation::ArxFeistelPermutation() :
+  left_mod_(0),
+  right_mask_(0),
+  right_bits_(0) {
+
+  memset(round_keys_, 0, sizeof(round_keys_));
+
+  LOG_DEBUG("Permutation::Permutation: constructor called for: " <<
+            GetNameInstance());
+}
+
+ArxFeistelPermutation::~ArxFeistelPermutation() {
+  LOG_DEBUG("Permutation::~Permutation: destructor called for: " <<
+            GetNameInstance());
+}
+
+/**
+ * @brief SipHash-2-4 of a single 64-bit word
+ *
+ * @param[in] k0 First half of the 128-bit key
+ * @param[in] k1 Second half of the 128-bit key
+ * @param[in] message Message (8 bytes, little endian)
+ * @return 64-bit hash
+ */
+uint64 ArxFeistelPermutation::SipHash24(uint64 k0, uint64 k1, uint64 message) {
+  uint64 v0 = k0 ^ 0x736f6d6570736575ULL;
+  uint64 v1 = k1 ^ 0x646f72616e646f6dULL;
+  uint64 v2 = k0 ^ 0x6c7967656e657261ULL;
+  uint64 v3 = k1 ^ 0x7465646279746573ULL;
+  const uint64 last = 8ULL << 56;
+
+  v3 ^= message;
+  SipRound(v0, v1, v2, v3);
+  SipRound(v0, v1, v2, v3);
+  v0 ^= message;
+
+  v3 ^= last;
+  SipRound(v0, v1, v2, v3);
+  SipRound(v0, v1, v2, v3);
+  v0 ^= last;
+
+  v2 ^= 0xff;
+  for (int i = 0; i < 4; ++i)
+    SipRound(v0, v1, v2, v3);
+
+  return v0 ^ v1 ^ v2 ^ v3;
+}
+
+void ArxFeistelPermutation::Init(PermElem requested_size, Key &key) {
+  if (key.GetSize() == 0)
+    throw std::runtime_error("ArxFeistelPermutation init: "
+                             "Invalid key (size=0)");
+
+  if (requested_size < AFP_MIN_REQ_SIZE)
+    throw std::runtime_error("ArxFeistelPermutation: "
+                             "requested_size < AFP_MIN_REQ_SIZE (=1024)");
+
+  uint8 bit_len = StegoMath::Log2(requested_size);
+
+  initialized_ = false;
+
+  right_bits_ = bit_len - bit_len / 2;
+  left_mod_ = (requested_size >> right_bits_);
+  right_mask_ = (1ULL << right_bits_) - 1;
+
+  size_ = left_mod_ << right_bits_;
+
+  // 128-bit master key: hash of the key folded into 16 bytes
+  Hash key_hash(key.GetData().GetConstRawPointer(), key.GetData().GetSize());
+  const MemoryBuffer& state = key_hash.GetState();
+  uint8 master[16] = { 0 };
+  for (std::size_t i = 0; i < state.GetSize(); ++i)
+    master[i % sizeof(master)] ^= state[i];
+
+  uint64 k0, k1;
+  memcpy(&k0, master, sizeof(uint64));
+  memcpy(&k1, master + sizeof(uint64), sizeof(uint64));
+
+  // initial SipHash state of each round
+  for (uint64 r = 0; r < AFP_NUMROUNDS; ++r)
+    for (uint64 j = 0; j < 4; ++j)
+      round_keys_[r][j] = SipHash24(k0, k1, r * 4 + j);
+
+  LOG_TRACE("ArxFeistelPermutation::init: left_mod_ = " << left_mod_ <<
+            ", right_bits_ = " << static_cast<int>(right_bits_));
+
+  initialized_ = true;
+}
+
+PermElem ArxFeistelPermutation::Permute(PermElem index) const {
+  CommonPermuteInputCheck(index);
+
+  uint64 permuted_index = PermuteUnchecked(index);
+
+  if (permuted_index >= size_)
+    throw std::runtime_error("ArxFeistelPermutation: "
+                             "permuted index calculation failed");
+
+  return permuted_index;
+}
+
+PermElem ArxFeistelPermutation::GetSizeUsingParams(PermElem requested_size,
+                                                   Key& /*key*/) {
+  if (requested_size < AFP_MIN_REQ_SIZE) return 0;
+
+  uint8 bit_len = StegoMath::Log2(requested_size);
+  uint8 right_bits = bit_len - bit_len / 2;
+  return (requested_size >> right_bits) << right_bits;
+}
+
+} // stego_disk
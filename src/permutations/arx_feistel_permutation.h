@@ -0,0 +1,131 @@
+/**
+* @file arx_feistel_permutation.h
+* @author Martin Kosdy
+* @author Matus Kysel
+* @date 2016
+* @brief Table-free Feistel permutation with ARX round function
+*
+*/
+
+#ifndef STEGODISK_PERMUTATIONS_ARXFEISTELPERMUTATION_H_
+#define STEGODISK_PERMUTATIONS_ARXFEISTELPERMUTATION_H_
+
+#include "permutation.h"
+#include "utils/stego_math.h"
+
+#define AFP_NUMROUNDS                           6
+
+namespace stego_disk {
+
+/**
+ * The ArxFeistelPermutation class.
+ *
+ * Feistel network of the same shape (and size) as FeistelMixPermutation,
+ * index = left * 2^right_bits + right, but the round function is computed
+ * on the fly instead of being looked up in tables: it is a reduced
+ * SipHash (add-rotate-xor) keyed by per-round keys derived from the key.
+ * Init costs a single hash of the key and memory does not depend
+ * on the size, so it suits very large domains.
+ */
+class ArxFeistelPermutation : public Permutation {
+
+public:
+  ArxFeistelPermutation();
+  ~ArxFeistelPermutation();
+
+  virtual void Init(PermElem requested_size, Key &key);
+  virtual PermElem Permute(PermElem index) const;
+  virtual PermElem GetSizeUsingParams(PermElem requested_size, Key &key);
+
+  // Permute without input checks, used by carrier kernels
+  inline PermElem PermuteUnchecked(PermElem index) const {
+    uint64 right = index & right_mask_;
+    uint64 left = index >> right_bits_;
+
+    for (int r = 0; r < AFP_NUMROUNDS; ++r) {
+      if (r % 2) {
+        right ^= Round(r, left) & right_mask_;
+      } else {
+        left += StegoMath::MulHigh(Round(r, right), left_mod_);
+        if (left >= left_mod_) left -= left_mod_;
+      }
+    }
+
+    return (left << right_bits_) + right;
+  }
+
+  // Number of indices permuted at once by PermuteRange
+  static const int kLanes = 8;
+
+  /**
+   * Permutes 'count' consecutive indices starting at 'first', input is
+   * not checked. Indices are processed in groups of kLanes independent
+   * lanes, round by round, so the compiler can interleave (vectorize)
+   * their round functions.
+   */
+  inline void PermuteRange(PermElem first, uint64 count, PermElem* out) const {
+    const uint64 full = count - count % kLanes;
+    uint64 i = 0;
+    for ( ; i < full; i += kLanes) {
+      uint64 left[kLanes], right[kLanes];
+      for (int k = 0; k < kLanes; ++k) {
+        right[k] = (first + i + k) & right_mask_;
+        left[k] = (first + i + k) >> right_bits_;
+      }
+      for (int r = 0; r < AFP_NUMROUNDS; ++r) {
+        if (r % 2) {
+          for (int k = 0; k < kLanes; ++k)
+            right[k] ^= Round(r, left[k]) & right_mask_;
+        } else {
+          for (int k = 0; k < kLanes; ++k) {
+            left[k] += StegoMath::MulHigh(Round(r, right[k]), left_mod_);
+            if (left[k] >= left_mod_) left[k] -= left_mod_;
+          }
+        }
+      }
+      for (int k = 0; k < kLanes; ++k)
+        out[i + k] = (left[k] << right_bits_) + right[k];
+    }
+    for ( ; i < count; ++i)
+      out[i] = PermuteUnchecked(first + i);
+  }
+
+  const std::string GetNameInstance() const { return "ArxFeistel"; }
+
+private:
+  static inline uint64 Rotl(uint64 x, int b) {
+    return (x << b) | (x >> (64 - b));
+  }
+
+  static inline void SipRound(uint64 &v0, uint64 &v1, uint64 &v2, uint64 &v3) {
+    v0 += v1; v1 = Rotl(v1, 13); v1 ^= v0; v0 = Rotl(v0, 32);
+    v2 += v3; v3 = Rotl(v3, 16); v3 ^= v2;
+    v0 += v3; v3 = Rotl(v3, 21); v3 ^= v0;
+    v2 += v1; v1 = Rotl(v1, 17); v1 ^= v2; v2 = Rotl(v2, 32);
+  }
+
+  // round function: SipHash-1-1 of a single word, keyed state of round r
+  inline uint64 Round(int r, uint64 x) const {
+    uint64 v0 = round_keys_[r][0];
+    uint64 v1 = round_keys_[r][1];
+    uint64 v2 = round_keys_[r][2];
+    uint64 v3 = round_keys_[r][3] ^ x;
+    SipRound(v0, v1, v2, v3);
+    v0 ^= x;
+    v2 ^= 0xff;
+    SipRound(v0, v1, v2, v3);
+    return v0 ^ v1 ^ v2 ^ v3;
+  }
+
+  static uint64 SipHash24(uint64 k0, uint64 k1, uint64 message);
+
+  uint64 round_keys_[AFP_NUMROUNDS][4];
+
+  uint64 left_mod_;
+  uint64 right_mask_;
+  uint8 right_bits_;
+};
+
+} // stego_disk
+
+#endif // STEGODISK_PERMUTATIONS_ARXFEISTELPERMUTATION_H_
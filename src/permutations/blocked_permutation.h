@@ -0,0 +1,131 @@
+/**
+* @file blocked_permutation.h
+* @author Martin Kosdy
+* @author Matus Kysel
+* @date 2016
+* @brief Two-level permutation of cache lines and bytes inside them
+*
+*/
+
+#ifndef STEGODISK_PERMUTATIONS_BLOCKEDPERMUTATION_H_
+#define STEGODISK_PERMUTATIONS_BLOCKEDPERMUTATION_H_
+
+#include <string.h>
+
+#include "permutation.h"
+#include "feistel_mix_permutation.h"
+#include "hash/hash.h"
+
+namespace stego_disk {
+
+/**
+ * The BlockedPermutation class.
+ *
+ * Domain is split into lines of kLineSize elements (one cache line
+ * of the virtual storage). Lines are permuted by the underlying keyed
+ * permutation, elements inside each line by a cheap keyed bijection
+ * which differs from line to line:
+ *   Permute(i) = P(i / kLineSize) * kLineSize + Q_line(i % kLineSize)
+ *
+ * Consecutive indices stay within one line of the storage, so carriers
+ * touch a new cache line (and page) only once per kLineSize bytes,
+ * while lines are still spread over the whole storage.
+ */
+template <class LinePermutation>
+class BlockedPermutation : public Permutation {
+
+public:
+  static const uint8 kLineBits = 6;
+  static const PermElem kLineSize = 1 << kLineBits;
+
+  BlockedPermutation() : line_key_(0) {}
+  ~BlockedPermutation() {}
+
+  virtual void Init(PermElem requested_size, Key &key) {
+    initialized_ = false;
+
+    line_permutation_.Init(requested_size >> kLineBits, key);
+
+    // key of in-line permutations differs from key of the line permutation
+    Hash line_hash(key.GetData().GetConstRawPointer(), key.GetData().GetSize());
+    line_hash.Append(GetNameInstance());
+    const MemoryBuffer& state = line_hash.GetState();
+    uint8 line_key[sizeof(uint64)] = { 0 };
+    for (std::size_t i = 0; i < state.GetSize(); ++i)
+      line_key[i % sizeof(line_key)] ^= state[i];
+    memcpy(&line_key_, line_key, sizeof(line_key_));
+
+    size_ = line_permutation_.GetSize() << kLineBits;
+    initialized_ = true;
+  }
+
+  virtual PermElem Permute(PermElem index) const {
+    CommonPermuteInputCheck(index);
+    return PermuteUnchecked(index);
+  }
+
+  virtual PermElem GetSizeUsingParams(PermElem requested_size, Key &key) {
+    return line_permutation_.GetSizeUsingParams(requested_size >> kLineBits,
+                                                key) << kLineBits;
+  }
+
+  // Permute without input checks, used by carrier kernels
+  inline PermElem PermuteUnchecked(PermElem index) const {
+    PermElem line = index >> kLineBits;
+    return LineBase(line) + PermuteInLine(LineKey(line),
+                                          index & (kLineSize - 1));
+  }
+
+  // first element of the permuted line
+  inline PermElem LineBase(PermElem line) const {
+    return line_permutation_.PermuteUnchecked(line) << kLineBits;
+  }
+
+  // key of the permutation inside the line (64-bit finalizer of MurmurHash3)
+  inline uint64 LineKey(PermElem line) const {
+    uint64 x = line ^ line_key_;
+    x ^= x >> 33;
+    x *= 0xff51afd7ed558ccdULL;
+    x ^= x >> 33;
+    x *= 0xc4ceb9fe1a85ec53ULL;
+    x ^= x >> 33;
+    return x;
+  }
+
+  // Feistel network over two halves of the offset, the round function
+  // of each round is a table of 8 entries taken from bits of line_key
+  static inline PermElem PermuteInLine(uint64 line_key, PermElem offset) {
+    PermElem left = offset >> kHalfBits;
+    PermElem right = offset & kHalfMask;
+    for (int round = 0; round < kLineRounds; ++round) {
+      PermElem f = (line_key >> (right * kHalfBits)) & kHalfMask;
+      PermElem next = left ^ f;
+      left = right;
+      right = next;
+      line_key = (line_key >> kRoundKeyBits) | (line_key << (64 - kRoundKeyBits));
+    }
+    return (left << kHalfBits) | right;
+  }
+
+  PermElem GetLineCount() const { return line_permutation_.GetSize(); }
+
+  const std::string GetNameInstance() const {
+    return "Blocked" + line_permutation_.GetNameInstance();
+  }
+
+private:
+  static const PermElem kHalfBits = kLineBits / 2;
+  static const PermElem kHalfMask = (1 << kHalfBits) - 1;
+  // rotation of the line key between rounds, each round reads 24 bits
+  static const int kRoundKeyBits = 21;
+  static const int kLineRounds = 3;
+
+  LinePermutation line_permutation_;
+  uint64 line_key_;
+};
+
+typedef BlockedPermutation<FeistelMixPermutation> BlockedFeistelMixPermutation;
+
+} // stego_disk
+
+#endif // STEGODISK_PERMUTATIONS_BLOCKEDPERMUTATION_H_
@@ -0,0 +1,125 @@
+/**
+* @file cycle_walking_permutation.h
+* @author Martin Kosdy
+* @author Matus Kysel
+* @date 2016
+* @brief Exact-size permutation using cycle walking
+*
+*/
+
+#ifndef STEGODISK_PERMUTATIONS_CYCLEWALKINGPERMUTATION_H_
+#define STEGODISK_PERMUTATIONS_CYCLEWALKINGPERMUTATION_H_
+
+#include <stdexcept>
+
+#include "permutation.h"
+#include "feistel_mix_permutation.h"
+#include "feistel_num_permutation.h"
+
+namespace stego_disk {
+
+/**
+ * The CycleWalkingPermutation class.
+ *
+ * Permutation of exactly the requested size. Underlying permutation
+ * is initialized with the smallest domain covering the requested size
+ * (its own size rounding goes up instead of down) and elements outside
+ * of the requested range are skipped by repeated permuting:
+ * Permute(i) = P(i), P(P(i)), ... until the result is < size.
+ *
+ * Underlying domain is at most a few per cent larger than the requested
+ * size, average number of steps is GetDomainSize() / GetSize().
+ */
+template <class UnderlyingPermutation>
+class CycleWalkingPermutation : public Permutation {
+
+public:
+  CycleWalkingPermutation() {}
+  ~CycleWalkingPermutation() {}
+
+  virtual void Init(PermElem requested_size, Key &key) {
+    initialized_ = false;
+
+    PermElem domain_request = GetDomainRequest(requested_size, key);
+    if (domain_request == 0)
+      throw std::runtime_error("CycleWalkingPermutation: "
+                               "requested size is not supported");
+
+    permutation_.Init(domain_request, key);
+    if (permutation_.GetSize() < requested_size)
+      throw std::runtime_error("CycleWalkingPermutation: "
+                               "domain of the permutation is too small");
+
+    size_ = requested_size;
+    initialized_ = true;
+  }
+
+  virtual PermElem Permute(PermElem index) const {
+    CommonPermuteInputCheck(index);
+    return PermuteUnchecked(index);
+  }
+
+  virtual PermElem GetSizeUsingParams(PermElem requested_size, Key &key) {
+    return (GetDomainRequest(requested_size, key) != 0) ? requested_size : 0;
+  }
+
+  // Permute without input checks, used by carrier kernels
+  inline PermElem PermuteUnchecked(PermElem index) const {
+    PermElem value = permutation_.PermuteUnchecked(index);
+    while (value >= size_)
+      value = permutation_.PermuteUnchecked(value);
+    return value;
+  }
+
+  // size of the underlying permutation
+  PermElem GetDomainSize() const { return permutation_.GetSize(); }
+
+  const std::string GetNameInstance() const {
+    return "Exact" + permutation_.GetNameInstance();
+  }
+
+private:
+  // Finds the smallest request for which the underlying permutation
+  // covers 'requested_size' elements; 0 if there is no such request.
+  // Size of the underlying permutation must not decrease with the request.
+  PermElem GetDomainRequest(PermElem requested_size, Key &key) {
+    if (requested_size == 0)
+      return 0;
+
+    if (permutation_.GetSizeUsingParams(requested_size, key) >= requested_size)
+      return requested_size;
+
+    // exponential search for a covering request ..
+    PermElem low = requested_size;
+    PermElem high = requested_size;
+    PermElem step = 1;
+    while (permutation_.GetSizeUsingParams(high, key) < requested_size) {
+      low = high;
+      if (high + step < high)
+        return 0;
+      high += step;
+      step *= 2;
+    }
+
+    // .. and binary search for the smallest one, low is not covering
+    while (high - low > 1) {
+      PermElem middle = low + (high - low) / 2;
+      if (permutation_.GetSizeUsingParams(middle, key) >= requested_size)
+        high = middle;
+      else
+        low = middle;
+    }
+    return high;
+  }
+
+  UnderlyingPermutation permutation_;
+};
+
+typedef CycleWalkingPermutation<FeistelMixPermutation>
+    ExactFeistelMixPermutation;
+typedef CycleWalkingPermutation<FeistelNumPermutation>
+    ExactFeistelNumPermutation;
+
+} // stego_disk
+
+#endif // STEGODISK_PERMUTATIONS_CYCLEWALKINGPERMUTATION_H_
@@ -16,10 +16,11 @@
 #include "utils/config.h"
 #include "utils/stego_errors.h"
 #include "logging/logger.h"
-#include "hash/hash.h"
+#include "feistel_tables.h"
 
 #define FMP_MIN_REQ_SIZE                        1024
-#define FMP_NUMROUNDS                           5
+// round tables have 2^right_bits_ entries indexed by uint32
+#define FMP_MAX_RIGHT_BITS                      31
 
 namespace stego_disk {
 
@@ -58,39 +59,22 @@ void FeistelMixPermutation::Init(PermElem requested_size, Key &key) {
 
   left_bits_ = bit_len / 2;
   right_bits_ = bit_len - left_bits_;
+
+  if (right_bits_ > FMP_MAX_RIGHT_BITS)
+    throw std::runtime_error("FeistelMixPermutation: "
+                             "requested size is too big");
+
   left_mod_ = (requested_size >> right_bits_);
-  right_mask_ = (1 << right_bits_) - 1;
+  right_mask_ = (1ULL << right_bits_) - 1;
 
   size_ = left_mod_ << right_bits_;
 
   uint32 max_hash = static_cast<uint32>(right_mask_ + 1);
 
-  hash_tables_ = std::vector<std::vector<uint32> >(
-                   FMP_NUMROUNDS, std::vector<uint32>(max_hash, 0));
-
-  //TODO: hash could be initialized_ by key and then just append "i" in each iteration - or not?
-  //      sth like: Hash hash(key.getData());
-  //      for (i..) hash.append(..)
-
-  Hash hash;
-
   LOG_TRACE("FeistelMixPermutation::init: computing hash table (HT) containing "
             << max_hash << " elements");
 
-  for (uint32 t = 0; t < FMP_NUMROUNDS; ++t) {
-    for (uint32 i = 0; i < max_hash; ++i) {
-      hash.Process(key.GetData());
-      hash.Append((uint8*)&i, sizeof(uint32));
-      hash.Append((uint8*)&t, sizeof(uint32));
-
-      //TODO: rewrite these lines - im sure there is a better way of writing this
-
-      if (hash.GetStateSize() < 4)
-        throw std::runtime_error("hash size is too small");
-
-      hash_tables_[t][i] = *((uint32*)hash.GetState().GetConstRawPointer()) % max_hash;
-    }
-  }
+  FeistelTables::Generate(key, FMP_NUMROUNDS, max_hash, hash_tables_);
   LOG_TRACE("FeistelMixPermutation::init: HT ready; left_mod_ = "
             << left_mod_ << ", right_mask_ = " << right_mask_ << endl);
 
@@ -100,18 +84,7 @@ void FeistelMixPermutation::Init(PermElem requested_size, Key &key) {
 PermElem FeistelMixPermutation::Permute(PermElem index) const {
   CommonPermuteInputCheck(index);
 
-  uint64 right = index & right_mask_;
-  uint64 left = index >> right_bits_;
-
-  for (int r = 0; r < FMP_NUMROUNDS; ++r) {
-    if (r % 2) {
-      right = (right ^ (hash_tables_[r][left] & right_mask_));
-    } else {
-      left = (left + (hash_tables_[r][right] >> right_bits_)) % left_mod_;
-    }
-  }
-
-  uint64 permuted_index = (left << right_bits_) + right;
+  uint64 permuted_index = PermuteUnchecked(index);
 
   if (permuted_index >= size_)
     throw std::runtime_error("FeistelMixPermutation: "
@@ -130,6 +103,9 @@ PermElem FeistelMixPermutation::GetSizeUsingParams(PermElem requested_size,
     return 0;
 
   uint8 right_bits = bit_len - bit_len / 2;
+  if (right_bits > FMP_MAX_RIGHT_BITS)
+    return 0;
+
   return (requested_size >> right_bits) << right_bits;
 }
 
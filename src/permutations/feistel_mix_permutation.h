@@ -14,6 +14,8 @@
 
 #include "permutation.h"
 
+#define FMP_NUMROUNDS                           5
+
 namespace stego_disk {
 
 class FeistelMixPermutation : public Permutation {
@@ -26,6 +28,22 @@ public:
   virtual PermElem Permute(PermElem index) const;
   virtual PermElem GetSizeUsingParams(PermElem requested_size, Key &key);
 
+  // Permute without input checks, used by carrier kernels
+  inline PermElem PermuteUnchecked(PermElem index) const {
+    uint64 right = index & right_mask_;
+    uint64 left = index >> right_bits_;
+
+    for (int r = 0; r < FMP_NUMROUNDS; ++r) {
+      if (r % 2) {
+        right = (right ^ (hash_tables_[r][left] & right_mask_));
+      } else {
+        left = (left + (hash_tables_[r][right] >> right_bits_)) % left_mod_;
+      }
+    }
+
+    return (left << right_bits_) + right;
+  }
+
   const std::string GetNameInstance() const { return "MixedFeistel"; }
 
   //    const string getNameInstance() const;
@@ -15,6 +15,7 @@
 #include "permutation.h"
 #include "utils/stego_types.h"
 
+#define FNP_NUMROUNDS                           5
 
 namespace stego_disk {
 
@@ -28,6 +29,23 @@ public:
   virtual PermElem Permute(PermElem index) const;
   virtual PermElem GetSizeUsingParams(PermElem requested_size, Key &key);
 
+  // Permute without input checks, used by carrier kernels
+  inline PermElem PermuteUnchecked(PermElem index) const {
+    uint64 right = index % modulus_;
+    uint64 left = index / modulus_;
+
+    // feistel rounds
+    for (std::size_t r = 0; r < FNP_NUMROUNDS; ++r) {
+      if (r % 2) {
+        right = (right + hash_tables_[r][left]) % modulus_;
+      } else {
+        left = (left + hash_tables_[r][right]) % modulus_;
+      }
+    }
+
+    return (left * modulus_) + right;
+  }
+
   const std::string GetNameInstance() const { return "NumericFeistel"; }
 
 private:
@@ -0,0 +1,144 @@
+/**
+* @file feistel_tables.cc
+* @author Martin Kosdy
+* @author Matus Kysel
+* @date 2016
+* @brief Generation of round tables for Feistel permutations - implementation
+*
+*/
+
+#include "feistel_tables.h"
+
+#include <string.h>
+#include <algorithm>
+#include <stdexcept>
+
+#include "hash/hash.h"
+#include "hash/hash_impl.h"
+#include "utils/thread_pool.h"
+
+namespace stego_disk {
+
+/**
+ * @brief Computes round tables of Feistel permutation
+ *
+ * Entry i of table t is the first 4 bytes (as uint32) of
+ *   Hash(key).Append(i).Append(t)
+ * reduced modulo 'table_size', where Append(x) is H(H(x) || state).
+ *
+ * Hash of the key, hashes of round numbers and the inner part
+ * H(H(i) || H(key)) (same for all rounds) are computed only once,
+ * so each entry costs one hash of a two-state block. Tables are filled
+ * in parallel chunks (serially on ThreadPool workers), several entries
+ * at once (Hash::ProcessMany); no memory is allocated per entry.
+ *
+ * @param[in] key Key of the permutation
+ * @param[in] rounds Number of rounds (tables)
+ * @param[in] table_size Number of entries in each table, also the modulus
+ * @param[out] tables Resized to 'rounds' x 'table_size' and filled
+ */
+void FeistelTables::Generate(Key &key, uint32 rounds, uint32 table_size,
+                             FeistelRoundTables &tables) {
+  if (table_size == 0)
+    throw std::invalid_argument("FeistelTables: table size cannot be 0");
+
+  tables = FeistelRoundTables(rounds, std::vector<uint32>(table_size, 0));
+
+  Hash key_hash(key.GetData().GetConstRawPointer(), key.GetData().GetSize());
+  std::size_t state_size = key_hash.GetStateSize();
+
+  if (state_size < 4)
+    throw std::runtime_error("hash size is too small");
+
+  MemoryBuffer round_hashes(rounds * state_size);
+  for (uint32 t = 0; t < rounds; ++t) {
+    Hash round_hash((uint8*)&t, sizeof(uint32));
+    round_hashes.Write(t * state_size, round_hash.GetState().GetConstRawPointer(),
+                       state_size);
+  }
+
+  // local permutations are initialized by carriers in the manager's
+  // thread pool, their tables are computed on the calling worker
+  ThreadPool::ForEachRange(table_size, kMinEntriesPerThread,
+                           [&](uint64 begin, uint64 end) {
+    GenerateRange(key_hash.GetState(), round_hashes, rounds, table_size,
+                  static_cast<uint32>(begin), static_cast<uint32>(end),
+                  tables);
+  });
+}
+
+/**
+ * @brief Computes entries <begin; end) of all round tables
+ *
+ * @param[in] key_hash H(key)
+ * @param[in] round_hashes H(t) for all rounds, one after another
+ * @param[in] rounds Number of rounds (tables)
+ * @param[in] table_size Number of entries in each table, also the modulus
+ * @param[in] begin First entry to compute
+ * @param[in] end Entry after the last one to compute
+ * @param[out] tables Tables of 'rounds' x 'table_size' entries
+ */
+void FeistelTables::GenerateRange(const MemoryBuffer &key_hash,
+                                  const MemoryBuffer &round_hashes,
+                                  uint32 rounds, uint32 table_size,
+                                  uint32 begin, uint32 end,
+                                  FeistelRoundTables &tables) {
+  const std::size_t state_size = Hash::GetDefaultStateSize();
+  const uint32 batch_size = kBatchSize;
+
+  if (state_size > HashImpl::kMaxStateSize)
+    throw std::runtime_error("hash size is too big");
+
+  // entries of a batch are hashed at once, see Hash::ProcessMany;
+  // blocks are [ H(input) | previous state ]
+  uint8 index[kBatchSize][sizeof(uint32)];
+  uint8 inner[kBatchSize][HashImpl::kMaxStateSize * 2];
+  uint8 outer[kBatchSize][HashImpl::kMaxStateSize * 2];
+  uint8 digest[kBatchSize][HashImpl::kMaxStateSize];
+
+  const uint8* index_ptr[kBatchSize];
+  const uint8* inner_ptr[kBatchSize];
+  const uint8* outer_ptr[kBatchSize];
+  uint8* inner_hash_ptr[kBatchSize];
+  uint8* outer_hash_ptr[kBatchSize];
+  uint8* digest_ptr[kBatchSize];
+
+  for (uint32 k = 0; k < kBatchSize; ++k) {
+    memcpy(inner[k] + state_size, key_hash.GetConstRawPointer(), state_size);
+    index_ptr[k] = index[k];
+    inner_ptr[k] = inner[k];
+    outer_ptr[k] = outer[k];
+    inner_hash_ptr[k] = inner[k];
+    outer_hash_ptr[k] = outer[k] + state_size;
+    digest_ptr[k] = digest[k];
+  }
+
+  for (uint32 first = begin; first < end; first += batch_size) {
+    uint32 count = std::min(batch_size, end - first);
+
+    // H(H(i) || H(key))
+    for (uint32 k = 0; k < count; ++k) {
+      uint32 i = first + k;
+      memcpy(index[k], &i, sizeof(uint32));
+    }
+    Hash::ProcessMany(index_ptr, sizeof(uint32), inner_hash_ptr, count);
+    Hash::ProcessMany(inner_ptr, state_size * 2, outer_hash_ptr, count);
+
+    // H(H(t) || H(H(i) || H(key)))
+    for (uint32 t = 0; t < rounds; ++t) {
+      for (uint32 k = 0; k < count; ++k) {
+        memcpy(outer[k], round_hashes.GetConstRawPointer() + t * state_size,
+               state_size);
+      }
+      Hash::ProcessMany(outer_ptr, state_size * 2, digest_ptr, count);
+
+      for (uint32 k = 0; k < count; ++k) {
+        uint32 hash_val;
+        memcpy(&hash_val, digest[k], sizeof(uint32));
+        tables[t][first + k] = hash_val % table_size;
+      }
+    }
+  }
+}
+
+} // stego_disk
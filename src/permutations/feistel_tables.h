@@ -0,0 +1,43 @@
+/**
+* @file feistel_tables.h
+* @author Martin Kosdy
+* @author Matus Kysel
+* @date 2016
+* @brief Generation of round tables for Feistel permutations
+*
+*/
+
+#ifndef STEGODISK_PERMUTATIONS_FEISTELTABLES_H_
+#define STEGODISK_PERMUTATIONS_FEISTELTABLES_H_
+
+#include <vector>
+
+#include "utils/stego_types.h"
+#include "keys/key.h"
+
+namespace stego_disk {
+
+typedef std::vector< std::vector<uint32> > FeistelRoundTables;
+
+class FeistelTables {
+
+public:
+  static void Generate(Key &key, uint32 rounds, uint32 table_size,
+                       FeistelRoundTables &tables);
+
+private:
+  static void GenerateRange(const MemoryBuffer &key_hash,
+                            const MemoryBuffer &round_hashes,
+                            uint32 rounds, uint32 table_size,
+                            uint32 begin, uint32 end,
+                            FeistelRoundTables &tables);
+
+  // minimal number of table entries computed by one thread
+  static const uint32 kMinEntriesPerThread = 4096;
+  // number of entries hashed at once
+  static const uint32 kBatchSize = 4;
+};
+
+} // stego_disk
+
+#endif // STEGODISK_PERMUTATIONS_FEISTELTABLES_H_
@@ -36,7 +36,7 @@ void IdentityPermutation::Init(PermElem requested_size, Key& /*key*/) {
 PermElem IdentityPermutation::Permute(PermElem index) const {
   CommonPermuteInputCheck(index);
 
-  return index;
+  return PermuteUnchecked(index);
 }
 
 PermElem IdentityPermutation::GetSizeUsingParams(PermElem requested_size,
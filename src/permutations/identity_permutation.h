@@ -24,6 +24,9 @@ public:
   virtual PermElem Permute(PermElem index) const;
   virtual PermElem GetSizeUsingParams(PermElem requested_size, Key &key);
 
+  // Permute without input checks, used by carrier kernels
+  inline PermElem PermuteUnchecked(PermElem index) const { return index; }
+
   const std::string GetNameInstance() const { return "Identity"; }
 };
 
@@ -17,6 +17,9 @@
 #include "affine64_permutation.h"
 #include "feistel_num_permutation.h"
 #include "feistel_mix_permutation.h"
+#include "cycle_walking_permutation.h"
+#include "arx_feistel_permutation.h"
+#include "blocked_permutation.h"
 
 namespace stego_disk {
 
@@ -54,10 +57,27 @@ vector<std::shared_ptr<Permutation>> PermutationFactory::GetPermutations() {
   list.push_back(make_shared<Affine64Permutation>());
   list.push_back(make_shared<FeistelNumPermutation>());
   list.push_back(make_shared<FeistelMixPermutation>());
+  list.push_back(make_shared<ExactFeistelNumPermutation>());
+  list.push_back(make_shared<ExactFeistelMixPermutation>());
+  list.push_back(make_shared<ArxFeistelPermutation>());
+  list.push_back(make_shared<BlockedFeistelMixPermutation>());
 
   return list;
 }
 
+vector<PermutationFactory::PermutationType>
+PermutationFactory::GetPermutationTypes() {
+  return { PermutationType::IDENTITY,
+           PermutationType::AFFINE,
+           PermutationType::AFFINE64,
+           PermutationType::FEISTEL_NUM,
+           PermutationType::FEISTEL_MIX,
+           PermutationType::FEISTEL_NUM_EXACT,
+           PermutationType::FEISTEL_MIX_EXACT,
+           PermutationType::ARX_FEISTEL,
+           PermutationType::FEISTEL_MIX_BLOCKED };
+}
+
 /**
  * @brief Get instance of the permutation by the code name
  *
@@ -114,6 +134,14 @@ std::shared_ptr<Permutation> PermutationFactory::GetPermutation(
       return std::make_shared<FeistelNumPermutation>();
     case PermutationType::FEISTEL_MIX:
       return std::make_shared<FeistelMixPermutation>();
+    case PermutationType::FEISTEL_NUM_EXACT:
+      return std::make_shared<ExactFeistelNumPermutation>();
+    case PermutationType::FEISTEL_MIX_EXACT:
+      return std::make_shared<ExactFeistelMixPermutation>();
+    case PermutationType::ARX_FEISTEL:
+      return std::make_shared<ArxFeistelPermutation>();
+    case PermutationType::FEISTEL_MIX_BLOCKED:
+      return std::make_shared<BlockedFeistelMixPermutation>();
     default:
       return nullptr;
   }
@@ -135,6 +163,14 @@ PermutationFactory::PermutationType PermutationFactory::GetPermutationType(
     return PermutationType::FEISTEL_NUM;
   } else if (l_perm == "mix_feistel"){
     return PermutationType::FEISTEL_MIX;
+  } else if (l_perm == "num_feistel_exact") {
+    return PermutationType::FEISTEL_NUM_EXACT;
+  } else if (l_perm == "mix_feistel_exact") {
+    return PermutationType::FEISTEL_MIX_EXACT;
+  } else if (l_perm == "arx_feistel") {
+    return PermutationType::ARX_FEISTEL;
+  } else if (l_perm == "mix_feistel_blocked") {
+    return PermutationType::FEISTEL_MIX_BLOCKED;
   } else {
     return GetDefaultPermutationType();
   }
@@ -151,6 +187,14 @@ const std::string PermutationFactory::GetPermutationName(
     return "affine64";
   } else if (permutation == PermutationType::FEISTEL_NUM) {
     return "num_feistel";
+  } else if (permutation == PermutationType::FEISTEL_NUM_EXACT) {
+    return "num_feistel_exact";
+  } else if (permutation == PermutationType::FEISTEL_MIX_EXACT) {
+    return "mix_feistel_exact";
+  } else if (permutation == PermutationType::ARX_FEISTEL) {
+    return "arx_feistel";
+  } else if (permutation == PermutationType::FEISTEL_MIX_BLOCKED) {
+    return "mix_feistel_blocked";
   } else {
     return "mix_feistel";
   }
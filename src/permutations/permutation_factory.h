@@ -29,11 +29,17 @@ public:
     AFFINE,
     AFFINE64,
     FEISTEL_NUM,
-    FEISTEL_MIX
+    FEISTEL_MIX,
+    FEISTEL_NUM_EXACT,
+    FEISTEL_MIX_EXACT,
+    ARX_FEISTEL,
+    FEISTEL_MIX_BLOCKED
   };
 
   // get vector of all permutations (each permutation once)
   static vector<std::shared_ptr<Permutation>> GetPermutations();
+  // get types of all permutations, in the order of GetPermutations
+  static vector<PermutationType> GetPermutationTypes();
   // get instance of permutation based on the code name
   static std::shared_ptr<Permutation> GetPermutation(
       const string &permutation_name);
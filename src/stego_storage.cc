@@ -13,10 +13,28 @@
 
 #include "virtual_storage/virtual_storage.h"
 #include "file_management/carrier_files_manager.h"
+#include "hash/hash.h"
+#include "hash/hash_factory.h"
+#include "utils/config.h"
 #include "utils/stego_config.h"
 
 namespace stego_disk {
 
+/**
+ * @brief Sets hash implementations selected in the configuration
+ *
+ * Keys (and everything derived from them) and the storage checksum
+ * may use different hash functions, see Hash::Purpose.
+ */
+static void ApplyHashConfig() {
+  Hash::SetHashImpl(Hash::Purpose::KEYS,
+                    HashFactory::GetHashImpl(StegoConfig::key_hash(),
+                                             SFS_KEY_HASH_LENGTH));
+  Hash::SetHashImpl(Hash::Purpose::STORAGE,
+                    HashFactory::GetHashImpl(StegoConfig::storage_hash(),
+                                             SFS_STORAGE_HASH_LENGTH));
+}
+
 StegoStorage::StegoStorage() :
   carrier_files_manager_(new CarrierFilesManager()), opened_(false) {}
 
@@ -48,6 +66,7 @@ void StegoStorage::Configure(const std::string &config_path) const {
     throw std::runtime_error("Failed to parse config file " + parse_error);
   }
   StegoConfig::Init(config);
+  ApplyHashConfig();
 }
 
 void StegoStorage::Configure() const {
@@ -58,13 +77,18 @@ void StegoStorage::Configure() const {
 
 void StegoStorage::Configure(const EncoderFactory::EncoderType encoder,
                              const PermutationFactory::PermutationType global_perm,
-                             const PermutationFactory::PermutationType local_perm) const {
+                             const PermutationFactory::PermutationType local_perm,
+                             const HashFactory::HashType key_hash,
+                             const HashFactory::HashType storage_hash) const {
 
   json::JsonObject config;
   config.AddToObject("encoder", EncoderFactory::GetEncoderName(encoder));
   config.AddToObject("global_perm", PermutationFactory::GetPermutationName(global_perm));
   config.AddToObject("local_perm",  PermutationFactory::GetPermutationName(local_perm));
+  config.AddToObject("key_hash", HashFactory::GetHashName(key_hash));
+  config.AddToObject("storage_hash", HashFactory::GetHashName(storage_hash));
   StegoConfig::Init(config);
+  ApplyHashConfig();
 }
 
 void StegoStorage::Load() {
@@ -79,6 +103,8 @@ void StegoStorage::Load() {
   try {
     carrier_files_manager_->SetEncoder(
           EncoderFactory::GetEncoder(StegoConfig::encoder()));
+    for (auto &arg : StegoConfig::encoder_args())
+      carrier_files_manager_->SetEncoderArg(arg.first, arg.second);
     carrier_files_manager_->ApplyEncoder();
 
     virtual_storage_ = std::make_shared<VirtualStorage>();
@@ -134,6 +160,20 @@ std::size_t StegoStorage::GetSize() const {
   catch (...) { throw; }
 }
 
+/**
+ * @brief Time spent in phases of Open, Load and Save, per carrier format
+ *
+ * Also reports bits modified and bytes written by the last Save
+ * (see StegoStats::ToJson for the JSON form).
+ */
+StegoStats StegoStorage::GetStats() const {
+  return carrier_files_manager_->GetStats();
+}
+
+void StegoStorage::ResetStats() const {
+  carrier_files_manager_->ResetStats();
+}
+
 void StegoStorage::ChangeEncoder(std::string &config) const {
 
   json::JsonObject json_config;
@@ -149,4 +189,28 @@ void StegoStorage::ChangeEncoder(std::string &config) const {
   catch (...) { throw; }
 }
 
+/**
+ * @brief Estimates capacities of configurations of the opened storage
+ *
+ * Only metadata read by Open are used, no carrier is decoded. Capacity
+ * of an estimate equals GetSize after Load with the same encoder and
+ * permutations (as they are set in StegoConfig), or zero when such
+ * storage can't be loaded and saved.
+ *
+ * @param[in] configs Encoders (with their parameters) and permutations
+ * @return Estimate for each configuration, in the same order
+ */
+std::vector<CapacityEstimate> StegoStorage::EstimateCapacity(
+    const std::vector<CapacityConfig> &configs) const {
+  if (!opened_)
+    throw std::runtime_error("Storage must be opened_ before estimating "
+                             "capacity");
+
+  return carrier_files_manager_->EstimateCapacity(configs);
+}
+
+std::vector<CapacityEstimate> StegoStorage::EstimateCapacity() const {
+  return EstimateCapacity(CarrierFilesManager::GetAllCapacityConfigs());
+}
+
 } // stego_disk
@@ -15,8 +15,11 @@
 #include <stdexcept>
 
 #include "encoders/encoder_factory.h"
+#include "file_management/capacity_estimate.h"
+#include "hash/hash_factory.h"
 #include "permutations/permutation_factory.h"
 #include "utils/json.h"
+#include "utils/perf_counters.h"
 
 namespace stego_disk {
 
@@ -42,12 +45,26 @@ public:
   void Configure() const;
   void Configure(const EncoderFactory::EncoderType encoder,
                  const PermutationFactory::PermutationType global_perm,
-                 const PermutationFactory::PermutationType local_perm) const;
+                 const PermutationFactory::PermutationType local_perm,
+                 const HashFactory::HashType key_hash =
+                     HashFactory::GetDefaultHashType(),
+                 const HashFactory::HashType storage_hash =
+                     HashFactory::GetDefaultHashType()) const;
 
   std::size_t GetSize() const;
 
+  // per-phase counters since construction or the last ResetStats
+  StegoStats GetStats() const;
+  void ResetStats() const;
+
   void ChangeEncoder(std::string &config) const;
 
+  // capacities of configurations of the opened storage, without Load
+  std::vector<CapacityEstimate> EstimateCapacity(
+      const std::vector<CapacityConfig> &configs) const;
+  // capacities of all encoders and permutation combinations
+  std::vector<CapacityEstimate> EstimateCapacity() const;
+
 private:
 
   std::unique_ptr<CarrierFilesManager> carrier_files_manager_;
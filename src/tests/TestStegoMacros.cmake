@@ -12,3 +12,27 @@ macro(add_stego_test NAME ENCODER PERMUTATION PASSWORD)
   )
 endmacro()
 
+
+macro(add_stego_hash_test NAME ENCODER PERMUTATION PASSWORD KEY_HASH STORAGE_HASH)
+  add_test(NAME ${NAME} COMMAND stego-test
+    --test_directory
+    --directory ${NAME}
+    --encoder ${ENCODER}
+    --permutation ${PERMUTATION}
+    --password ${PASSWORD}
+    --key_hash ${KEY_HASH}
+    --storage_hash ${STORAGE_HASH}
+  )
+endmacro()
+
+
+macro(add_stego_encoder_arg_test NAME ENCODER ENCODER_ARG PERMUTATION PASSWORD)
+  add_test(NAME ${NAME} COMMAND stego-test
+    --test_directory
+    --directory ${NAME}
+    --encoder ${ENCODER}
+    --encoder_arg ${ENCODER_ARG}
+    --permutation ${PERMUTATION}
+    --password ${PASSWORD}
+  )
+endmacro()
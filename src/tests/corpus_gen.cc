@@ -0,0 +1,86 @@
+/**
+* @file corpus_gen.cc
+* @author Martin Kosdy
+* @author Matus Kysel
+* @date 2016
+* @brief Generates a deterministic set of synthetic carrier files
+*
+*/
+
+#include <sys/stat.h>
+#include <sys/types.h>
+#ifdef _WIN32
+#include <direct.h>
+#endif
+
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+#include "corpus_generator.h"
+
+static void PrintHelp(char *name) {
+  std::cerr << "Usage: " << name << " <option(s)>\n"
+            << "Options:\n"
+            << "\t-d,--dir <DIRECTORY>\toutput directory (created if missing)\n"
+            << "\t-n,--count <N>\t\tnumber of files (default 16)\n"
+            << "\t--width <PIXELS>\twidth of images (default 1024)\n"
+            << "\t--height <PIXELS>\theight of images (default 768)\n"
+            << "\t--mix <B:P:J>\t\tweights of BMP, PNG and JPEG files (default 1:1:1)\n"
+            << "\t--quality <Q>\t\tJPEG quality (default 90)\n"
+            << "\t--seed <N>\t\tseed of image content (default 1)\n"
+            << std::endl;
+}
+
+int main(int argc, char *argv[]) {
+  CorpusSpec spec = { 16, 1024, 768, 1, 1, 1, 90, 1 };
+  std::string dir;
+
+  for (int i = 1; i < argc; ++i) {
+    std::string arg = argv[i];
+    if (arg == "-h" || arg == "--help" || i + 1 >= argc) {
+      PrintHelp(argv[0]);
+      return arg == "-h" || arg == "--help" ? 0 : -1;
+    }
+    std::string value = argv[++i];
+    if (arg == "-d" || arg == "--dir") dir = value;
+    else if (arg == "-n" || arg == "--count") spec.count = std::atoi(value.c_str());
+    else if (arg == "--width") spec.width = std::atoi(value.c_str());
+    else if (arg == "--height") spec.height = std::atoi(value.c_str());
+    else if (arg == "--quality") spec.jpeg_quality = std::atoi(value.c_str());
+    else if (arg == "--seed") spec.seed = std::strtoull(value.c_str(), nullptr, 10);
+    else if (arg == "--mix") {
+      if (sscanf(value.c_str(), "%u:%u:%u", &spec.bmp_weight, &spec.png_weight,
+                 &spec.jpg_weight) != 3) {
+        PrintHelp(argv[0]);
+        return -1;
+      }
+    } else {
+      PrintHelp(argv[0]);
+      return -1;
+    }
+  }
+
+  if (dir.empty() || spec.width == 0 || spec.height == 0) {
+    PrintHelp(argv[0]);
+    return -1;
+  }
+
+#ifdef _WIN32
+  _mkdir(dir.c_str());
+#else
+  mkdir(dir.c_str(), 0755);
+#endif
+
+  try {
+    auto files = CorpusGenerator::Generate(dir, spec);
+    std::cout << "Generated " << files.size() << " files in " << dir
+              << std::endl;
+  } catch (std::exception &e) {
+    std::cerr << "Error: " << e.what() << std::endl;
+    return -1;
+  }
+
+  return 0;
+}
@@ -0,0 +1,182 @@
+/**
+* @file corpus_generator.h
+* @author Martin Kosdy
+* @author Matus Kysel
+* @date 2016
+* @brief Deterministic generator of synthetic BMP/PNG/JPEG carriers
+*
+*/
+
+#ifndef CORPUS_GENERATOR_H
+#define CORPUS_GENERATOR_H
+
+#include <stdio.h>
+
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "lodepng.h"
+// jpeglib must be includes AFTER all precedense files
+// because in VS2010 is included BaseTsd.h, which defines INT32 type
+#include <jpeglib.h>
+
+struct CorpusSpec {
+  unsigned int count;
+  unsigned int width;
+  unsigned int height;
+  // relative weights of formats, files are assigned round-robin
+  unsigned int bmp_weight;
+  unsigned int png_weight;
+  unsigned int jpg_weight;
+  int jpeg_quality;
+  unsigned long long seed;
+};
+
+/**
+ * The CorpusGenerator class.
+ *
+ * Images are smooth gradients with pseudo-random texture, so JPEG files
+ * have realistic numbers of non-zero DCT coefficients. Content depends
+ * only on the seed and the index of the file, the same spec always
+ * produces the same corpus.
+ */
+class CorpusGenerator {
+public:
+  enum Format { BMP, PNG, JPG };
+
+  inline static std::vector<std::string> Generate(const std::string &dir,
+                                                  const CorpusSpec &spec) {
+    std::vector<Format> cycle;
+    cycle.insert(cycle.end(), spec.bmp_weight, BMP);
+    cycle.insert(cycle.end(), spec.png_weight, PNG);
+    cycle.insert(cycle.end(), spec.jpg_weight, JPG);
+    if (cycle.empty()) throw std::invalid_argument("No carrier format selected");
+
+    std::vector<std::string> files;
+    for (unsigned int i = 0; i < spec.count; ++i) {
+      std::vector<unsigned char> rgb = Image(spec, i);
+      Format format = cycle[i % cycle.size()];
+
+      char name[32];
+      snprintf(name, sizeof(name), "carrier_%06u.%s", i,
+               format == BMP ? "bmp" : (format == PNG ? "png" : "jpg"));
+      std::string path = dir + "/" + name;
+
+      if (format == BMP) WriteBmp(path, rgb, spec.width, spec.height);
+      else if (format == PNG) WritePng(path, rgb, spec.width, spec.height);
+      else WriteJpeg(path, rgb, spec.width, spec.height, spec.jpeg_quality);
+
+      files.push_back(path);
+    }
+    return files;
+  }
+
+  // RGB pixels, rows from the top
+  inline static std::vector<unsigned char> Image(const CorpusSpec &spec,
+                                                 unsigned int index) {
+    unsigned long long state = (spec.seed + index) * 0x9e3779b97f4a7c15ULL | 1;
+    std::vector<unsigned char> rgb(3ULL * spec.width * spec.height);
+    std::size_t position = 0;
+
+    for (unsigned int y = 0; y < spec.height; ++y) {
+      for (unsigned int x = 0; x < spec.width; ++x) {
+        state ^= state << 13;
+        state ^= state >> 7;
+        state ^= state << 17;
+        unsigned int base = (x * 255 / spec.width + y * 255 / spec.height +
+                             index * 37) / 2;
+        for (int c = 0; c < 3; ++c)
+          rgb[position++] = static_cast<unsigned char>(
+                              base + c * 40 + ((state >> (8 * c)) & 15));
+      }
+    }
+    return rgb;
+  }
+
+  // uncompressed 24-bit BMP, rows from the bottom, padded to 4 bytes
+  inline static void WriteBmp(const std::string &path,
+                              const std::vector<unsigned char> &rgb,
+                              unsigned int width, unsigned int height) {
+    unsigned int row_size = (3 * width + 3) & ~3U;
+    unsigned int image_size = row_size * height;
+    unsigned int file_size = 54 + image_size;
+
+    unsigned char header[54] = { 'B', 'M' };
+    PutLe(header + 2, file_size, 4);
+    PutLe(header + 10, 54, 4);
+    PutLe(header + 14, 40, 4);
+    PutLe(header + 18, width, 4);
+    PutLe(header + 22, height, 4);
+    PutLe(header + 26, 1, 2);
+    PutLe(header + 28, 24, 2);
+    PutLe(header + 34, image_size, 4);
+
+    std::vector<unsigned char> data(image_size, 0);
+    for (unsigned int y = 0; y < height; ++y) {
+      const unsigned char *source = &rgb[3ULL * width * (height - 1 - y)];
+      unsigned char *row = &data[static_cast<std::size_t>(row_size) * y];
+      for (unsigned int x = 0; x < width; ++x) {
+        row[3 * x] = source[3 * x + 2];
+        row[3 * x + 1] = source[3 * x + 1];
+        row[3 * x + 2] = source[3 * x];
+      }
+    }
+
+    FILE *file = fopen(path.c_str(), "wb");
+    if (!file) throw std::runtime_error("Unable to create file " + path);
+    bool ok = fwrite(header, 1, sizeof(header), file) == sizeof(header) &&
+              fwrite(data.data(), 1, data.size(), file) == data.size();
+    ok = (fclose(file) == 0) && ok;
+    if (!ok) throw std::runtime_error("Unable to write file " + path);
+  }
+
+  inline static void WritePng(const std::string &path,
+                              const std::vector<unsigned char> &rgb,
+                              unsigned int width, unsigned int height) {
+    if (lodepng_encode24_file(path.c_str(), rgb.data(), width, height))
+      throw std::runtime_error("Unable to write file " + path);
+  }
+
+  inline static void WriteJpeg(const std::string &path,
+                               const std::vector<unsigned char> &rgb,
+                               unsigned int width, unsigned int height,
+                               int quality) {
+    FILE *file = fopen(path.c_str(), "wb");
+    if (!file) throw std::runtime_error("Unable to create file " + path);
+
+    struct jpeg_compress_struct cinfo;
+    struct jpeg_error_mgr jerr;
+    cinfo.err = jpeg_std_error(&jerr);
+    jpeg_create_compress(&cinfo);
+    jpeg_stdio_dest(&cinfo, file);
+
+    cinfo.image_width = width;
+    cinfo.image_height = height;
+    cinfo.input_components = 3;
+    cinfo.in_color_space = JCS_RGB;
+    jpeg_set_defaults(&cinfo);
+    jpeg_set_quality(&cinfo, quality, TRUE);
+    jpeg_start_compress(&cinfo, TRUE);
+
+    while (cinfo.next_scanline < cinfo.image_height) {
+      JSAMPROW row = const_cast<JSAMPROW>(
+                       &rgb[3ULL * width * cinfo.next_scanline]);
+      jpeg_write_scanlines(&cinfo, &row, 1);
+    }
+
+    jpeg_finish_compress(&cinfo);
+    jpeg_destroy_compress(&cinfo);
+    if (fclose(file) != 0)
+      throw std::runtime_error("Unable to write file " + path);
+  }
+
+private:
+  inline static void PutLe(unsigned char *buffer, unsigned int value,
+                           int bytes) {
+    for (int i = 0; i < bytes; ++i)
+      buffer[i] = static_cast<unsigned char>(value >> (8 * i));
+  }
+};
+
+#endif // CORPUS_GENERATOR_H
@@ -0,0 +1,350 @@
+/**
+* @file macro_bench.cc
+* @author Martin Kosdy
+* @author Matus Kysel
+* @date 2016
+* @brief End-to-end benchmark: Open, Load, write N %, Save and reload
+*
+* For each phase reports wall time, CPU time of the process (all threads),
+* bytes read and written by the process, peak resident memory and wall
+* time per carrier file. Capacity estimated after Open (for all encoder
+* and permutation combinations) is checked against the loaded storage.
+*/
+
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "corpus_generator.h"
+#include "logging/logger.h"
+#include "stego_storage.h"
+#include "utils/buffer_pool.h"
+#include "utils/json.h"
+#include "utils/stego_config.h"
+#include "utils/tracer.h"
+
+using namespace stego_disk;
+
+struct ProcessCounters {
+  std::chrono::steady_clock::time_point wall;
+  double cpu_ms;
+  uint64 bytes_read;
+  uint64 bytes_written;
+  BufferPool::Stats pool;
+};
+
+// value of 'key' from /proc/self/<file>, 0 if it is not available
+static uint64 ReadProcValue(const std::string &file, const std::string &key) {
+  std::ifstream in("/proc/self/" + file);
+  std::string name;
+  uint64 value;
+  while (in >> name >> value) {
+    if (name == key) return value;
+    in.ignore(256, '\n');
+  }
+  return 0;
+}
+
+static ProcessCounters ReadCounters() {
+  struct rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+
+  ProcessCounters counters;
+  counters.wall = std::chrono::steady_clock::now();
+  counters.cpu_ms = (usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * 1e3 +
+                    (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e3;
+  // bytes passed by read/write calls, including those served by page cache
+  counters.bytes_read = ReadProcValue("io", "rchar:");
+  counters.bytes_written = ReadProcValue("io", "wchar:");
+  counters.pool = BufferPool::GetStats();
+  return counters;
+}
+
+// resets peak RSS of the process (Linux), so it can be reported per phase
+static void ResetPeakRss() {
+  std::ofstream clear_refs("/proc/self/clear_refs");
+  clear_refs << "5";
+}
+
+static uint64 PeakRssKb() {
+  uint64 peak = ReadProcValue("status", "VmHWM:");
+  if (peak) return peak;
+
+  struct rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+  return usage.ru_maxrss;
+}
+
+class PhaseReport {
+public:
+  PhaseReport() : carriers_(0), phases_(json::JsonObject::ARRAY) {
+    std::cout << std::left << std::setw(10) << "phase" << std::right
+              << std::setw(12) << "wall[ms]" << std::setw(12) << "cpu[ms]"
+              << std::setw(14) << "read[B]" << std::setw(14) << "written[B]"
+              << std::setw(14) << "peak rss[kB]"
+              << std::setw(16) << "carrier[us]" << std::endl;
+  }
+
+  // number of carriers, known after the first phase
+  void SetCarriers(uint64 carriers) { carriers_ = carriers; }
+
+  void Begin() {
+    ResetPeakRss();
+    start_ = ReadCounters();
+  }
+
+  void End(const std::string &name) {
+    ProcessCounters end = ReadCounters();
+    double wall_ms = std::chrono::duration<double, std::milli>(
+                       end.wall - start_.wall).count();
+    uint64 bytes_read = end.bytes_read - start_.bytes_read;
+    uint64 bytes_written = end.bytes_written - start_.bytes_written;
+    uint64 peak_rss = PeakRssKb();
+    double per_carrier_us = carriers_ ? wall_ms * 1000 / carriers_ : 0;
+
+    std::cout << std::left << std::setw(10) << name << std::right
+              << std::fixed << std::setprecision(1)
+              << std::setw(12) << wall_ms
+              << std::setw(12) << end.cpu_ms - start_.cpu_ms
+              << std::setw(14) << bytes_read << std::setw(14) << bytes_written
+              << std::setw(14) << peak_rss
+              << std::setw(16) << per_carrier_us << std::endl;
+
+    json::JsonObject phase;
+    phase["phase"] = json::JsonObject(name);
+    phase["wall_ms"] = Number(wall_ms);
+    phase["cpu_ms"] = Number(end.cpu_ms - start_.cpu_ms);
+    phase["bytes_read"] = Number(static_cast<double>(bytes_read));
+    phase["bytes_written"] = Number(static_cast<double>(bytes_written));
+    phase["peak_rss_kb"] = Number(static_cast<double>(peak_rss));
+    phase["per_carrier_us"] = Number(per_carrier_us);
+    // MemoryBuffer allocations, and those served by BufferPool caches
+    phase["buffer_allocations"] = Number(static_cast<double>(
+                                    end.pool.allocations - start_.pool.allocations));
+    phase["buffer_reused"] = Number(static_cast<double>(
+                               end.pool.reused - start_.pool.reused));
+    phases_.AddToArray(phase);
+  }
+
+  const json::JsonObject& GetPhases() const { return phases_; }
+
+  static json::JsonObject Number(double value) {
+    json::JsonObject object;
+    object.Assign(value);
+    return object;
+  }
+
+private:
+  ProcessCounters start_;
+  uint64 carriers_;
+  json::JsonObject phases_;
+};
+
+static void PrintHelp(char *name) {
+  std::cerr << "Usage: " << name << " <option(s)>\n"
+            << "Options:\n"
+            << "\t-d,--dir <DIRECTORY>\tcarrier files (modified by the benchmark)\n"
+            << "\t-p,--password <PASSWORD>\tpassword of the storage\n"
+            << "\t-e,--encoder <NAME>\tencoder (lsb, hamming)\n"
+            << "\t--permutation <NAME>\tpermutation (e.g. mix_feistel)\n"
+            << "\t--write-percent <N>\tpart of the storage written (default 10)\n"
+            << "\t-o,--out <FILE>\t\twrite JSON report to file\n"
+            << "\t--trace <FILE>\t\twrite Chrome trace of all phases to file\n"
+            << "\t--generate\t\tgenerate corpus into the directory first, with:\n"
+            << "\t  -n,--count <N> --width <PIXELS> --height <PIXELS>\n"
+            << "\t  --mix <B:P:J> --quality <Q> --seed <N>\n"
+            << "\t\t\t\t(same meaning as in stego-corpus-gen)\n"
+            << std::endl;
+}
+
+int main(int argc, char *argv[]) {
+  std::string logging_level("ERROR");
+  Logger::SetVerbosityLevel(logging_level, std::string("cout"));
+
+  std::string dir, password = "heslo", out_path, trace_path;
+  std::string encoder = "hamming", permutation = "mix_feistel";
+  double write_percent = 10;
+  bool generate = false;
+  CorpusSpec spec = { 16, 1024, 768, 1, 1, 1, 90, 1 };
+
+  for (int i = 1; i < argc; ++i) {
+    std::string arg = argv[i];
+    if (arg == "--generate") {
+      generate = true;
+      continue;
+    }
+    if (arg == "-h" || arg == "--help" || i + 1 >= argc) {
+      PrintHelp(argv[0]);
+      return arg == "-h" || arg == "--help" ? 0 : -1;
+    }
+    std::string value = argv[++i];
+    if (arg == "-d" || arg == "--dir") dir = value;
+    else if (arg == "-p" || arg == "--password") password = value;
+    else if (arg == "-e" || arg == "--encoder") encoder = value;
+    else if (arg == "--permutation") permutation = value;
+    else if (arg == "--write-percent") write_percent = std::atof(value.c_str());
+    else if (arg == "-o" || arg == "--out") out_path = value;
+    else if (arg == "--trace") trace_path = value;
+    else if (arg == "-n" || arg == "--count") spec.count = std::atoi(value.c_str());
+    else if (arg == "--width") spec.width = std::atoi(value.c_str());
+    else if (arg == "--height") spec.height = std::atoi(value.c_str());
+    else if (arg == "--quality") spec.jpeg_quality = std::atoi(value.c_str());
+    else if (arg == "--seed") spec.seed = std::strtoull(value.c_str(), nullptr, 10);
+    else if (arg == "--mix") {
+      if (sscanf(value.c_str(), "%u:%u:%u", &spec.bmp_weight, &spec.png_weight,
+                 &spec.jpg_weight) != 3) {
+        PrintHelp(argv[0]);
+        return -1;
+      }
+    } else {
+      PrintHelp(argv[0]);
+      return -1;
+    }
+  }
+
+  if (dir.empty() || write_percent < 0 || write_percent > 100) {
+    PrintHelp(argv[0]);
+    return -1;
+  }
+
+  try {
+    if (generate) {
+      mkdir(dir.c_str(), 0755);
+      CorpusGenerator::Generate(dir, spec);
+    }
+
+    auto encoder_type = EncoderFactory::GetEncoderType(encoder);
+    auto permutation_type = PermutationFactory::GetPermutationType(permutation);
+
+    if (!trace_path.empty()) {
+      Tracer::SetThreadName("main");
+      Tracer::Start();
+    }
+
+    PhaseReport report;
+    std::string input, output;
+    uint64 storage_size;
+    uint64 carriers = 0;
+    uint64 estimated_size = 0, estimate_configs = 0;
+    double estimate_ms = 0;
+    json::JsonObject stats;
+
+    {
+      std::unique_ptr<StegoStorage> storage(new StegoStorage());
+      storage->Configure(encoder_type, permutation_type, permutation_type);
+
+      report.Begin();
+      storage->Open(dir, password);
+      StegoStats open_stats = storage->GetStats();
+      for (int format = 0; format < StegoStats::FORMAT_COUNT; ++format)
+        carriers += open_stats.formats[format].carriers;
+      report.SetCarriers(carriers);
+      report.End("open");
+
+      auto estimate_start = std::chrono::steady_clock::now();
+      auto estimates = storage->EstimateCapacity();
+      estimate_ms = std::chrono::duration<double, std::milli>(
+                      std::chrono::steady_clock::now() - estimate_start).count();
+      estimate_configs = estimates.size();
+
+      // permutations as loaded by StegoConfig (Configure stores the global
+      // one under a key it doesn't read, the default is used instead)
+      auto configured = EncoderFactory::GetEncoder(encoder_type);
+      for (auto &estimate : estimates) {
+        const CapacityConfig &config = estimate.config;
+        if (config.encoder->GetNameInstance() == configured->GetNameInstance() &&
+            config.encoder->GetDataBlockSize() == configured->GetDataBlockSize() &&
+            config.encoder->GetCodewordBlockSize() ==
+            configured->GetCodewordBlockSize() &&
+            config.global_permutation == StegoConfig::global_perm() &&
+            config.local_permutation == StegoConfig::local_perm())
+          estimated_size = estimate.capacity;
+      }
+
+      report.Begin();
+      storage->Load();
+      report.End("load");
+
+      storage_size = storage->GetSize();
+      if (estimated_size != storage_size)
+        throw std::runtime_error("estimated capacity " +
+                                 std::to_string(estimated_size) +
+                                 " differs from storage size " +
+                                 std::to_string(storage_size));
+      input.resize(static_cast<std::size_t>(storage_size * write_percent / 100));
+      for (std::size_t i = 0; i < input.size(); ++i)
+        input[i] = static_cast<char>(i * 131 + (i >> 11));
+
+      report.Begin();
+      if (!input.empty()) storage->Write(&input[0], 0, input.size());
+      report.End("write");
+
+      report.Begin();
+      storage->Save();
+      report.End("save");
+
+      stats = storage->GetStats().ToJson();
+    }
+
+    {
+      std::unique_ptr<StegoStorage> storage(new StegoStorage());
+      storage->Configure(encoder_type, permutation_type, permutation_type);
+
+      report.Begin();
+      storage->Open(dir, password);
+      storage->Load();
+      output.resize(input.size());
+      if (!output.empty()) storage->Read(&output[0], 0, output.size());
+      report.End("reload");
+    }
+
+    if (input != output) {
+      std::cerr << "Error: data read after reload differ from written data"
+                << std::endl;
+      return -1;
+    }
+
+    if (!trace_path.empty()) {
+      Tracer::Stop();
+      if (!Tracer::WriteJson(trace_path))
+        throw std::runtime_error("Unable to write trace to " + trace_path);
+    }
+
+    std::cout << "storage " << storage_size << "B, written " << input.size()
+              << "B, " << encoder << "/" << permutation << std::endl;
+    std::cout << "capacity of " << estimate_configs << " configurations "
+              << "estimated in " << estimate_ms << " ms" << std::endl;
+
+    if (!out_path.empty()) {
+      json::JsonObject json_report;
+      json_report["suite"] = json::JsonObject("stego-macro-bench");
+      json_report["encoder"] = json::JsonObject(encoder);
+      json_report["permutation"] = json::JsonObject(permutation);
+      json_report["carriers"] = PhaseReport::Number(static_cast<double>(carriers));
+      json_report["storage_size"] = PhaseReport::Number(static_cast<double>(storage_size));
+      json_report["bytes_written_to_storage"] = PhaseReport::Number(static_cast<double>(input.size()));
+      json_report["phases"] = report.GetPhases();
+      json_report["storage_stats"] = stats;
+      json_report["estimate"]["configs"] = PhaseReport::Number(static_cast<double>(estimate_configs));
+      json_report["estimate"]["ms"] = PhaseReport::Number(estimate_ms);
+
+      std::ofstream out(out_path);
+      out << json_report.PrettySerialize() << std::endl;
+    }
+  } catch (std::exception &e) {
+    std::cerr << "Error: " << e.what() << std::endl;
+    return -1;
+  }
+
+  return 0;
+}
@@ -0,0 +1,322 @@
+/**
+* @file nbd_bench.cc
+* @author Martin Kosdy
+* @author Matus Kysel
+* @date 2016
+* @brief Throughput of the NBD export compared with the FUSE file
+*
+* --socket PATH  local NBD client connected to stego_nbd, requests are
+*                pipelined up to --depth and replies matched by handles
+* --file PATH    pwrite/pread on the file exposed by stego_fuse
+*                (e.g. /tmp/stego_fuse/virtualdisc.iso); given twice it
+*                compares FuseService with FuseLowlevelService (stego_fuse -l)
+*/
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "utils/stego_types.h"
+
+using namespace stego_disk;
+
+static const uint64 kOptionMagic = 0x49484156454F5054ULL;
+static const uint64 kReplyMagic = 0x3e889045565a9ULL;
+static const uint32 kRequestMagic = 0x25609513;
+static const uint32 kSimpleReplyMagic = 0x67446698;
+static const uint32 kOptGo = 7;
+static const uint32 kRepAck = 1;
+static const uint32 kRepInfo = 3;
+static const uint16 kCmdRead = 0;
+static const uint16 kCmdWrite = 1;
+static const uint16 kCmdDisc = 2;
+static const uint16 kCmdFlush = 3;
+
+struct BenchParams {
+  uint64 total;
+  uint32 request;
+  unsigned int depth;
+};
+
+static void PutUint16(uint8 *buffer, uint16 value) {
+  buffer[0] = static_cast<uint8>(value >> 8);
+  buffer[1] = static_cast<uint8>(value);
+}
+
+static void PutUint32(uint8 *buffer, uint32 value) {
+  for (int i = 0; i < 4; ++i)
+    buffer[i] = static_cast<uint8>(value >> (24 - 8 * i));
+}
+
+static void PutUint64(uint8 *buffer, uint64 value) {
+  for (int i = 0; i < 8; ++i)
+    buffer[i] = static_cast<uint8>(value >> (56 - 8 * i));
+}
+
+static uint64 GetUint(const uint8 *buffer, int bytes) {
+  uint64 value = 0;
+  for (int i = 0; i < bytes; ++i)
+    value = (value << 8) | buffer[i];
+  return value;
+}
+
+static void ReceiveAll(int fd, void *buffer, std::size_t length) {
+  uint8 *position = static_cast<uint8 *>(buffer);
+  while (length > 0) {
+    ssize_t received = recv(fd, position, length, 0);
+    if (received < 0 && errno == EINTR) continue;
+    if (received <= 0) throw std::runtime_error("connection closed");
+    position += received;
+    length -= static_cast<std::size_t>(received);
+  }
+}
+
+static void SendAll(int fd, const void *buffer, std::size_t length) {
+  const uint8 *position = static_cast<const uint8 *>(buffer);
+  while (length > 0) {
+    ssize_t sent = send(fd, position, length, 0);
+    if (sent < 0 && errno == EINTR) continue;
+    if (sent <= 0) throw std::runtime_error("connection closed");
+    position += sent;
+    length -= static_cast<std::size_t>(sent);
+  }
+}
+
+static uint8 Pattern(uint64 position) {
+  return static_cast<uint8>((position * 131) ^ (position >> 9));
+}
+
+static double MegabytesPerSecond(uint64 bytes,
+                                 std::chrono::steady_clock::time_point start) {
+  double seconds = std::chrono::duration<double>(
+                     std::chrono::steady_clock::now() - start).count();
+  return bytes / seconds / (1 << 20);
+}
+
+/**
+ * @brief Fixed newstyle handshake with NBD_OPT_GO
+ *
+ * @return Size of the export
+ */
+static uint64 NbdHandshake(int fd) {
+  uint8 greeting[18];
+  ReceiveAll(fd, greeting, sizeof(greeting));
+  if (GetUint(greeting + 8, 8) != kOptionMagic)
+    throw std::runtime_error("server is not fixed newstyle");
+
+  uint8 flags[4];
+  PutUint32(flags, 3);  // FIXED_NEWSTYLE | NO_ZEROES
+  SendAll(fd, flags, sizeof(flags));
+
+  uint8 option[16 + 6];
+  PutUint64(option, kOptionMagic);
+  PutUint32(option + 8, kOptGo);
+  PutUint32(option + 12, 6);
+  PutUint32(option + 16, 0);  // empty export name
+  PutUint16(option + 20, 0);  // no information requests
+  SendAll(fd, option, sizeof(option));
+
+  uint64 size = 0;
+  while (true) {
+    uint8 reply[20];
+    ReceiveAll(fd, reply, sizeof(reply));
+    if (GetUint(reply, 8) != kReplyMagic)
+      throw std::runtime_error("wrong option reply");
+    uint32 type = static_cast<uint32>(GetUint(reply + 12, 4));
+    uint32 length = static_cast<uint32>(GetUint(reply + 16, 4));
+    std::vector<uint8> data(length);
+    if (length) ReceiveAll(fd, data.data(), length);
+
+    if (type == kRepAck) return size;
+    if (type != kRepInfo)
+      throw std::runtime_error("NBD_OPT_GO refused");
+    if (length >= 10 && GetUint(data.data(), 2) == 0)
+      size = GetUint(data.data() + 2, 8);
+  }
+}
+
+static void NbdRequest(int fd, uint16 type, uint64 handle, uint64 offset,
+                       uint32 length, const uint8 *data) {
+  uint8 request[28];
+  PutUint32(request, kRequestMagic);
+  PutUint16(request + 4, 0);
+  PutUint16(request + 6, type);
+  PutUint64(request + 8, handle);
+  PutUint64(request + 16, offset);
+  PutUint32(request + 24, length);
+  SendAll(fd, request, sizeof(request));
+  if (type == kCmdWrite) SendAll(fd, data, length);
+}
+
+/**
+ * @brief Receives one simple reply, data of READ replies are stored
+ *        into 'buffer' at the offset of the request
+ */
+static void NbdReply(int fd, std::map<uint64, uint64> &pending,
+                     uint32 length, bool read, std::vector<uint8> &buffer) {
+  uint8 reply[16];
+  ReceiveAll(fd, reply, sizeof(reply));
+  if (GetUint(reply, 4) != kSimpleReplyMagic)
+    throw std::runtime_error("wrong reply magic");
+  if (GetUint(reply + 4, 4) != 0)
+    throw std::runtime_error("request failed with error " +
+                             std::to_string(GetUint(reply + 4, 4)));
+
+  auto it = pending.find(GetUint(reply + 8, 8));
+  if (it == pending.end()) throw std::runtime_error("unknown handle");
+  if (read) ReceiveAll(fd, buffer.data() + it->second, length);
+  pending.erase(it);
+}
+
+static void BenchNbd(const std::string &socket_path, BenchParams params) {
+  int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  struct sockaddr_un address;
+  memset(&address, 0, sizeof(address));
+  address.sun_family = AF_UNIX;
+  strncpy(address.sun_path, socket_path.c_str(), sizeof(address.sun_path) - 1);
+  if (fd < 0 || connect(fd, reinterpret_cast<struct sockaddr *>(&address),
+                        sizeof(address)) < 0)
+    throw std::runtime_error("cannot connect to " + socket_path);
+
+  uint64 size = NbdHandshake(fd);
+  uint64 total = std::min(params.total, size - size % params.request);
+  if (total == 0) throw std::runtime_error("export is smaller than request");
+  std::cout << "nbd: export size " << size << "B, " << total << "B in "
+            << params.request << "B requests, depth " << params.depth
+            << std::endl;
+
+  std::vector<uint8> data(total);
+  for (uint64 i = 0; i < total; ++i)
+    data[i] = Pattern(i);
+  std::vector<uint8> readback(total);
+
+  for (int pass = 0; pass < 2; ++pass) {
+    bool read = pass == 1;
+    std::map<uint64, uint64> pending;
+    uint64 handle = 0;
+
+    auto start = std::chrono::steady_clock::now();
+    for (uint64 offset = 0; offset < total; offset += params.request) {
+      if (pending.size() >= params.depth)
+        NbdReply(fd, pending, params.request, read, readback);
+      pending[++handle] = offset;
+      NbdRequest(fd, read ? kCmdRead : kCmdWrite, handle, offset,
+                 params.request, data.data() + offset);
+    }
+    while (!pending.empty())
+      NbdReply(fd, pending, params.request, read, readback);
+
+    if (!read) {
+      pending[++handle] = 0;
+      NbdRequest(fd, kCmdFlush, handle, 0, 0, nullptr);
+      NbdReply(fd, pending, 0, false, readback);
+    }
+
+    std::cout << (read ? "  read  " : "  write+flush ") << std::fixed
+              << std::setprecision(1) << MegabytesPerSecond(total, start)
+              << " MB/s" << std::endl;
+  }
+
+  NbdRequest(fd, kCmdDisc, 0, 0, 0, nullptr);
+  close(fd);
+
+  if (readback != data)
+    throw std::runtime_error("data read over NBD differ from written data");
+}
+
+static void BenchFile(const std::string &path, BenchParams params) {
+  int fd = open(path.c_str(), O_RDWR);
+  if (fd < 0) throw std::runtime_error("cannot open " + path);
+
+  off_t size = lseek(fd, 0, SEEK_END);
+  uint64 total = std::min<uint64>(params.total, size - size % params.request);
+  if (total == 0) throw std::runtime_error("file is smaller than request");
+  std::cout << "file: size " << size << "B, " << total << "B in "
+            << params.request << "B requests" << std::endl;
+
+  std::vector<uint8> data(total);
+  for (uint64 i = 0; i < total; ++i)
+    data[i] = Pattern(i);
+  std::vector<uint8> readback(total);
+
+  auto start = std::chrono::steady_clock::now();
+  for (uint64 offset = 0; offset < total; offset += params.request)
+    if (pwrite(fd, data.data() + offset, params.request, offset) !=
+        static_cast<ssize_t>(params.request))
+      throw std::runtime_error("pwrite failed");
+  fsync(fd);
+  std::cout << "  write+fsync " << std::fixed << std::setprecision(1)
+            << MegabytesPerSecond(total, start) << " MB/s" << std::endl;
+
+  start = std::chrono::steady_clock::now();
+  for (uint64 offset = 0; offset < total; offset += params.request)
+    if (pread(fd, readback.data() + offset, params.request, offset) !=
+        static_cast<ssize_t>(params.request))
+      throw std::runtime_error("pread failed");
+  std::cout << "  read  " << std::fixed << std::setprecision(1)
+            << MegabytesPerSecond(total, start) << " MB/s" << std::endl;
+
+  close(fd);
+
+  if (readback != data)
+    throw std::runtime_error("data read from file differ from written data");
+}
+
+static void PrintHelp(char *name) {
+  std::cerr << "Usage: " << name << " <option(s)>\n"
+            << "\t--socket <PATH>\tbenchmark NBD server on UNIX socket\n"
+            << "\t--file <PATH>\tbenchmark file exposed by FUSE\n"
+            << "\t--size <MB>\tamount of data (default 16)\n"
+            << "\t--request <KB>\trequest size (default 128)\n"
+            << "\t--depth <N>\tNBD requests in flight (default 8)\n"
+            << std::endl;
+}
+
+int main(int argc, char *argv[]) {
+  std::vector<std::string> sockets, files;
+  BenchParams params = { 16ULL << 20, 128 << 10, 8 };
+
+  for (int i = 1; i + 1 < argc; i += 2) {
+    std::string arg = argv[i];
+    if (arg == "--socket") sockets.push_back(argv[i + 1]);
+    else if (arg == "--file") files.push_back(argv[i + 1]);
+    else if (arg == "--size") params.total = std::strtoull(argv[i + 1], nullptr, 10) << 20;
+    else if (arg == "--request") params.request = static_cast<uint32>(std::strtoul(argv[i + 1], nullptr, 10) << 10);
+    else if (arg == "--depth") params.depth = static_cast<unsigned int>(std::strtoul(argv[i + 1], nullptr, 10));
+    else {
+      PrintHelp(argv[0]);
+      return -1;
+    }
+  }
+
+  if ((sockets.empty() && files.empty()) || params.request == 0 ||
+      params.depth == 0) {
+    PrintHelp(argv[0]);
+    return -1;
+  }
+
+  try {
+    for (auto &socket_path : sockets)
+      BenchNbd(socket_path, params);
+    for (auto &path : files)
+      BenchFile(path, params);
+  } catch (std::exception &e) {
+    std::cerr << "Error: " << e.what() << std::endl;
+    return -1;
+  }
+
+  return 0;
+}
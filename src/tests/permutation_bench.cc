@@ -0,0 +1,239 @@
+/**
+* @file permutation_bench.cc
+* @author Martin Kosdy
+* @author Matus Kysel
+* @date 2016
+* @brief Benchmark of exact-size, table-free and blocked permutations
+*
+*/
+
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "carrier_files/carrier_kernel.h"
+#include "encoders/lsb_encoder.h"
+#include "keys/key.h"
+#include "logging/logger.h"
+#include "permutations/arx_feistel_permutation.h"
+#include "permutations/cycle_walking_permutation.h"
+#include "permutations/feistel_mix_permutation.h"
+#include "permutations/identity_permutation.h"
+#include "permutations/permutation_factory.h"
+#include "utils/stego_math.h"
+#include "virtual_storage/virtual_storage.h"
+
+using namespace stego_disk;
+
+// maximal number of elements permuted by each measurement
+static const uint64 kMaxSamples = 1 << 22;
+
+// keeps results of measured code alive
+static volatile uint64 sink;
+
+/**
+ * @brief Measures average time of Permute over the first elements
+ *
+ * @return Nanoseconds per element
+ */
+static double MeasurePermute(const Permutation &permutation) {
+  uint64 count = permutation.GetSize();
+  if (count > kMaxSamples) count = kMaxSamples;
+
+  uint64 checksum = 0;
+  auto start = std::chrono::steady_clock::now();
+  for (uint64 i = 0; i < count; ++i)
+    checksum += permutation.Permute(i);
+  auto end = std::chrono::steady_clock::now();
+
+  sink = checksum;
+
+  return std::chrono::duration<double, std::nano>(end - start).count() / count;
+}
+
+template <class ExactPermutation>
+static void Bench(const std::string &name,
+                  PermutationFactory::PermutationType base_type,
+                  PermElem requested_size, Key &key) {
+  std::shared_ptr<Permutation> base = PermutationFactory::GetPermutation(base_type);
+  ExactPermutation exact;
+
+  if (base->GetSizeUsingParams(requested_size, key) == 0) {
+    std::cout << std::left << std::setw(12) << name << std::right
+              << std::setw(14) << requested_size
+              << "  size is not supported" << std::endl;
+    return;
+  }
+
+  base->Init(requested_size, key);
+  exact.Init(requested_size, key);
+
+  double base_ns = MeasurePermute(*base);
+  double exact_ns = MeasurePermute(exact);
+  double walk = static_cast<double>(exact.GetDomainSize()) / exact.GetSize();
+
+  std::cout << std::left << std::setw(12) << name << std::right
+            << std::setw(14) << requested_size
+            << std::setw(10) << std::fixed << std::setprecision(3)
+            << 100.0 * (requested_size - base->GetSize()) / requested_size
+            << std::setw(10) << walk
+            << std::setw(10) << std::setprecision(2) << base_ns
+            << std::setw(10) << exact_ns << std::endl;
+}
+
+/**
+ * @brief Measures average time of ArxFeistelPermutation::PermuteRange
+ *
+ * @return Nanoseconds per element
+ */
+static double MeasurePermuteRange(const ArxFeistelPermutation &permutation) {
+  uint64 count = permutation.GetSize();
+  if (count > kMaxSamples) count = kMaxSamples;
+
+  std::vector<PermElem> values(count);
+  auto start = std::chrono::steady_clock::now();
+  permutation.PermuteRange(0, count, values.data());
+  auto end = std::chrono::steady_clock::now();
+
+  sink = values[count / 2];
+
+  return std::chrono::duration<double, std::nano>(end - start).count() / count;
+}
+
+template <class PermutationType>
+static double MeasureInit(PermutationType &permutation,
+                          PermElem requested_size, Key &key) {
+  auto start = std::chrono::steady_clock::now();
+  permutation.Init(requested_size, key);
+  auto end = std::chrono::steady_clock::now();
+  return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+// Compares table-free ARX permutation with FeistelMixPermutation
+// of the same domain: init time, memory and throughput
+static void BenchArx(PermElem requested_size, Key &key) {
+  ArxFeistelPermutation arx;
+  FeistelMixPermutation mix;
+
+  if (mix.GetSizeUsingParams(requested_size, key) == 0) {
+    std::cout << std::setw(14) << requested_size
+              << "  size is not supported" << std::endl;
+    return;
+  }
+
+  double arx_init = MeasureInit(arx, requested_size, key);
+  double mix_init = MeasureInit(mix, requested_size, key);
+
+  // round tables of FeistelMixPermutation, 2^right_bits entries each
+  uint8 bit_len = StegoMath::Log2(requested_size);
+  uint64 mix_memory = (static_cast<uint64>(FMP_NUMROUNDS) * sizeof(uint32))
+                      << (bit_len - bit_len / 2);
+
+  std::cout << std::setw(14) << requested_size
+            << std::fixed << std::setprecision(2)
+            << std::setw(12) << arx_init << std::setw(12) << mix_init
+            << std::setw(10) << sizeof(ArxFeistelPermutation)
+            << std::setw(12) << mix_memory
+            << std::setw(10) << MeasurePermute(arx)
+            << std::setw(10) << MeasurePermuteRange(arx)
+            << std::setw(10) << MeasurePermute(mix) << std::endl;
+}
+
+/**
+ * @brief Measures embedding and extraction of the storage by carrier kernel
+ *
+ * LSB encoder and identity local permutation, so the time is dominated
+ * by accesses to the storage through the global permutation.
+ */
+static void BenchStorage(PermutationFactory::PermutationType type,
+                         uint64 storage_size, Key &key) {
+  std::shared_ptr<VirtualStorage> storage = std::make_shared<VirtualStorage>();
+  storage->SetPermutation(PermutationFactory::GetPermutation(type));
+  storage->ApplyPermutation(storage_size, key);
+
+  std::shared_ptr<Permutation> local = std::make_shared<IdentityPermutation>();
+  CarrierKernel kernel(std::make_shared<LsbEncoder>(), local, storage);
+
+  uint64 bytes = storage->GetRawCapacity();
+  std::vector<uint8> codewords(bytes);
+
+  auto start = std::chrono::steady_clock::now();
+  kernel.EmbedBlocks(codewords.data(), bytes, 0, bytes);
+  auto middle = std::chrono::steady_clock::now();
+  kernel.ExtractBlocks(codewords.data(), bytes, 0, bytes);
+  auto end = std::chrono::steady_clock::now();
+
+  std::cout << std::left << std::setw(22)
+            << PermutationFactory::GetPermutationName(type) << std::right
+            << std::setw(14) << bytes << std::fixed << std::setprecision(2)
+            << std::setw(10)
+            << std::chrono::duration<double, std::nano>(middle - start).count() / bytes
+            << std::setw(10)
+            << std::chrono::duration<double, std::nano>(end - middle).count() / bytes
+            << std::endl;
+}
+
+int main(int argc, char *argv[]) {
+  std::string logging_level("ERROR");
+  Logger::SetVerbosityLevel(logging_level, std::string("cout"));
+
+  std::vector<PermElem> sizes = { 1000003, (1 << 20) + 1, 3 * (1 << 20) - 1,
+                                  12345678, 100000007 };
+  for (int i = 1; i < argc; ++i)
+    sizes.push_back(std::strtoull(argv[i], nullptr, 10));
+
+  MemoryBuffer key_data(32);
+  for (std::size_t i = 0; i < key_data.GetSize(); ++i)
+    key_data[i] = static_cast<uint8>(i * 7 + 1);
+  Key key(key_data);
+
+  // lost: capacity lost by the truncating permutation (%)
+  // walk: average number of steps of the exact permutation
+  std::cout << std::left << std::setw(12) << "permutation" << std::right
+            << std::setw(14) << "size" << std::setw(10) << "lost[%]"
+            << std::setw(10) << "walk" << std::setw(10) << "base[ns]"
+            << std::setw(10) << "exact[ns]" << std::endl;
+
+  for (PermElem size : sizes) {
+    Bench<ExactFeistelMixPermutation>("mix_feistel",
+                                      PermutationFactory::PermutationType::FEISTEL_MIX,
+                                      size, key);
+    Bench<ExactFeistelNumPermutation>("num_feistel",
+                                      PermutationFactory::PermutationType::FEISTEL_NUM,
+                                      size, key);
+  }
+
+  std::vector<PermElem> arx_sizes = { 1ULL << 20, 1ULL << 26, 1ULL << 32,
+                                      1ULL << 36 };
+  for (int i = 1; i < argc; ++i)
+    arx_sizes.push_back(std::strtoull(argv[i], nullptr, 10));
+
+  // init in ms, memory in bytes, time per element in ns
+  std::cout << std::endl << std::setw(14) << "size"
+            << std::setw(12) << "arx init" << std::setw(12) << "mix init"
+            << std::setw(10) << "arx mem" << std::setw(12) << "mix mem"
+            << std::setw(10) << "arx" << std::setw(10) << "arx range"
+            << std::setw(10) << "mix" << std::endl;
+
+  for (PermElem size : arx_sizes)
+    BenchArx(size, key);
+
+  // time per byte of the storage in ns
+  std::cout << std::endl << std::left << std::setw(22) << "global permutation"
+            << std::right << std::setw(14) << "storage"
+            << std::setw(10) << "embed" << std::setw(10) << "extract"
+            << std::endl;
+
+  for (uint64 storage_size : { 1ULL << 24, 1ULL << 30 }) {
+    BenchStorage(PermutationFactory::PermutationType::FEISTEL_MIX,
+                 storage_size, key);
+    BenchStorage(PermutationFactory::PermutationType::FEISTEL_MIX_BLOCKED,
+                 storage_size, key);
+  }
+
+  return 0;
+}
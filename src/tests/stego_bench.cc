@@ -0,0 +1,456 @@
+/**
+* @file stego_bench.cc
+* @author Martin Kosdy
+* @author Matus Kysel
+* @date 2016
+* @brief Micro-benchmarks of encoders, permutations, hashes, memory buffers
+*        and fitness, results are written as JSON
+*
+* Each result is an object { "group", "name", "params", "metrics" }, so runs
+* of two builds can be compared by matching group, name and params.
+*/
+
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "carrier_files/carrier_file.h"
+#include "encoders/encoder_factory.h"
+#include "encoders/hamming_encoder.h"
+#include "fitness/context_fitness.h"
+#include "hash/hash.h"
+#include "hash/hash_factory.h"
+#include "keys/key.h"
+#include "logging/logger.h"
+#include "permutations/permutation_factory.h"
+#include "utils/json.h"
+#include "utils/memory_buffer.h"
+
+using namespace stego_disk;
+
+struct BenchOptions {
+  double min_time_ns;
+  uint8 min_bits;
+  uint8 max_bits;
+  uint8 step_bits;
+  std::string filter;
+};
+
+// maximal number of elements permuted by each measurement
+static const uint64 kMaxPermuteSamples = 1 << 20;
+
+static BenchOptions options = { 2e8, 10, 34, 4, "" };
+static json::JsonObject results(json::JsonObject::ARRAY);
+
+// keeps results of measured code alive
+static volatile uint64 sink;
+
+/**
+ * @brief Runs 'body' repeatedly for at least options.min_time_ns
+ *
+ * @return Average nanoseconds per run
+ */
+template <class Body>
+static double TimeRuns(Body body) {
+  body();  // warm up
+
+  uint64 runs = 0;
+  double elapsed = 0;
+  auto start = std::chrono::steady_clock::now();
+  do {
+    body();
+    ++runs;
+    elapsed = std::chrono::duration<double, std::nano>(
+                std::chrono::steady_clock::now() - start).count();
+  } while (elapsed < options.min_time_ns);
+
+  return elapsed / runs;
+}
+
+static json::JsonObject Number(double value) {
+  json::JsonObject object;
+  object.Assign(value);
+  return object;
+}
+
+static double MegabytesPerSecond(uint64 bytes, double ns) {
+  return bytes / ns * 1e9 / (1 << 20);
+}
+
+static bool Selected(const std::string &group, const std::string &name) {
+  return options.filter.empty() ||
+         group.find(options.filter) != std::string::npos ||
+         name.find(options.filter) != std::string::npos;
+}
+
+static void AddResult(const std::string &group, const std::string &name,
+                      const json::JsonObject &params,
+                      const json::JsonObject &metrics) {
+  json::JsonObject result;
+  result["group"] = json::JsonObject(group);
+  result["name"] = json::JsonObject(name);
+  result["params"] = params;
+  result["metrics"] = metrics;
+  results.AddToArray(result);
+
+  std::cerr << group << " " << name << " " << params.Serialize() << " "
+            << metrics.Serialize() << std::endl;
+}
+
+static Key BenchKey() {
+  MemoryBuffer key_data(32);
+  for (std::size_t i = 0; i < key_data.GetSize(); ++i)
+    key_data[i] = static_cast<uint8>(i * 7 + 1);
+  return Key(key_data);
+}
+
+// deterministic pseudo-random bytes (xorshift64)
+static void FillPattern(uint8 *data, std::size_t length, uint64 seed) {
+  uint64 state = seed | 1;
+  for (std::size_t i = 0; i < length; ++i) {
+    state ^= state << 13;
+    state ^= state >> 7;
+    state ^= state << 17;
+    data[i] = static_cast<uint8>(state);
+  }
+}
+
+/**
+ * @brief Embed and extract throughput of every encoder configuration
+ *        (each Hamming parity setting, each LSB block size)
+ */
+static void BenchEncoders() {
+  const std::size_t kCodewordBytes = 1 << 20;
+
+  for (auto &encoder : EncoderFactory::GetAllEncoders()) {
+    std::string name = encoder->GetNameInstance();
+    if (!Selected("encoder", name)) continue;
+
+    uint32 codeword_size = encoder->GetCodewordBlockSize();
+    uint32 data_size = encoder->GetDataBlockSize();
+    uint64 blocks = kCodewordBytes / codeword_size;
+
+    std::vector<uint8> codewords(blocks * codeword_size);
+    std::vector<uint8> data(blocks * data_size);
+    FillPattern(codewords.data(), codewords.size(), 1);
+    FillPattern(data.data(), data.size(), 2);
+
+    double embed_ns = TimeRuns([&] {
+      encoder->EmbedBlocks(codewords.data(), data.data(), blocks);
+    });
+    double extract_ns = TimeRuns([&] {
+      encoder->ExtractBlocks(codewords.data(), data.data(), blocks);
+    });
+
+    json::JsonObject params;
+    auto hamming = std::dynamic_pointer_cast<HammingEncoder>(encoder);
+    if (hamming)
+      params["parity_bits"] = Number(hamming->GetParityBits());
+    params["codeword_block_size"] = Number(codeword_size);
+    params["data_block_size"] = Number(data_size);
+
+    // throughput of user data
+    json::JsonObject metrics;
+    metrics["embed_mb_per_s"] = Number(MegabytesPerSecond(data.size(), embed_ns));
+    metrics["extract_mb_per_s"] = Number(MegabytesPerSecond(data.size(), extract_ns));
+    AddResult("encoder", name, params, metrics);
+  }
+}
+
+/**
+ * @brief Init time, sequential and random Permute of every permutation type
+ */
+static void BenchPermutations() {
+  std::vector<PermutationFactory::PermutationType> types = {
+    PermutationFactory::PermutationType::IDENTITY,
+    PermutationFactory::PermutationType::AFFINE,
+    PermutationFactory::PermutationType::AFFINE64,
+    PermutationFactory::PermutationType::FEISTEL_NUM,
+    PermutationFactory::PermutationType::FEISTEL_MIX,
+    PermutationFactory::PermutationType::FEISTEL_NUM_EXACT,
+    PermutationFactory::PermutationType::FEISTEL_MIX_EXACT,
+    PermutationFactory::PermutationType::ARX_FEISTEL,
+    PermutationFactory::PermutationType::FEISTEL_MIX_BLOCKED
+  };
+  Key key = BenchKey();
+
+  for (auto type : types) {
+    std::string name = PermutationFactory::GetPermutationName(type);
+    if (!Selected("permutation", name)) continue;
+
+    for (uint8 bits = options.min_bits; bits <= options.max_bits;
+         bits = static_cast<uint8>(bits + options.step_bits)) {
+      PermElem requested_size = 1ULL << bits;
+      std::shared_ptr<Permutation> permutation =
+          PermutationFactory::GetPermutation(type);
+
+      json::JsonObject params;
+      params["requested_size_bits"] = Number(bits);
+      json::JsonObject metrics;
+
+      if (permutation->GetSizeUsingParams(requested_size, key) == 0) {
+        metrics["supported"] = json::JsonObject(false);
+        AddResult("permutation", name, params, metrics);
+        continue;
+      }
+
+      auto start = std::chrono::steady_clock::now();
+      permutation->Init(requested_size, key);
+      double init_ms = std::chrono::duration<double, std::milli>(
+                         std::chrono::steady_clock::now() - start).count();
+
+      PermElem size = permutation->GetSize();
+      uint64 samples = size < kMaxPermuteSamples ? size : kMaxPermuteSamples;
+
+      double sequential_ns = TimeRuns([&] {
+        uint64 checksum = 0;
+        for (uint64 i = 0; i < samples; ++i)
+          checksum += permutation->Permute(i);
+        sink = checksum;
+      }) / samples;
+
+      // indices spread over the whole domain
+      PermElem stride = (size / 2 + 12345) % size;
+      double random_ns = TimeRuns([&] {
+        uint64 checksum = 0;
+        PermElem index = 0;
+        for (uint64 i = 0; i < samples; ++i) {
+          checksum += permutation->Permute(index);
+          index += stride;
+          if (index >= size) index -= size;
+        }
+        sink = checksum;
+      }) / samples;
+
+      metrics["supported"] = json::JsonObject(true);
+      metrics["size"] = Number(static_cast<double>(size));
+      metrics["init_ms"] = Number(init_ms);
+      metrics["sequential_ns"] = Number(sequential_ns);
+      metrics["random_ns"] = Number(random_ns);
+      AddResult("permutation", name, params, metrics);
+    }
+  }
+}
+
+/**
+ * @brief Throughput of hash implementations, single and multi-buffer
+ */
+static void BenchHashes() {
+  const std::vector<std::size_t> lengths = { 64, 4096, 1 << 20 };
+  const std::size_t kManyCount = 8;
+
+  for (auto type : { HashFactory::HashType::KECCAK,
+                     HashFactory::HashType::KANGAROO_TWELVE }) {
+    std::string name = HashFactory::GetHashName(type);
+    if (!Selected("hash", name)) continue;
+
+    std::shared_ptr<HashImpl> hash =
+        HashFactory::GetHashImpl(type, Hash::GetDefaultStateSize());
+
+    for (std::size_t length : lengths) {
+      std::vector<uint8> data(length * kManyCount);
+      FillPattern(data.data(), data.size(), length);
+      MemoryBuffer state(hash->GetStateSize());
+
+      double process_ns = TimeRuns([&] {
+        hash->Process(state, data.data(), length);
+      });
+
+      std::vector<const uint8*> messages(kManyCount);
+      std::vector<MemoryBuffer> digests(kManyCount,
+                                        MemoryBuffer(hash->GetStateSize()));
+      std::vector<uint8*> digest_pointers(kManyCount);
+      for (std::size_t i = 0; i < kManyCount; ++i) {
+        messages[i] = data.data() + i * length;
+        digest_pointers[i] = digests[i].GetRawPointer();
+      }
+      double many_ns = TimeRuns([&] {
+        hash->ProcessMany(messages.data(), length, digest_pointers.data(),
+                          kManyCount);
+      });
+
+      json::JsonObject params;
+      params["length"] = Number(length);
+      params["state_size"] = Number(hash->GetStateSize());
+      json::JsonObject metrics;
+      metrics["process_ns"] = Number(process_ns);
+      metrics["process_mb_per_s"] = Number(MegabytesPerSecond(length, process_ns));
+      metrics["process_many_mb_per_s"] =
+          Number(MegabytesPerSecond(length * kManyCount, many_ns));
+      AddResult("hash", name, params, metrics);
+    }
+  }
+}
+
+/**
+ * @brief Costs of MemoryBuffer lifetime and bulk operations
+ */
+static void BenchMemoryBuffer() {
+  if (!Selected("memory_buffer", "MemoryBuffer")) return;
+
+  for (std::size_t size : { 4096, 1 << 20, 16 << 20 }) {
+    MemoryBuffer buffer(size);
+    MemoryBuffer other(size);
+    other.Fill(0x5a);
+
+    json::JsonObject metrics;
+    metrics["construct_destroy_ns"] = Number(TimeRuns([&] {
+      MemoryBuffer temporary(size);
+      sink = temporary.GetSize();
+    }));
+    metrics["copy_ns"] = Number(TimeRuns([&] {
+      MemoryBuffer copy(other);
+      sink = copy[size - 1];
+    }));
+    metrics["resize_ns"] = Number(TimeRuns([&] {
+      buffer.Resize(size / 2);
+      buffer.Resize(size);
+    }) / 2);
+    metrics["clear_ns"] = Number(TimeRuns([&] { buffer.Clear(); }));
+    metrics["fill_ns"] = Number(TimeRuns([&] { buffer.Fill(0xa5); }));
+    metrics["xor_ns"] = Number(TimeRuns([&] { buffer ^= other; }));
+    metrics["randomize_ns"] = Number(TimeRuns([&] { buffer.Randomize(); }));
+
+    json::JsonObject params;
+    params["size"] = Number(size);
+    AddResult("memory_buffer", "MemoryBuffer", params, metrics);
+  }
+}
+
+/**
+ * Grayscale carrier of given dimensions, only fields used by fitness
+ */
+class SyntheticGrayscaleCarrier : public CarrierFile {
+public:
+  SyntheticGrayscaleCarrier(uint32 width, uint32 height)
+    : CarrierFile(File("", "synthetic"), nullptr, nullptr, nullptr) {
+    width_ = width;
+    height_ = height;
+    is_grayscale_ = true;
+    raw_capacity_ = static_cast<uint64>(width) * height / 8;
+  }
+
+  virtual void LoadFile() { file_loaded_ = true; }
+  virtual void SaveFile() {}
+};
+
+/**
+ * @brief ContextFitness::SelectBytes and InsertBytes over synthetic grayscale
+ *        images
+ *
+ * Image is a smooth gradient with noise in the lowest bits, so part of
+ * the pixels is selected.
+ */
+static void BenchFitness() {
+  if (!Selected("fitness", "ContextFitness")) return;
+
+  for (uint32 dimension : { 512, 2048, 4096 }) {
+    auto carrier = std::make_shared<SyntheticGrayscaleCarrier>(dimension,
+                                                               dimension);
+    MemoryBuffer image(static_cast<std::size_t>(dimension) * dimension);
+    FillPattern(image.GetRawPointer(), image.GetSize(), dimension);
+    for (uint32 y = 0; y < dimension; ++y)
+      for (uint32 x = 0; x < dimension; ++x) {
+        std::size_t i = static_cast<std::size_t>(y) * dimension + x;
+        image[i] = static_cast<uint8>(((x + y) >> 3) + (image[i] & 3));
+      }
+
+    uint64 selected = 0;
+    double select_ns = TimeRuns([&] {
+      ContextFitness fitness(carrier);
+      MemoryBuffer out;
+      selected = fitness.SelectBytes(image, &out);
+    });
+
+    ContextFitness fitness(carrier);
+    MemoryBuffer selected_bytes;
+    fitness.SelectBytes(image, &selected_bytes);
+    double insert_ns = TimeRuns([&] {
+      fitness.InsertBytes(selected_bytes, &image);
+    });
+
+    json::JsonObject params;
+    params["width"] = Number(dimension);
+    params["height"] = Number(dimension);
+    json::JsonObject metrics;
+    metrics["select_ms"] = Number(select_ns / 1e6);
+    metrics["mb_per_s"] = Number(MegabytesPerSecond(image.GetSize(), select_ns));
+    metrics["insert_ms"] = Number(insert_ns / 1e6);
+    metrics["selected"] = Number(static_cast<double>(selected));
+    AddResult("fitness", "ContextFitness", params, metrics);
+  }
+}
+
+static void PrintHelp(char *name) {
+  std::cerr << "Usage: " << name << " <option(s)>\n"
+            << "\t-o,--out <FILE>\t\twrite JSON to file instead of stdout\n"
+            << "\t-f,--filter <TEXT>\trun only groups or names containing text\n"
+            << "\t-l,--label <TEXT>\tlabel of the run (e.g. commit)\n"
+            << "\t--min-time <MS>\t\tminimal time of each measurement (default 200)\n"
+            << "\t--min-bits <N>\t\tsmallest permutation size 2^N (default 10)\n"
+            << "\t--max-bits <N>\t\tlargest permutation size 2^N (default 34)\n"
+            << "\t--step-bits <N>\t\tstep of permutation sizes (default 4)\n"
+            << std::endl;
+}
+
+int main(int argc, char *argv[]) {
+  std::string logging_level("ERROR");
+  Logger::SetVerbosityLevel(logging_level, std::string("cout"));
+
+  std::string out_path;
+  std::string label;
+
+  for (int i = 1; i < argc; ++i) {
+    std::string arg = argv[i];
+    if (arg == "-h" || arg == "--help" || i + 1 >= argc) {
+      PrintHelp(argv[0]);
+      return arg == "-h" || arg == "--help" ? 0 : -1;
+    }
+    std::string value = argv[++i];
+    if (arg == "-o" || arg == "--out") out_path = value;
+    else if (arg == "-f" || arg == "--filter") options.filter = value;
+    else if (arg == "-l" || arg == "--label") label = value;
+    else if (arg == "--min-time") options.min_time_ns = std::atof(value.c_str()) * 1e6;
+    else if (arg == "--min-bits") options.min_bits = static_cast<uint8>(std::atoi(value.c_str()));
+    else if (arg == "--max-bits") options.max_bits = static_cast<uint8>(std::atoi(value.c_str()));
+    else if (arg == "--step-bits") options.step_bits = static_cast<uint8>(std::atoi(value.c_str()));
+    else {
+      PrintHelp(argv[0]);
+      return -1;
+    }
+  }
+
+  if (options.step_bits == 0 || options.max_bits > 63) {
+    PrintHelp(argv[0]);
+    return -1;
+  }
+
+  BenchEncoders();
+  BenchPermutations();
+  BenchHashes();
+  BenchMemoryBuffer();
+  BenchFitness();
+
+  json::JsonObject report;
+  report["suite"] = json::JsonObject("stego-bench");
+  report["label"] = json::JsonObject(label);
+  report["min_time_ms"] = Number(options.min_time_ns / 1e6);
+  report["results"] = results;
+
+  if (out_path.empty()) {
+    std::cout << report.PrettySerialize() << std::endl;
+  } else {
+    std::ofstream out(out_path);
+    out << report.PrettySerialize() << std::endl;
+    if (!out) {
+      std::cerr << "Unable to write " << out_path << std::endl;
+      return -1;
+    }
+  }
+
+  return 0;
+}
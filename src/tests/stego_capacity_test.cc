@@ -0,0 +1,208 @@
+/**
+* @file stego_capacity_test.cc
+* @author Martin Kosdy
+* @author Matus Kysel
+* @date 2016
+* @brief Tests of capacity estimates against loaded storages
+*
+* Capacity estimated right after Open has to equal GetSize of the storage
+* loaded with the same encoder (every setting of every encoder) and
+* permutations, data saved to it have to be read back after reload, and
+* configurations estimated as unusable must fail to load or save.
+* Carriers of formats with their own permutation in StegoConfig keep it
+* in estimates too.
+*/
+
+#include <sys/stat.h>
+#include <sys/types.h>
+#ifdef _WIN32
+#include <direct.h>
+#endif
+
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "encoders/encoder_factory.h"
+#include "encoders/hamming_encoder.h"
+#include "logging/logger.h"
+#include "permutations/permutation_factory.h"
+#include "stego_storage.h"
+#include "utils/stego_config.h"
+
+#include "corpus_generator.h"
+#include "file_manager.h"
+#include "test_assert_helper.h"
+#include "tests/test_config.h"
+
+using namespace stego_disk;
+
+static const std::string kDirectory = std::string(DST_DIRECTORY) + "capacity";
+
+static void MakeDirectory(const std::string &path) {
+#ifdef _WIN32
+  _mkdir(path.c_str());
+#else
+  mkdir(path.c_str(), 0755);
+#endif
+}
+
+// carriers of two sizes, larger ones are renamed to be sorted first
+static void GenerateCorpus(unsigned int bmp_weight, unsigned int jpg_weight) {
+  const CorpusSpec small = { 9, 32, 32, bmp_weight, 0, jpg_weight, 90, 2016 };
+  const CorpusSpec large = { 6, 128, 96, bmp_weight, 0, jpg_weight, 90, 7 };
+  const std::string large_directory = kDirectory + "_large";
+
+  FileManager::RemoveDirectory(kDirectory);
+  MakeDirectory(DST_DIRECTORY);
+  MakeDirectory(kDirectory);
+  MakeDirectory(large_directory);
+  CorpusGenerator::Generate(kDirectory, small);
+  for (auto &path : CorpusGenerator::Generate(large_directory, large)) {
+    std::string name = path.substr(large_directory.size() + 1);
+    std::rename(path.c_str(), (kDirectory + "/big_" + name).c_str());
+  }
+  FileManager::RemoveDirectory(large_directory);
+}
+
+// encoder settings are passed to Load by StegoConfig
+static void SetEncoderArgs(const std::shared_ptr<Encoder> &encoder) {
+  StegoConfig::encoder_args().clear();
+  auto hamming = std::dynamic_pointer_cast<HammingEncoder>(encoder);
+  if (hamming) {
+    StegoConfig::encoder_args()["parityBits"] =
+        std::to_string(hamming->GetParityBits());
+  } else {
+    StegoConfig::encoder_args()["blockSize"] =
+        std::to_string(encoder->GetDataBlockSize());
+  }
+}
+
+static uint8 PatternByte(std::size_t position) {
+  return static_cast<uint8>(position * 29 + (position >> 8) + 3);
+}
+
+// reopens the saved storage and compares its content with the pattern
+static int CheckReload(std::size_t size) {
+  StegoStorage storage;
+  storage.Open(kDirectory, PASSWORD);
+  storage.Load();
+  STEGO_TEST_CHECK(storage.GetSize() == size, -1);
+
+  std::vector<uint8> data(size);
+  storage.Read(data.data(), 0, size);
+  for (std::size_t i = 0; i < size; ++i)
+    STEGO_TEST_CHECK(data[i] == PatternByte(i), -1);
+
+  return 0;
+}
+
+/**
+ * @brief Estimates the configuration, then loads and saves the storage
+ *
+ * Saved BMP carriers keep their raw capacity, so the corpus is reused
+ * by following configurations.
+ */
+static int CheckConfiguration(const std::shared_ptr<Encoder> &encoder,
+                              PermutationFactory::PermutationType global,
+                              PermutationFactory::PermutationType local,
+                              bool save) {
+  StegoStorage storage;
+  storage.Configure(
+      EncoderFactory::GetEncoderType(encoder->GetNameInstance()), global,
+      local);
+  // Configure names the global permutation differently than
+  // StegoConfig::Init reads it, Init sets the default one
+  StegoConfig::global_perm() = global;
+  SetEncoderArgs(encoder);
+  storage.Open(kDirectory, PASSWORD);
+
+  CapacityConfig config = { encoder, global, local };
+  std::vector<CapacityEstimate> estimates = storage.EstimateCapacity({ config });
+  STEGO_TEST_CHECK(estimates.size() == 1, -1);
+  uint64 capacity = estimates[0].capacity;
+
+  bool usable = true;
+  try {
+    storage.Load();
+    STEGO_TEST_CHECK(storage.GetSize() == capacity || capacity == 0, -1);
+    if (save) {
+      std::vector<uint8> data(storage.GetSize());
+      for (std::size_t i = 0; i < data.size(); ++i) data[i] = PatternByte(i);
+      storage.Write(data.data(), 0, data.size());
+      storage.Save();
+    }
+  } catch (std::exception &) {
+    usable = false;
+  }
+
+  if (usable != (capacity > 0)) {
+    std::cout << encoder->GetNameInstance() << " "
+              << encoder->GetDataBlockSize() << " "
+              << PermutationFactory::GetPermutationName(global) << " "
+              << PermutationFactory::GetPermutationName(local)
+              << ": estimated " << capacity << ", loaded size "
+              << storage.GetSize() << std::endl;
+    return -1;
+  }
+
+  if (usable && save)
+    STEGO_TEST_CHECK(CheckReload(storage.GetSize()) == 0, -1);
+
+  return 0;
+}
+
+static int TestConfigurations() {
+  GenerateCorpus(1, 0);
+
+  for (auto &encoder : EncoderFactory::GetAllEncoders()) {
+    for (auto global : PermutationFactory::GetPermutationTypes()) {
+      for (auto local : PermutationFactory::GetPermutationTypes()) {
+        STEGO_TEST_CHECK(CheckConfiguration(encoder, global, local, true) == 0,
+                         -1);
+      }
+    }
+  }
+
+  return 0;
+}
+
+static int TestFormatPermutation() {
+  GenerateCorpus(1, 1);
+
+  // JPEG carriers are created with their own permutation, saving them
+  // could change their raw capacity
+  StegoConfig::file_config()["jpg"] = std::make_pair(
+      EncoderFactory::EncoderType::HAMMING,
+      PermutationFactory::PermutationType::IDENTITY);
+
+  for (auto &encoder : EncoderFactory::GetEncoders()) {
+    for (auto local : PermutationFactory::GetPermutationTypes()) {
+      STEGO_TEST_CHECK(CheckConfiguration(
+          encoder, PermutationFactory::PermutationType::AFFINE, local,
+          false) == 0, -1);
+    }
+  }
+
+  StegoConfig::file_config().erase("jpg");
+  StegoConfig::encoder_args().clear();
+  return 0;
+}
+
+int main() {
+  std::string logging_level("ERROR");
+  if (getenv("LOGGING_LEVEL"))
+    logging_level.assign(getenv("LOGGING_LEVEL"));
+  Logger::SetVerbosityLevel(logging_level, std::string("cout"));
+
+  STEGO_TEST_CHECK(TestConfigurations() == 0, -1);
+  STEGO_TEST_CHECK(TestFormatPermutation() == 0, -1);
+
+  FileManager::RemoveDirectory(kDirectory);
+  std::cout << "OK" << std::endl;
+  return 0;
+}
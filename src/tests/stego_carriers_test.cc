@@ -0,0 +1,146 @@
+/**
+* @file stego_carriers_test.cc
+* @author Martin Kosdy
+* @author Matus Kysel
+* @date 2016
+* @brief Tests of parallel loops of CarrierFilesManager over carriers
+*
+* Keys, subkeys and encoders of carriers are set by ranges of carriers,
+* running as tasks of the thread pool when the manager is created with
+* a small number of carriers per task. Carriers saved this way have to
+* be the same as carriers saved by the serial loop, and readable by it.
+*/
+
+#include <sys/stat.h>
+#include <sys/types.h>
+#ifdef _WIN32
+#include <direct.h>
+#endif
+
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "encoders/encoder_factory.h"
+#include "file_management/carrier_files_manager.h"
+#include "logging/logger.h"
+#include "permutations/permutation_factory.h"
+#include "stego_storage.h"
+#include "utils/stego_config.h"
+#include "virtual_storage/virtual_storage.h"
+
+#include "corpus_generator.h"
+#include "file_manager.h"
+#include "test_assert_helper.h"
+#include "tests/test_config.h"
+
+using namespace stego_disk;
+
+static const std::string kDirectory = std::string(DST_DIRECTORY) + "carriers";
+
+struct SavedCarriers {
+  uint64 capacity;
+  uint64 storage_size;
+  std::vector<std::vector<char>> files;
+};
+
+static std::vector<char> ReadFile(const std::string &path) {
+  std::ifstream file(path, std::ios::binary);
+  return std::vector<char>((std::istreambuf_iterator<char>(file)),
+                           std::istreambuf_iterator<char>());
+}
+
+static void GenerateCorpus(std::vector<std::string> *files) {
+  const CorpusSpec spec = { 40, 32, 32, 1, 0, 0, 90, 2016 };
+
+  FileManager::RemoveDirectory(kDirectory);
+#ifdef _WIN32
+  _mkdir(DST_DIRECTORY);
+  _mkdir(kDirectory.c_str());
+#else
+  mkdir(DST_DIRECTORY, 0755);
+  mkdir(kDirectory.c_str(), 0755);
+#endif
+  *files = CorpusGenerator::Generate(kDirectory, spec);
+}
+
+static std::shared_ptr<VirtualStorage> LoadStorage(
+    CarrierFilesManager &manager) {
+  manager.SetPassword(PASSWORD);
+  manager.LoadDirectory(kDirectory);
+  manager.SetEncoder(EncoderFactory::GetEncoder(StegoConfig::encoder()));
+  manager.ApplyEncoder();
+
+  auto storage = std::make_shared<VirtualStorage>();
+  storage->SetPermutation(
+        PermutationFactory::GetPermutation(StegoConfig::global_perm()));
+  manager.LoadVirtualStorage(storage);
+  return storage;
+}
+
+static uint8 PatternByte(uint64 position) {
+  return static_cast<uint8>(position * 13 + (position >> 8) + 5);
+}
+
+// writes the pattern to a fresh corpus and saves it
+static SavedCarriers SaveCorpus(std::size_t min_carriers_per_task) {
+  std::vector<std::string> files;
+  GenerateCorpus(&files);
+
+  CarrierFilesManager manager(min_carriers_per_task);
+  auto storage = LoadStorage(manager);
+
+  std::vector<uint8> data(storage->GetUsableCapacity());
+  for (std::size_t i = 0; i < data.size(); ++i) data[i] = PatternByte(i);
+  storage->Write(0, data.size(), data.data());
+  manager.SaveVirtualStorage();
+
+  SavedCarriers saved = { manager.GetCapacity(), data.size(), {} };
+  for (auto &file : files) saved.files.push_back(ReadFile(file));
+  return saved;
+}
+
+static int TestParallelRanges() {
+  // one range (serial loop), a range per carrier, uneven and two ranges
+  SavedCarriers serial = SaveCorpus(CarrierFilesManager::kMinCarriersPerTask);
+  STEGO_TEST_CHECK(serial.storage_size > 0, -1);
+
+  for (std::size_t min_carriers_per_task : { std::size_t(1), std::size_t(7),
+                                             std::size_t(20) }) {
+    SavedCarriers parallel = SaveCorpus(min_carriers_per_task);
+    STEGO_TEST_CHECK(parallel.capacity == serial.capacity, -1);
+    STEGO_TEST_CHECK(parallel.storage_size == serial.storage_size, -1);
+    STEGO_TEST_CHECK(parallel.files == serial.files, -1);
+
+    // carriers saved in parallel are read by the serial loop
+    CarrierFilesManager manager;
+    auto storage = LoadStorage(manager);
+    std::vector<uint8> data(storage->GetUsableCapacity());
+    storage->Read(0, data.size(), data.data());
+    for (std::size_t i = 0; i < data.size(); ++i)
+      STEGO_TEST_CHECK(data[i] == PatternByte(i), -1);
+  }
+
+  FileManager::RemoveDirectory(kDirectory);
+  return 0;
+}
+
+int main() {
+  std::string logging_level("ERROR");
+  if (getenv("LOGGING_LEVEL"))
+    logging_level.assign(getenv("LOGGING_LEVEL"));
+  Logger::SetVerbosityLevel(logging_level, std::string("cout"));
+
+  StegoStorage().Configure(EncoderFactory::EncoderType::HAMMING,
+                           PermutationFactory::PermutationType::FEISTEL_MIX,
+                           PermutationFactory::PermutationType::FEISTEL_MIX);
+
+  STEGO_TEST_CHECK(TestParallelRanges() == 0, -1);
+
+  std::cout << "OK" << std::endl;
+  return 0;
+}
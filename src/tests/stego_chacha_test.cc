@@ -0,0 +1,202 @@
+/**
+* @file stego_chacha_test.cc
+* @author Martin Kosdy
+* @author Matus Kysel
+* @date 2016
+* @brief Tests of ChaCha20 keystream and wiping of memory buffers
+*
+* Keystream is checked against test vectors of RFC 8439 (appendix A.1);
+* with 64-bit nonce, RFC nonce 00..00 nn maps to nonce 00..00 nn and the
+* 32-bit block counter to the low half of the 64-bit one. Keystream
+* started at any block and keystream generated in parallel ranges has
+* to equal the serial keystream.
+*/
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "logging/logger.h"
+#include "utils/chacha20.h"
+#include "utils/memory_buffer.h"
+
+#include "test_assert_helper.h"
+
+using namespace stego_disk;
+
+struct KeystreamVector {
+  uint8 key_last;       // last byte of the key, others are zero
+  uint8 nonce_last;     // last byte of the nonce, others are zero
+  uint64 block;
+  std::string keystream;
+};
+
+static std::string ToHex(const uint8 *data, std::size_t length) {
+  static const char digits[] = "0123456789abcdef";
+  std::string hex;
+  for (std::size_t i = 0; i < length; ++i) {
+    hex += digits[data[i] >> 4];
+    hex += digits[data[i] & 0x0F];
+  }
+  return hex;
+}
+
+static int TestVectors() {
+  const std::vector<KeystreamVector> vectors = {
+    { 0, 0, 0, "76b8e0ada0f13d90405d6ae55386bd28bdd219b8a08ded1aa836efcc8b770dc7"
+               "da41597c5157488d7724e03fb8d84a376a43b8f41518a11cc387b669b2ee6586" },
+    { 0, 0, 1, "9f07e7be5551387a98ba977c732d080dcb0f29a048e3656912c6533e32ee7aed"
+               "29b721769ce64e43d57133b074d839d531ed1f28510afb45ace10a1f4b794d6f" },
+    { 1, 0, 1, "3aeb5224ecf849929b9d828db1ced4dd832025e8018b8160b82284f3c949aa5a"
+               "8eca00bbb4a73bdad192b5c42f73f2fd4e273644c8b36125a64addeb006c13a0" },
+    { 0, 2, 0, "c2c64d378cd536374ae204b9ef933fcd1a8b2288b3dfa49672ab765b54ee27c7"
+               "8a970e0e955c14f3a88e741b97c286f75f8fc299e8148362fa198a39531bed6d" },
+  };
+
+  for (auto &vector : vectors) {
+    uint8 key[32] = { 0 };
+    uint8 nonce[8] = { 0 };
+    key[31] = vector.key_last;
+    nonce[7] = vector.nonce_last;
+
+    uint8 block[ChaCha20::kBlockSize];
+    ChaCha20::Generate(key, nonce, vector.block, block, sizeof(block));
+    STEGO_TEST_CHECK(ToHex(block, sizeof(block)) == vector.keystream, -1);
+  }
+
+  // two consecutive blocks at once
+  uint8 key[32] = { 0 };
+  uint8 nonce[8] = { 0 };
+  uint8 blocks[2 * ChaCha20::kBlockSize];
+  ChaCha20::Generate(key, nonce, 0, blocks, sizeof(blocks));
+  STEGO_TEST_CHECK(ToHex(blocks, sizeof(blocks)) ==
+                   vectors[0].keystream + vectors[1].keystream, -1);
+
+  return 0;
+}
+
+static void TestKey(uint8 key[32], uint8 nonce[8]) {
+  for (std::size_t i = 0; i < 32; ++i) key[i] = static_cast<uint8>(i * 11 + 7);
+  for (std::size_t i = 0; i < 8; ++i) nonce[i] = static_cast<uint8>(i * 5 + 1);
+}
+
+static int TestBlockOffsets() {
+  uint8 key[32], nonce[8];
+  TestKey(key, nonce);
+
+  // not a multiple of blocks computed at once
+  const std::size_t length = 37 * ChaCha20::kBlockSize + 13;
+  std::vector<uint8> serial(length);
+  ChaCha20::Generate(key, nonce, 0, serial.data(), length);
+
+  for (uint64 first_block = 1; first_block < 12; ++first_block) {
+    for (std::size_t part : { std::size_t(1), std::size_t(63),
+                              std::size_t(64), std::size_t(65),
+                              std::size_t(300) }) {
+      std::size_t offset = first_block * ChaCha20::kBlockSize;
+      std::vector<uint8> output(part);
+      ChaCha20::Generate(key, nonce, first_block, output.data(), part);
+      STEGO_TEST_CHECK(std::equal(output.begin(), output.end(),
+                                  serial.begin() + offset), -1);
+    }
+  }
+
+  return 0;
+}
+
+static int TestParallelRanges() {
+  uint8 key[32], nonce[8];
+  TestKey(key, nonce);
+
+  // enough for 4 threads, last range ends in the middle of a block
+  const std::size_t length = 4 * ChaCha20::kMinBytesPerThread + 77;
+  const uint64 first_block = 5;
+  std::vector<uint8> serial(length);
+  ChaCha20::Generate(key, nonce, first_block, serial.data(), length, 1);
+
+  for (std::size_t threads : { std::size_t(2), std::size_t(3),
+                               std::size_t(4) }) {
+    std::vector<uint8> parallel(length);
+    ChaCha20::Generate(key, nonce, first_block, parallel.data(), length,
+                       threads);
+    STEGO_TEST_CHECK(parallel == serial, -1);
+  }
+
+  return 0;
+}
+
+/**
+ * @brief Memory released by MemoryBuffer is wiped by the policy
+ *
+ * BufferPool returns the last released block of the size class to the
+ * same thread, with its previous content; the whole capacity is checked,
+ * including bytes left beyond the size by shrinking.
+ */
+static int TestWipePolicy() {
+  const std::size_t size = 4000;
+  const uint8 pattern = 0xA5;
+  MemoryBuffer::WipePolicy previous = MemoryBuffer::GetWipePolicy();
+
+  for (auto policy : { MemoryBuffer::kWipeNone, MemoryBuffer::kWipeZero,
+                       MemoryBuffer::kWipeRandom }) {
+    MemoryBuffer::SetWipePolicy(policy);
+    STEGO_TEST_CHECK(MemoryBuffer::GetWipePolicy() == policy, -1);
+
+    const uint8 *released;
+    std::size_t capacity;
+    {
+      MemoryBuffer buffer(size);
+      buffer.Fill(pattern);
+      buffer.Resize(size / 8);
+      released = buffer.GetConstRawPointer();
+      capacity = buffer.GetCapacity();
+    }
+
+    MemoryBuffer reused(capacity);
+    STEGO_TEST_CHECK(reused.GetConstRawPointer() == released, -1);
+
+    const uint8 *data = reused.GetConstRawPointer();
+    std::size_t patterns = std::count(data, data + capacity, pattern);
+    std::size_t zeros = std::count(data, data + capacity, 0);
+    switch (policy) {
+      case MemoryBuffer::kWipeNone:
+        STEGO_TEST_CHECK(patterns >= size, -1);
+        break;
+      case MemoryBuffer::kWipeZero:
+        STEGO_TEST_CHECK(zeros == capacity, -1);
+        break;
+      case MemoryBuffer::kWipeRandom:
+        STEGO_TEST_CHECK(patterns < capacity / 64, -1);
+        STEGO_TEST_CHECK(zeros < capacity / 64, -1);
+        break;
+    }
+  }
+
+  MemoryBuffer::SetWipePolicy(previous);
+
+  uint8 secret[100];
+  memset(secret, pattern, sizeof(secret));
+  MemoryBuffer::SecureZero(secret, sizeof(secret));
+  STEGO_TEST_CHECK(std::count(secret, secret + sizeof(secret), 0) ==
+                   sizeof(secret), -1);
+
+  return 0;
+}
+
+int main() {
+  std::string logging_level("ERROR");
+  if (getenv("LOGGING_LEVEL"))
+    logging_level.assign(getenv("LOGGING_LEVEL"));
+  Logger::SetVerbosityLevel(logging_level, std::string("cout"));
+
+  STEGO_TEST_CHECK(TestVectors() == 0, -1);
+  STEGO_TEST_CHECK(TestBlockOffsets() == 0, -1);
+  STEGO_TEST_CHECK(TestParallelRanges() == 0, -1);
+  STEGO_TEST_CHECK(TestWipePolicy() == 0, -1);
+
+  std::cout << "OK" << std::endl;
+  return 0;
+}
@@ -0,0 +1,184 @@
+/**
+* @file stego_fitness_test.cc
+* @author Martin Kosdy
+* @author Matus Kysel
+* @date 2016
+* @brief Tests of ContextFitness selection on random images
+*
+* Selected pixels have to be the same as selected by the original
+* per-block implementation (CheckValidity below), for images of assorted
+* sizes and noise levels, both on the calling thread and from a worker
+* of ThreadPool (where SelectBytes stays serial).
+*/
+
+#include <array>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "carrier_files/carrier_file.h"
+#include "fitness/context_fitness.h"
+#include "logging/logger.h"
+#include "utils/thread_pool.h"
+
+#include "test_assert_helper.h"
+
+using namespace stego_disk;
+
+/**
+ * Grayscale carrier without a file, only its dimensions are set.
+ */
+class SyntheticImage : public CarrierFile {
+public:
+  SyntheticImage(uint32 width, uint32 height)
+    : CarrierFile(File("", "synthetic"), nullptr, nullptr, nullptr) {
+    width_ = width;
+    height_ = height;
+    is_grayscale_ = true;
+  }
+
+  virtual void LoadFile() { file_loaded_ = true; }
+  virtual void SaveFile() {}
+};
+
+// original implementation, at most one pair of equal pixels in the sub-box
+static bool CheckSubboxValidity(const std::array<uint8, 4> &subbox) {
+  uint8 validity = 1;
+
+  validity <<= !(subbox[0] - subbox[1]);
+  validity <<= !(subbox[0] - subbox[2]);
+  validity <<= !(subbox[0] - subbox[3]);
+  validity <<= !(subbox[1] - subbox[2]);
+  validity <<= !(subbox[1] - subbox[3]);
+  validity <<= !(subbox[2] - subbox[3]);
+
+  return validity <= 2;
+}
+
+static bool CheckValidity(const std::array<uint8, 9> &box) {
+  bool valid = true;
+
+  for (uint8 central_pixel : { uint8(box[4] & 0xFE), uint8(box[4] | 0x01) }) {
+    valid = valid &&
+        CheckSubboxValidity({{ box[0], box[1], box[3], central_pixel }}) &&
+        CheckSubboxValidity({{ box[1], box[2], central_pixel, box[5] }}) &&
+        CheckSubboxValidity({{ box[3], central_pixel, box[6], box[7] }}) &&
+        CheckSubboxValidity({{ central_pixel, box[5], box[7], box[8] }});
+  }
+
+  return valid;
+}
+
+static std::vector<uint32> ReferenceSelection(const MemoryBuffer &image,
+                                              uint32 width, uint32 height) {
+  std::vector<uint32> indices;
+
+  for (uint32 i = 0; i < height / 3; ++i) {
+    for (uint32 j = 0; j < width / 3; ++j) {
+      uint32 index = (3 * i + 1) * width + 3 * j + 1;
+      std::array<uint8, 9> box = {{
+        image[index - width - 1], image[index - width], image[index - width + 1],
+        image[index - 1], image[index], image[index + 1],
+        image[index + width - 1], image[index + width], image[index + width + 1]
+      }};
+      if (CheckValidity(box)) indices.push_back(index);
+    }
+  }
+
+  return indices;
+}
+
+// selects bytes of the image and checks them against the reference
+static int CheckSelection(const MemoryBuffer &image, uint32 width,
+                          uint32 height) {
+  std::vector<uint32> expected = ReferenceSelection(image, width, height);
+
+  ContextFitness fitness(std::make_shared<SyntheticImage>(width, height));
+  MemoryBuffer selected;
+  STEGO_TEST_CHECK(fitness.SelectBytes(image, &selected) == expected.size(), -1);
+  STEGO_TEST_CHECK(fitness.GetSelectedIndices() == expected, -1);
+  for (std::size_t i = 0; i < expected.size(); ++i)
+    STEGO_TEST_CHECK(selected[i] == image[expected[i]], -1);
+
+  // LSBs of selected pixels are changed only by InsertBytes
+  MemoryBuffer changed(image);
+  for (std::size_t i = 0; i < selected.GetSize(); ++i) selected[i] ^= 0x01;
+  fitness.InsertBytes(selected, &changed);
+  for (std::size_t i = 0; i < expected.size(); ++i) {
+    STEGO_TEST_CHECK(changed[expected[i]] == (image[expected[i]] ^ 0x01), -1);
+    changed[expected[i]] ^= 0x01;
+  }
+  STEGO_TEST_CHECK(changed == image, -1);
+
+  return 0;
+}
+
+static MemoryBuffer RandomImage(std::mt19937 &random, uint32 width,
+                                uint32 height) {
+  // few distinct values make equal pixels (and rejected blocks) common
+  uint32 levels = std::uniform_int_distribution<uint32>(1, 12)(random);
+  if (levels > 8) levels = 256;
+  std::uniform_int_distribution<uint32> pixel(0, levels - 1);
+
+  MemoryBuffer image(static_cast<std::size_t>(width) * height);
+  for (std::size_t i = 0; i < image.GetSize(); ++i)
+    image[i] = static_cast<uint8>(100 + pixel(random));
+
+  return image;
+}
+
+static int TestRandomImages() {
+  std::mt19937 random(2016);
+  std::uniform_int_distribution<uint32> small(1, 400);
+  std::uniform_int_distribution<uint32> large(1000, 3000);
+
+  // a few images are large enough to be split between threads
+  for (int test = 0; test < 300; ++test) {
+    bool is_large = test % 30 == 0;
+    uint32 width = is_large ? large(random) : small(random);
+    uint32 height = is_large ? large(random) : small(random);
+    MemoryBuffer image = RandomImage(random, width, height);
+
+    if (CheckSelection(image, width, height)) {
+      std::cout << "selection differs for " << width << "x" << height
+                << " image" << std::endl;
+      return -1;
+    }
+  }
+
+  return 0;
+}
+
+static int TestPoolWorker() {
+  std::mt19937 random(3);
+  const uint32 width = 2001;
+  const uint32 height = 1500;
+  MemoryBuffer image = RandomImage(random, width, height);
+
+  STEGO_TEST_CHECK(!ThreadPool::IsWorkerThread(), -1);
+
+  ThreadPool pool(2);
+  auto worker = pool.enqueue([]() { return ThreadPool::IsWorkerThread(); });
+  STEGO_TEST_CHECK(worker.get(), -1);
+
+  auto result = pool.enqueue(&CheckSelection, std::cref(image), width, height);
+  STEGO_TEST_CHECK(result.get() == 0, -1);
+
+  return 0;
+}
+
+int main() {
+  std::string logging_level("ERROR");
+  if (getenv("LOGGING_LEVEL"))
+    logging_level.assign(getenv("LOGGING_LEVEL"));
+  Logger::SetVerbosityLevel(logging_level, std::string("cout"));
+
+  STEGO_TEST_CHECK(TestRandomImages() == 0, -1);
+  STEGO_TEST_CHECK(TestPoolWorker() == 0, -1);
+
+  std::cout << "OK" << std::endl;
+  return 0;
+}
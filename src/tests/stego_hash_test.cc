@@ -0,0 +1,261 @@
+/**
+* @file stego_hash_test.cc
+* @author Martin Kosdy
+* @author Matus Kysel
+* @date 2016
+* @brief Known-answer tests of hash functions and derived keys
+*
+* Round-trip tests of the storage use the same hash for writing and
+* reading, so they can't detect a change of its output. Digests here
+* are fixed: Keccak (original padding, as used by this library),
+* KangarooTwelve (RFC 9861) and keys derived from a fixed password as
+* computed by earlier versions.
+*/
+
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "hash/hash.h"
+#include "hash/kangaroo_twelve_hash_impl.h"
+#include "hash/keccak_hash_impl.h"
+#include "keys/key.h"
+#include "logging/logger.h"
+#include "permutations/feistel_mix_permutation.h"
+#include "permutations/feistel_num_permutation.h"
+
+#include "test_assert_helper.h"
+
+using namespace stego_disk;
+
+struct DigestVector {
+  std::size_t state_size;
+  std::string message;
+  std::string digest;
+};
+
+static std::string ToHex(const uint8 *data, std::size_t length) {
+  static const char digits[] = "0123456789abcdef";
+  std::string hex;
+  for (std::size_t i = 0; i < length; ++i) {
+    hex += digits[data[i] >> 4];
+    hex += digits[data[i] & 0x0F];
+  }
+  return hex;
+}
+
+static std::string ToHex(const MemoryBuffer &buffer) {
+  return ToHex(buffer.GetConstRawPointer(), buffer.GetSize());
+}
+
+// message of 'length' bytes, longer than the rate of all digest sizes
+static std::vector<uint8> Pattern(std::size_t length, uint8 shift = 0) {
+  std::vector<uint8> data(length);
+  for (std::size_t i = 0; i < length; ++i)
+    data[i] = static_cast<uint8>(i * 7 + 3 + shift);
+  return data;
+}
+
+static std::string PatternString(std::size_t length) {
+  std::vector<uint8> data = Pattern(length);
+  return std::string(data.begin(), data.end());
+}
+
+static int TestKeccak() {
+  const std::vector<DigestVector> vectors = {
+    { 32, "", "c5d2460186f7233c927e7db2dcc703c0e500b653ca82273b7bfad8045d85a470" },
+    { 28, "abc", "c30411768506ebe1c2871b1ee2e87d38df342317300a9b97a95ec6a8" },
+    { 32, "abc", "4e03657aea45a94fc7d47ba826c8d667c0d1e6e33a64a036ec44f58fa12d6c45" },
+    { 48, "abc", "f7df1165f033337be098e7d288ad6a2f74409d7a60b49c36642218de161b1f99"
+                 "f8c681e4afaf31a34db29fb763e3c28e" },
+    { 64, "abc", "18587dc2ea106b9a1563e32b3312421ca164c7f1f07bc922a9c83d77cea3a1e5"
+                 "d0c69910739025372dc14ac9642629379540c17e2a65b19d77aa511a9d00bb96" },
+    { 32, PatternString(1000),
+      "80cdc8dd52cbb3dbaea8f383209893fa2bb52efbd5aedbb4b26dcfe307fcdc9b" },
+    { 64, PatternString(1000),
+      "d9b704aa601fdc425139fd2a6b3965b90d1bad81751bcf94591f532881d657a8"
+      "56a0fc6196b762843ef4ceac0504872bf2d94d9c64e68a3594b5808c42bc0b99" },
+  };
+
+  for (auto &vector : vectors) {
+    KeccakHashImpl impl(vector.state_size);
+    const uint8 *message = reinterpret_cast<const uint8 *>(vector.message.data());
+
+    MemoryBuffer state(vector.state_size);
+    impl.Process(state, message, vector.message.size());
+    STEGO_TEST_CHECK(ToHex(state) == vector.digest, -1);
+
+    // streaming in pieces which are not aligned to the rate
+    for (std::size_t piece : { std::size_t(1), std::size_t(13),
+                               std::size_t(136), std::size_t(137) }) {
+      HashContext context;
+      std::vector<uint8> digest(vector.state_size);
+      impl.Init(context);
+      for (std::size_t offset = 0; offset < vector.message.size();
+           offset += piece)
+        impl.Update(context, message + offset,
+                    std::min(piece, vector.message.size() - offset));
+      impl.Final(context, digest.data());
+      STEGO_TEST_CHECK(ToHex(digest.data(), digest.size()) == vector.digest, -1);
+    }
+  }
+
+  return 0;
+}
+
+static int TestKeccakMany() {
+  // two groups of 4 messages (multi-buffer path) and a single one
+  const std::size_t count = 9;
+  const std::size_t length = 1000;
+
+  for (std::size_t state_size : { std::size_t(32), std::size_t(64) }) {
+    KeccakHashImpl impl(state_size);
+
+    std::vector<std::vector<uint8>> messages;
+    std::vector<std::vector<uint8>> digests(count,
+                                            std::vector<uint8>(state_size));
+    std::vector<const uint8 *> inputs;
+    std::vector<uint8 *> outputs;
+    for (std::size_t i = 0; i < count; ++i)
+      messages.push_back(Pattern(length, static_cast<uint8>(i)));
+    for (std::size_t i = 0; i < count; ++i) {
+      inputs.push_back(messages[i].data());
+      outputs.push_back(digests[i].data());
+    }
+
+    impl.ProcessMany(inputs.data(), length, outputs.data(), count);
+
+    for (std::size_t i = 0; i < count; ++i) {
+      MemoryBuffer state(state_size);
+      impl.Process(state, messages[i].data(), length);
+      STEGO_TEST_CHECK(ToHex(digests[i].data(), state_size) == ToHex(state), -1);
+    }
+
+    std::string expected = state_size == 32
+      ? "80cdc8dd52cbb3dbaea8f383209893fa2bb52efbd5aedbb4b26dcfe307fcdc9b"
+      : "d9b704aa601fdc425139fd2a6b3965b90d1bad81751bcf94591f532881d657a8"
+        "56a0fc6196b762843ef4ceac0504872bf2d94d9c64e68a3594b5808c42bc0b99";
+    STEGO_TEST_CHECK(ToHex(digests[0].data(), state_size) == expected, -1);
+  }
+
+  return 0;
+}
+
+// test pattern of RFC 9861: bytes 00 01 .. FA repeated
+static std::string RfcPattern(std::size_t length) {
+  std::string data(length, '\0');
+  for (std::size_t i = 0; i < length; ++i)
+    data[i] = static_cast<char>(i % 251);
+  return data;
+}
+
+static int TestKangarooTwelve() {
+  // RFC 9861, KT128 with empty customization string
+  const std::vector<DigestVector> vectors = {
+    { 32, "", "1ac2d450fc3b4205d19da7bfca1b37513c0803577ac7167f06fe2ce1f0ef39e5" },
+    { 64, "", "1ac2d450fc3b4205d19da7bfca1b37513c0803577ac7167f06fe2ce1f0ef39e5"
+              "4269c056b8c82e48276038b6d292966cc07a3d4645272e31ff38508139eb0a71" },
+    { 32, RfcPattern(17),
+      "6bf75fa2239198db4772e36478f8e19b0f371205f6a9a93a273f51df37122888" },
+    { 32, RfcPattern(289),
+      "0c315ebcdedbf61426de7dcf8fb725d1e74675d7f5327a5067f367b108ecb67c" },
+    { 32, RfcPattern(4913),
+      "cb552e2ec77d9910701d578b457ddf772c12e322e4ee7fe417f92c758f0d59d0" },
+    { 32, RfcPattern(83521),
+      "8701045e22205345ff4dda05555cbb5c3af1a771c2b89baef37db43d9998b9fe" },
+    { 32, RfcPattern(1419857),
+      "844d610933b1b9963cbdeb5ae3b6b05cc7cbd67ceedf883eb678a0a8e0371682" },
+  };
+
+  for (auto &vector : vectors) {
+    KangarooTwelveHashImpl impl(vector.state_size);
+    const uint8 *message = reinterpret_cast<const uint8 *>(vector.message.data());
+
+    MemoryBuffer state(vector.state_size);
+    impl.Process(state, message, vector.message.size());
+    STEGO_TEST_CHECK(ToHex(state) == vector.digest, -1);
+
+    // streaming in pieces around the chunk size
+    for (std::size_t piece : { std::size_t(1000), std::size_t(8191),
+                               std::size_t(8192), std::size_t(8193) }) {
+      HashContext context;
+      std::vector<uint8> digest(vector.state_size);
+      impl.Init(context);
+      for (std::size_t offset = 0; offset < vector.message.size();
+           offset += piece)
+        impl.Update(context, message + offset,
+                    std::min(piece, vector.message.size() - offset));
+      impl.Final(context, digest.data());
+      STEGO_TEST_CHECK(ToHex(digest.data(), digest.size()) == vector.digest, -1);
+    }
+  }
+
+  // Hash instances use the implementation set for their purpose
+  std::shared_ptr<HashImpl> keys = Hash::GetHashImpl(Hash::Purpose::KEYS);
+  Hash::SetHashImpl(Hash::Purpose::STORAGE,
+                    std::make_shared<KangarooTwelveHashImpl>());
+  Hash storage_hash(Hash::Purpose::STORAGE);
+  storage_hash.Process(RfcPattern(17));
+  STEGO_TEST_CHECK(ToHex(storage_hash.GetState()) ==
+                   "6bf75fa2239198db4772e36478f8e19b"
+                   "0f371205f6a9a93a273f51df37122888", -1);
+  STEGO_TEST_CHECK(Hash::GetHashImpl(Hash::Purpose::KEYS) == keys, -1);
+  Hash::SetHashImpl(Hash::Purpose::STORAGE, std::make_shared<KeccakHashImpl>());
+
+  return 0;
+}
+
+/**
+ * @brief Keys derived from a fixed password, as by CarrierFilesManager
+ *        (Key::FromString, Hash::Append) and Feistel round tables
+ */
+static int TestDerivedKeys() {
+  Key key = Key::FromString("heslo");
+  STEGO_TEST_CHECK(ToHex(key.GetData()) ==
+                   "2b5a74c8341d9c7d75aadbd324e0f54b"
+                   "8fda6df8a6fe325406fe96a6a65f26fe", -1);
+
+  Hash hash(key.GetData().GetConstRawPointer(), key.GetData().GetSize());
+  hash.Append(std::string("7"));
+  hash.Append(std::string("dir/image.bmp"));
+  STEGO_TEST_CHECK(ToHex(hash.GetState()) ==
+                   "b264223cb12da23dd18170bbe5deb946"
+                   "9ea54d0cd6949d42772ca40d17a38639", -1);
+
+  Key subkey(hash.GetState());
+  const std::vector<PermElem> mix_expected = { 123, 1044, 2167, 3945,
+                                               4660, 6399, 7409, 8298 };
+  const std::vector<PermElem> num_expected = { 21890, 5458, 54262, 93742,
+                                               65052, 79634, 15378, 81272 };
+
+  FeistelMixPermutation mix;
+  mix.Init(100000, subkey);
+  STEGO_TEST_CHECK(mix.GetSize() == 99840, -1);
+  FeistelNumPermutation num;
+  num.Init(100000, subkey);
+  STEGO_TEST_CHECK(num.GetSize() == 99856, -1);
+
+  for (std::size_t i = 0; i < mix_expected.size(); ++i) {
+    STEGO_TEST_CHECK(mix.Permute(i * 1237) == mix_expected[i], -1);
+    STEGO_TEST_CHECK(num.Permute(i * 1237) == num_expected[i], -1);
+  }
+
+  return 0;
+}
+
+int main() {
+  std::string logging_level("ERROR");
+  if (getenv("LOGGING_LEVEL"))
+    logging_level.assign(getenv("LOGGING_LEVEL"));
+  Logger::SetVerbosityLevel(logging_level, std::string("cout"));
+
+  STEGO_TEST_CHECK(TestKeccak() == 0, -1);
+  STEGO_TEST_CHECK(TestKeccakMany() == 0, -1);
+  STEGO_TEST_CHECK(TestKangarooTwelve() == 0, -1);
+  STEGO_TEST_CHECK(TestDerivedKeys() == 0, -1);
+
+  std::cout << "OK" << std::endl;
+  return 0;
+}
@@ -0,0 +1,216 @@
+/**
+* @file stego_large_domain_test.cc
+* @author Martin Kosdy
+* @author Matus Kysel
+* @date 2016
+* @brief Tests of permutations and carriers with domains beyond 2^32
+*
+*/
+
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "carrier_files/carrier_file.h"
+#include "encoders/encoder_factory.h"
+#include "keys/key.h"
+#include "logging/logger.h"
+#include "permutations/affine_permutation.h"
+#include "permutations/blocked_permutation.h"
+#include "permutations/permutation_factory.h"
+#include "utils/stego_math.h"
+
+#include "test_assert_helper.h"
+
+using namespace stego_disk;
+
+static const uint64 k2To32 = 1ULL << 32;
+
+// number of consecutive indices checked at each probed position
+static const uint64 kSampleRun = 1 << 12;
+
+/**
+ * Carrier without a file, only its raw capacity is set.
+ * Allows to exercise the block-count machinery with capacities
+ * which could not be loaded into memory.
+ */
+class SyntheticCarrier : public CarrierFile {
+public:
+  SyntheticCarrier(uint64 raw_capacity,
+                   std::shared_ptr<Encoder> encoder,
+                   std::shared_ptr<Permutation> permutation)
+    : CarrierFile(File("", "synthetic"), encoder, permutation, nullptr) {
+    raw_capacity_ = raw_capacity;
+  }
+
+  virtual void LoadFile() { file_loaded_ = true; }
+  virtual void SaveFile() {}
+};
+
+static Key TestKey() {
+  MemoryBuffer key_data(32);
+  for (std::size_t i = 0; i < key_data.GetSize(); ++i)
+    key_data[i] = static_cast<uint8>(i * 13 + 5);
+  return Key(key_data);
+}
+
+/**
+ * @brief Permutes runs of indices at the start, around multiples of 2^32
+ * and at the end of the domain; all results have to be in the domain and
+ * distinct, some of them have to be beyond 32 bits.
+ */
+static int CheckPermutation(Permutation &permutation) {
+  PermElem size = permutation.GetSize();
+  STEGO_TEST_CHECK(size > k2To32, -1);
+
+  std::vector<PermElem> starts = { 0, k2To32 - kSampleRun / 2,
+                                   size / 2, size - kSampleRun };
+  for (PermElem start = 2 * k2To32; start + kSampleRun <= size;
+       start += k2To32)
+    starts.push_back(start - kSampleRun / 2);
+
+  // runs can overlap, each index is permuted once
+  std::vector<PermElem> indices;
+  for (PermElem start : starts)
+    for (PermElem i = start; i < start + kSampleRun; ++i)
+      indices.push_back(i);
+  std::sort(indices.begin(), indices.end());
+  indices.erase(std::unique(indices.begin(), indices.end()), indices.end());
+
+  std::vector<PermElem> values;
+  for (PermElem index : indices)
+    values.push_back(permutation.Permute(index));
+
+  std::sort(values.begin(), values.end());
+  STEGO_TEST_CHECK(values.back() < size, -1);
+  STEGO_TEST_CHECK(values.back() >= k2To32, -1);
+  STEGO_TEST_CHECK(std::adjacent_find(values.begin(), values.end()) ==
+                   values.end(), -1);
+
+  return 0;
+}
+
+static int TestPermutations(Key &key) {
+  std::vector<PermElem> sizes = { (1ULL << 33) + 12345, (1ULL << 35) - 1 };
+
+  for (auto permutation : PermutationFactory::GetPermutations()) {
+    for (PermElem requested : sizes) {
+      PermElem expected = permutation->GetSizeUsingParams(requested, key);
+      STEGO_TEST_CHECK(expected <= requested, -1);
+      STEGO_TEST_CHECK(expected > requested / 2, -1);
+
+      permutation->Init(requested, key);
+      STEGO_TEST_CHECK(permutation->GetSize() == expected, -1);
+
+      if (CheckPermutation(*permutation)) {
+        std::cout << permutation->GetNameInstance() << " failed at size "
+                  << requested << std::endl;
+        return -1;
+      }
+    }
+  }
+
+  // affine iterator has to follow Permute across 2^32
+  AffinePermutation affine;
+  affine.Init((1ULL << 34) + 3, key);
+  PermElem start = k2To32 - kSampleRun / 2;
+  auto it = affine.IteratorAt(start);
+  for (PermElem i = start; i < start + kSampleRun; ++i, ++it)
+    STEGO_TEST_CHECK(*it == affine.Permute(i), -1);
+
+  return 0;
+}
+
+/**
+ * @brief In-line permutations of BlockedPermutation are bijections of
+ * the line and bits of the offset are mixed: a bit of the result equals
+ * the same bit of the offset (or its negation) in only a few lines
+ */
+static int TestInLinePermutation(Key &key) {
+  typedef BlockedFeistelMixPermutation Blocked;
+  const PermElem lines = 1024;
+  Blocked permutation;
+  permutation.Init(1ULL << 20, key);
+
+  PermElem unmixed[Blocked::kLineBits] = { 0 };
+  for (PermElem line = 0; line < lines; ++line) {
+    uint64 line_key = permutation.LineKey(line);
+    std::vector<PermElem> values;
+    PermElem kept[Blocked::kLineBits] = { 0 };
+    for (PermElem offset = 0; offset < Blocked::kLineSize; ++offset) {
+      PermElem value = Blocked::PermuteInLine(line_key, offset);
+      values.push_back(value);
+      for (uint8 bit = 0; bit < Blocked::kLineBits; ++bit)
+        kept[bit] += (((value ^ offset) >> bit) & 1) ^ 1;
+    }
+    std::sort(values.begin(), values.end());
+    for (PermElem offset = 0; offset < Blocked::kLineSize; ++offset)
+      STEGO_TEST_CHECK(values[offset] == offset, -1);
+    for (uint8 bit = 0; bit < Blocked::kLineBits; ++bit)
+      if (kept[bit] == 0 || kept[bit] == Blocked::kLineSize)
+        ++unmixed[bit];
+  }
+  for (uint8 bit = 0; bit < Blocked::kLineBits; ++bit)
+    STEGO_TEST_CHECK(unmixed[bit] < lines / 64, -1);
+
+  return 0;
+}
+
+static int TestIntegerSqrt() {
+  std::vector<uint64> roots = { 1, 2, 65535, 65536, 94906265, 94906266,
+                                (1ULL << 32) - 1 };
+  for (uint64 root : roots) {
+    uint64 square = root * root;
+    STEGO_TEST_CHECK(StegoMath::IntegerSqrt(square) == root, -1);
+    STEGO_TEST_CHECK(StegoMath::IntegerSqrt(square - 1) == root - 1, -1);
+    if (root < (1ULL << 32) - 1)
+      STEGO_TEST_CHECK(StegoMath::IntegerSqrt(square + 2 * root) == root, -1);
+  }
+  STEGO_TEST_CHECK(StegoMath::IntegerSqrt(~0ULL) == (1ULL << 32) - 1, -1);
+  return 0;
+}
+
+static int TestCarriers(Key &key) {
+  // 2^43 bits in a single carrier
+  const uint64 raw_capacity = 1ULL << 40;
+
+  for (auto encoder : EncoderFactory::GetEncoders()) {
+    for (auto permutation : PermutationFactory::GetPermutations()) {
+      SyntheticCarrier carrier(raw_capacity, encoder, permutation);
+      carrier.SetSubkey(key);
+      carrier.SetEncoder(encoder);
+
+      uint64 block_count = (permutation->GetSizeUsingParams(raw_capacity * 8,
+                                                            key) / 8)
+                           / encoder->GetCodewordBlockSize();
+
+      STEGO_TEST_CHECK(carrier.GetBlockCount() == block_count, -1);
+      STEGO_TEST_CHECK(carrier.GetBlockCount() > k2To32, -1);
+      STEGO_TEST_CHECK(carrier.GetCapacity() ==
+                       block_count * encoder->GetDataBlockSize(), -1);
+      STEGO_TEST_CHECK(carrier.GetCapacity() > k2To32, -1);
+    }
+  }
+
+  return 0;
+}
+
+int main() {
+  std::string logging_level("ERROR");
+  if (getenv("LOGGING_LEVEL"))
+    logging_level.assign(getenv("LOGGING_LEVEL"));
+  Logger::SetVerbosityLevel(logging_level, std::string("cout"));
+
+  Key key = TestKey();
+
+  STEGO_TEST_CHECK(TestIntegerSqrt() == 0, -1);
+  STEGO_TEST_CHECK(TestPermutations(key) == 0, -1);
+  STEGO_TEST_CHECK(TestInLinePermutation(key) == 0, -1);
+  STEGO_TEST_CHECK(TestCarriers(key) == 0, -1);
+
+  std::cout << "OK" << std::endl;
+  return 0;
+}
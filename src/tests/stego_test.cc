@@ -12,6 +12,7 @@
 #include <cstring>
 
 #include "stego_storage.h"
+#include "utils/stego_config.h"
 #include "logging/logger.h"
 
 #include "test_assert_helper.h"
@@ -41,6 +42,9 @@ static void PrintHelp(char *name) {
             << "\t-h,--help\t\tShow this help message\n"
             << "\t-e,--encoder ENCODER\tSpecify the encoder\n"
             << "\t-p,--permutation PERMUTATION\tSpecify the permutation\n"
+            << "\t-k,--key_hash HASH\tSpecify the hash of keys\n"
+            << "\t-s,--storage_hash HASH\tSpecify the hash of the storage\n"
+            << "\t-a,--encoder_arg NAME=VALUE\tSet parameter of the encoder\n"
             << "\t-g,--gen_file_size GEN_SIZE\tSpecify size of generated data\n"
             << "\t-%,--percent PERCENT\tSpecify percentage of carrier loading\n"
             << "\t-d,--directory DIRECTORY\tSpecify the source directory\n"
@@ -75,11 +79,34 @@ stego_disk::PermutationFactory::PermutationType StrToPermutation(std::string &pe
     return stego_disk::PermutationFactory::PermutationType::FEISTEL_NUM;
   } else if (permutation == "mix_feistel"){
     return stego_disk::PermutationFactory::PermutationType::FEISTEL_MIX;
+  } else if (permutation == "num_feistel_exact") {
+    return stego_disk::PermutationFactory::PermutationType::FEISTEL_NUM_EXACT;
+  } else if (permutation == "mix_feistel_exact") {
+    return stego_disk::PermutationFactory::PermutationType::FEISTEL_MIX_EXACT;
+  } else if (permutation == "arx_feistel") {
+    return stego_disk::PermutationFactory::PermutationType::ARX_FEISTEL;
+  } else if (permutation == "mix_feistel_blocked") {
+    return stego_disk::PermutationFactory::PermutationType::FEISTEL_MIX_BLOCKED;
   } else {
     return stego_disk::PermutationFactory::GetDefaultPermutationType();
   }
 }
 
+// configures the storage, encoder_arg is NAME=VALUE or empty
+void Configure(stego_disk::StegoStorage *stego_storage, std::string &encoder,
+               std::string &permutation, std::string &key_hash,
+               std::string &storage_hash, const std::string &encoder_arg) {
+  stego_storage->Configure(StrToEncoder(encoder), StrToPermutation(permutation),
+                           StrToPermutation(permutation),
+                           stego_disk::HashFactory::GetHashType(key_hash),
+                           stego_disk::HashFactory::GetHashType(storage_hash));
+  if (!encoder_arg.empty()) {
+    std::size_t separator = encoder_arg.find('=');
+    stego_disk::StegoConfig::encoder_args()[encoder_arg.substr(0, separator)] =
+        encoder_arg.substr(separator + 1);
+  }
+}
+
 int main(int argc, char *argv[]) {
   bool error = false;
 
@@ -90,6 +117,9 @@ int main(int argc, char *argv[]) {
 
   std::string encoder;
   std::string permutation;
+  std::string key_hash;
+  std::string storage_hash;
+  std::string encoder_arg;
   std::string file_type;
   std::string dir;
   bool test_directory = false;
@@ -121,6 +151,31 @@ int main(int argc, char *argv[]) {
         LOG_ERROR("--permutation option requires one argument.");
         return -1;
       }
+    } else if ((arg == "-k") || (arg == "--key_hash")) {
+      if (++i < argc) {
+        key_hash = argv[i];
+      } else {
+        LOG_ERROR("--key_hash option requires one argument.");
+        return -1;
+      }
+    } else if ((arg == "-s") || (arg == "--storage_hash")) {
+      if (++i < argc) {
+        storage_hash = argv[i];
+      } else {
+        LOG_ERROR("--storage_hash option requires one argument.");
+        return -1;
+      }
+    } else if ((arg == "-a") || (arg == "--encoder_arg")) {
+      if (i + 1 < argc) {
+        encoder_arg = argv[++i];
+        if (encoder_arg.find('=') == std::string::npos) {
+          LOG_ERROR("--encoder_arg option requires NAME=VALUE.");
+          return -1;
+        }
+      } else {
+        LOG_ERROR("--encoder_arg option requires one argument.");
+        return -1;
+      }
     } else if ((arg == "-g") || (arg == "--gen_file_size")) {
       if (++i < argc) {
         gen_file_size = static_cast<size_t>(atoi(argv[i]));
@@ -184,8 +239,8 @@ int main(int argc, char *argv[]) {
     LOG_ERROR("directory was not set");
     return false;
   }
-  stego_storage->Configure(StrToEncoder(encoder), StrToPermutation(permutation),
-                           StrToPermutation(permutation));
+  Configure(stego_storage.get(), encoder, permutation, key_hash, storage_hash,
+            encoder_arg);
   LOG_DEBUG("Opening storage");
   stego_storage->Open(dir, (password) ? PASSWORD : "");
   LOG_DEBUG("Loading storage");
@@ -214,8 +269,8 @@ int main(int argc, char *argv[]) {
   stego_storage->Save();
 
   LOG_DEBUG("Opening storage");
-  stego_storage->Configure(StrToEncoder(encoder), StrToPermutation(permutation),
-                           StrToPermutation(permutation));
+  Configure(stego_storage.get(), encoder, permutation, key_hash, storage_hash,
+            encoder_arg);
   stego_storage->Open(dir, (password) ? PASSWORD : "");
   LOG_DEBUG("Loading storage");
   stego_storage->Load();
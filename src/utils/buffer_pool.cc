@@ -0,0 +1,195 @@
+/**
+* @file buffer_pool.cc
+* @author Martin Kosdy
+* @author Matus Kysel
+* @date 2016
+* @brief Implementation of size-class pool of memory blocks
+*
+*/
+
+#include "buffer_pool.h"
+
+#include <atomic>
+#include <mutex>
+#include <vector>
+
+namespace stego_disk {
+
+struct BlockCache {
+  BlockCache() : bytes(0) {}
+
+  std::vector<uint8*> blocks[BufferPool::kClassCount];
+  std::size_t bytes;
+};
+
+struct GlobalBlockCache {
+  std::mutex mutex;
+  BlockCache cache;
+};
+
+struct ThreadBlockCache {
+  ~ThreadBlockCache();
+
+  BlockCache cache;
+};
+
+static std::atomic<uint64> allocation_count(0);
+static std::atomic<uint64> reuse_count(0);
+
+// never destroyed, blocks may be released while static objects are destroyed
+static GlobalBlockCache& GlobalCache() {
+  static GlobalBlockCache *cache = new GlobalBlockCache();
+  return *cache;
+}
+
+static thread_local ThreadBlockCache thread_cache;
+// set when thread_cache is destroyed (at thread exit)
+static thread_local bool thread_cache_destroyed = false;
+
+// index of the smallest class with capacity >= size, kClassCount if none
+static std::size_t ClassIndex(std::size_t size) {
+  const std::size_t min_class = std::size_t(1) << BufferPool::kMinClassBits;
+  if (size <= min_class) return 0;
+
+  // 2^bits <= size - 1 < 2^(bits + 1)
+  std::size_t bits = BufferPool::kMinClassBits;
+  while (bits < BufferPool::kMaxClassBits && ((size - 1) >> (bits + 1)))
+    ++bits;
+  if (bits >= BufferPool::kMaxClassBits) return BufferPool::kClassCount;
+
+  std::size_t base = std::size_t(1) << bits;
+  std::size_t step = base / BufferPool::kSubclasses;
+  std::size_t subclass = (size - base + step - 1) / step;
+
+  return (bits - BufferPool::kMinClassBits) * BufferPool::kSubclasses +
+         subclass;
+}
+
+static std::size_t ClassCapacity(std::size_t index) {
+  if (index == 0) return std::size_t(1) << BufferPool::kMinClassBits;
+
+  std::size_t bits = (index - 1) / BufferPool::kSubclasses +
+                     BufferPool::kMinClassBits;
+  std::size_t subclass = (index - 1) % BufferPool::kSubclasses + 1;
+  std::size_t base = std::size_t(1) << bits;
+
+  return base + subclass * (base / BufferPool::kSubclasses);
+}
+
+static void FreeBlocks(BlockCache *cache) {
+  for (auto &blocks : cache->blocks) {
+    for (uint8 *block : blocks) delete[] block;
+    blocks.clear();
+  }
+  cache->bytes = 0;
+}
+
+static bool ReleaseToGlobal(uint8 *block, std::size_t index,
+                            std::size_t capacity) {
+  GlobalBlockCache &global = GlobalCache();
+  std::lock_guard<std::mutex> lock(global.mutex);
+  if (global.cache.bytes + capacity > BufferPool::kGlobalCacheBytes)
+    return false;
+
+  global.cache.blocks[index].push_back(block);
+  global.cache.bytes += capacity;
+  return true;
+}
+
+ThreadBlockCache::~ThreadBlockCache() {
+  thread_cache_destroyed = true;
+
+  for (std::size_t index = 0; index < BufferPool::kClassCount; ++index) {
+    std::size_t capacity = ClassCapacity(index);
+    for (uint8 *block : cache.blocks[index]) {
+      if (!ReleaseToGlobal(block, index, capacity)) delete[] block;
+    }
+    cache.blocks[index].clear();
+  }
+  cache.bytes = 0;
+}
+
+std::size_t BufferPool::GetClassCapacity(std::size_t size) {
+  std::size_t index = ClassIndex(size);
+  if (index == kClassCount) return size;
+  return ClassCapacity(index);
+}
+
+uint8* BufferPool::Allocate(std::size_t size, std::size_t *capacity) {
+  allocation_count.fetch_add(1, std::memory_order_relaxed);
+
+  std::size_t index = ClassIndex(size);
+  if (index == kClassCount) {
+    *capacity = size;
+    return new uint8[size];
+  }
+  *capacity = ClassCapacity(index);
+
+  if (!thread_cache_destroyed) {
+    BlockCache &cache = thread_cache.cache;
+    if (!cache.blocks[index].empty()) {
+      uint8 *block = cache.blocks[index].back();
+      cache.blocks[index].pop_back();
+      cache.bytes -= *capacity;
+      reuse_count.fetch_add(1, std::memory_order_relaxed);
+      return block;
+    }
+  }
+
+  {
+    GlobalBlockCache &global = GlobalCache();
+    std::lock_guard<std::mutex> lock(global.mutex);
+    if (!global.cache.blocks[index].empty()) {
+      uint8 *block = global.cache.blocks[index].back();
+      global.cache.blocks[index].pop_back();
+      global.cache.bytes -= *capacity;
+      reuse_count.fetch_add(1, std::memory_order_relaxed);
+      return block;
+    }
+  }
+
+  return new uint8[*capacity];
+}
+
+void BufferPool::Release(uint8 *block, std::size_t capacity) {
+  if (block == nullptr) return;
+
+  std::size_t index = ClassIndex(capacity);
+  if (index == kClassCount || ClassCapacity(index) != capacity) {
+    delete[] block;
+    return;
+  }
+
+  if (!thread_cache_destroyed) {
+    BlockCache &cache = thread_cache.cache;
+    if (cache.blocks[index].size() < kThreadCacheBlocks &&
+        cache.bytes + capacity <= kThreadCacheBytes) {
+      cache.blocks[index].push_back(block);
+      cache.bytes += capacity;
+      return;
+    }
+  }
+
+  if (!ReleaseToGlobal(block, index, capacity)) delete[] block;
+}
+
+BufferPool::Stats BufferPool::GetStats() {
+  Stats stats;
+  stats.allocations = allocation_count.load(std::memory_order_relaxed);
+  stats.reused = reuse_count.load(std::memory_order_relaxed);
+
+  GlobalBlockCache &global = GlobalCache();
+  std::lock_guard<std::mutex> lock(global.mutex);
+  stats.cached_bytes = global.cache.bytes;
+  return stats;
+}
+
+void BufferPool::Trim() {
+  if (!thread_cache_destroyed) FreeBlocks(&thread_cache.cache);
+
+  GlobalBlockCache &global = GlobalCache();
+  std::lock_guard<std::mutex> lock(global.mutex);
+  FreeBlocks(&global.cache);
+}
+
+} // stego_disk
@@ -0,0 +1,62 @@
+/**
+* @file buffer_pool.h
+* @author Martin Kosdy
+* @author Matus Kysel
+* @date 2016
+* @brief Size-class pool of memory blocks used by MemoryBuffer
+*
+*/
+
+#ifndef STEGODISK_UTILS_BUFFERPOOL_H_
+#define STEGODISK_UTILS_BUFFERPOOL_H_
+
+#include <cstddef>
+
+#include "stego_types.h"
+
+namespace stego_disk {
+
+/**
+ * The BufferPool class.
+ *
+ * Blocks are rounded up to size classes (four classes per power of two,
+ * so at most 25 % of a block is unused). Released blocks are kept in a
+ * cache of the releasing thread, then in a global cache shared by all
+ * threads; both caches are limited in size. Blocks bigger than the
+ * largest class are allocated and freed directly.
+ *
+ * Blocks are returned with their previous content; MemoryBuffer wipes
+ * its data before releasing them.
+ */
+class BufferPool {
+public:
+  struct Stats {
+    uint64 allocations;     // all Allocate calls
+    uint64 reused;          // served from a cache
+    uint64 cached_bytes;    // currently held by the global cache
+  };
+
+  // returns block of at least 'size' bytes, its real size is in 'capacity'
+  static uint8* Allocate(std::size_t size, std::size_t *capacity);
+  static void Release(uint8 *block, std::size_t capacity);
+
+  static Stats GetStats();
+  // frees all blocks of the global cache and of the calling thread's cache
+  static void Trim();
+
+  static std::size_t GetClassCapacity(std::size_t size);
+
+  static const std::size_t kMinClassBits = 6;            // 64 B
+  static const std::size_t kMaxClassBits = 30;           // 1 GB
+  static const std::size_t kSubclasses = 4;              // per power of two
+  static const std::size_t kClassCount =
+      (kMaxClassBits - kMinClassBits) * kSubclasses + 1;
+
+  static const std::size_t kThreadCacheBytes = 64 << 20;
+  static const std::size_t kThreadCacheBlocks = 4;       // per class
+  static const std::size_t kGlobalCacheBytes = 256 << 20;
+};
+
+} // stego_disk
+
+#endif // STEGODISK_UTILS_BUFFERPOOL_H_
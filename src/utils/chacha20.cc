@@ -0,0 +1,179 @@
+/**
+* @file chacha20.cc
+* @author Martin Kosdy
+* @author Matus Kysel
+* @date 2016
+* @brief Implementation of ChaCha20 keystream
+*
+*/
+
+#include "chacha20.h"
+
+#include <string.h>
+
+#include <algorithm>
+#include <random>
+
+#include "memory_buffer.h"
+#include "thread_pool.h"
+
+namespace stego_disk {
+
+static inline uint32 Rotate(uint32 value, int bits) {
+  return (value << bits) | (value >> (32 - bits));
+}
+
+static inline uint32 Load32(const uint8 *in) {
+  return static_cast<uint32>(in[0]) | (static_cast<uint32>(in[1]) << 8) |
+         (static_cast<uint32>(in[2]) << 16) | (static_cast<uint32>(in[3]) << 24);
+}
+
+static inline void Store32(uint8 *out, uint32 value) {
+  out[0] = static_cast<uint8>(value);
+  out[1] = static_cast<uint8>(value >> 8);
+  out[2] = static_cast<uint8>(value >> 16);
+  out[3] = static_cast<uint8>(value >> 24);
+}
+
+// quarter round on all lanes, the inner loop is vectorized
+#define CHACHA_QUARTER_ROUND(x, a, b, c, d)                                   \
+  for (std::size_t l = 0; l < ChaCha20::kLanes; ++l) {                        \
+    x[a][l] += x[b][l]; x[d][l] = Rotate(x[d][l] ^ x[a][l], 16);              \
+    x[c][l] += x[d][l]; x[b][l] = Rotate(x[b][l] ^ x[c][l], 12);              \
+    x[a][l] += x[b][l]; x[d][l] = Rotate(x[d][l] ^ x[a][l], 8);               \
+    x[c][l] += x[d][l]; x[b][l] = Rotate(x[b][l] ^ x[c][l], 7);               \
+  }
+
+// computes kLanes consecutive blocks starting at 'block'
+static void Blocks(const uint32 *input, uint64 block, uint8 *out) {
+  uint32 x[16][ChaCha20::kLanes];
+  uint32 j[16][ChaCha20::kLanes];
+
+  for (std::size_t i = 0; i < 16; ++i)
+    for (std::size_t l = 0; l < ChaCha20::kLanes; ++l)
+      x[i][l] = input[i];
+  for (std::size_t l = 0; l < ChaCha20::kLanes; ++l) {
+    x[12][l] = static_cast<uint32>(block + l);
+    x[13][l] = static_cast<uint32>((block + l) >> 32);
+  }
+  memcpy(j, x, sizeof(x));
+
+  for (int round = 0; round < 20; round += 2) {
+    CHACHA_QUARTER_ROUND(x, 0, 4, 8, 12)
+    CHACHA_QUARTER_ROUND(x, 1, 5, 9, 13)
+    CHACHA_QUARTER_ROUND(x, 2, 6, 10, 14)
+    CHACHA_QUARTER_ROUND(x, 3, 7, 11, 15)
+    CHACHA_QUARTER_ROUND(x, 0, 5, 10, 15)
+    CHACHA_QUARTER_ROUND(x, 1, 6, 11, 12)
+    CHACHA_QUARTER_ROUND(x, 2, 7, 8, 13)
+    CHACHA_QUARTER_ROUND(x, 3, 4, 9, 14)
+  }
+
+  for (std::size_t l = 0; l < ChaCha20::kLanes; ++l)
+    for (std::size_t i = 0; i < 16; ++i)
+      Store32(out + l * ChaCha20::kBlockSize + i * 4, x[i][l] + j[i][l]);
+}
+
+#undef CHACHA_QUARTER_ROUND
+
+static void SetupInput(const uint8 key[32], const uint8 nonce[8],
+                       uint32 input[16]) {
+  // "expand 32-byte k"
+  input[0] = 0x61707865;
+  input[1] = 0x3320646e;
+  input[2] = 0x79622d32;
+  input[3] = 0x6b206574;
+  for (int i = 0; i < 8; ++i) input[4 + i] = Load32(key + i * 4);
+  input[12] = 0;
+  input[13] = 0;
+  input[14] = Load32(nonce);
+  input[15] = Load32(nonce + 4);
+}
+
+/**
+ * @brief Fills data with keystream generated on the calling thread
+ *
+ * @param[in] input Initial state (constants, key, nonce)
+ * @param[in] first_block Counter of the first block
+ * @param[out] data Output
+ * @param[in] length Output length
+ */
+void ChaCha20::GenerateRange(const uint32 *input, uint64 first_block,
+                             uint8 *data, std::size_t length) {
+  const std::size_t step = kLanes * kBlockSize;
+  std::size_t offset = 0;
+
+  for ( ; offset + step <= length; offset += step) {
+    Blocks(input, first_block, data + offset);
+    first_block += kLanes;
+  }
+
+  if (offset < length) {
+    uint8 tail[kLanes * kBlockSize];
+    Blocks(input, first_block, tail);
+    memcpy(data + offset, tail, length - offset);
+    MemoryBuffer::SecureZero(tail, sizeof(tail));
+  }
+}
+
+/**
+ * @brief Computes keystream of (key, nonce)
+ *
+ * Ranges of whole blocks are generated in parallel, when the output
+ * is large enough and more cores are available.
+ *
+ * @param[in] key 256-bit key
+ * @param[in] nonce 64-bit nonce
+ * @param[in] first_block Counter of the first block
+ * @param[out] data Output
+ * @param[in] length Output length
+ * @param[in] max_threads Maximal number of threads, 0 for number of cores
+ *                        (one on ThreadPool workers)
+ */
+void ChaCha20::Generate(const uint8 key[32], const uint8 nonce[8],
+                        uint64 first_block, uint8 *data, std::size_t length,
+                        std::size_t max_threads) {
+  if (length == 0) return;
+
+  uint32 input[16];
+  SetupInput(key, nonce, input);
+
+  // buffers wiped by ThreadPool tasks are generated on the worker,
+  // the pool already keeps the cores busy; ranges are whole multiples
+  // of kLanes blocks, so only the last one has a tail
+  try {
+    ThreadPool::ForEachRange(length, kMinBytesPerThread,
+                             [&](uint64 begin, uint64 end) {
+      GenerateRange(input, first_block + begin / kBlockSize, data + begin,
+                    static_cast<std::size_t>(end - begin));
+    }, max_threads, kLanes * kBlockSize);
+  } catch (...) {
+    MemoryBuffer::SecureZero(input, sizeof(input));
+    throw;
+  }
+
+  MemoryBuffer::SecureZero(input, sizeof(input));
+}
+
+/**
+ * @brief Fills data with cryptographically secure random bytes
+ *
+ * Key and nonce are taken from std::random_device (the system entropy
+ * source) on every call, the output is their ChaCha20 keystream.
+ *
+ * @param[out] data Output
+ * @param[in] length Output length
+ */
+void ChaCha20::FillRandom(uint8 *data, std::size_t length) {
+  if (length == 0) return;
+
+  uint8 seed[40];
+  std::random_device device;
+  for (std::size_t i = 0; i < sizeof(seed); i += 4)
+    Store32(seed + i, device());
+
+  Generate(seed, seed + 32, 0, data, length);
+  MemoryBuffer::SecureZero(seed, sizeof(seed));
+}
+
+} // stego_disk
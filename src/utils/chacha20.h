@@ -0,0 +1,49 @@
+/**
+* @file chacha20.h
+* @author Martin Kosdy
+* @author Matus Kysel
+* @date 2016
+* @brief ChaCha20 keystream used as random generator
+*
+*/
+
+#ifndef STEGODISK_UTILS_CHACHA20_H_
+#define STEGODISK_UTILS_CHACHA20_H_
+
+#include <cstddef>
+
+#include "stego_types.h"
+
+namespace stego_disk {
+
+/**
+ * The ChaCha20 class.
+ *
+ * ChaCha20 with 64-bit block counter and 64-bit nonce (the original
+ * variant by D. J. Bernstein). Several blocks are computed at once in
+ * lane-interleaved state, so the rounds are vectorized by the compiler.
+ * The stream can be started at any block, large outputs are split
+ * into ranges generated in parallel.
+ */
+class ChaCha20 {
+public:
+  // fills data with keystream under a fresh key from std::random_device
+  static void FillRandom(uint8 *data, std::size_t length);
+
+  // keystream of (key, nonce) starting at block 'first_block'
+  static void Generate(const uint8 key[32], const uint8 nonce[8],
+                       uint64 first_block, uint8 *data, std::size_t length,
+                       std::size_t max_threads = 0);
+
+  static const std::size_t kBlockSize = 64;
+  static const std::size_t kLanes = 4;                   // blocks at once
+  static const std::size_t kMinBytesPerThread = 4 << 20;
+
+private:
+  static void GenerateRange(const uint32 *input, uint64 first_block,
+                            uint8 *data, std::size_t length);
+};
+
+} // stego_disk
+
+#endif // STEGODISK_UTILS_CHACHA20_H_
@@ -4,6 +4,11 @@
 
 #include "keccak.h"
 
+#if defined(__GNUC__) && defined(__x86_64__)
+#define KECCAK_X4_AVX2
+#include <immintrin.h>
+#endif
+
 const uint64_t keccakf_rndc[24] =
 {
     0x0000000000000001ULL, 0x0000000000008082ULL, 0x800000000000808aULL,
@@ -16,95 +21,417 @@ const uint64_t keccakf_rndc[24] =
     0x8000000000008080ULL, 0x0000000080000001ULL, 0x8000000080008008ULL
 };
 
-const int keccakf_rotc[24] =
-{
-    1,  3,  6,  10, 15, 21, 28, 36, 45, 55, 2,  14,
-    27, 41, 56, 8,  25, 43, 62, 18, 39, 61, 20, 44
-};
+// apply rounds <first; last) of Keccak-f[1600] to the state
+//
+// Unrolled implementation with lanes 1, 2, 8, 12, 17 and 20 kept
+// complemented during the rounds (lane complementing transform), which
+// replaces most NOT operations in Chi by OR. Result is the same as of the
+// straightforward implementation (theta, rho, pi, chi and iota in loops).
 
-const int keccakf_piln[24] =
+static void keccak_rounds(uint64_t st[25], int first, int last)
 {
-    10, 7,  11, 17, 18, 3, 5,  16, 8,  21, 24, 4,
-    15, 23, 19, 13, 12, 2, 20, 14, 22, 9,  6,  1
-};
+    int round;
+    uint64_t Aba, Abe, Abi, Abo, Abu, Aga, Age, Agi, Ago, Agu,
+             Aka, Ake, Aki, Ako, Aku, Ama, Ame, Ami, Amo, Amu,
+             Asa, Ase, Asi, Aso, Asu;
+    uint64_t Bba, Bbe, Bbi, Bbo, Bbu, Bga, Bge, Bgi, Bgo, Bgu,
+             Bka, Bke, Bki, Bko, Bku, Bma, Bme, Bmi, Bmo, Bmu,
+             Bsa, Bse, Bsi, Bso, Bsu;
+    uint64_t Ca, Ce, Ci, Co, Cu, Da, De, Di, Do, Du;
+
+    Aba = st[0];   Abe = ~st[1];  Abi = ~st[2];  Abo = st[3];   Abu = st[4];
+    Aga = st[5];   Age = st[6];   Agi = st[7];   Ago = ~st[8];  Agu = st[9];
+    Aka = st[10];  Ake = st[11];  Aki = ~st[12]; Ako = st[13];  Aku = st[14];
+    Ama = st[15];  Ame = st[16];  Ami = ~st[17]; Amo = st[18];  Amu = st[19];
+    Asa = ~st[20]; Ase = st[21];  Asi = st[22];  Aso = st[23];  Asu = st[24];
+
+    for (round = first; round < last; round++) {
+
+        // Theta
+        Ca = Aba ^ Aga ^ Aka ^ Ama ^ Asa;
+        Ce = Abe ^ Age ^ Ake ^ Ame ^ Ase;
+        Ci = Abi ^ Agi ^ Aki ^ Ami ^ Asi;
+        Co = Abo ^ Ago ^ Ako ^ Amo ^ Aso;
+        Cu = Abu ^ Agu ^ Aku ^ Amu ^ Asu;
+        Da = Cu ^ ROTL64(Ce, 1);
+        De = Ca ^ ROTL64(Ci, 1);
+        Di = Ce ^ ROTL64(Co, 1);
+        Do = Ci ^ ROTL64(Cu, 1);
+        Du = Co ^ ROTL64(Ca, 1);
+
+        // Rho Pi Chi Iota, plane by plane
+        Bba = Aba ^ Da;
+        Bbe = ROTL64(Age ^ De, 44);
+        Bbi = ROTL64(Aki ^ Di, 43);
+        Bbo = ROTL64(Amo ^ Do, 21);
+        Bbu = ROTL64(Asu ^ Du, 14);
+        Bga = ROTL64(Abo ^ Do, 28);
+        Bge = ROTL64(Agu ^ Du, 20);
+        Bgi = ROTL64(Aka ^ Da, 3);
+        Bgo = ROTL64(Ame ^ De, 45);
+        Bgu = ROTL64(Asi ^ Di, 61);
+        Bka = ROTL64(Abe ^ De, 1);
+        Bke = ROTL64(Agi ^ Di, 6);
+        Bki = ROTL64(Ako ^ Do, 25);
+        Bko = ROTL64(Amu ^ Du, 8);
+        Bku = ROTL64(Asa ^ Da, 18);
+        Bma = ROTL64(Abu ^ Du, 27);
+        Bme = ROTL64(Aga ^ Da, 36);
+        Bmi = ROTL64(Ake ^ De, 10);
+        Bmo = ROTL64(Ami ^ Di, 15);
+        Bmu = ROTL64(Aso ^ Do, 56);
+        Bsa = ROTL64(Abi ^ Di, 62);
+        Bse = ROTL64(Ago ^ Do, 55);
+        Bsi = ROTL64(Aku ^ Du, 39);
+        Bso = ROTL64(Ama ^ Da, 41);
+        Bsu = ROTL64(Ase ^ De, 2);
+
+        Aba =   Bba  ^ (  Bbe  |  Bbi );
+        Aba ^= keccakf_rndc[round];
+        Abe =   Bbe  ^ ((~Bbi) |  Bbo );
+        Abi =   Bbi  ^ (  Bbo  &  Bbu );
+        Abo =   Bbo  ^ (  Bbu  |  Bba );
+        Abu =   Bbu  ^ (  Bba  &  Bbe );
+
+        Aga =   Bga  ^ (  Bge  |  Bgi );
+        Age =   Bge  ^ (  Bgi  &  Bgo );
+        Agi =   Bgi  ^ (  Bgo  | (~Bgu));
+        Ago =   Bgo  ^ (  Bgu  |  Bga );
+        Agu =   Bgu  ^ (  Bga  &  Bge );
+
+        Aka =   Bka  ^ (  Bke  |  Bki );
+        Ake =   Bke  ^ (  Bki  &  Bko );
+        Aki =   Bki  ^ ((~Bko) &  Bku );
+        Ako = (~Bko) ^ (  Bku  |  Bka );
+        Aku =   Bku  ^ (  Bka  &  Bke );
+
+        Ama =   Bma  ^ (  Bme  &  Bmi );
+        Ame =   Bme  ^ (  Bmi  |  Bmo );
+        Ami =   Bmi  ^ ((~Bmo) |  Bmu );
+        Amo = (~Bmo) ^ (  Bmu  &  Bma );
+        Amu =   Bmu  ^ (  Bma  |  Bme );
+
+        Asa =   Bsa  ^ ((~Bse) &  Bsi );
+        Ase = (~Bse) ^ (  Bsi  |  Bso );
+        Asi =   Bsi  ^ (  Bso  &  Bsu );
+        Aso =   Bso  ^ (  Bsu  |  Bsa );
+        Asu =   Bsu  ^ (  Bsa  &  Bse );
+    }
+
+    st[0] = Aba;   st[1] = ~Abe;  st[2] = ~Abi;  st[3] = Abo;   st[4] = Abu;
+    st[5] = Aga;   st[6] = Age;   st[7] = Agi;   st[8] = ~Ago;  st[9] = Agu;
+    st[10] = Aka;  st[11] = Ake;  st[12] = ~Aki; st[13] = Ako;  st[14] = Aku;
+    st[15] = Ama;  st[16] = Ame;  st[17] = ~Ami; st[18] = Amo;  st[19] = Amu;
+    st[20] = ~Asa; st[21] = Ase;  st[22] = Asi;  st[23] = Aso;  st[24] = Asu;
+}
 
 // update the state with given number of rounds
 
 void keccakf(uint64_t st[25], int rounds)
 {
-    int i, j, round;
-    uint64_t t, bc[5];
+    keccak_rounds(st, 0, rounds);
+}
 
-    for (round = 0; round < rounds; round++) {
+// Keccak-p[1600, 12], the last 12 rounds of Keccak-f[1600]
 
-        // Theta
-        for (i = 0; i < 5; i++)
-            bc[i] = st[i] ^ st[i + 5] ^ st[i + 10] ^ st[i + 15] ^ st[i + 20];
+void keccakp12(uint64_t st[25])
+{
+    keccak_rounds(st, 12, 24);
+}
 
-        for (i = 0; i < 5; i++) {
-            t = bc[(i + 4) % 5] ^ ROTL64(bc[(i + 1) % 5], 1);
-            for (j = 0; j < 25; j += 5)
-                st[j + i] ^= t;
-        }
+// compute a keccak hash (md) of given byte length from "in"
 
-        // Rho Pi
-        t = st[1];
-        for (i = 0; i < 24; i++) {
-            j = keccakf_piln[i];
-            bc[0] = st[j];
-            st[j] = ROTL64(t, keccakf_rotc[i]);
-            t = bc[0];
+int keccak(const uint8_t *in, int inlen, uint8_t *md, int mdlen)
+{
+    keccak_ctx_t c;
+
+    if (keccak_init(&c, mdlen) != 0)
+        return -1;
+    keccak_update(&c, in, (size_t)inlen);
+    keccak_final(&c, md);
+
+    return 0;
+}
+
+// initialize the streaming computation
+
+int keccak_init(keccak_ctx_t *c, int mdlen)
+{
+    if (mdlen <= 0 || mdlen >= 100)
+        return -1;
+
+    memset(c->st, 0, sizeof(c->st));
+    c->mdlen = (size_t)mdlen;
+    c->rsiz = 200 - 2 * (size_t)mdlen;
+    c->pt = 0;
+    c->first_round = 0;
+    c->last_round = KECCAK_ROUNDS;
+
+    return 0;
+}
+
+// absorb more data, full blocks are xored word by word
+
+void keccak_update(keccak_ctx_t *c, const uint8_t *in, size_t inlen)
+{
+    size_t i, j = c->pt;
+    uint8_t *b = (uint8_t *) c->st;
+    uint64_t w;
+
+    while (inlen > 0) {
+        if (j == 0 && inlen >= c->rsiz) {
+            for (i = 0; i < c->rsiz / 8; i++) {
+                memcpy(&w, in + 8 * i, 8);
+                c->st[i] ^= w;
+            }
+            keccak_rounds(c->st, c->first_round, c->last_round);
+            in += c->rsiz;
+            inlen -= c->rsiz;
+            continue;
         }
 
-        //  Chi
-        for (j = 0; j < 25; j += 5) {
-            for (i = 0; i < 5; i++)
-                bc[i] = st[j + i];
-            for (i = 0; i < 5; i++)
-                st[j + i] ^= (~bc[(i + 1) % 5]) & bc[(i + 2) % 5];
+        b[j++] ^= *in++;
+        inlen--;
+        if (j == c->rsiz) {
+            keccak_rounds(c->st, c->first_round, c->last_round);
+            j = 0;
         }
+    }
+
+    c->pt = j;
+}
+
+// pad the last block and squeeze the digest
+
+void keccak_final(keccak_ctx_t *c, uint8_t *md)
+{
+    uint8_t *b = (uint8_t *) c->st;
+
+    b[c->pt] ^= 0x01;
+    b[c->rsiz - 1] ^= 0x80;
+    keccak_rounds(c->st, c->first_round, c->last_round);
+
+    memcpy(md, c->st, c->mdlen);
+}
+
+// initialize TurboSHAKE128: Keccak-p[1600, 12], capacity 256 bits
 
-        //  Iota
-        st[0] ^= keccakf_rndc[round];
+void turboshake128_init(keccak_ctx_t *c)
+{
+    memset(c->st, 0, sizeof(c->st));
+    c->mdlen = 0;
+    c->rsiz = TURBOSHAKE128_RATE;
+    c->pt = 0;
+    c->first_round = 12;
+    c->last_round = 24;
+}
+
+// pad with domain separation byte and squeeze any number of bytes
+
+void turboshake128_final(keccak_ctx_t *c, uint8_t ds,
+                         uint8_t *out, size_t outlen)
+{
+    uint8_t *b = (uint8_t *) c->st;
+    size_t n;
+
+    b[c->pt] ^= ds;
+    b[c->rsiz - 1] ^= 0x80;
+    keccakp12(c->st);
+
+    for (;;) {
+        n = outlen < c->rsiz ? outlen : c->rsiz;
+        memcpy(out, c->st, n);
+        out += n;
+        outlen -= n;
+        if (outlen == 0)
+            break;
+        keccakp12(c->st);
     }
 }
 
-// compute a keccak hash (md) of given byte length from "in"
+#ifdef KECCAK_X4_AVX2
 
-int keccak(const uint8_t *in, int inlen, uint8_t *md, int mdlen)
+// 4 interleaved states, lane i of state k is word k of st[i]
+
+#define ROTL256(x, y) _mm256_or_si256(_mm256_slli_epi64((x), (y)), \
+                                      _mm256_srli_epi64((x), 64 - (y)))
+
+#define CHI256(b0, b1, b2) _mm256_xor_si256((b0), _mm256_andnot_si256((b1), (b2)))
+
+__attribute__((target("avx2")))
+static void keccakf_x4_avx2(uint64_t st[4][25], int first, int last)
 {
-//    uint64_t st[25];
-//    uint8_t temp[144];
+    int i, round;
+    __m256i A[25], B[25], C[5], D[5];
+
+    for (i = 0; i < 25; i++)
+        A[i] = _mm256_set_epi64x((long long)st[3][i], (long long)st[2][i],
+                                 (long long)st[1][i], (long long)st[0][i]);
+
+    for (round = first; round < last; round++) {
+
+        // Theta
+        for (i = 0; i < 5; i++)
+            C[i] = _mm256_xor_si256(_mm256_xor_si256(A[i], A[i + 5]),
+                   _mm256_xor_si256(_mm256_xor_si256(A[i + 10], A[i + 15]),
+                                    A[i + 20]));
+        for (i = 0; i < 5; i++)
+            D[i] = _mm256_xor_si256(C[(i + 4) % 5], ROTL256(C[(i + 1) % 5], 1));
+
+        // Rho Pi
+        B[0]  = _mm256_xor_si256(A[0], D[0]);
+        B[1]  = ROTL256(_mm256_xor_si256(A[6],  D[1]), 44);
+        B[2]  = ROTL256(_mm256_xor_si256(A[12], D[2]), 43);
+        B[3]  = ROTL256(_mm256_xor_si256(A[18], D[3]), 21);
+        B[4]  = ROTL256(_mm256_xor_si256(A[24], D[4]), 14);
+        B[5]  = ROTL256(_mm256_xor_si256(A[3],  D[3]), 28);
+        B[6]  = ROTL256(_mm256_xor_si256(A[9],  D[4]), 20);
+        B[7]  = ROTL256(_mm256_xor_si256(A[10], D[0]), 3);
+        B[8]  = ROTL256(_mm256_xor_si256(A[16], D[1]), 45);
+        B[9]  = ROTL256(_mm256_xor_si256(A[22], D[2]), 61);
+        B[10] = ROTL256(_mm256_xor_si256(A[1],  D[1]), 1);
+        B[11] = ROTL256(_mm256_xor_si256(A[7],  D[2]), 6);
+        B[12] = ROTL256(_mm256_xor_si256(A[13], D[3]), 25);
+        B[13] = ROTL256(_mm256_xor_si256(A[19], D[4]), 8);
+        B[14] = ROTL256(_mm256_xor_si256(A[20], D[0]), 18);
+        B[15] = ROTL256(_mm256_xor_si256(A[4],  D[4]), 27);
+        B[16] = ROTL256(_mm256_xor_si256(A[5],  D[0]), 36);
+        B[17] = ROTL256(_mm256_xor_si256(A[11], D[1]), 10);
+        B[18] = ROTL256(_mm256_xor_si256(A[17], D[2]), 15);
+        B[19] = ROTL256(_mm256_xor_si256(A[23], D[3]), 56);
+        B[20] = ROTL256(_mm256_xor_si256(A[2],  D[2]), 62);
+        B[21] = ROTL256(_mm256_xor_si256(A[8],  D[3]), 55);
+        B[22] = ROTL256(_mm256_xor_si256(A[14], D[4]), 39);
+        B[23] = ROTL256(_mm256_xor_si256(A[15], D[0]), 41);
+        B[24] = ROTL256(_mm256_xor_si256(A[21], D[1]), 2);
+
+        // Chi
+        for (i = 0; i < 25; i += 5) {
+            A[i]     = CHI256(B[i],     B[i + 1], B[i + 2]);
+            A[i + 1] = CHI256(B[i + 1], B[i + 2], B[i + 3]);
+            A[i + 2] = CHI256(B[i + 2], B[i + 3], B[i + 4]);
+            A[i + 3] = CHI256(B[i + 3], B[i + 4], B[i]);
+            A[i + 4] = CHI256(B[i + 4], B[i],     B[i + 1]);
+        }
+
+        // Iota
+        A[0] = _mm256_xor_si256(A[0],
+                   _mm256_set1_epi64x((long long)keccakf_rndc[round]));
+    }
+
+    for (i = 0; i < 25; i++) {
+        uint64_t lanes[4];
+        _mm256_storeu_si256((__m256i *) lanes, A[i]);
+        st[0][i] = lanes[0];
+        st[1][i] = lanes[1];
+        st[2][i] = lanes[2];
+        st[3][i] = lanes[3];
+    }
+}
 
-    uint64_t st[25];
-    uint8_t temp[500];
 
-    int i, rsiz, rsizw;
+// absorb 4 messages of the same length with given rate, padding byte
+// and rounds <first; last), write 'mdlen' (at most 'rsiz') bytes of each state
 
-    rsiz = 200 - 2 * mdlen;
-    rsizw = rsiz / 8;
+static void sponge_x4_avx2(const uint8_t *const in[4], size_t inlen,
+                           size_t rsiz, uint8_t pad, int first, int last,
+                           uint8_t *const md[4], size_t mdlen)
+{
+    uint64_t st[4][25];
+    size_t i, off;
+    uint64_t w;
+    uint8_t *b;
+    int k;
 
     memset(st, 0, sizeof(st));
 
-    for ( ; inlen >= rsiz; inlen -= rsiz, in += rsiz) {
-        for (i = 0; i < rsizw; i++)
-            st[i] ^= ((uint64_t *) in)[i];
-        keccakf(st, KECCAK_ROUNDS);
+    for (off = 0; inlen - off >= rsiz; off += rsiz) {
+        for (k = 0; k < 4; k++) {
+            for (i = 0; i < rsiz / 8; i++) {
+                memcpy(&w, in[k] + off + 8 * i, 8);
+                st[k][i] ^= w;
+            }
+        }
+        keccakf_x4_avx2(st, first, last);
     }
 
     // last block and padding
-    memcpy(temp, in, (size_t)inlen);
-    temp[inlen++] = 1;
-    memset(temp + inlen, 0, (size_t)(rsiz - inlen));
-    temp[rsiz - 1] |= 0x80;
+    for (k = 0; k < 4; k++) {
+        b = (uint8_t *) st[k];
+        for (i = 0; i < inlen - off; i++)
+            b[i] ^= in[k][off + i];
+        b[inlen - off] ^= pad;
+        b[rsiz - 1] ^= 0x80;
+    }
+    keccakf_x4_avx2(st, first, last);
+
+    for (k = 0; k < 4; k++)
+        memcpy(md[k], st[k], mdlen);
+}
+
+#endif // KECCAK_X4_AVX2
+
+int keccak_x4_native(void)
+{
+#ifdef KECCAK_X4_AVX2
+    static const int native = __builtin_cpu_supports("avx2") ? 1 : 0;
+    return native;
+#else
+    return 0;
+#endif
+}
+
+// hash 4 messages of the same length at once
+
+int keccak_x4(const uint8_t *const in[4], size_t inlen,
+              uint8_t *const md[4], int mdlen)
+{
+    int k;
 
-    for (i = 0; i < rsizw; i++)
-        st[i] ^= ((uint64_t *) temp)[i];
+    if (mdlen <= 0 || mdlen >= 100)
+        return -1;
 
-    keccakf(st, KECCAK_ROUNDS);
+#ifdef KECCAK_X4_AVX2
+    if (keccak_x4_native()) {
+        sponge_x4_avx2(in, inlen, 200 - 2 * (size_t)mdlen, 0x01,
+                       0, KECCAK_ROUNDS, md, (size_t)mdlen);
+        return 0;
+    }
+#endif
 
-    memcpy(md, st, (size_t)mdlen);
+    for (k = 0; k < 4; k++) {
+        keccak_ctx_t c;
+        keccak_init(&c, mdlen);
+        keccak_update(&c, in[k], inlen);
+        keccak_final(&c, md[k]);
+    }
 
     return 0;
 }
 
+// TurboSHAKE128 of 4 messages of the same length at once
+
+int turboshake128_x4(const uint8_t *const in[4], size_t inlen, uint8_t ds,
+                     uint8_t *const out[4], size_t outlen)
+{
+    int k;
+
+    if (outlen > TURBOSHAKE128_RATE)
+        return -1;
+
+#ifdef KECCAK_X4_AVX2
+    if (keccak_x4_native()) {
+        sponge_x4_avx2(in, inlen, TURBOSHAKE128_RATE, ds, 12, 24, out, outlen);
+        return 0;
+    }
+#endif
+
+    for (k = 0; k < 4; k++) {
+        keccak_ctx_t c;
+        turboshake128_init(&c);
+        keccak_update(&c, in[k], inlen);
+        turboshake128_final(&c, ds, out[k], outlen);
+    }
+
+    return 0;
+}
@@ -11,15 +11,55 @@
 #define KECCAK_ROUNDS 24
 #endif
 
+// rate of TurboSHAKE128 in bytes
+#define TURBOSHAKE128_RATE 168
+
 #ifndef ROTL64
 #define ROTL64(x, y) (((x) << (y)) | ((x) >> (64 - (y))))
 #endif
 
+// streaming computation state; plain data, copy it to clone the computation
+typedef struct {
+    uint64_t st[25];    // sponge state
+    size_t pt;          // position in the current block
+    size_t rsiz;        // rate (block size) in bytes
+    size_t mdlen;       // digest length in bytes
+    int first_round;    // permutation runs rounds <first_round; last_round)
+    int last_round;
+} keccak_ctx_t;
+
 // compute a keccak hash (md) of given byte length from "in"
 int keccak(const uint8_t *in, int inlen, uint8_t *md, int mdlen);
 
+// streaming interface; keccak_init returns -1 if mdlen is not in <1;99>
+int keccak_init(keccak_ctx_t *c, int mdlen);
+void keccak_update(keccak_ctx_t *c, const uint8_t *in, size_t inlen);
+void keccak_final(keccak_ctx_t *c, uint8_t *md);
+
+// hash 4 messages of the same length at once; uses interleaved AVX2
+// implementation when the CPU supports it, 4 sequential hashes otherwise
+int keccak_x4(const uint8_t *const in[4], size_t inlen,
+              uint8_t *const md[4], int mdlen);
+
+// TurboSHAKE128 (Keccak-p[1600, 12]), absorb with keccak_update;
+// 'ds' is the domain separation byte in <0x01;0x7F>
+void turboshake128_init(keccak_ctx_t *c);
+void turboshake128_final(keccak_ctx_t *c, uint8_t ds,
+                         uint8_t *out, size_t outlen);
+
+// TurboSHAKE128 of 4 messages of the same length at once, like keccak_x4;
+// returns -1 if outlen is greater than TURBOSHAKE128_RATE
+int turboshake128_x4(const uint8_t *const in[4], size_t inlen, uint8_t ds,
+                     uint8_t *const out[4], size_t outlen);
+
+// 1 if keccak_x4 runs the AVX2 implementation on this CPU
+int keccak_x4_native(void);
+
 // update the state
 void keccakf(uint64_t st[25], int norounds);
 
+// Keccak-p[1600, 12], the last 12 rounds of keccakf
+void keccakp12(uint64_t st[25]);
+
 #endif // STEGODISK_UTILS_KECCAK_KECCAK_H_
 
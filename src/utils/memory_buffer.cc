@@ -14,30 +14,39 @@
 
 #include <string.h>
 #include <algorithm>
+#include <atomic>
 #include <exception>
 #include <stdexcept>
-#include <ctime>
 
+#ifdef _WIN32
+#include <Windows.h>
+#endif
+
+#include "buffer_pool.h"
+#include "chacha20.h"
 #include "stego_types.h"
 
 using namespace std;
 
 namespace stego_disk {
 
+static std::atomic<int> wipe_policy(MemoryBuffer::kWipeZero);
+
 void MemoryBuffer::Init(std::size_t new_size) {
   size_ = new_size;
   if (size_ > 0) {
-    buffer_ = new uint8[size_];
+    buffer_ = BufferPool::Allocate(size_, &capacity_);
   } else {
     size_ = 0;
+    capacity_ = 0;
     buffer_ = nullptr;
   }
 }
 
-MemoryBuffer::MemoryBuffer() : buffer_(nullptr), size_(0) {}
+MemoryBuffer::MemoryBuffer() : buffer_(nullptr), size_(0), capacity_(0) {}
 
 
-MemoryBuffer::MemoryBuffer(std::size_t new_size) : size_(new_size) {
+MemoryBuffer::MemoryBuffer(std::size_t new_size) {
   Init( new_size );
 }
 
@@ -64,14 +73,11 @@ MemoryBuffer::MemoryBuffer(const MemoryBuffer& other) {
  * move constructor
  * other buffer is not destroyed - data are moved to new buffer
  */
-MemoryBuffer::MemoryBuffer(MemoryBuffer&& other) {
-  if ( buffer_ != nullptr ) Destroy();
-
-  buffer_ = other.buffer_;
-  size_ = other.size_;
-
+MemoryBuffer::MemoryBuffer(MemoryBuffer&& other)
+  : buffer_(other.buffer_), size_(other.size_), capacity_(other.capacity_) {
   other.buffer_ = nullptr;
   other.size_ = 0;
+  other.capacity_ = 0;
 }
 
 // copy assignment
@@ -79,20 +85,26 @@ MemoryBuffer& MemoryBuffer::operator=(const MemoryBuffer& other) {
   // self-assignment check expected
   if ( this == &other ) return *this;
 
-  if (size_ != other.size_) {
+  if (other.size_ > capacity_) {
     Destroy();
     Init(other.size_);
+  } else {
+    size_ = other.size_;
   }
-  memcpy(buffer_, other.buffer_, size_);
+  if (size_ > 0) memcpy(buffer_, other.buffer_, size_);
   return *this;
 }
 
 // move assignment
 MemoryBuffer& MemoryBuffer::operator=(MemoryBuffer&& other) {
+  if ( this == &other ) return *this;
+
   Destroy();
   buffer_ = other.buffer_;
   size_ = other.size_;
+  capacity_ = other.capacity_;
   other.size_ = 0;
+  other.capacity_ = 0;
   other.buffer_ = nullptr;
   return *this;
 }
@@ -121,19 +133,22 @@ void MemoryBuffer::Resize(std::size_t new_size) {
 
   if (new_size == size_) return;
 
-  uint8* original_buffer = buffer_;
-  std::size_t original_size = size_;
+  if (new_size <= capacity_) {
+    if (new_size > size_) memset(buffer_ + size_, 0, new_size - size_);
+    size_ = new_size;
+    return;
+  }
 
-  uint8* new_buffer = new uint8[new_size];
+  std::size_t new_capacity;
+  uint8* new_buffer = BufferPool::Allocate(new_size, &new_capacity);
 
-  memset(new_buffer, 0, new_size);
-  if (original_buffer != nullptr) {
-    memcpy(new_buffer, original_buffer, std::min(new_size, original_size));
-    Randomize();
-    delete[] original_buffer;
-  }
-  size_ = new_size;
+  if (size_ > 0) memcpy(new_buffer, buffer_, size_);
+  memset(new_buffer + size_, 0, new_size - size_);
+
+  Destroy();
   buffer_ = new_buffer;
+  size_ = new_size;
+  capacity_ = new_capacity;
 }
 
 uint8& MemoryBuffer::operator[](std::size_t index) {
@@ -178,6 +193,10 @@ std::size_t MemoryBuffer::GetSize() const {
   return size_;
 }
 
+std::size_t MemoryBuffer::GetCapacity() const {
+  return capacity_;
+}
+
 uint8* MemoryBuffer::GetRawPointer() const {
   return buffer_;
 }
@@ -207,13 +226,7 @@ void MemoryBuffer::Randomize() {
 
   if ((buffer_ == nullptr) || (size_ == 0)) return;
 
-  memset(buffer_, 0, size_);
-  memset(buffer_, 0xFF, size_); //TODO(Matus) naco je toto dobre
-
-  srand(static_cast<unsigned int>(time(NULL)));
-  for (std::size_t i = 0; i < size_; ++i) {
-    buffer_[i] = static_cast<uint8>(rand());
-  }
+  ChaCha20::FillRandom(buffer_, size_);
 }
 
 void MemoryBuffer::Fill(uint8 value) {
@@ -227,10 +240,44 @@ void MemoryBuffer::Destroy() {
 
   if ( buffer_ == nullptr ) return;
 
-  Randomize();
-  delete[] buffer_;
+  // wipe also data left beyond the size by shrinking
+  switch (GetWipePolicy()) {
+    case kWipeNone:
+      break;
+    case kWipeZero:
+      SecureZero(buffer_, capacity_);
+      break;
+    case kWipeRandom:
+      ChaCha20::FillRandom(buffer_, capacity_);
+      break;
+  }
+  BufferPool::Release(buffer_, capacity_);
   buffer_ = nullptr;
   size_ = 0;
+  capacity_ = 0;
+}
+
+void MemoryBuffer::SetWipePolicy(WipePolicy policy) {
+  wipe_policy.store(policy, std::memory_order_relaxed);
+}
+
+MemoryBuffer::WipePolicy MemoryBuffer::GetWipePolicy() {
+  return static_cast<WipePolicy>(wipe_policy.load(std::memory_order_relaxed));
+}
+
+void MemoryBuffer::SecureZero(void *data, std::size_t length) {
+
+  if ((data == nullptr) || (length == 0)) return;
+
+#if defined(HAVE_EXPLICIT_BZERO)
+  explicit_bzero(data, length);
+#elif defined(_WIN32)
+  SecureZeroMemory(data, length);
+#else
+  // stores through volatile pointer cannot be optimized out
+  volatile uint8 *bytes = static_cast<volatile uint8*>(data);
+  for (std::size_t i = 0; i < length; ++i) bytes[i] = 0;
+#endif
 }
 
 } // stego_disk
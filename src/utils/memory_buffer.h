@@ -16,10 +16,24 @@
 
 namespace stego_disk {
 
+/**
+ * The MemoryBuffer class.
+ *
+ * Memory is taken from BufferPool and its capacity is kept by Resize,
+ * so buffers of the same size can be reused without new allocations.
+ * Content is wiped according to the wipe policy before memory is
+ * returned to the pool.
+ */
 class MemoryBuffer {
 public:
+  enum WipePolicy {
+    kWipeNone,      // memory is released with its content
+    kWipeZero,      // zeroed by SecureZero (default)
+    kWipeRandom     // overwritten by random data
+  };
+
   MemoryBuffer();
-  MemoryBuffer(std::size_t size);
+  MemoryBuffer(std::size_t size); // content is undefined, see Clear
   MemoryBuffer(const uint8* data, std::size_t length);
 
   MemoryBuffer(const MemoryBuffer& other); // copy constructor
@@ -42,6 +56,8 @@ public:
   void Write(std::size_t offset, const uint8* data, std::size_t length);
 
   std::size_t GetSize() const;
+  std::size_t GetCapacity() const;
+  // bytes added by growing are zero-filled, capacity is never reduced
   void Resize(std::size_t new_size);
   uint8* GetRawPointer() const;
   const uint8* GetConstRawPointer() const;
@@ -50,12 +66,20 @@ public:
   void Randomize(); // replace content by random data
   void Fill(uint8 value); // fill entire buffer with value
 
+  // applies to all buffers destroyed after the call
+  static void SetWipePolicy(WipePolicy policy);
+  static WipePolicy GetWipePolicy();
+
+  // zeroing which is not removed by the compiler
+  static void SecureZero(void *data, std::size_t length);
+
 private:
   void Destroy();
   void Init(std::size_t new_size);
 
   uint8* buffer_;
   std::size_t size_;
+  std::size_t capacity_;
 };
 
 } // stego_disk
@@ -0,0 +1,175 @@
+/**
+* @file perf_counters.cc
+* @author Martin Kosdy
+* @author Matus Kysel
+* @date 2016
+* @brief Implementation of performance counters
+*
+*/
+
+#include "perf_counters.h"
+
+#include <algorithm>
+#include <cctype>
+
+namespace stego_disk {
+
+static const std::memory_order kRelaxed = std::memory_order_relaxed;
+
+static json::JsonObject Number(uint64 value) {
+  json::JsonObject object;
+  object.Assign(value);
+  return object;
+}
+
+static uint64 SumOf(const std::atomic<uint64> (&counters)[StegoStats::FORMAT_COUNT]) {
+  uint64 sum = 0;
+  for (int f = 0; f < StegoStats::FORMAT_COUNT; ++f)
+    sum += counters[f].load(kRelaxed);
+  return sum;
+}
+
+const char* StegoStats::GetPhaseName(Phase phase) {
+  static const char* const kNames[PHASE_COUNT] = {
+    "directory_walk", "capacity_scan", "key_derivation", "permutation_init",
+    "decode", "extract", "checksum", "embed", "encode", "write"
+  };
+  return kNames[phase];
+}
+
+const char* StegoStats::GetFormatName(Format format) {
+  static const char* const kNames[FORMAT_COUNT] = {
+    "storage", "bmp", "jpg", "png"
+  };
+  return kNames[format];
+}
+
+StegoStats::Format StegoStats::GetFormat(const std::string &extension) {
+  std::string ext(extension);
+  std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
+  if (ext == "bmp") return BMP;
+  if (ext == "jpg" || ext == "jpeg") return JPEG;
+  if (ext == "png") return PNG;
+  return STORAGE;
+}
+
+json::JsonObject StegoStats::ToJson() const {
+  json::JsonObject stats;
+  json::JsonObject formats_json(json::JsonObject::OBJECT);
+
+  for (int f = 0; f < FORMAT_COUNT; ++f) {
+    const FormatStats &format = formats[f];
+    json::JsonObject format_json;
+    json::JsonObject phases_json(json::JsonObject::OBJECT);
+
+    for (int p = 0; p < PHASE_COUNT; ++p) {
+      const PhaseStats &phase = format.phases[p];
+      if (phase.calls == 0) continue;
+      json::JsonObject phase_json;
+      phase_json["calls"] = Number(phase.calls);
+      phase_json["ms"].Assign(phase.nanoseconds / 1e6);
+      phase_json["bytes"] = Number(phase.bytes);
+      phases_json[GetPhaseName(static_cast<Phase>(p))] = phase_json;
+    }
+
+    if (f != STORAGE) {
+      if (format.carriers == 0 && phases_json.ToObject().empty()) continue;
+      format_json["carriers"] = Number(format.carriers);
+      format_json["raw_capacity"] = Number(format.raw_capacity);
+      format_json["bits_modified"] = Number(format.bits_modified);
+      format_json["bytes_written"] = Number(format.bytes_written);
+    }
+    format_json["phases"] = phases_json;
+    formats_json[GetFormatName(static_cast<Format>(f))] = format_json;
+  }
+
+  json::JsonObject save_json;
+  save_json["count"] = Number(save_count);
+  save_json["storage_bytes"] = Number(last_save.storage_bytes);
+  save_json["bits_modified"] = Number(last_save.bits_modified);
+  save_json["bytes_written"] = Number(last_save.bytes_written);
+  // bytes written to carrier files per byte of the virtual storage
+  save_json["write_amplification"].Assign(
+      last_save.storage_bytes ?
+        static_cast<double>(last_save.bytes_written) / last_save.storage_bytes :
+        0.0);
+
+  json::JsonObject hash_json;
+  hash_json["calls"] = Number(hash_calls);
+  hash_json["bytes"] = Number(hash_bytes);
+
+  stats["formats"] = formats_json;
+  stats["last_save"] = save_json;
+  stats["hash"] = hash_json;
+  return stats;
+}
+
+PerfCounters::PerfCounters() {
+  Reset();
+}
+
+void PerfCounters::AddPhase(StegoStats::Format format, StegoStats::Phase phase,
+                            uint64 nanoseconds, uint64 bytes) {
+  AtomicPhase &counters = phases_[format][phase];
+  counters.calls.fetch_add(1, kRelaxed);
+  counters.nanoseconds.fetch_add(nanoseconds, kRelaxed);
+  counters.bytes.fetch_add(bytes, kRelaxed);
+}
+
+void PerfCounters::AddSave(StegoStats::Format format, uint64 bits_modified,
+                           uint64 bytes_written) {
+  bits_modified_[format].fetch_add(bits_modified, kRelaxed);
+  bytes_written_[format].fetch_add(bytes_written, kRelaxed);
+}
+
+void PerfCounters::BeginSave(uint64 storage_bytes) {
+  save_storage_bytes_ = storage_bytes;
+  save_bits_base_ = SumOf(bits_modified_);
+  save_bytes_base_ = SumOf(bytes_written_);
+}
+
+void PerfCounters::EndSave() {
+  last_save_storage_bytes_.store(save_storage_bytes_, kRelaxed);
+  last_save_bits_.store(SumOf(bits_modified_) - save_bits_base_, kRelaxed);
+  last_save_bytes_.store(SumOf(bytes_written_) - save_bytes_base_, kRelaxed);
+  save_count_.fetch_add(1, kRelaxed);
+}
+
+void PerfCounters::Fill(StegoStats *stats) const {
+  for (int f = 0; f < StegoStats::FORMAT_COUNT; ++f) {
+    StegoStats::FormatStats &format = stats->formats[f];
+    for (int p = 0; p < StegoStats::PHASE_COUNT; ++p) {
+      const AtomicPhase &counters = phases_[f][p];
+      format.phases[p].calls = counters.calls.load(kRelaxed);
+      format.phases[p].nanoseconds = counters.nanoseconds.load(kRelaxed);
+      format.phases[p].bytes = counters.bytes.load(kRelaxed);
+    }
+    format.bits_modified = bits_modified_[f].load(kRelaxed);
+    format.bytes_written = bytes_written_[f].load(kRelaxed);
+  }
+  stats->save_count = save_count_.load(kRelaxed);
+  stats->last_save.storage_bytes = last_save_storage_bytes_.load(kRelaxed);
+  stats->last_save.bits_modified = last_save_bits_.load(kRelaxed);
+  stats->last_save.bytes_written = last_save_bytes_.load(kRelaxed);
+}
+
+void PerfCounters::Reset() {
+  for (int f = 0; f < StegoStats::FORMAT_COUNT; ++f) {
+    for (int p = 0; p < StegoStats::PHASE_COUNT; ++p) {
+      phases_[f][p].calls.store(0, kRelaxed);
+      phases_[f][p].nanoseconds.store(0, kRelaxed);
+      phases_[f][p].bytes.store(0, kRelaxed);
+    }
+    bits_modified_[f].store(0, kRelaxed);
+    bytes_written_[f].store(0, kRelaxed);
+  }
+  save_count_.store(0, kRelaxed);
+  save_storage_bytes_ = 0;
+  last_save_storage_bytes_.store(0, kRelaxed);
+  save_bits_base_ = 0;
+  save_bytes_base_ = 0;
+  last_save_bits_.store(0, kRelaxed);
+  last_save_bytes_.store(0, kRelaxed);
+}
+
+} // stego_disk
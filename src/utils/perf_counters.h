@@ -0,0 +1,185 @@
+/**
+* @file perf_counters.h
+* @author Martin Kosdy
+* @author Matus Kysel
+* @date 2016
+* @brief Performance counters of storage phases, aggregated per carrier format
+*
+*/
+
+#ifndef STEGODISK_UTILS_PERFCOUNTERS_H_
+#define STEGODISK_UTILS_PERFCOUNTERS_H_
+
+#include <atomic>
+#include <chrono>
+#include <string>
+
+#include "utils/json.h"
+#include "utils/stego_types.h"
+#include "utils/tracer.h"
+
+namespace stego_disk {
+
+/**
+ * Totals of one phase: number of calls, time spent and bytes processed
+ */
+struct PhaseStats {
+  uint64 calls;
+  uint64 nanoseconds;
+  uint64 bytes;
+};
+
+/**
+ * The StegoStats class.
+ *
+ * Snapshot of PerfCounters returned by StegoStorage::GetStats. Phases of
+ * the storage itself (directory walk, key derivation, global permutation,
+ * checksum) are reported under the format "storage", phases of carriers
+ * under their format ("bmp", "jpg", "png").
+ */
+struct StegoStats {
+  enum Phase {
+    DIRECTORY_WALK,
+    CAPACITY_SCAN,
+    KEY_DERIVATION,
+    PERMUTATION_INIT,
+    DECODE,
+    EXTRACT,
+    CHECKSUM,
+    EMBED,
+    ENCODE,
+    WRITE,
+    PHASE_COUNT
+  };
+
+  enum Format {
+    STORAGE,
+    BMP,
+    JPEG,
+    PNG,
+    FORMAT_COUNT
+  };
+
+  struct FormatStats {
+    uint64 carriers;
+    uint64 raw_capacity;
+    PhaseStats phases[PHASE_COUNT];
+    // LSBs changed and bytes written to carrier files by all saves
+    uint64 bits_modified;
+    uint64 bytes_written;
+  };
+
+  // one call of StegoStorage::Save
+  struct SaveStats {
+    uint64 storage_bytes;
+    uint64 bits_modified;
+    uint64 bytes_written;
+  };
+
+  FormatStats formats[FORMAT_COUNT];
+  uint64 save_count;
+  SaveStats last_save;
+  // all Hash computations of the process (keys, permutations, checksums)
+  uint64 hash_calls;
+  uint64 hash_bytes;
+
+  json::JsonObject ToJson() const;
+
+  static const char* GetPhaseName(Phase phase);
+  static const char* GetFormatName(Format format);
+  static Format GetFormat(const std::string &extension);
+};
+
+/**
+ * The PerfCounters class.
+ *
+ * Counters are relaxed atomics, so carriers processed by ThreadPool
+ * workers can add to them concurrently; each update is a few atomic
+ * additions per carrier and phase.
+ */
+class PerfCounters {
+public:
+  PerfCounters();
+
+  void AddPhase(StegoStats::Format format, StegoStats::Phase phase,
+                uint64 nanoseconds, uint64 bytes);
+  void AddSave(StegoStats::Format format, uint64 bits_modified,
+               uint64 bytes_written);
+  // StegoStorage::Save of 'storage_bytes' of the virtual storage
+  void BeginSave(uint64 storage_bytes);
+  void EndSave();
+
+  // fills counters of 'stats', carriers and capacities are left untouched
+  void Fill(StegoStats *stats) const;
+  void Reset();
+
+private:
+  struct AtomicPhase {
+    std::atomic<uint64> calls;
+    std::atomic<uint64> nanoseconds;
+    std::atomic<uint64> bytes;
+  };
+
+  AtomicPhase phases_[StegoStats::FORMAT_COUNT][StegoStats::PHASE_COUNT];
+  std::atomic<uint64> bits_modified_[StegoStats::FORMAT_COUNT];
+  std::atomic<uint64> bytes_written_[StegoStats::FORMAT_COUNT];
+
+  std::atomic<uint64> save_count_;
+  // totals when the running save started
+  uint64 save_storage_bytes_;
+  uint64 save_bits_base_;
+  uint64 save_bytes_base_;
+  std::atomic<uint64> last_save_storage_bytes_;
+  std::atomic<uint64> last_save_bits_;
+  std::atomic<uint64> last_save_bytes_;
+};
+
+/**
+ * The PhaseTimer class.
+ *
+ * Measures the phase from construction to destruction (or Stop) and adds
+ * it to the counters (unless they are nullptr) and to the timeline, if
+ * Tracer is enabled.
+ */
+class PhaseTimer {
+public:
+  PhaseTimer(PerfCounters *counters, StegoStats::Format format,
+             StegoStats::Phase phase, uint64 bytes = 0)
+    : counters_(counters), format_(format), phase_(phase), bytes_(bytes),
+      traced_(Tracer::IsEnabled()) {
+    if (counters_ || traced_) start_ = std::chrono::steady_clock::now();
+  }
+
+  ~PhaseTimer() { Stop(); }
+
+  void SetBytes(uint64 bytes) { bytes_ = bytes; }
+
+  void Stop() {
+    if (!counters_ && !traced_) return;
+    auto end = std::chrono::steady_clock::now();
+    if (counters_) {
+      counters_->AddPhase(format_, phase_, static_cast<uint64>(
+          std::chrono::duration_cast<std::chrono::nanoseconds>(
+            end - start_).count()), bytes_);
+    }
+    if (traced_) {
+      Tracer::AddEvent(StegoStats::GetFormatName(format_),
+                       StegoStats::GetPhaseName(phase_), std::string(),
+                       start_, end);
+    }
+    counters_ = nullptr;
+    traced_ = false;
+  }
+
+private:
+  PerfCounters *counters_;
+  StegoStats::Format format_;
+  StegoStats::Phase phase_;
+  uint64 bytes_;
+  bool traced_;
+  std::chrono::steady_clock::time_point start_;
+};
+
+} // stego_disk
+
+#endif // STEGODISK_UTILS_PERFCOUNTERS_H_
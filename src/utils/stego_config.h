@@ -16,6 +16,7 @@
 #include <memory>
 
 #include "encoders/encoder_factory.h"
+#include "hash/hash_factory.h"
 #include "permutations/permutation_factory.h"
 #include "utils/json.h"
 
@@ -30,8 +31,19 @@ public:
     Instance().encoder_ = EncoderFactory::GetEncoderType(config["encoder"].ToString());
     Instance().global_perm_ = PermutationFactory::GetPermutationType(config["glob_perm"].ToString());
     Instance().local_perm_ = PermutationFactory::GetPermutationType(config["local_perm"].ToString());
+    Instance().key_hash_ = HashFactory::GetHashType(config["key_hash"].ToString());
+    Instance().storage_hash_ = HashFactory::GetHashType(config["storage_hash"].ToString());
     Instance().stego_config_loaded_ = true;
 
+    Instance().encoder_args_.clear();
+    if(config["encoder_args"].IsObject()) {
+      for (auto &arg : config["encoder_args"].ToObject()) {
+        if(arg.second.IsString()) {
+          Instance().encoder_args_[arg.first] = arg.second.ToString();
+        }
+      }
+    }
+
     if(config["exclude_types"].IsArray()) {
       json::JsonObject exclude_list = config["exclude_types"];
       for (size_t i = 0; i < exclude_list.ArraySize(); ++i) {
@@ -58,7 +70,11 @@ public:
   inline static PermutationFactory::PermutationType &global_perm() { return Instance().global_perm_; }
   inline static PermutationFactory::PermutationType &local_perm() { return Instance().local_perm_; }
   inline static EncoderFactory::EncoderType &encoder() { return Instance().encoder_; }
+  inline static HashFactory::HashType &key_hash() { return Instance().key_hash_; }
+  inline static HashFactory::HashType &storage_hash() { return Instance().storage_hash_; }
   inline static std::set<std::string> &exclude_list() { return Instance().exclude_list_; }
+  // parameters of the encoder by name (see Encoder::SetArgByName)
+  inline static std::map<std::string, std::string> &encoder_args() { return Instance().encoder_args_; }
   inline static std::map<std::string, std::pair<EncoderFactory::EncoderType, PermutationFactory::PermutationType> >
   &file_config() { return Instance().file_config_; }
 
@@ -66,7 +82,10 @@ public:
 private:
   StegoConfig() :
     stego_config_loaded_(false),
+    key_hash_(HashFactory::GetDefaultHashType()),
+    storage_hash_(HashFactory::GetDefaultHashType()),
     exclude_list_(),
+    encoder_args_(),
     file_config_()
   {}
 
@@ -81,7 +100,10 @@ private:
   EncoderFactory::EncoderType encoder_;
   PermutationFactory::PermutationType global_perm_;
   PermutationFactory::PermutationType local_perm_;
+  HashFactory::HashType key_hash_;
+  HashFactory::HashType storage_hash_;
   std::set<std::string> exclude_list_;
+  std::map<std::string, std::string> encoder_args_;
   std::map<std::string, std::pair<EncoderFactory::EncoderType, PermutationFactory::PermutationType> > file_config_;
 
   static StegoConfig stego_config_;
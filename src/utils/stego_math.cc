@@ -11,9 +11,15 @@
 
 #include <stdlib.h>
 #include <stdio.h>
+#include <math.h>
 
+#include <algorithm>
 #include <sstream>
 #include <iomanip>
+#include <map>
+#include <mutex>
+#include <stdexcept>
+#include <vector>
 
 namespace stego_disk {
 
@@ -33,54 +39,121 @@ uint64 StegoMath::Lcm(uint64 a, uint64 b) {
   return a * b / Gcd(a,b);
 }
 
+/*
+ * Arithmetic modulo odd n in Montgomery form (x * 2^64 mod n),
+ * multiplication needs no division
+ */
+class MontgomeryForm {
+public:
+  explicit MontgomeryForm(uint64 n) : n_(n) {
+    // n * inverse = 1 (mod 2^64), Newton iteration doubles correct bits
+    inverse_ = n;
+    for (int i = 0; i < 5; ++i)
+      inverse_ *= 2 - n * inverse_;
+    one_ = (0 - n) % n;                       // 2^64 mod n
+    r2_ = StegoMath::Mulmod(one_, one_, n);   // 2^128 mod n
+  }
+
+  // a * b * 2^-64 mod n
+  inline uint64 Multiply(uint64 a, uint64 b) const {
+    uint64 high = StegoMath::MulHigh(a, b);
+    uint64 m = a * b * inverse_;
+    uint64 mn_high = StegoMath::MulHigh(m, n_);
+    return (high >= mn_high) ? high - mn_high : high - mn_high + n_;
+  }
+
+  inline uint64 To(uint64 a) const { return Multiply(a % n_, r2_); }
+  inline uint64 One() const { return one_; }
+  inline uint64 MinusOne() const { return n_ - one_; }
+
+  uint64 Power(uint64 base, uint64 exponent) const {
+    uint64 result = one_;
+    while (exponent) {
+      if (exponent & 1) result = Multiply(result, base);
+      base = Multiply(base, base);
+      exponent >>= 1;
+    }
+    return result;
+  }
+
+private:
+  uint64 n_;
+  uint64 inverse_;
+  uint64 one_;
+  uint64 r2_;
+};
+
+// primes below kSmallPrimesLimit, for trial division and sieving
+static const uint32 kSmallPrimesLimit = 1 << 12;
+
+static const std::vector<uint32>& SmallPrimes() {
+  static const std::vector<uint32> primes = [] {
+    std::vector<bool> composite(kSmallPrimesLimit, false);
+    std::vector<uint32> list;
+    for (uint32 i = 2; i < kSmallPrimesLimit; ++i) {
+      if (composite[i]) continue;
+      list.push_back(i);
+      for (uint32 j = i * i; j < kSmallPrimesLimit; j += i)
+        composite[j] = true;
+    }
+    return list;
+  }();
+  return primes;
+}
+
 /*
  *  Miller-Rabin Primality Test
  *
- * source: http://community.topcoder.com/tc?module=Static&d1=tutorials&d2=primalityTesting
+ * Deterministic for all 64-bit numbers: witnesses 2, 325, 9375, 28178,
+ * 450775, 9780504 and 1795265022 (J. Sinclair) have no strong liar
+ * below 2^64. Computation runs in Montgomery form.
  */
 bool StegoMath::MillerRabin(uint64 p) {
-  if(p < 2) {
-    return false;
-  }
-  if(p != 2 && p %2 == 0) {
+  static const uint64 kWitnesses[] = { 2, 325, 9375, 28178, 450775,
+                                       9780504, 1795265022 };
+  static const uint32 kTrialPrimes[] = { 2, 3, 5, 7, 11, 13, 17, 19, 23,
+                                         29, 31, 37 };
+
+  if (p < 2)
     return false;
+
+  for (uint32 prime : kTrialPrimes) {
+    if (p % prime == 0)
+      return p == prime;
   }
-  uint64 s = p - 1;
-  while (s % 2 == 0) {
-    s /= 2;
+  if (p < 41 * 41)
+    return true;
+
+  uint64 d = p - 1;
+  int s = 0;
+  while ((d & 1) == 0) {
+    d >>= 1;
+    ++s;
   }
 
-  /*
-    if n < 1,373,653, it is enough to test a = 2 and 3;
-    if n < 9,080,191, it is enough to test a = 31 and 73;
-    if n < 4,759,123,141, it is enough to test a = 2, 7, and 61;
-    if n < 1,122,004,669,633, it is enough to test a = 2, 13, 23, and 1662803;
-    if n < 2,152,302,898,747, it is enough to test a = 2, 3, 5, 7, and 11;
-    if n < 3,474,749,660,383, it is enough to test a = 2, 3, 5, 7, 11, and 13;
-    if n < 341,550,071,728,321, it is enough to test a = 2, 3, 5, 7, 11, 13, and 17.
-    */
-
-  uint64 witness[] = {2,3,5,7,11,13,17,19,23,29,31,37,41,43,47,53,59,61,67,71,
-                      73,79,83,89,97,1662803};
-  //if (iterations > (sizeof(witness) >> 3)) iterations = it;
-  int iterations = (sizeof(witness) >> 3);
-
-
-  for (int i = 0; i < iterations; ++i) {
-    uint64 a = rand() % (p - 1) + 1, temp = s;
-    uint64 mod = Modulo(a, temp, p);
-    while (temp != p - 1 && mod != 1 && mod != p - 1) {
-      mod = Mulmod(mod, mod, p);
-      temp *= 2;
+  MontgomeryForm mont(p);
+
+  for (uint64 witness : kWitnesses) {
+    uint64 a = witness % p;
+    if (a == 0)
+      continue;
+
+    uint64 x = mont.Power(mont.To(a), d);
+    if (x == mont.One() || x == mont.MinusOne())
+      continue;
+
+    int i = 1;
+    for ( ; i < s; ++i) {
+      x = mont.Multiply(x, x);
+      if (x == mont.MinusOne())
+        break;
     }
-    if(mod != p - 1 && temp % 2 == 0) {
+    if (i == s)
       return false;
-    }
   }
   return true;
 }
 
-
 /* This function calculates (a^b)%c */
 uint64 StegoMath::Modulo(uint64 a, uint64 b, uint64 c) {
 
@@ -104,41 +177,123 @@ uint64 StegoMath::Modulo(uint64 a, uint64 b, uint64 c) {
   return x % c;
 }
 
+/* This function calculates (a*b)%m */
 uint64 StegoMath::Mulmod(uint64 a,uint64 b,uint64 m) {
-  if ((a < 0xFFFFFF) && (b < 0xFFFFFF)) {
+
+#if __GNUC__ && (__x86_64__ || __ppc64__ || __aarch64__)
+  return static_cast<uint64>((static_cast<__uint128_t>(a) * b) % m);
+#else
+  if ((a <= 0xFFFFFFFF) && (b <= 0xFFFFFFFF)) {
     return (a * b) % m;
   }
 
   uint64 res = 0;
+  a %= m;
+  b %= m;
   while (a != 0) {
     if (a & 1) res = (res + b) % m;
     a >>= 1;
     b = (b << 1) % m;
   }
   return res;
+#endif
 }
 
+/**
+ * @brief Prepares multiplication by 'factor' modulo 'modulus'
+ *
+ * @param[in] factor Constant factor, reduced modulo 'modulus'
+ * @param[in] modulus Modulus in <1; kMaxModulus>
+ */
+ModularMultiplier::ModularMultiplier(uint64 factor, uint64 modulus) {
+  if (modulus == 0 || modulus > kMaxModulus)
+    throw std::out_of_range("ModularMultiplier: modulus should be "
+                            "in <1, 2^63 - 1>");
+
+  factor_ = factor % modulus;
+  modulus_ = modulus;
+
+  // reciprocal_ = floor(factor_ * 2^64 / modulus_) by long division,
+  // factor_ < modulus_ so the quotient fits into 64 bits
+  uint64 remainder = factor_;
+  reciprocal_ = 0;
+  for (int i = 0; i < 64; ++i) {
+    remainder <<= 1;
+    reciprocal_ <<= 1;
+    if (remainder >= modulus_) {
+      remainder -= modulus_;
+      reciprocal_ |= 1;
+    }
+  }
+}
+
+// number of odd candidates sieved at once by ClosestSmallerPrime
+static const uint32 kSieveWindow = 256;
+// maximal number of memoized results of ClosestSmallerPrime
+static const std::size_t kMaxMemoizedPrimes = 1 << 16;
+
 /*
- * Finds the closest smaller prime to the number
+ * Finds the closest smaller (or equal) odd prime to the number
+ *
+ * Odd candidates are searched downwards in windows; multiples of small
+ * primes are sieved out first, so Miller-Rabin runs only for candidates
+ * without a small factor. Results are memoized, as the same sizes
+ * are requested for every carrier repeatedly.
  *
  * @return closest smaller prime or 0 if there is no smaller prime than number
  */
 uint64 StegoMath::ClosestSmallerPrime(uint64 number) {
-  if (number < 2) return 0;
-  if (number % 2 == 0) number--;
+  if (number < 3) return 0;
+
+  static std::mutex memo_mutex;
+  static std::map<uint64, uint64> memo;
+  {
+    std::lock_guard<std::mutex> lock(memo_mutex);
+    auto it = memo.find(number);
+    if (it != memo.end())
+      return it->second;
+  }
 
-  srand(2);
+  const std::vector<uint32>& small_primes = SmallPrimes();
+  uint64 high = (number % 2 == 0) ? number - 1 : number;  // odd
+  uint64 prime = 0;
+
+  // candidates high, high - 2, .., high - 2 * (window - 1)
+  std::vector<bool> composite(kSieveWindow);
+  while (prime == 0) {
+    uint32 window = kSieveWindow;
+    if ((high - 1) / 2 < window)
+      window = static_cast<uint32>((high - 1) / 2);   // candidates >= 3
+    uint64 low = high - 2 * (uint64)(window - 1);
+
+    std::fill(composite.begin(), composite.end(), false);
+    for (std::size_t k = 1; k < small_primes.size(); ++k) {
+      uint64 q = small_primes[k];
+      if (q * q > high) break;
+      // first odd multiple of q, not smaller than max(low, q * q)
+      uint64 first = (low + q - 1) / q * q;
+      if (first < q * q) first = q * q;
+      if (first % 2 == 0) first += q;
+      for (uint64 m = first; m <= high; m += 2 * q)
+        composite[(high - m) / 2] = true;
+    }
 
-  while (!MillerRabin(number) && (number > 2)) {
-    number -= 2;
-  }
+    for (uint32 i = 0; i < window; ++i) {
+      if (!composite[i] && MillerRabin(high - 2 * (uint64)i)) {
+        prime = high - 2 * (uint64)i;
+        break;
+      }
+    }
 
-  if (number > 1) {
-    return number;
-  } else {
-    return 0;
+    if (low <= 3) break;
+    high = low - 2;
   }
 
+  std::lock_guard<std::mutex> lock(memo_mutex);
+  if (memo.size() >= kMaxMemoizedPrimes)
+    memo.clear();
+  memo[number] = prime;
+  return prime;
 }
 
 void StegoMath::PrintHexBuffer(const uint8 *buffer, std::size_t length) {
@@ -185,15 +340,23 @@ uint8 StegoMath::Log2(uint64 number) {
   return 64 - leadingZeros;
 }
 
+/**
+ * @brief Computes floor(sqrt(number)) exactly
+ *
+ * Double precision sqrt is only an estimate for numbers above 2^52,
+ * it is corrected to the exact value.
+ */
+uint64 StegoMath::IntegerSqrt(uint64 number) {
+  uint64 root = static_cast<uint64>(sqrt(static_cast<double>(number)));
+
+  // root * root must not exceed number (and must not overflow)
+  if (root > 0xFFFFFFFFULL) root = 0xFFFFFFFFULL;
+  while (root * root > number)
+    --root;
+  while (root < 0xFFFFFFFFULL && (root + 1) * (root + 1) <= number)
+    ++root;
 
-uint8 StegoMath::Popcount(uint64 x) {
-  x -= (x >> 1) & 0x5555555555555555;
-  x = (x & 0x3333333333333333) + ((x >> 2) & 0x3333333333333333);
-  x = (x + (x >> 4)) & 0x0f0f0f0f0f0f0f0f;
-  x += x >> 8;
-  x += x >> 16;
-  x += x >> 32;
-  return x & 0x7f;
+  return root;
 }
 
 } // stego_disk
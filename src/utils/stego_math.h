@@ -12,6 +12,10 @@
 
 #include <string>
 
+#if defined(_MSC_VER) && defined(_M_X64)
+#include <intrin.h>
+#endif
+
 #include "stego_header.h"
 #include "memory_buffer.h"
 
@@ -32,8 +36,68 @@ public:
   static uint64 Modulo(uint64 a, uint64 b, uint64 c);
   static uint64 Mulmod(uint64 a, uint64 b, uint64 m);
   static uint8 Log2(uint64 number);
-  static uint8 Popcount(uint64 x);
+  static uint64 IntegerSqrt(uint64 number);
+
+  // number of set bits, inline as carrier kernels call it for each block
+  static inline uint8 Popcount(uint64 x) {
+    x -= (x >> 1) & 0x5555555555555555;
+    x = (x & 0x3333333333333333) + ((x >> 2) & 0x3333333333333333);
+    x = (x + (x >> 4)) & 0x0f0f0f0f0f0f0f0f;
+    x += x >> 8;
+    x += x >> 16;
+    x += x >> 32;
+    return x & 0x7f;
+  }
+
+  // upper 64 bits of the 128-bit product a * b
+  static inline uint64 MulHigh(uint64 a, uint64 b) {
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__ppc64__) || defined(__aarch64__))
+    return static_cast<uint64>((static_cast<__uint128_t>(a) * b) >> 64);
+#elif defined(_MSC_VER) && defined(_M_X64)
+    return __umulh(a, b);
+#else
+    uint64 a_lo = a & 0xFFFFFFFF, a_hi = a >> 32;
+    uint64 b_lo = b & 0xFFFFFFFF, b_hi = b >> 32;
+    uint64 lo_lo = a_lo * b_lo;
+    uint64 hi_lo = a_hi * b_lo;
+    uint64 cross = (lo_lo >> 32) + (hi_lo & 0xFFFFFFFF) + a_lo * b_hi;
+    return (hi_lo >> 32) + (cross >> 32) + a_hi * b_hi;
+#endif
+  }
+
+};
+
+/**
+ * The ModularMultiplier class.
+ *
+ * Multiplies by a constant factor modulo a constant modulus (Shoup's method).
+ * Quotient of the product is estimated using precomputed reciprocal
+ * floor(factor * 2^64 / modulus), so each multiplication costs
+ * two multiplications and a conditional subtraction instead of a division.
+ * Modulus must be less than 2^63.
+ */
+class ModularMultiplier {
+
+public:
+  ModularMultiplier() : factor_(0), reciprocal_(0), modulus_(1) {}
+  ModularMultiplier(uint64 factor, uint64 modulus);
+
+  // (x * factor) mod modulus, for any x
+  inline uint64 Multiply(uint64 x) const {
+    uint64 quotient = StegoMath::MulHigh(x, reciprocal_);
+    uint64 result = x * factor_ - quotient * modulus_;
+    return (result >= modulus_) ? result - modulus_ : result;
+  }
+
+  uint64 GetFactor() const { return factor_; }
+  uint64 GetModulus() const { return modulus_; }
+
+  static const uint64 kMaxModulus = 0x7FFFFFFFFFFFFFFFULL;
 
+private:
+  uint64 factor_;
+  uint64 reciprocal_;
+  uint64 modulus_;
 };
 
 } // stego_disk
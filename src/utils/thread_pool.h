@@ -18,6 +18,10 @@
 #include <future>
 #include <functional>
 #include <stdexcept>
+#include <string>
+
+#include "utils/stego_types.h"
+#include "utils/tracer.h"
 
 
 namespace stego_disk {
@@ -29,7 +33,23 @@ public:
   auto enqueue(F&& f, Args&&... args)
   -> std::future<typename std::result_of<F(Args...)>::type>;
   ~ThreadPool();
+
+  size_t GetThreadCount() const;
+
+  // true on worker threads of any pool; tasks which could split their
+  // work between more threads stay serial there, pool keeps cores busy
+  static bool IsWorkerThread();
+
+  // calls function(begin, end) on contiguous ranges of <0; count) with
+  // std::async, a range per core (max_threads, 0 for number of cores
+  // and one on workers) but at least min_work units each; ranges are
+  // multiples of step except the last one
+  static void ForEachRange(uint64 count, uint64 min_work,
+                           const std::function<void(uint64, uint64)> &function,
+                           uint64 max_threads = 0, uint64 step = 1);
 private:
+  static bool& WorkerThreadFlag();
+
   std::vector<std::thread> workers;
   std::queue<std::function<void()> > tasks;
 
@@ -47,8 +67,10 @@ inline ThreadPool::ThreadPool(size_t threads)
 
   for(size_t i = 0; i < threads; ++i)
     workers.emplace_back(
-          [this]
+          [this, i]
     {
+      Tracer::SetThreadName("pool worker " + std::to_string(i));
+      WorkerThreadFlag() = true;
       for(;;)
       {
         std::function<void()> task;
@@ -63,12 +85,60 @@ inline ThreadPool::ThreadPool(size_t threads)
           this->tasks.pop();
         }
 
+        TraceScope trace("pool", "task");
         task();
       }
     }
     );
 }
 
+inline bool& ThreadPool::WorkerThreadFlag()
+{
+  static thread_local bool worker_thread = false;
+  return worker_thread;
+}
+
+inline size_t ThreadPool::GetThreadCount() const
+{
+  return workers.size();
+}
+
+inline bool ThreadPool::IsWorkerThread()
+{
+  return WorkerThreadFlag();
+}
+
+inline void ThreadPool::ForEachRange(
+    uint64 count, uint64 min_work,
+    const std::function<void(uint64, uint64)> &function,
+    uint64 max_threads, uint64 step)
+{
+  if (count == 0)
+    return;
+
+  uint64 threads = max_threads;
+  if (threads == 0)
+    threads = IsWorkerThread()
+        ? 1 : std::max(1u, std::thread::hardware_concurrency());
+  threads = std::min(threads, count / std::max<uint64>(min_work, 1));
+
+  if (threads <= 1) {
+    function(0, count);
+    return;
+  }
+
+  std::vector<std::future<void>> results;
+  uint64 range = ((count - 1) / threads / step + 1) * step;
+
+  for (uint64 begin = 0; begin < count; begin += range)
+    results.emplace_back(std::async(std::launch::async, function, begin,
+                                    std::min(count, begin + range)));
+
+  // ranges may use buffers of the caller, all of them finish first
+  for (auto &&result: results) result.wait();
+  for (auto &&result: results) result.get();
+}
+
 template<class F, class... Args>
 auto ThreadPool::enqueue(F&& f, Args&&... args)
 -> std::future<typename std::result_of<F(Args...)>::type>
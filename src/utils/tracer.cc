@@ -0,0 +1,166 @@
+/**
+* @file tracer.cc
+* @author Martin Kosdy
+* @author Matus Kysel
+* @date 2016
+* @brief Implementation of timeline tracer
+*
+*/
+
+#include "tracer.h"
+
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "utils/json.h"
+
+namespace stego_disk {
+
+struct TraceEvent {
+  const char *category;
+  const char *name;
+  std::string detail;
+  std::chrono::steady_clock::time_point begin;
+  std::chrono::steady_clock::time_point end;
+};
+
+// events of one thread; the mutex is contended only while writing JSON
+struct TraceBuffer {
+  std::mutex mutex;
+  uint32 thread_id;
+  std::string thread_name;
+  std::vector<TraceEvent> events;
+};
+
+struct TraceRegistry {
+  TraceRegistry() : next_thread_id(1) {}
+
+  std::mutex mutex;
+  std::vector<std::shared_ptr<TraceBuffer>> buffers;
+  uint32 next_thread_id;
+  std::chrono::steady_clock::time_point start;
+};
+
+std::atomic<bool> Tracer::enabled_(false);
+
+static TraceRegistry& Registry() {
+  static TraceRegistry *registry = new TraceRegistry();
+  return *registry;
+}
+
+static thread_local std::shared_ptr<TraceBuffer> thread_buffer;
+static thread_local std::string thread_name;
+
+static TraceBuffer& ThreadBuffer() {
+  if (!thread_buffer) {
+    TraceRegistry &registry = Registry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    thread_buffer = std::make_shared<TraceBuffer>();
+    thread_buffer->thread_id = registry.next_thread_id++;
+    thread_buffer->thread_name = thread_name;
+    registry.buffers.push_back(thread_buffer);
+  }
+  return *thread_buffer;
+}
+
+static json::JsonObject Number(double value) {
+  json::JsonObject object;
+  object.Assign(value);
+  return object;
+}
+
+/**
+ * @brief Clears recorded events and starts recording
+ */
+void Tracer::Start() {
+  TraceRegistry &registry = Registry();
+  {
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    for (auto &buffer : registry.buffers) {
+      std::lock_guard<std::mutex> buffer_lock(buffer->mutex);
+      buffer->events.clear();
+    }
+    registry.start = std::chrono::steady_clock::now();
+  }
+  enabled_.store(true);
+}
+
+void Tracer::Stop() {
+  enabled_.store(false);
+}
+
+void Tracer::SetThreadName(const std::string &name) {
+  thread_name = name;
+  if (thread_buffer) {
+    std::lock_guard<std::mutex> lock(thread_buffer->mutex);
+    thread_buffer->thread_name = name;
+  }
+}
+
+void Tracer::AddEvent(const char *category, const char *name,
+                      const std::string &detail,
+                      std::chrono::steady_clock::time_point begin,
+                      std::chrono::steady_clock::time_point end) {
+  TraceBuffer &buffer = ThreadBuffer();
+  std::lock_guard<std::mutex> lock(buffer.mutex);
+  TraceEvent event = { category, name, detail, begin, end };
+  buffer.events.push_back(std::move(event));
+}
+
+/**
+ * @brief Writes recorded events in Chrome trace event format
+ *
+ * Events are "complete" events (phase X) with timestamps in microseconds
+ * since Start, threads are named by "thread_name" metadata events.
+ *
+ * @param[in] path Output file
+ * @return false if the file cannot be written
+ */
+bool Tracer::WriteJson(const std::string &path) {
+  TraceRegistry &registry = Registry();
+  json::JsonObject events(json::JsonObject::ARRAY);
+
+  std::lock_guard<std::mutex> lock(registry.mutex);
+  for (auto &buffer : registry.buffers) {
+    std::lock_guard<std::mutex> buffer_lock(buffer->mutex);
+
+    if (!buffer->thread_name.empty()) {
+      json::JsonObject metadata;
+      metadata["name"] = json::JsonObject("thread_name");
+      metadata["ph"] = json::JsonObject("M");
+      metadata["pid"] = Number(1);
+      metadata["tid"] = Number(buffer->thread_id);
+      metadata["args"]["name"] = json::JsonObject(buffer->thread_name);
+      events.AddToArray(metadata);
+    }
+
+    for (auto &event : buffer->events) {
+      json::JsonObject object;
+      object["name"] = json::JsonObject(event.name);
+      object["cat"] = json::JsonObject(event.category);
+      object["ph"] = json::JsonObject("X");
+      object["pid"] = Number(1);
+      object["tid"] = Number(buffer->thread_id);
+      object["ts"] = Number(std::chrono::duration<double, std::micro>(
+                              event.begin - registry.start).count());
+      object["dur"] = Number(std::chrono::duration<double, std::micro>(
+                               event.end - event.begin).count());
+      if (!event.detail.empty())
+        object["args"]["detail"] = json::JsonObject(event.detail);
+      events.AddToArray(object);
+    }
+  }
+
+  json::JsonObject trace;
+  trace["traceEvents"] = events;
+  trace["displayTimeUnit"] = json::JsonObject("ms");
+
+  std::ofstream out(path);
+  if (!out.is_open()) return false;
+  out << trace.Serialize() << std::endl;
+  return out.good();
+}
+
+} // stego_disk
@@ -0,0 +1,84 @@
+/**
+* @file tracer.h
+* @author Martin Kosdy
+* @author Matus Kysel
+* @date 2016
+* @brief Timeline of operations in Chrome trace event format
+*
+*/
+
+#ifndef STEGODISK_UTILS_TRACER_H_
+#define STEGODISK_UTILS_TRACER_H_
+
+#include <atomic>
+#include <chrono>
+#include <string>
+
+#include "utils/stego_types.h"
+
+namespace stego_disk {
+
+/**
+ * The Tracer class.
+ *
+ * Records complete events (name, category, thread, begin and duration)
+ * into per-thread buffers while enabled. WriteJson stores them as Chrome
+ * trace event JSON, which can be opened in chrome://tracing or Perfetto.
+ * When tracing is disabled, TraceScope costs one relaxed atomic load.
+ */
+class Tracer {
+public:
+  static void Start();
+  static void Stop();
+  static bool WriteJson(const std::string &path);
+
+  static inline bool IsEnabled() {
+    return enabled_.load(std::memory_order_relaxed);
+  }
+
+  // name of the calling thread in the timeline
+  static void SetThreadName(const std::string &name);
+
+  // name and category must be string literals (they are not copied)
+  static void AddEvent(const char *category, const char *name,
+                       const std::string &detail,
+                       std::chrono::steady_clock::time_point begin,
+                       std::chrono::steady_clock::time_point end);
+
+private:
+  static std::atomic<bool> enabled_;
+};
+
+/**
+ * The TraceScope class.
+ *
+ * Records an event from construction to destruction, if tracing is enabled.
+ */
+class TraceScope {
+public:
+  TraceScope(const char *category, const char *name)
+    : category_(category), name_(name), active_(Tracer::IsEnabled()) {
+    if (active_) begin_ = std::chrono::steady_clock::now();
+  }
+
+  ~TraceScope() {
+    if (active_)
+      Tracer::AddEvent(category_, name_, detail_, begin_,
+                       std::chrono::steady_clock::now());
+  }
+
+  bool IsActive() const { return active_; }
+  // shown as argument of the event, set it only if IsActive
+  void SetDetail(const std::string &detail) { detail_ = detail; }
+
+private:
+  const char *category_;
+  const char *name_;
+  bool active_;
+  std::string detail_;
+  std::chrono::steady_clock::time_point begin_;
+};
+
+} // stego_disk
+
+#endif // STEGODISK_UTILS_TRACER_H_
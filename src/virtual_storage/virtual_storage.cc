@@ -30,7 +30,7 @@ void VirtualStorage::Init() {
   global_permutation_ = std::shared_ptr<Permutation>(nullptr);
 }
 
-VirtualStorage::VirtualStorage() {
+VirtualStorage::VirtualStorage() : counters_(nullptr) {
   Init();
 }
 
@@ -184,6 +184,30 @@ void VirtualStorage::WriteByte(uint64 position, uint8 value) {
   data_[global_permutation_->Permute(position)] = value;
 }
 
+/**
+ * @brief Returns global permutation of the storage
+ *
+ * Used by CarrierKernel, which permutes positions without
+ * calling virtual Permute for every byte.
+ *
+ * @return Global permutation (may be nullptr)
+ */
+std::shared_ptr<Permutation> VirtualStorage::GetPermutation() const {
+  return global_permutation_;
+}
+
+/**
+ * @brief Returns pointer to the storage buffer (not permuted)
+ *
+ * Buffer has GetRawCapacity() bytes. Pointer is valid until
+ * the next call of ApplyPermutation.
+ *
+ * @return Pointer to the first byte of the storage
+ */
+uint8* VirtualStorage::GetRawPointer() {
+  return data_.GetRawPointer();
+}
+
 /**
  * @brief Reads length bytes from offset to buffer
  *
@@ -279,7 +303,7 @@ bool VirtualStorage::IsValidChecksum() {
                                 "capacity storage is not Initialized yet");
 
   //TODO:    #warning Sync hash length with SFS_STORAGE_HASH_LENGTH
-  Hash checksum(data_.GetConstRawPointer(), usable_capacity_);
+  Hash checksum = ComputeChecksum();
 
   MemoryBuffer stored_checksum(data_.GetConstRawPointer() + usable_capacity_,
                                SFS_STORAGE_HASH_LENGTH);
@@ -297,6 +321,40 @@ bool VirtualStorage::IsValidChecksum() {
 }
 
 
+/**
+ * @brief Computes hash of the usable part of the storage
+ *
+ * Storage is fed to the hash in chunks of kChecksumChunkSize bytes,
+ * so its size is not limited by the length type of a single hash call.
+ * Hash implementation is the one configured for storage integrity
+ * (see Hash::Purpose), tree hashes process each chunk in parallel.
+ *
+ * @return Hash with the checksum as its state
+ */
+Hash VirtualStorage::ComputeChecksum() const {
+  PhaseTimer timer(counters_, StegoStats::STORAGE, StegoStats::CHECKSUM,
+                   usable_capacity_);
+  Hash checksum(Hash::Purpose::STORAGE);
+  const uint8* data = data_.GetConstRawPointer();
+
+  for (uint64 offset = 0; offset < usable_capacity_;
+       offset += kChecksumChunkSize) {
+    uint64 length = usable_capacity_ - offset;
+    if (length > kChecksumChunkSize) length = kChecksumChunkSize;
+    checksum.Update(data + offset, length);
+  }
+  checksum.Final();
+
+  return checksum;
+}
+
+/**
+ * @brief Sets counters for timing of checksum computation (nullptr disables it)
+ */
+void VirtualStorage::SetPerfCounters(PerfCounters *counters) {
+  counters_ = counters;
+}
+
 /**
  * @brief Writes checksum of currently stored data_ at the end of the storage
  *
@@ -307,7 +365,7 @@ void VirtualStorage::WriteChecksum() {
 
   //TODO:    #warning Sync hash length with SFS_STORAGE_HASH_LENGTH
 
-  Hash checksum(data_.GetConstRawPointer(), usable_capacity_);
+  Hash checksum = ComputeChecksum();
 
   data_.Write(usable_capacity_, checksum.GetState().GetConstRawPointer(),
               checksum.GetStateSize());
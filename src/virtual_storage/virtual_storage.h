@@ -15,6 +15,8 @@
 #include "utils/stego_types.h"
 #include "permutations/permutation_factory.h"
 #include "keys/key.h"
+#include "hash/hash.h"
+#include "utils/perf_counters.h"
 
 
 namespace stego_disk {
@@ -45,6 +47,10 @@ public:
   void WriteByte(uint64 position, uint8 value);
   uint8 ReadByte(uint64 position);
 
+  // Accessed by CarrierKernel, which permutes positions itself
+  std::shared_ptr<Permutation> GetPermutation() const;
+  uint8* GetRawPointer();
+
   // Accessed by main I/O layer (Fuse, VirtualDisc driver..)
   void Read(uint64 offSet, std::size_t length, uint8* buffer) const;
   void Write(uint64 offSet, std::size_t length, const uint8* buffer);
@@ -59,12 +65,19 @@ public:
   bool IsValidChecksum();
   void WriteChecksum();
 
+  void SetPerfCounters(PerfCounters *counters);
+
 private:
+  Hash ComputeChecksum() const;
+
+  static const uint64 kChecksumChunkSize = 1 << 26;
+
   std::shared_ptr<Permutation> global_permutation_;
   bool   is_set_global_permutation_;
   uint64 raw_capacity_;                // raw capacity (hash + storage)
   uint64 usable_capacity_;             // usable capacity (storage only)
   MemoryBuffer data_;
+  PerfCounters *counters_;
 };
 
 } // stego_disk